@@ -22,8 +22,11 @@ Reads packets from a file in ERF format, produced by the University of
 Waikato's DAG tools. Pushes them out the output, and optionally stops the
 driver when there are no more packets.
 
-FromDAGDump also transparently reads gzip- and bzip2-compressed files, if you
-have zcat(1) and bzcat(1) installed.
+FromDAGDump also transparently reads gzip- and bzip2-compressed files.  It
+decompresses them in-process when Click was built with zlib and libbz2, and
+otherwise runs zcat(1) or bzcat(1), if installed.  In-process decompression
+works on the standard input too, and, with multithreaded Click, runs in a
+separate thread that decompresses ahead of the reader.
 
 Keyword arguments are:
 
@@ -101,6 +104,12 @@ Legacy-format dumps don't contain any encapsulation information, however, so
 you should supply an encapsulation type explicitly (or FromDAGDump will assume
 ENCAP type "ATM").
 
+=item DECOMPRESS
+
+Boolean. If true, then FromDAGDump decompresses gzip- and bzip2-compressed
+files itself, rather than running zcat(1) or bzcat(1).  This requires a Click
+built with zlib and libbz2.  Default is true.
+
 =item MMAP
 
 Boolean. If true, then FromDAGDump will use mmap(2) to access the tcpdump
@@ -142,6 +151,12 @@ Returns the filename supplied to FromDAGDump.
 Returns the length of the FromDAGDump file, in bytes, or "-" if that length
 cannot be determined (because the file was compressed, for example).
 
+=h decompress_rate read-only
+
+Returns the rate at which FromDAGDump has decompressed the file, in
+uncompressed bytes per second of decompression time, or "-" if the file is
+not being decompressed in-process.
+
 =h filepos read-only
 
 Returns FromDAGDump's position in the (uncompressed) file, in bytes.
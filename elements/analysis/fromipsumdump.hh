@@ -13,7 +13,7 @@ CLICK_DECLS
 /*
 =c
 
-FromIPSummaryDump(FILENAME [, I<keywords> STOP, TIMING, ACTIVE, ZERO, CHECKSUM, PROTO, MULTIPACKET, SAMPLE, CONTENTS, FLOWID])
+FromIPSummaryDump(FILENAME [, I<keywords> STOP, TIMING, ACTIVE, ZERO, CHECKSUM, PROTO, MULTIPACKET, SAMPLE, CONTENTS, FLOWID, SELECT, START, END])
 
 =s traces
 
@@ -24,13 +24,15 @@ reads packets from an IP summary dump file
 Reads IP packet descriptors from a file produced by ToIPSummaryDump, then
 creates packets containing info from the descriptors and pushes them out the
 output. Optionally stops the driver when there are no more packets.
+The file may be in ASCII, binary, or columnar format (see ToIPSummaryDump).
 
-The file may be compressed with gzip(1) or bzip2(1); FromIPSummaryDump will
-run zcat(1) or bzcat(1) to uncompress it.
+The file may be compressed with gzip(1) or bzip2(1).  When Click was built
+with zlib and libbz2, FromIPSummaryDump uncompresses it in-process; otherwise it
+runs zcat(1) or bzcat(1).
 
 FromIPSummaryDump reads from the file named FILENAME unless FILENAME is a
-single dash 'C<->', in which case it reads from the standard input. It will
-not uncompress the standard input, however.
+single dash 'C<->', in which case it reads from the standard input. It
+uncompresses the standard input only in-process.
 
 Keyword arguments are:
 
@@ -100,6 +102,23 @@ destination address, destination port, and, optionally, protocol). Defines the
 IP addresses and ports used by default. Any flow information in the input file
 will override this setting.
 
+=item SELECT
+
+String, containing a space-separated list of content names. If given, then
+FromIPSummaryDump ignores dump fields not in the list. In columnar dumps, the
+ignored fields are not even decoded. Default is to use every field.
+
+=item START
+
+Absolute time in seconds since the epoch. FromIPSummaryDump will skip packets
+with timestamps before that time. In columnar dumps, FromIPSummaryDump skips
+earlier blocks without decoding them.
+
+=item END
+
+Absolute time in seconds since the epoch. FromIPSummaryDump will stop when
+encountering a packet with timestamp at or after that time.
+
 =item ALLOW_NONEXISTENT
 
 Boolean.  If true, allow nonexistent and empty files: FromIPSummaryDump will
@@ -176,6 +195,10 @@ class FromIPSummaryDump : public Element, public IPSummaryDumpInfo { public:
 
     Vector<const IPSummaryDump::FieldReader *> _fields;
     Vector<int> _field_order;
+    Vector<uint8_t> _field_used;
+    Vector<uint8_t> _field_fast;
+    Vector<const char *> _tokens;
+    Vector<const IPSummaryDump::FieldReader *> _select;
     uint16_t _default_proto;
     uint32_t _sampling_prob;
     IPFlowID _flowid;
@@ -193,11 +216,18 @@ class FromIPSummaryDump : public Element, public IPSummaryDumpInfo { public:
     bool _timing : 1;
     bool _have_timing : 1;
     bool _allow_nonexistent : 1;
+    bool _columnar : 1;
     Packet *_work_packet;
     uint32_t _multipacket_length;
     Timestamp _multipacket_timestamp_delta;
     Timestamp _multipacket_end_timestamp;
     Timestamp _timing_offset;
+    Timestamp _start;
+    Timestamp _end;
+
+    Vector<String> _columns;
+    Vector<const uint8_t *> _column_pos;
+    uint32_t _block_left;
 
     Task _task;
     ActiveNotifier _notifier;
@@ -207,6 +237,7 @@ class FromIPSummaryDump : public Element, public IPSummaryDumpInfo { public:
     IPFlowID _given_flowid;
 
     int read_binary(String &, ErrorHandler *);
+    int read_block(uint32_t record_length, ErrorHandler *);
 
     static int sort_fields_compare(const void *, const void *, void *);
     void bang_data(const String &, ErrorHandler *);
@@ -214,6 +245,7 @@ class FromIPSummaryDump : public Element, public IPSummaryDumpInfo { public:
     void bang_flowid(const String &, ErrorHandler *);
     void bang_aggregate(const String &, ErrorHandler *);
     void bang_binary(const String &, ErrorHandler *);
+    void bang_columnar(const String &, ErrorHandler *);
     void check_defaults();
     bool check_timing(Packet *p);
     Packet *read_packet(ErrorHandler *);
@@ -23,8 +23,11 @@ Reads IP packets from a file in a format used for NLANR traces: either FR,
 FR+, or TSH. Pushes them out the output, and optionally stops the driver when
 there are no more packets.
 
-FromNLANRDump also transparently reads gzip- and bzip2-compressed files, if
-you have zcat(1) and bzcat(1) installed.
+FromNLANRDump also transparently reads gzip- and bzip2-compressed files.  It
+decompresses them in-process when Click was built with zlib and libbz2, and
+otherwise runs zcat(1) or bzcat(1), if installed.  In-process decompression
+works on the standard input too, and, with multithreaded Click, runs in a
+separate thread that decompresses ahead of the reader.
 
 Keyword arguments are:
 
@@ -95,6 +98,12 @@ probability.
 Boolean. If true, then FromNLANRDump tries to maintain the inter-packet timing
 of the original packet stream. False by default.
 
+=item DECOMPRESS
+
+Boolean. If true, then FromNLANRDump decompresses gzip- and bzip2-compressed
+files itself, rather than running zcat(1) or bzcat(1).  This requires a Click
+built with zlib and libbz2.  Default is true.
+
 =item MMAP
 
 Boolean. If true, then FromNLANRDump will use mmap(2) to access the tcpdump
@@ -142,6 +151,12 @@ Returns the filename supplied to FromNLANRDump.
 Returns the length of the FromNLANRDump file, in bytes, or "-" if that length
 cannot be determined (because the file was compressed, for example).
 
+=h decompress_rate read-only
+
+Returns the rate at which FromNLANRDump has decompressed the file, in
+uncompressed bytes per second of decompression time, or "-" if the file is
+not being decompressed in-process.
+
 =h filepos read-only
 
 Returns FromNLANRDump's position in the (uncompressed) file, in bytes.
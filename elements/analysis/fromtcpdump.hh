@@ -26,12 +26,13 @@ Reads textual TCP/IP packet descriptors from an ASCII tcpdump(1) output file,
 then creates packets resembling those descriptors and pushes them out the
 output. Optionally stops the driver when there are no more packets.
 
-The file may be compressed with gzip(1) or bzip2(1); FromTcpdump will
-run zcat(1) or bzcat(1) to uncompress it.
+The file may be compressed with gzip(1) or bzip2(1).  When Click was built
+with zlib and libbz2, FromTcpdump uncompresses it in-process; otherwise it
+runs zcat(1) or bzcat(1).
 
 FromTcpdump reads from the file named FILENAME unless FILENAME is a
-single dash `C<->', in which case it reads from the standard input. It will
-not uncompress the standard input, however.
+single dash `C<->', in which case it reads from the standard input. It
+uncompresses the standard input only in-process.
 
 FromTcpdump doesn't parse many of the relevant parts of the file. It handles
 fragments badly, for example. Mostly it just does TCP and some rudimentary
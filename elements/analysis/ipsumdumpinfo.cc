@@ -28,6 +28,9 @@
 #include <clicknet/tcp.h>
 #include <clicknet/udp.h>
 #include <clicknet/icmp.h>
+#if HAVE_ZLIB
+# include <zlib.h>
+#endif
 CLICK_DECLS
 
 static Vector<const void *> *writers;
@@ -342,6 +345,176 @@ const uint8_t *inb(PacketOdesc& d, const uint8_t *s, const uint8_t *end, const F
     }
 }
 
+static int column_lane(int type, int &width)
+{
+    switch (type) {
+      case B_1:
+	width = 1;
+	return 1;
+      case B_2:
+	width = 2;
+	return 2;
+      case B_4:
+      case B_4NET:
+	width = 4;
+	return 4;
+      case B_8:
+	width = 8;
+	return 4;
+      default:
+	width = 0;
+	return 0;
+    }
+}
+
+static inline uint32_t get_lane(const uint8_t *s, int lane)
+{
+    if (lane == 4)
+	return GET4(s);
+    else if (lane == 2)
+	return GET2(s);
+    else
+	return s[0];
+}
+
+void encode_column(StringAccum &sa, const uint8_t *data, uint32_t len,
+		   int type, bool compress)
+{
+    int width, lane = column_lane(type, width);
+    if (lane && len % width != 0)
+	lane = 0;
+
+    // Integer lanes become zigzag varints of their differences from the
+    // previous record's lane; small, slowly changing values get short.
+    StringAccum coded;
+    if (lane && len) {
+	int nlanes = width / lane, shift = 32 - 8 * lane;
+	uint32_t prev[2] = {0, 0};
+	uint8_t *o = (uint8_t *) coded.extend((len / lane) * 5);
+	if (!o)
+	    return;
+	uint8_t *ostart = o;
+	for (const uint8_t *s = data; s < data + len; )
+	    for (int l = 0; l < nlanes; ++l, s += lane) {
+		uint32_t v = get_lane(s, lane);
+		int32_t delta = (int32_t) ((v - prev[l]) << shift) >> shift;
+		uint32_t z = ((uint32_t) delta << 1) ^ (uint32_t) (delta >> 31);
+		prev[l] = v;
+		for (; z >= 0x80; z >>= 7)
+		    *o++ = z | 0x80;
+		*o++ = z;
+	    }
+	coded.set_length(o - ostart);
+	data = (const uint8_t *) coded.data();
+	len = coded.length();
+    }
+
+    int encoding = lane;
+    uint32_t stored_len = len;
+    int hpos = sa.length();
+    if (!sa.extend(COLUMN_HEADER_SIZE))
+	return;
+#if HAVE_ZLIB
+    if (compress && len > 64) {
+	uLongf clen = compressBound(len);
+	if (char *c = sa.reserve(clen))
+	    if (compress2((Bytef *) c, &clen, data, len, Z_BEST_SPEED) == Z_OK
+		&& clen < len) {
+		sa.adjust_length(clen);
+		encoding |= COLUMN_ZLIB;
+		stored_len = clen;
+	    }
+    }
+#else
+    (void) compress;
+#endif
+    if (!(encoding & COLUMN_ZLIB))
+	sa.append((const char *) data, len);
+
+    uint8_t *h = (uint8_t *) sa.data() + hpos;
+    h[0] = encoding;
+    h[1] = (lane ? width : 0);
+    h[2] = h[3] = 0;
+    PUT4(h + 4, stored_len);
+    PUT4(h + 8, len);
+}
+
+const uint8_t *decode_column(String &result, const uint8_t *s,
+			     const uint8_t *end, uint32_t nrecords, bool skip)
+{
+    if (s + COLUMN_HEADER_SIZE > end)
+	return 0;
+    int encoding = s[0], lane = encoding & ~COLUMN_ZLIB, width = s[1];
+    uint32_t stored_len = GET4(s + 4), len = GET4(s + 8);
+    s += COLUMN_HEADER_SIZE;
+    if (stored_len > (uint32_t) (end - s) || len > (uint32_t) INT_MAX)
+	return 0;
+    const uint8_t *next = s + stored_len;
+    if (skip)
+	return next;
+
+    String expanded;
+    if (encoding & COLUMN_ZLIB) {
+#if HAVE_ZLIB
+	expanded = String::make_uninitialized(len);
+	uLongf elen = len;
+	if (!expanded.mutable_data()
+	    || uncompress((Bytef *) expanded.mutable_data(), &elen, s, stored_len) != Z_OK
+	    || elen != len)
+	    return 0;
+	s = (const uint8_t *) expanded.data();
+#else
+	return 0;
+#endif
+    } else if (len != stored_len)
+	return 0;
+
+    if (lane == 0) {
+	if (s == (const uint8_t *) expanded.data())
+	    result = expanded;
+	else
+	    result = String((const char *) s, len);
+	return next;
+    } else if ((lane != 1 && lane != 2 && lane != 4)
+	       || width == 0 || width % lane != 0 || width / lane > 2)
+	return 0;
+
+    // Every value takes at least one byte, so a count the data cannot
+    // cover is corrupt; this also keeps the output size from overflowing.
+    int nlanes = width / lane, shift = 32 - 8 * lane;
+    if (nrecords > (uint32_t) (INT_MAX / width)
+	|| (uint64_t) nrecords * nlanes > len)
+	return 0;
+    uint32_t prev[2] = {0, 0};
+    result = String::make_uninitialized(nrecords * width);
+    uint8_t *o = (uint8_t *) result.mutable_data();
+    if (!o && nrecords)
+	return 0;
+    const uint8_t *e = s + len;
+    for (uint32_t r = 0; r < nrecords; ++r)
+	for (int l = 0; l < nlanes; ++l) {
+	    uint32_t z = 0;
+	    for (int bits = 0; ; bits += 7) {
+		if (s == e || bits > 28)
+		    return 0;
+		z |= (uint32_t) (*s & 0x7F) << bits;
+		if (!(*s++ & 0x80))
+		    break;
+	    }
+	    uint32_t v = prev[l] + ((z >> 1) ^ -(z & 1));
+	    v = (v << shift) >> shift;
+	    prev[l] = v;
+	    if (lane == 4)
+		PUT4(o, v);
+	    else if (lane == 2)
+		PUT2(o, v);
+	    else
+		PUT1(o, v);
+	    o += lane;
+	}
+    return (s == e ? next : 0);
+}
+
 
 
 void ip_prepare(PacketDesc &d, const FieldWriter *)
@@ -171,6 +171,21 @@ void outb(const PacketDesc&, bool ok, const FieldWriter *);
 bool num_ina(PacketOdesc&, const String &, const FieldReader *);
 const uint8_t *inb(PacketOdesc&, const uint8_t*, const uint8_t*, const FieldReader *);
 
+// Columnar dumps store a block of records field by field.  Integer fields
+// are stored as zigzag varints of per-lane differences from the previous
+// record, other fields as their concatenated binary values; either may then
+// be zlib-compressed.  A column has a COLUMN_HEADER_SIZE header: encoding
+// byte (lane width or 0, plus COLUMN_ZLIB), record width, 2 reserved bytes,
+// stored length, and expanded length.
+enum { BLOCK_HEADER_SIZE = 24,
+       COLUMN_HEADER_SIZE = 12,
+       COLUMN_ZLIB = 0x80,
+       MAX_BLOCK_PACKETS = 1048576 };
+void encode_column(StringAccum &sa, const uint8_t *data, uint32_t len,
+		   int type, bool compress);
+const uint8_t *decode_column(String &result, const uint8_t *s,
+			     const uint8_t *end, uint32_t nrecords, bool skip);
+
 enum { MISSING_IP = 0,
        MISSING_ETHERNET = 260 };
 inline bool field_missing(const PacketDesc &d, int proto, int l);
@@ -31,7 +31,7 @@
 CLICK_DECLS
 
 ToIPSummaryDump::ToIPSummaryDump()
-    : _f(0), _task(this)
+    : _task(this)
 {
 }
 
@@ -48,9 +48,13 @@ ToIPSummaryDump::configure(Vector<String> &conf, ErrorHandler *errh)
     bool careful_trunc = true;
     bool multipacket = false;
     bool binary = false;
+    bool columnar = false;
+    uint32_t block_packets = 4096;
     bool header = true;
     bool extra_length = true;
 
+    if (_writer.configure_keywords(conf, this, errh) < 0)
+	return -1;
     if (Args(conf, this, errh)
 	.read_mp("FILENAME", FilenameArg(), _filename)
 	.read("CONTENTS", AnyArg(), save)
@@ -63,8 +67,12 @@ ToIPSummaryDump::configure(Vector<String> &conf, ErrorHandler *errh)
 	.read("CAREFUL_TRUNC", careful_trunc)
 	.read("EXTRA_LENGTH", extra_length)
 	.read("BINARY", binary)
+	.read("COLUMNAR", columnar)
+	.read("BLOCK_PACKETS", block_packets)
 	.complete() < 0)
 	return -1;
+    if (block_packets == 0 || block_packets > IPSummaryDump::MAX_BLOCK_PACKETS)
+	return errh->error("BLOCK_PACKETS out of range");
 
     Vector<String> v;
     cp_spacevec(save, v);
@@ -90,8 +98,8 @@ ToIPSummaryDump::configure(Vector<String> &conf, ErrorHandler *errh)
 	// binary size
       found_prepare:
 	int s = f->binary_size();
-	if ((s < 0 || !f->outb) && binary)
-	    errh->error("cannot use CONTENTS %s with BINARY", word.c_str());
+	if ((s < 0 || !f->outb) && (binary || columnar))
+	    errh->error("cannot use CONTENTS %s with %s", word.c_str(), columnar ? "COLUMNAR" : "BINARY");
 	_binary_size += s;
 
 	// remove _multipacket if packet count specified
@@ -105,7 +113,9 @@ ToIPSummaryDump::configure(Vector<String> &conf, ErrorHandler *errh)
     _bad_packets = bad_packets;
     _careful_trunc = careful_trunc;
     _multipacket = multipacket;
-    _binary = binary;
+    _binary = binary || columnar;
+    _columnar = columnar;
+    _block_packets = block_packets;
     _header = header;
     _extra_length = extra_length;
 
@@ -115,15 +125,9 @@ ToIPSummaryDump::configure(Vector<String> &conf, ErrorHandler *errh)
 int
 ToIPSummaryDump::initialize(ErrorHandler *errh)
 {
-    assert(!_f);
-    if (_filename != "-") {
-	_f = fopen(_filename.c_str(), "wb");
-	if (!_f)
-	    return errh->error("%s: %s", _filename.c_str(), strerror(errno));
-    } else {
-	_f = stdout;
-	_filename = "<stdout>";
-    }
+    if (_writer.initialize(_filename, false, errh) < 0)
+	return -1;
+    _filename = _writer.filename();
 
     if (input_is_pull(0)) {
 	ScheduleInfo::join_scheduler(this, &_task, errh);
@@ -131,6 +135,11 @@ ToIPSummaryDump::initialize(ErrorHandler *errh)
     }
     _active = true;
     _output_count = 0;
+    _block_count = 0;
+    if (_columnar) {
+	_columns.resize(_fields.size());
+	_field_ends.resize(_fields.size());
+    }
 
     // magic number
     StringAccum sa;
@@ -161,12 +170,14 @@ ToIPSummaryDump::initialize(ErrorHandler *errh)
     sa << '\n';
 
     // binary marker
-    if (_binary)
+    if (_columnar)
+	sa << "!columnar\n";
+    else if (_binary)
 	sa << "!binary\n";
 
     // print output
     if (_header)
-	ignore_result(fwrite(sa.data(), 1, sa.length(), _f));
+	_writer.set_header(sa.take_string());
 
     return 0;
 }
@@ -174,13 +185,13 @@ ToIPSummaryDump::initialize(ErrorHandler *errh)
 void
 ToIPSummaryDump::cleanup(CleanupStage)
 {
-    if (_f && _f != stdout)
-	fclose(_f);
-    _f = 0;
+    if (_columnar && _block_count)
+	write_block();
+    _writer.cleanup();
 }
 
 bool
-ToIPSummaryDump::summary(Packet* p, StringAccum& sa, StringAccum* bad_sa) const
+ToIPSummaryDump::summary(Packet* p, StringAccum& sa, StringAccum* bad_sa, uint32_t* field_ends) const
 {
     IPSummaryDump::PacketDesc d(this, p, &sa, bad_sa, _careful_trunc, _extra_length);
 
@@ -193,6 +204,8 @@ ToIPSummaryDump::summary(Packet* p, StringAccum& sa, StringAccum* bad_sa) const
 	    d.clear_values();
 	    bool ok = _fields[i]->extract(d, _fields[i]);
 	    _fields[i]->outb(d, ok, _fields[i]);
+	    if (field_ends)
+		field_ends[i] = sa.length();
 	}
 	*(reinterpret_cast<uint32_t*>(sa.data())) = htonl(sa.length());
     } else {
@@ -247,14 +260,72 @@ ToIPSummaryDump::write_packet(Packet* p, int multipacket)
 	_sa.clear();
 	_bad_sa.clear();
 
-	summary(p, _sa, (_bad_packets ? &_bad_sa : 0));
+	summary(p, _sa, (_bad_packets ? &_bad_sa : 0), (_columnar ? _field_ends.begin() : 0));
 
 	if (_bad_packets && _bad_sa)
 	    write_line(_bad_sa.take_string());
-	ignore_result(fwrite(_sa.data(), 1, _sa.length(), _f));
+	if (_columnar) {
+	    append_block_record(p->timestamp_anno());
+	    return;
+	}
+	int r = _writer.write(_sa.data(), _sa.length());
+	if (r > 0)
+	    _output_count++;
+	else if (r < 0) {
+	    _active = false;
+	    click_chatter("%p{element}: %s", this, _writer.error().c_str());
+	}
+    }
+}
+
+void
+ToIPSummaryDump::append_block_record(const Timestamp &ts)
+{
+    const char *data = _sa.data();
+    uint32_t pos = 4;
+    for (int i = 0; i < _fields.size(); i++) {
+	_columns[i].append(data + pos, _field_ends[i] - pos);
+	pos = _field_ends[i];
+    }
+    if (!_block_count || ts < _block_first)
+	_block_first = ts;
+    if (!_block_count || ts > _block_last)
+	_block_last = ts;
+    if (++_block_count == _block_packets)
+	write_block();
+}
+
+int
+ToIPSummaryDump::write_block()
+{
+    if (!_block_count)
+	return 0;
+
+    _block_sa.clear();
+    if (!_block_sa.extend(IPSummaryDump::BLOCK_HEADER_SIZE))
+	return -1;
+    for (int i = 0; i < _fields.size(); i++) {
+	IPSummaryDump::encode_column(_block_sa, (const uint8_t *) _columns[i].data(), _columns[i].length(), _fields[i]->type, true);
+	_columns[i].clear();
+    }
 
-	_output_count++;
+    uint32_t *h = reinterpret_cast<uint32_t *>(_block_sa.data());
+    h[0] = htonl(_block_sa.length());
+    h[1] = htonl(_block_count);
+    h[2] = htonl(_block_first.sec());
+    h[3] = htonl(_block_first.nsec());
+    h[4] = htonl(_block_last.sec());
+    h[5] = htonl(_block_last.nsec());
+
+    int r = _writer.write(_block_sa.data(), _block_sa.length());
+    if (r > 0)
+	_output_count += _block_count;
+    else if (r < 0) {
+	_active = false;
+	click_chatter("%p{element}: %s", this, _writer.error().c_str());
     }
+    _block_count = 0;
+    return r;
 }
 
 void
@@ -287,11 +358,13 @@ ToIPSummaryDump::write_line(const String& s)
 {
     if (s.length()) {
 	assert(s.back() == '\n');
+	if (_columnar && _block_count)
+	    write_block();
 	if (_binary) {
 	    uint32_t marker = htonl(s.length() | 0x80000000U);
-	    ignore_result(fwrite(&marker, 4, 1, _f));
-	}
-	ignore_result(fwrite(s.data(), 1, s.length(), _f));
+	    _writer.write(&marker, 4, s.data(), s.length());
+	} else
+	    _writer.write(s.data(), s.length());
     }
 }
 
@@ -299,24 +372,30 @@ void
 ToIPSummaryDump::add_note(const String &s)
 {
     if (s.length()) {
-	int extra = 1 + (s.back() == '\n' ? 0 : 1);
+	String note = "#" + s;
+	if (s.back() != '\n')
+	    note += '\n';
+	if (_columnar && _block_count)
+	    write_block();
 	if (_binary) {
-	    uint32_t marker = htonl((s.length() + extra) | 0x80000000U);
-	    ignore_result(fwrite(&marker, 4, 1, _f));
-	}
-	fputc('#', _f);
-	ignore_result(fwrite(s.data(), 1, s.length(), _f));
-	if (extra > 1)
-	    fputc('\n', _f);
+	    uint32_t marker = htonl(note.length() | 0x80000000U);
+	    _writer.write(&marker, 4, note.data(), note.length());
+	} else
+	    _writer.write(note.data(), note.length());
     }
 }
 
 int
-ToIPSummaryDump::flush_handler(const String &, Element *e, void *, ErrorHandler *)
+ToIPSummaryDump::flush_handler(const String &, Element *e, void *, ErrorHandler *errh)
 {
     ToIPSummaryDump *tod = (ToIPSummaryDump *) e;
-    if (tod->_f)
-	fflush(tod->_f);
+    // A partial COLUMNAR block is written before the flush, so readers see
+    // every packet received so far.
+    int r = tod->_columnar ? tod->write_block() : 0;
+    if (r >= 0)
+	r = tod->_writer.flush();
+    if (r < 0)
+	return errh->error("%s", tod->_writer.error().c_str());
     return 0;
 }
 
@@ -326,8 +405,9 @@ ToIPSummaryDump::add_handlers()
     if (input_is_pull(0))
 	add_task_handlers(&_task);
     add_write_handler("flush", flush_handler);
+    _writer.add_handlers(this);
 }
 
-ELEMENT_REQUIRES(userlevel IPSummaryDump IPSummaryDump_Anno IPSummaryDump_IP IPSummaryDump_TCP IPSummaryDump_UDP IPSummaryDump_ICMP IPSummaryDump_Payload IPSummaryDump_Link)
+ELEMENT_REQUIRES(userlevel AsyncWriter IPSummaryDump IPSummaryDump_Anno IPSummaryDump_IP IPSummaryDump_TCP IPSummaryDump_UDP IPSummaryDump_ICMP IPSummaryDump_Payload IPSummaryDump_Link)
 EXPORT_ELEMENT(ToIPSummaryDump)
 CLICK_ENDDECLS
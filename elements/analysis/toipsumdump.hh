@@ -6,6 +6,7 @@
 #include <click/straccum.hh>
 #include <click/notifier.hh>
 #include "ipsumdumpinfo.hh"
+#include "elements/userlevel/asyncwriter.hh"
 CLICK_DECLS
 
 /*
@@ -23,7 +24,8 @@ Writes summary information about incoming packets to FILENAME in a simple
 ASCII format---each line corresponds to a packet.  The CONTENTS keyword
 argument determines what information is written.  Writes to standard output if
 FILENAME is a single dash `C<->'.  The BINARY keyword argument writes a packed
-binary format to save space.
+binary format to save space, and the COLUMNAR keyword argument writes a
+smaller, block-compressed format that is quick to read back.
 
 ToIPSummaryDump uses packets' extra-length and extra-packet-count annotations.
 
@@ -137,6 +139,18 @@ of the dump. Ignored if HEADER is false.
 Boolean. If true, then output packet records in a binary format (explained
 below). Defaults to false.
 
+=item COLUMNAR
+
+Boolean. If true, then output packet records in blocks, storing each field
+as a compressed column (explained below). Columnar dumps are usually several
+times smaller than binary dumps, and FromIPSummaryDump can skip blocks by
+time and decode only some fields. Defaults to false.
+
+=item BLOCK_PACKETS
+
+Integer. With COLUMNAR, the maximum number of packets per block. Larger
+blocks compress better; smaller blocks allow finer seeking. Defaults to 4096.
+
 =item MULTIPACKET
 
 Boolean. If true, and the CONTENTS option doesn't contain 'C<count>', then
@@ -163,6 +177,11 @@ Actual packet output immediately follows the 'C<!bad>' line.  Default is true.
 
 Boolean.  If false, then ignore extra length annotations.  Defaults to true.
 
+=item ASYNC, BUFFER_SIZE, MAX_BUFFERED, BLOCK, ROTATE_SIZE, ROTATE_INTERVAL
+
+Write the dump from a separate thread, and start new files by size or age,
+as for ToDump.  Each new file begins with the dump's header lines.
+
 =back
 
 =e
@@ -338,9 +357,54 @@ The data stored in a metadata record is just an ASCII string, ending with
 newline, same as in a regular ASCII IPSummaryDump file. 'C<!bad>' records, for
 example, are stored this way.
 
+=head1 COLUMNAR FORMAT
+
+Columnar IPSummaryDump files begin with ASCII lines, and the line
+'C<!columnar>' indicates that the rest of the file consists of records in the
+binary format above. Metadata records are as in binary files, but every
+other record is a block containing up to BLOCK_PACKETS packets:
+
+   +---------------+---------------+-------------------------------+
+   |0|record length| packet count  | first timestamp (sec + nsec)  |
+   +---------------+---------------+-------------------------------+
+   | last timestamp (sec + nsec)   |  columns ...
+   +-------------------------------+--------------...
+
+The first and last timestamps are the earliest and latest packet timestamps
+in the block; readers can skip blocks outside a time range without decoding
+them. One column follows for each field in the 'C<!data>' line:
+
+   +-------+-------+-------+---------------+---------------+-----...
+   |  enc  | width |   0   | stored length |expanded length| data
+   +-------+-------+-------+---------------+---------------+-----...
+
+If the low bits of 'C<enc>' are zero, then the expanded data is the
+concatenation of the packets' binary field values. Otherwise, each packet's
+value, which is 'C<width>' bytes long, is split into lanes of 'C<enc>' (1, 2,
+or 4) bytes, and the expanded data contains, for each packet and lane, the
+difference between that lane's value and the previous packet's (or 0 for the
+first packet), modulo the lane size. Each difference is zigzag-encoded (0,
+-1, 1, -2, ... become 0, 1, 2, 3, ...) and then stored 7 bits per byte, least
+significant bits first, with the high bit set on every byte but the last. If 'C<enc>' has bit 0x80 set, the stored data is zlib-compressed.
+Metadata records, such as 'C<!bad>' lines, end the current block.
+
 =h flush write-only
 
-Flush all internal buffers to disk.
+Flush all internal buffers to disk.  With COLUMNAR, first writes the current
+partial block.  With ASYNC, waits until the writer thread has written
+everything buffered so far.
+
+=h queued_bytes read-only
+
+Returns the number of bytes buffered but not yet written to the file.
+
+=h write_drops read-only
+
+Returns the number of records dropped because no buffer space was available.
+
+=h rotations read-only
+
+Returns the number of times ToIPSummaryDump has started a new file.
 
 =a
 
@@ -372,7 +436,7 @@ class ToIPSummaryDump : public Element, public IPSummaryDumpInfo { public:
   private:
 
     String _filename;
-    FILE *_f;
+    AsyncWriter _writer;
     Vector<const IPSummaryDump::FieldWriter *> _fields;
     Vector<const IPSummaryDump::FieldWriter *> _prepare_fields;
     bool _verbose : 1;
@@ -381,10 +445,19 @@ class ToIPSummaryDump : public Element, public IPSummaryDumpInfo { public:
     bool _multipacket : 1;
     bool _active : 1;
     bool _binary : 1;
+    bool _columnar : 1;
     bool _header : 1;
     bool _extra_length : 1;
     int32_t _binary_size;
     uint32_t _output_count;
+
+    uint32_t _block_packets;
+    uint32_t _block_count;
+    Timestamp _block_first;
+    Timestamp _block_last;
+    Vector<StringAccum> _columns;
+    Vector<uint32_t> _field_ends;
+    StringAccum _block_sa;
     Task _task;
     NotifierSignal _signal;
 
@@ -393,8 +466,10 @@ class ToIPSummaryDump : public Element, public IPSummaryDumpInfo { public:
 
     String _banner;
 
-    bool summary(Packet* p, StringAccum& sa, StringAccum* bad_sa) const;
+    bool summary(Packet* p, StringAccum& sa, StringAccum* bad_sa, uint32_t* field_ends = 0) const;
     void write_packet(Packet* p, int multipacket);
+    void append_block_record(const Timestamp &ts);
+    int write_block();
     static int flush_handler(const String &, Element *, void *, ErrorHandler *);
 
 };
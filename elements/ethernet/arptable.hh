@@ -159,6 +159,12 @@ class ARPTableBase : public Element { public:
     uint32_t drops() const {
 	return _drops;
     }
+    /** @brief Return a counter that changes whenever an address mapping
+     * is added, changed or removed.  Callers that cache lookup() results
+     * can compare generations to tell whether their copies are stale. */
+    uint32_t generation() const {
+	return _generation;
+    }
     uint32_t count() const {
 	return _entry_count;
     }
@@ -232,6 +238,7 @@ class ARPTableBase : public Element { public:
     uint32_t _capacity_slim_factor;
     uint32_t _timeout_j;
     atomic_uint32_t _drops;
+    atomic_uint32_t _generation;
     SizedHashAllocator<sizeof(ARPEntry)> _alloc;
     Timer _expire_timer;
 
@@ -278,7 +285,7 @@ template <typename T>
 ARPTableBase<T>::ARPTableBase()
     : _entry_capacity(0), _packet_capacity(2048), _expire_timer(this)
 {
-    _entry_count = _packet_count = _drops = 0;
+    _entry_count = _packet_count = _drops = _generation = 0;
 }
 
 template <typename T>
@@ -328,6 +335,7 @@ ARPTableBase<T>::clear()
     }
     _entry_count = _packet_count = 0;
     _age.__clear();
+    ++_generation;
 }
 
 template <typename T>
@@ -348,6 +356,7 @@ ARPTableBase<T>::take_state(Element *e, ErrorHandler *errh)
     _packet_count = arpt->_packet_count;
     _drops = arpt->_drops;
     _alloc.swap(arpt->_alloc);
+    ++_generation;
 
     arpt->_entry_count = 0;
     arpt->_packet_count = 0;
@@ -375,6 +384,7 @@ ARPTableBase<T>::slim(click_jiffies_t now)
 
 	_alloc.deallocate(ae);
 	--_entry_count;
+	++_generation;
     }
 
     // Mark entries for polling, and delete packets to make space.
@@ -440,6 +450,8 @@ ARPTableBase<T>::insert(T ip, const EtherAddress &eth, Packet **head)
     if (!ae)
 	return -ENOMEM;
 
+    if (ae->_eth != eth || ae->_known == eth.is_broadcast())
+	++_generation;
     ae->_eth = eth;
     ae->_known = !eth.is_broadcast();
 
@@ -72,6 +72,16 @@ EtherEncap::pull(int)
 	return 0;
 }
 
+void
+EtherEncap::push_batch(int, PacketBatch &batch)
+{
+    PacketBatch out;
+    while (Packet *p = batch.pop_front())
+	if (Packet *q = smaction(p))
+	    out.push_back(q);
+    output(0).push_batch(out);
+}
+
 void
 EtherEncap::add_handlers()
 {
@@ -114,7 +114,7 @@ ICMPPingRewriter::get_entry(int ip_p, const IPFlowID &xflowid, int input)
     bool echo = (input != get_entry_reply);
     IPFlowID flowid(xflowid.saddr(), xflowid.sport() + !echo,
 		    xflowid.daddr(), xflowid.sport() + echo);
-    IPRewriterEntry *m = _map.get(flowid);
+    IPRewriterEntry *m = _maps[0].get(flowid);
     if (!m && (unsigned) input < (unsigned) _input_specs.size()) {
 	IPRewriterInput &is = _input_specs[input];
 	IPFlowID rewritten_flowid = IPFlowID::uninitialized_t();
@@ -140,7 +140,7 @@ ICMPPingRewriter::add_flow(int, const IPFlowID &flowid,
 	(&_input_specs[input], flowid, rewritten_flowid,
 	 !!_timeouts[1], click_jiffies() + relevant_timeout(_timeouts));
 
-    return store_flow(flow, input, _map);
+    return store_flow(flow, input, _maps);
 }
 
 void
@@ -168,7 +168,7 @@ ICMPPingRewriter::push(int port, Packet *p_in)
     IPFlowID flowid(iph->ip_src, icmph->icmp_identifier + !echo,
 		    iph->ip_dst, icmph->icmp_identifier + echo);
 
-    IPRewriterEntry *m = _map.get(flowid);
+    IPRewriterEntry *m = _maps[0].get(flowid);
 
     if (!m && !echo)
 	goto mapping_fail;
@@ -201,7 +201,7 @@ ICMPPingRewriter::dump_mappings_handler(Element *e, void *)
     ICMPPingRewriter *rw = (ICMPPingRewriter *)e;
     StringAccum sa;
     click_jiffies_t now = click_jiffies();
-    for (Map::iterator iter = rw->_map.begin(); iter.live(); ++iter) {
+    for (Map::iterator iter = rw->_maps[0].begin(); iter.live(); ++iter) {
 	ICMPPingFlow *f = static_cast<ICMPPingFlow *>(iter->flow());
 	f->unparse(sa, iter->direction(), now);
 	sa << '\n';
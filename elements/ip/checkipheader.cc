@@ -225,6 +225,16 @@ CheckIPHeader::simple_action(Packet *p)
   return(p);
 }
 
+void
+CheckIPHeader::push_batch(int, PacketBatch &batch)
+{
+  PacketBatch out;
+  while (Packet *p = batch.pop_front())
+    if ((p = CheckIPHeader::simple_action(p)))
+      out.push_back(p);
+  output(0).push_batch(out);
+}
+
 String
 CheckIPHeader::read_handler(Element *e, void *)
 {
@@ -118,6 +118,7 @@ class CheckIPHeader : public Element { public:
   void add_handlers() CLICK_COLD;
 
   Packet *simple_action(Packet *);
+  void push_batch(int port, PacketBatch &batch);
 
   struct OldBadSrcArg {
       static bool parse(const String &str, Vector<IPAddress> &result,
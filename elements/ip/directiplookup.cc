@@ -24,6 +24,7 @@
 #include <click/straccum.hh>
 #include <click/router.hh>
 #include <click/error.hh>
+#include <click/hashtable.hh>
 CLICK_DECLS
 
 
@@ -132,8 +133,10 @@ DirectIPLookup::Table::dump() const
 int
 DirectIPLookup::Table::vport_find(IPAddress gw, int16_t port)
 {
+    // _vport[0] belongs to the default route, which can be removed by
+    // setting its port to DISCARD_PORT, so never share it
     for (int vp = _vport_head; vp >= 0; vp = _vport[vp].ll_next)
-	if (_vport[vp].gw == gw && _vport[vp].port == port)
+	if (vp != 0 && _vport[vp].gw == gw && _vport[vp].port == port)
 	    return vp;
     if (_vport_empty_head < 0 && _vport_size == _vport_capacity) {
 	if (_vport_capacity == vport_capacity_limit)
@@ -177,6 +180,80 @@ DirectIPLookup::Table::vport_unref(uint16_t vport_i)
     }
 }
 
+int
+DirectIPLookup::Table::grow_rtable(uint32_t capacity)
+{
+    CleartextEntry *new_rtable = (CleartextEntry *) CLICK_LALLOC(sizeof(CleartextEntry) * capacity);
+    if (!new_rtable)
+	return -ENOMEM;
+    memcpy(new_rtable, _rtable, sizeof(CleartextEntry) * _rtable_capacity);
+    CLICK_LFREE(_rtable, sizeof(CleartextEntry) * _rtable_capacity);
+    _rtable = new_rtable;
+    _rtable_capacity = capacity;
+    return 0;
+}
+
+int
+DirectIPLookup::Table::reserve_tbl_24_31()
+{
+    // make sure a free _tbl_24_31[] block is available
+    if (!(_tbl_24_31_empty_head & 0x8000))
+	return 0;
+    if (_tbl_24_31_size == _tbl_24_31_capacity
+	&& _tbl_24_31_capacity >= tbl_24_31_capacity_limit)
+	return -ENOMEM;
+    if (_tbl_24_31_size == _tbl_24_31_capacity) {
+	uint16_t *new_tbl = (uint16_t *) CLICK_LALLOC((sizeof(uint16_t) + sizeof(uint8_t)) * 2 * _tbl_24_31_capacity);
+	if (!new_tbl)
+	    return -ENOMEM;
+	memcpy(new_tbl, _tbl_24_31, sizeof(uint16_t) * _tbl_24_31_capacity);
+	memcpy(new_tbl + 2 * _tbl_24_31_capacity, _tbl_24_31_plen, sizeof(uint8_t) * _tbl_24_31_capacity);
+	CLICK_LFREE(_tbl_24_31, (sizeof(uint16_t) + sizeof(uint8_t)) * _tbl_24_31_capacity);
+	_tbl_24_31 = new_tbl;
+	_tbl_24_31_plen = (uint8_t *) (new_tbl + 2 * _tbl_24_31_capacity);
+	_tbl_24_31_capacity *= 2;
+    }
+    _tbl_24_31_empty_head = _tbl_24_31_size >> 8;
+    _tbl_24_31[_tbl_24_31_empty_head << 8] = 0x8000;
+    _tbl_24_31_size += 256;
+    return 0;
+}
+
+void
+DirectIPLookup::Table::link_entry(int rt_i, uint32_t prefix, uint32_t plen)
+{
+    // rt_i must be _rt_empty_head
+    _rt_empty_head = _rtable[rt_i].ll_next;
+
+    _rtable[rt_i].prefix = prefix;	// in host-order format
+    _rtable[rt_i].plen = plen;
+
+    // Insert the new entry in our hashtable
+    uint32_t hash = prefix_hash(prefix, plen);
+    _rtable[rt_i].ll_prev = -1;
+    _rtable[rt_i].ll_next = _rt_hashtbl[hash];
+    if (_rt_hashtbl[hash] >= 0)
+	_rtable[_rt_hashtbl[hash]].ll_prev = rt_i;
+    _rt_hashtbl[hash] = rt_i;
+}
+
+void
+DirectIPLookup::Table::link_vport(int vport_i, IPAddress gw, int16_t port)
+{
+    // vport_i must be _vport_empty_head
+    _vport_empty_head = _vport[vport_i].ll_next;
+    _vport[vport_i].refcount = 0;
+    _vport[vport_i].gw = gw;
+    _vport[vport_i].port = port;
+
+    // Add the entry to the vport linked list
+    _vport[vport_i].ll_prev = -1;
+    _vport[vport_i].ll_next = _vport_head;
+    if (_vport_head >= 0)
+	_vport[_vport_head].ll_prev = vport_i;
+    _vport_head = vport_i;
+}
+
 int
 DirectIPLookup::Table::find_entry(uint32_t prefix, uint32_t plen) const
 {
@@ -218,15 +295,9 @@ DirectIPLookup::Table::add_route(const IPRoute& route, bool allow_replace, IPRou
 
     } else {
 	// Attempt to allocate a new _rtable[] entry.
-	if (_rt_empty_head < 0 && _rtable_size == _rtable_capacity) {
-	    CleartextEntry *new_rtable = (CleartextEntry *) CLICK_LALLOC(sizeof(CleartextEntry) * _rtable_capacity * 2);
-	    if (!new_rtable)
-		return -ENOMEM;
-	    memcpy(new_rtable, _rtable, sizeof(CleartextEntry) * _rtable_capacity);
-	    CLICK_LFREE(_rtable, sizeof(CleartextEntry) * _rtable_capacity);
-	    _rtable = new_rtable;
-	    _rtable_capacity *= 2;
-	}
+	if (_rt_empty_head < 0 && _rtable_size == _rtable_capacity
+	    && grow_rtable(_rtable_capacity * 2) < 0)
+	    return -ENOMEM;
 	if (_rt_empty_head < 0) {
 	    _rtable[_rtable_size].ll_next = _rt_empty_head;
 	    _rt_empty_head = _rtable_size;
@@ -244,55 +315,14 @@ DirectIPLookup::Table::add_route(const IPRoute& route, bool allow_replace, IPRou
     int start = prefix >> 8;
     int end = start + (plen < 24 ? 1 << (24 - plen) : 1);
     if (plen > 24 && !(_tbl_0_23[start] & 0x8000)
-	&& (_tbl_24_31_empty_head & 0x8000) != 0) {
-	if (_tbl_24_31_size == _tbl_24_31_capacity
-	    && _tbl_24_31_capacity >= tbl_24_31_capacity_limit)
-	    return -ENOMEM;
-	if (_tbl_24_31_size == _tbl_24_31_capacity) {
-	    uint16_t *new_tbl = (uint16_t *) CLICK_LALLOC((sizeof(uint16_t) + sizeof(uint8_t)) * 2 * _tbl_24_31_capacity);
-	    if (!new_tbl)
-		return -ENOMEM;
-	    memcpy(new_tbl, _tbl_24_31, sizeof(uint16_t) * _tbl_24_31_capacity);
-	    memcpy(new_tbl + _tbl_24_31_capacity, _tbl_24_31_plen, sizeof(uint8_t) * _tbl_24_31_capacity);
-	    CLICK_LFREE(_tbl_24_31, (sizeof(uint16_t) + sizeof(uint8_t)) * _tbl_24_31_capacity);
-	    _tbl_24_31 = new_tbl;
-	    _tbl_24_31_plen = (uint8_t *) (new_tbl + 2 * _tbl_24_31_capacity);
-	    _tbl_24_31_capacity *= 2;
-	}
-	_tbl_24_31_empty_head = _tbl_24_31_size >> 8;
-	_tbl_24_31[_tbl_24_31_empty_head << 8] = 0x8000;
-	_tbl_24_31_size += 256;
-    }
+	&& reserve_tbl_24_31() < 0)
+	return -ENOMEM;
 
     // At this point we have successfully allocated all memory.
-    if (rt_i == _rt_empty_head) {
-	_rt_empty_head = _rtable[rt_i].ll_next;
-
-	_rtable[rt_i].prefix = prefix;	// in host-order format
-	_rtable[rt_i].plen = plen;
-
-	// Insert the new entry in our hashtable
-	uint32_t hash = prefix_hash(prefix, plen);
-	_rtable[rt_i].ll_prev = -1;
-	_rtable[rt_i].ll_next = _rt_hashtbl[hash];
-	if (_rt_hashtbl[hash] >= 0)
-	    _rtable[_rt_hashtbl[hash]].ll_prev = rt_i;
-	_rt_hashtbl[hash] = rt_i;
-    }
-
-    if (vport_i == _vport_empty_head) {
-	_vport_empty_head = _vport[vport_i].ll_next;
-	_vport[vport_i].refcount = 0;
-	_vport[vport_i].gw = route.gw;
-	_vport[vport_i].port = route.port;
-
-	// Add the entry to the vport linked list
-	_vport[vport_i].ll_prev = -1;
-	_vport[vport_i].ll_next = _vport_head;
-	if (_vport_head >= 0)
-	    _vport[_vport_head].ll_prev = vport_i;
-	_vport_head = vport_i;
-    }
+    if (rt_i == _rt_empty_head)
+	link_entry(rt_i, prefix, plen);
+    if (vport_i == _vport_empty_head)
+	link_vport(vport_i, route.gw, route.port);
     ++_vport[vport_i].refcount;
     _rtable[rt_i].vport = vport_i;
 
@@ -364,6 +394,115 @@ DirectIPLookup::Table::add_route(const IPRoute& route, bool allow_replace, IPRou
     return 0;
 }
 
+int
+DirectIPLookup::Table::load(const Vector<IPRoute> &routes, bool allow_replace, ErrorHandler *)
+{
+    // Visit the routes shortest prefix first, keeping their order otherwise.
+    // Each route can then simply overwrite the lookup entries it covers,
+    // with none of the per-entry comparisons add_route() needs.
+    int count[34];
+    memset(count, 0, sizeof(count));
+    for (const IPRoute *r = routes.begin(); r != routes.end(); ++r)
+	++count[r->prefix_len() + 1];
+    for (int plen = 1; plen < 34; ++plen)
+	count[plen] += count[plen - 1];
+    Vector<int> order(routes.size(), 0);
+    for (int i = 0; i < routes.size(); ++i)
+	order[count[routes[i].prefix_len()]++] = i;
+
+    flush();
+    uint32_t capacity = _rtable_capacity;
+    while (capacity < (uint32_t) routes.size() + 1)
+	capacity *= 2;
+    if (capacity != _rtable_capacity && grow_rtable(capacity) < 0)
+	return -ENOMEM;
+
+    // vport_find() is linear in the number of vports; remember them instead
+    HashTable<uint64_t, int> vports(-1);
+    int nduplicate = 0;
+
+    for (const int *op = order.begin(); op != order.end(); ++op) {
+	const IPRoute &route = routes[*op];
+	uint32_t prefix = ntohl(route.addr.addr());
+	uint32_t plen = route.prefix_len();
+
+	if (plen == 0) {
+	    // The default route only sets _vport[0], as in add_route()
+	    if (_vport[0].port != DISCARD_PORT) {
+		++nduplicate;
+		if (!allow_replace)
+		    continue;
+	    }
+	    _vport[0].gw = route.gw;
+	    _vport[0].port = route.port;
+	    continue;
+	}
+
+	int rt_i = find_entry(prefix, plen);
+	if (rt_i >= 0) {
+	    ++nduplicate;
+	    if (!allow_replace)
+		continue;
+	    int old_vport = _rtable[rt_i].vport;
+	    vport_unref(old_vport);
+	    if (_vport[old_vport].refcount == 0)
+		vports.erase((uint64_t(_vport[old_vport].gw.addr()) << 16) | uint16_t(_vport[old_vport].port));
+	} else {
+	    if (_rt_empty_head < 0) {
+		if (_rtable_size == _rtable_capacity
+		    && grow_rtable(_rtable_capacity * 2) < 0)
+		    return -ENOMEM;
+		_rtable[_rtable_size].ll_next = _rt_empty_head;
+		_rt_empty_head = _rtable_size;
+		++_rtable_size;
+	    }
+	    rt_i = _rt_empty_head;
+	    link_entry(rt_i, prefix, plen);
+	}
+
+	HashTable<uint64_t, int>::iterator it = vports.find_insert((uint64_t(route.gw.addr()) << 16) | uint16_t(route.port));
+	if (it.value() < 0) {
+	    int vport_i = vport_find(route.gw, route.port);
+	    if (vport_i < 0)
+		return vport_i;
+	    if (vport_i == _vport_empty_head)
+		link_vport(vport_i, route.gw, route.port);
+	    it.value() = vport_i;
+	}
+	int vport_i = it.value();
+	++_vport[vport_i].refcount;
+	_rtable[rt_i].vport = vport_i;
+
+	uint32_t i = prefix >> 8;
+	if (plen <= 24) {
+	    // all longer prefixes come later, so no secondary tables yet
+	    for (uint32_t end = i + (1 << (24 - plen)); i < end; ++i) {
+		_tbl_0_23[i] = vport_i;
+		_tbl_0_23_plen[i] = plen;
+	    }
+	} else {
+	    if (!(_tbl_0_23[i] & 0x8000)) {
+		if (reserve_tbl_24_31() < 0)
+		    return -ENOMEM;
+		int sec_i = _tbl_24_31_empty_head << 8;
+		_tbl_24_31_empty_head = _tbl_24_31[sec_i];
+		for (int j = 0; j < 256; j++) {
+		    _tbl_24_31[sec_i + j] = _tbl_0_23[i];
+		    _tbl_24_31_plen[sec_i + j] = _tbl_0_23_plen[i];
+		}
+		_tbl_0_23[i] = (sec_i >> 8) | 0x8000;
+	    }
+	    uint32_t j = ((_tbl_0_23[i] & 0x7fff) << 8) | (prefix & 0xFF);
+	    for (uint32_t end = j + (1 << (32 - plen)); j < end; ++j) {
+		_tbl_24_31[j] = vport_i;
+		_tbl_24_31_plen[j] = plen;
+	    }
+	}
+    }
+
+    return nduplicate;
+}
+
 int
 DirectIPLookup::Table::remove_route(const IPRoute& route, IPRoute* old_route, ErrorHandler *errh)
 {
@@ -488,6 +627,7 @@ DirectIPLookup::Table::remove_route(const IPRoute& route, IPRoute* old_route, Er
 // DIRECTIPLOOKUP
 
 DirectIPLookup::DirectIPLookup()
+    : _active(&_t), _writer(&_t)
 {
 }
 
@@ -505,10 +645,29 @@ DirectIPLookup::configure(Vector<String> &conf, ErrorHandler *errh)
     return IPRouteTable::configure(conf, errh);
 }
 
+int
+DirectIPLookup::enable_shadow(ErrorHandler *errh)
+{
+    if (_shadow_t.initialize() < 0)
+	return errh->error("out of memory");
+    _shadow_t.flush();
+    _writer = &_shadow_t;
+    return 0;
+}
+
+void
+DirectIPLookup::publish_shadow()
+{
+    Table *t = _active;
+    _active = _writer;
+    _writer = t;
+}
+
 void
 DirectIPLookup::cleanup(CleanupStage)
 {
     _t.cleanup();
+    _shadow_t.cleanup();
 }
 
 void
@@ -528,41 +687,45 @@ DirectIPLookup::push(int, Packet *p)
 int
 DirectIPLookup::lookup_route(IPAddress dest, IPAddress &gw) const
 {
+    const Table *t = _active;
     uint32_t ip_addr = ntohl(dest.addr());
-    uint16_t vport_i = _t._tbl_0_23[ip_addr >> 8];
+    uint16_t vport_i = t->_tbl_0_23[ip_addr >> 8];
 
     if (vport_i & 0x8000)
-        vport_i = _t._tbl_24_31[((vport_i & 0x7fff) << 8) | (ip_addr & 0xff)];
+        vport_i = t->_tbl_24_31[((vport_i & 0x7fff) << 8) | (ip_addr & 0xff)];
 
-    gw = _t._vport[vport_i].gw;
-    return _t._vport[vport_i].port;
+    gw = t->_vport[vport_i].gw;
+    return t->_vport[vport_i].port;
 }
 
 int
 DirectIPLookup::add_route(const IPRoute& route, bool allow_replace, IPRoute* old_route, ErrorHandler *errh)
 {
-    return _t.add_route(route, allow_replace, old_route, errh);
+    return _writer->add_route(route, allow_replace, old_route, errh);
 }
 
 int
 DirectIPLookup::remove_route(const IPRoute& route, IPRoute* old_route, ErrorHandler *errh)
 {
-    return _t.remove_route(route, old_route, errh);
+    return _writer->remove_route(route, old_route, errh);
+}
+
+void
+DirectIPLookup::flush_table()
+{
+    _writer->flush();
 }
 
 int
-DirectIPLookup::flush_handler(const String &, Element *e, void *,
-				ErrorHandler *)
+DirectIPLookup::load_routes(const Vector<IPRoute> &routes, bool allow_replace, ErrorHandler *errh)
 {
-    DirectIPLookup *t = static_cast<DirectIPLookup *>(e);
-    t->_t.flush();
-    return 0;
+    return _writer->load(routes, allow_replace, errh);
 }
 
 String
 DirectIPLookup::dump_routes()
 {
-    return _t.dump();
+    return _active->dump();
 }
 
 void
@@ -570,6 +733,7 @@ DirectIPLookup::add_handlers()
 {
     IPRouteTable::add_handlers();
     add_write_handler("flush", flush_handler, 0, Handler::BUTTON);
+    add_write_handler("load", load_handler, 0);
 }
 
 CLICK_ENDDECLS
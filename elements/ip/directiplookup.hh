@@ -28,11 +28,32 @@ DirectIPLookup is optimized for lookup speed at the expense of extensive RAM
 usage. Each longest-prefix lookup is accomplished in one to maximum two DRAM
 accesses, regardless on the number of routing table entries. Individual
 entries can be dynamically added to or removed from the routing table with
-relatively low CPU overhead, allowing for high update rates.
+relatively low CPU overhead, allowing for high update rates.  The routes in
+the configuration, and those written to the C<load> handler, are instead
+sorted by prefix length and written into the lookup tables in a single pass,
+which is much faster than adding them one at a time.
 
 DirectIPLookup implements the I<DIR-24-8-BASIC> lookup scheme described by
 Gupta, Lin, and McKeown in the paper cited below.
 
+Keyword arguments are:
+
+=over 8
+
+=item FILE
+
+Filename. Read more routes from this file, one `C<ADDR/MASK [GW] OUT>' per
+line, after those in the arguments.  Only available at user level.
+
+=item SHADOW
+
+Boolean. If true, route updates go to a shadow copy of the lookup tables,
+which is then published atomically, so updates never disturb lookups running
+on other threads.  This doubles the memory used for lookups.  See
+IPRouteTable for details.  Defaults to false.
+
+=back
+
 =h table read-only
 
 Outputs a human-readable version of the current routing table.
@@ -65,6 +86,13 @@ operation.
 
 Clears the entire routing table in a single atomic operation.
 
+=h load write-only
+
+Replaces the routing table with the routes written, one `C<ADDR/MASK [GW]
+OUT>' per line.  If several routes have the same prefix, the last one wins.
+With SHADOW, lookups see either the old table or the new one, never a
+mix.
+
 =n
 
 See IPRouteTable for a performance comparison of the various IP routing
@@ -103,8 +131,11 @@ class DirectIPLookup : public IPRouteTable { public:
     int remove_route(const IPRoute&, IPRoute*, ErrorHandler *);
     int lookup_route(IPAddress, IPAddress&) const;
     String dump_routes();
+    void flush_table();
+    int load_routes(const Vector<IPRoute>&, bool, ErrorHandler *);
 
-    static int flush_handler(const String &, Element *, void *, ErrorHandler *);
+    int enable_shadow(ErrorHandler *errh);
+    void publish_shadow();
 
     enum {
 	RT_SIZE_MAX = 256 * 1024, // accomodate a full BGP view and more
@@ -174,16 +205,24 @@ class DirectIPLookup : public IPRouteTable { public:
 
 	int vport_find(IPAddress gw, int16_t port);
 	void vport_unref(uint16_t);
+	int grow_rtable(uint32_t capacity);
+	int reserve_tbl_24_31();
+	void link_entry(int rt_i, uint32_t prefix, uint32_t plen);
+	void link_vport(int vport_i, IPAddress gw, int16_t port);
 
 	int add_route(const IPRoute&, bool, IPRoute*, ErrorHandler *);
 	int remove_route(const IPRoute&, IPRoute*, ErrorHandler *);
 	void flush();
+	int load(const Vector<IPRoute>&, bool, ErrorHandler *);
 
     };
 
   protected:
 
     Table _t;
+    Table _shadow_t;
+    Table * volatile _active;	// lookups use this table
+    Table *_writer;		// updates change this table
 
     friend class RangeIPLookup;
 
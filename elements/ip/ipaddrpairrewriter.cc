@@ -105,7 +105,7 @@ IPRewriterEntry *
 IPAddrPairRewriter::get_entry(int, const IPFlowID &xflowid, int input)
 {
     IPFlowID flowid(xflowid.saddr(), 0, xflowid.daddr(), 0);
-    IPRewriterEntry *m = _map.get(flowid);
+    IPRewriterEntry *m = _maps[0].get(flowid);
     if (!m && (unsigned) input < (unsigned) _input_specs.size()) {
 	IPRewriterInput &is = _input_specs[input];
 	IPFlowID rewritten_flowid = IPFlowID::uninitialized_t();
@@ -129,7 +129,7 @@ IPAddrPairRewriter::add_flow(int, const IPFlowID &flowid,
 	(&_input_specs[input], flowid, rewritten_flowid,
 	 !!_timeouts[1], click_jiffies() + relevant_timeout(_timeouts));
 
-    return store_flow(flow, input, _map);
+    return store_flow(flow, input, _maps);
 }
 
 void
@@ -139,7 +139,7 @@ IPAddrPairRewriter::push(int port, Packet *p_in)
     click_ip *iph = p->ip_header();
 
     IPFlowID flowid(iph->ip_src, 0, iph->ip_dst, 0);
-    IPRewriterEntry *m = _map.get(flowid);
+    IPRewriterEntry *m = _maps[0].get(flowid);
 
     if (!m) {			// create new mapping
 	IPRewriterInput &is = _input_specs.unchecked_at(port);
@@ -167,7 +167,7 @@ IPAddrPairRewriter::dump_mappings_handler(Element *e, void *)
     IPAddrPairRewriter *rw = (IPAddrPairRewriter *)e;
     click_jiffies_t now = click_jiffies();
     StringAccum sa;
-    for (Map::iterator iter = rw->_map.begin(); iter.live(); iter++) {
+    for (Map::iterator iter = rw->_maps[0].begin(); iter.live(); iter++) {
 	IPAddrPairFlow *f = static_cast<IPAddrPairFlow *>(iter->flow());
 	f->unparse(sa, iter->direction(), now);
 	sa << '\n';
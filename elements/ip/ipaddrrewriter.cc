@@ -106,10 +106,10 @@ IPRewriterEntry *
 IPAddrRewriter::get_entry(int, const IPFlowID &xflowid, int input)
 {
     IPFlowID flowid(xflowid.saddr(), 0, IPAddress(), 0);
-    IPRewriterEntry *m = _map.get(flowid);
+    IPRewriterEntry *m = _maps[0].get(flowid);
     if (!m) {
 	IPFlowID rflowid(IPAddress(), 0, xflowid.daddr(), 0);
-	m = _map.get(rflowid);
+	m = _maps[0].get(rflowid);
     }
     if (!m && (unsigned) input < (unsigned) _input_specs.size()) {
 	IPRewriterInput &is = _input_specs[input];
@@ -135,7 +135,7 @@ IPAddrRewriter::add_flow(int, const IPFlowID &flowid,
 	(&_input_specs[input], flowid, rewritten_flowid,
 	 !!_timeouts[1], click_jiffies() + relevant_timeout(_timeouts));
 
-    return store_flow(flow, input, _map);
+    return store_flow(flow, input, _maps);
 }
 
 void
@@ -145,11 +145,11 @@ IPAddrRewriter::push(int port, Packet *p_in)
     click_ip *iph = p->ip_header();
 
     IPFlowID flowid(iph->ip_src, 0, IPAddress(), 0);
-    IPRewriterEntry *m = _map.get(flowid);
+    IPRewriterEntry *m = _maps[0].get(flowid);
 
     if (!m) {
 	IPFlowID rflowid = IPFlowID(IPAddress(), 0, iph->ip_dst, 0);
-	m = _map.get(rflowid);
+	m = _maps[0].get(rflowid);
     }
 
     if (!m) {			// create new mapping
@@ -178,7 +178,7 @@ IPAddrRewriter::dump_mappings_handler(Element *e, void *)
     IPAddrRewriter *rw = (IPAddrRewriter *)e;
     StringAccum sa;
     click_jiffies_t now = click_jiffies();
-    for (Map::iterator iter = rw->_map.begin(); iter.live(); iter++) {
+    for (Map::iterator iter = rw->_maps[0].begin(); iter.live(); iter++) {
 	IPAddrFlow *f = static_cast<IPAddrFlow *>(iter->flow());
 	f->unparse(sa, iter->direction(), now);
 	sa << '\n';
@@ -87,6 +87,11 @@ dropped if the mapping table is full of guaranteed flows.
 
 Reap timed-out connections every I<time> seconds. Default is 15 minutes.
 
+=item REAP_BUDGET I<n>
+
+Reap at most I<n> timed-out connections at a time. Default is 1024. See
+IPRewriter.
+
 =item MAPPING_CAPACITY I<capacity>
 
 Set the maximum number of mappings this rewriter can hold to I<capacity>.
@@ -161,7 +166,7 @@ class IPAddrRewriter : public IPRewriterBase { public:
 inline void
 IPAddrRewriter::destroy_flow(IPRewriterFlow *flow)
 {
-    unmap_flow(flow, _map);
+    unmap_flow(flow, _maps);
     static_cast<IPAddrFlow *>(flow)->~IPAddrFlow();
     _allocator.deallocate(flow);
 }
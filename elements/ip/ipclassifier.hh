@@ -198,6 +198,9 @@ Every IPClassifier element has an equivalent corresponding IPFilter element
 and vice versa. Use the element whose syntax is more convenient for your
 needs.
 
+At user level on x86-64, IPClassifier translates its program into machine
+code at configuration time, as Classifier does; see Classifier for details.
+
 =e
 
 For example,
@@ -228,6 +231,15 @@ is using to classify packets. At each step in the program, four bytes
 of packet data are ANDed with a mask and compared against four bytes of
 classifier pattern.
 
+=h jit read/write
+Returns true if IPClassifier is running its program as machine code.  Write
+false to interpret the program instead, or true to compile it again.
+
+=h cycles read-only
+Returns the average number of CPU cycles IPClassifier has spent classifying
+each packet.  Only packets that arrive in batches are timed.  Writing the
+C<jit> handler resets the average.
+
 =h pattern0 rw
 Returns or sets the element's pattern 0. There are as many C<pattern>
 handlers as there are output ports.
@@ -37,6 +37,9 @@ Every IPFilter element has an equivalent corresponding IPClassifier element
 and vice versa. Use the element whose syntax is more convenient for your
 needs.
 
+At user level on x86-64, IPFilter translates its program into machine code at
+configuration time, as Classifier does; see Classifier for details.
+
 B<Compatibility note>: 'C<deny>' formerly meant 'C<1>' if the element had at
 least two outputs and 'C<drop>' if it did not. We decided this was
 error-prone; now it just means 'C<drop>'. For now, however, 'C<deny>' will
@@ -107,6 +110,15 @@ is using to classify packets. At each step in the program, four bytes
 of packet data are ANDed with a mask and compared against four bytes of
 classifier pattern.
 
+=h jit read/write
+Returns true if IPFilter is running its program as machine code.  Write false
+to interpret the program instead, or true to compile it again.
+
+=h cycles read-only
+Returns the average number of CPU cycles IPFilter has spent classifying each
+packet.  Only packets that arrive in batches are timed.  Writing the C<jit>
+handler resets the average.
+
 =a
 
 IPClassifier, Classifier, CheckIPHeader, MarkIPHeader, CheckIPHeader2,
@@ -131,12 +143,14 @@ class IPFilter : public Element { public:
     void add_handlers() CLICK_COLD;
 
     void push(int port, Packet *);
+    void push_batch(int port, PacketBatch &batch);
 
     typedef Classification::Wordwise::CompressedProgram IPFilterProgram;
     static void parse_program(IPFilterProgram &zprog,
 			      const Vector<String> &conf, int noutputs,
 			      const Element *context, ErrorHandler *errh);
     static inline int match(const IPFilterProgram &zprog, const Packet *p);
+    static inline int match_length(const Packet *p);
 
     enum {
 	TYPE_NONE	= 0,		// data types
@@ -258,6 +272,15 @@ class IPFilter : public Element { public:
   protected:
 
     IPFilterProgram _zprog;
+    Classification::Wordwise::CompiledProgram _jit;
+    bool _use_jit;
+    click_cycles_t _cycles;
+    uint64_t _cycle_packets;
+
+    enum { batch_chunk = 32 };
+
+    inline int classify(const Packet *p) const;
+    void compile_jit();
 
   private:
 
@@ -302,6 +325,9 @@ class IPFilter : public Element { public:
 				    const Packet *p, int packet_length);
 
     static String program_string(Element *e, void *user_data);
+    static String read_handler(Element *e, void *user_data);
+    static int jit_handler(const String &str, Element *e, void *user_data,
+			   ErrorHandler *errh);
 
 };
 
@@ -324,14 +350,21 @@ IPFilter::Primitive::negation_is_simple() const
 }
 
 inline int
-IPFilter::match(const IPFilterProgram &zprog, const Packet *p)
+IPFilter::match_length(const Packet *p)
 {
+    // the packet length in program offsets
     int packet_length = p->network_length(),
 	network_header_length = p->network_header_length();
     if (packet_length > network_header_length)
-	packet_length += offset_transp - network_header_length;
+	return packet_length + offset_transp - network_header_length;
     else
-	packet_length += offset_net;
+	return packet_length + offset_net;
+}
+
+inline int
+IPFilter::match(const IPFilterProgram &zprog, const Packet *p)
+{
+    int packet_length = match_length(p);
 
     if (zprog.output_everything() >= 0)
 	return zprog.output_everything();
@@ -30,6 +30,8 @@ IPFragmenter::IPFragmenter()
 {
     _fragments = 0;
     _drops = 0;
+    _copies = 0;
+    _copy_bytes = 0;
 }
 
 IPFragmenter::~IPFragmenter()
@@ -73,6 +75,7 @@ IPFragmenter::optcopy(const click_ip *ip1, click_ip *ip2)
 		memcpy(oout + outpos, oin + i, optlen);
 	    outpos += optlen;
 	}
+	i += optlen;
     }
 
     for (; (outpos & 3) != 0; outpos++)
@@ -98,10 +101,28 @@ IPFragmenter::fragment(Packet *p_in)
 	return;
     }
 
-    // make sure we can modify the packet
-    WritablePacket *p = p_in->uniqueify();
-    if (!p)
-	return;
+    // The first fragment needs a writable header.  If nothing else uses the
+    // input's buffer, the first fragment shares it.  Otherwise copy just the
+    // first fragment: uniqueifying would copy the whole input, and the
+    // later fragments' data would then be copied twice.
+    WritablePacket *p;
+    Packet *first_fragment;
+    if (!p_in->shared()) {
+	p = p_in->uniqueify();
+	first_fragment = 0;
+    } else {
+	uint32_t first_len = p_in->network_header_offset() + hlen + first_dlen;
+	p = Packet::make(_headroom, p_in->data(), first_len, 0);
+	if (!p) {
+	    p_in->kill();
+	    return;
+	}
+	p->set_network_header(p->data() + p_in->network_header_offset(), hlen);
+	p->copy_annotations(p_in);
+	_copies++;
+	_copy_bytes += first_len;
+	first_fragment = p;
+    }
     click_ip *ip = p->ip_header();
 
     // output the first fragment
@@ -115,13 +136,17 @@ IPFragmenter::fragment(Packet *p_in)
     ip->ip_off |= htons(IP_MF);
     ip->ip_sum = 0;
     ip->ip_sum = click_in_cksum((const unsigned char *)ip, hlen);
-    Packet *first_fragment = p->clone();
-    first_fragment->take(p->length() - p->network_header_offset() - hlen - first_dlen);
-    output(0).push(first_fragment);
-    _fragments++;
+    if (!first_fragment) {
+	first_fragment = p->clone();
+	first_fragment->take(p->length() - p->network_header_offset() - hlen - first_dlen);
+    }
 
-    // output the remaining fragments
+    // The remaining fragments copy their data from the input.  Push the
+    // first fragment only afterwards, since downstream elements might
+    // change the header they copy.
+    const unsigned char *in_data = p_in->network_header() + hlen;
     int out_hlen = sizeof(click_ip) + optcopy(ip, 0);
+    Packet *head = first_fragment, *tail = first_fragment;
 
     for (int off = first_dlen; off < in_dlen; ) {
 	// prepare packet
@@ -136,7 +161,7 @@ IPFragmenter::fragment(Packet *p_in)
 
 	    memcpy(qip, ip, sizeof(click_ip));
 	    optcopy(ip, qip);
-	    memcpy(q->transport_header(), p->transport_header() + off, out_dlen);
+	    memcpy(q->transport_header(), in_data + off, out_dlen);
 
 	    qip->ip_hl = out_hlen >> 2;
 	    qip->ip_off = htons(ntohs(ip->ip_off) + (off >> 3));
@@ -147,15 +172,29 @@ IPFragmenter::fragment(Packet *p_in)
 	    qip->ip_sum = click_in_cksum((const unsigned char *)qip, out_hlen);
 
 	    q->copy_annotations(p);
+	    _copies++;
+	    _copy_bytes += out_hlen + out_dlen;
 
-	    output(0).push(q);
-	    _fragments++;
+	    tail->set_next(q);
+	    tail = q;
 	}
 
 	off += out_dlen;
     }
+    tail->set_next(0);
 
-    p->kill();
+    if (p != p_in)
+	p_in->kill();
+    else
+	p->kill();
+
+    while (head) {
+	Packet *next = head->next();
+	head->set_next(0);
+	output(0).push(head);
+	_fragments++;
+	head = next;
+    }
 }
 
 void
@@ -172,6 +211,8 @@ IPFragmenter::add_handlers()
 {
     add_data_handlers("drops", Handler::OP_READ, &_drops);
     add_data_handlers("fragments", Handler::OP_READ, &_fragments);
+    add_data_handlers("copies", Handler::OP_READ, &_copies);
+    add_data_handlers("copy_bytes", Handler::OP_READ, &_copy_bytes);
 }
 
 CLICK_ENDDECLS
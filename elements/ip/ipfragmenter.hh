@@ -28,6 +28,11 @@ CLICK_DECLS
  * IPFragmenter, since any MAC header is not copied to second and subsequent
  * fragments.
  *
+ * The first fragment shares the input packet's buffer when no other packet
+ * does, so its data is not copied.  Each later fragment gets a new buffer
+ * holding its header and a copy of its slice of the data; no byte is copied
+ * more than once.
+ *
  * Keyword arguments are:
  *
  * =over 8
@@ -48,6 +53,25 @@ CLICK_DECLS
  * Unsigned.  Sets the headroom on the output packets to an explicit value,
  * rather than the default (which is usually about 28 bytes).
  *
+ * =back
+ *
+ * =h drops read-only
+ *
+ * Returns the number of packets sent to output 1.
+ *
+ * =h fragments read-only
+ *
+ * Returns the number of fragments emitted.
+ *
+ * =h copies read-only
+ *
+ * Returns the number of fragments IPFragmenter has copied into new buffers.
+ *
+ * =h copy_bytes read-only
+ *
+ * Returns the number of bytes IPFragmenter has copied into new buffers,
+ * headers included.
+ *
  * =e
  *   ... -> fr::IPFragmenter(1024) -> Queue(20) -> ...
  *   fr[1] -> ICMPError(18.26.4.24, 3, 4) -> ...
@@ -80,6 +104,8 @@ class IPFragmenter : public Element { public:
   unsigned _headroom;
   atomic_uint32_t _drops;
   atomic_uint32_t _fragments;
+  atomic_uint32_t _copies;
+  atomic_uint32_t _copy_bytes;
 
   void fragment(Packet *);
   int optcopy(const click_ip *ip1, click_ip *ip2);
@@ -36,25 +36,31 @@ CLICK_DECLS
 #define IP_BYTE_OFF(iph)	((ntohs((iph)->ip_off) & IP_OFFMASK) << 3)
 
 IPReassembler::IPReassembler()
-    : _stat_frags_seen(0), _stat_good_assem(0), _stat_failed_assem(0), _stat_bad_pkts(0)
+    : _map(0), _nbuckets(0), _nqueues(0), _age_head(0), _age_tail(0),
+      _stat_frags_seen(0), _stat_good_assem(0), _stat_failed_assem(0),
+      _stat_bad_pkts(0), _stat_late(0), _stat_timeouts(0), _stat_evictions(0),
+      _stat_source_drops(0), _stat_frag_limit(0), _stat_nomem(0)
 {
-    for (int i = 0; i < NMAP; i++)
-	_map[i] = 0;
     static_assert(IPREASSEMBLER_ANNO_OFFSET + IPREASSEMBLER_ANNO_SIZE <= Packet::anno_size, "anno too big");
     static_assert(sizeof(ChunkLink) == IPREASSEMBLER_ANNO_SIZE, "sizeof(ChunkLink) is expected to equal IPREASSEMBLER_ANNO_SIZE.");
 }
 
 IPReassembler::~IPReassembler()
 {
+    delete[] _map;
 }
 
 int
 IPReassembler::configure(Vector<String> &conf, ErrorHandler *errh)
 {
     _mem_high_thresh = 256 * 1024;
+    _source_high_thresh = 0;
+    _max_frags = 128;
     int mtu_anno = -1;
     if (Args(conf, this, errh)
 	.read("HIMEM", _mem_high_thresh)
+	.read("SOURCE_HIMEM", _source_high_thresh)
+	.read("MAX_FRAGMENTS", _max_frags)
 	.read("MAX_MTU_ANNO", AnnoArg(2), mtu_anno)
 	.complete() < 0)
 	return -1;
@@ -67,19 +73,28 @@ int
 IPReassembler::initialize(ErrorHandler *)
 {
     _mem_used = 0;
-    _reap_time = 0;
+    _nbuckets = INITIAL_NBUCKETS;
+    _map = new Queue *[_nbuckets];
+    for (int i = 0; i < _nbuckets; i++)
+	_map[i] = 0;
+    // A secret seed keeps senders from aiming fragments at one bucket.
+    _hash_seed = click_random();
     return 0;
 }
 
 void
 IPReassembler::cleanup(CleanupStage)
 {
-    for (int i = 0; i < NMAP; i++)
-	while (_map[i]) {
-	    WritablePacket *next = (WritablePacket *)(_map[i]->next());
-	    _map[i]->kill();
-	    _map[i] = next;
-	}
+    while (Queue *q = _age_head) {
+	_age_head = q->age_next;
+	q->p->kill();
+	delete q;
+    }
+    _age_tail = 0;
+    for (int i = 0; i < _nbuckets; i++)
+	if (_map)
+	    _map[i] = 0;
+    _nqueues = 0;
 }
 
 void
@@ -104,13 +119,19 @@ IPReassembler::check(ErrorHandler *errh)
     if (!errh)
 	errh = ErrorHandler::default_handler();
     uint32_t mem_used = 0;
-    for (int b = 0; b < NMAP; b++)
-	for (WritablePacket *q = _map[b]; q; q = (WritablePacket *)(q->next()))
+    int nqueues = 0;
+    HashTable<uint32_t, uint32_t> source_mem;
+    for (int b = 0; b < _nbuckets; b++)
+	for (Queue *qq = _map[b]; qq; qq = qq->hash_next) {
+	    WritablePacket *q = qq->p;
+	    ++nqueues;
 	    if (q->has_network_header()) {
 		const click_ip *qip = q->ip_header();
 		if (bucketno(qip) != b)
 		    check_error(errh, b, q, "in wrong bucket");
 		mem_used += IPH_MEM_USED + q->transport_length();
+		if (_source_high_thresh)
+		    source_mem[qip->ip_src.s_addr] += IPH_MEM_USED + q->transport_length();
 		ChunkLink *chunk = &PACKET_CHUNK(q);
 		int off = 0;
 #if VERBOSE_DEBUG
@@ -137,8 +158,26 @@ IPReassembler::check(ErrorHandler *errh)
 		}
 	    } else
 		errh->error("buck %d: missing IP header", b);
+	}
     if (mem_used != _mem_used)
 	errh->error("bad mem_used: have %u, claim %u", mem_used, _mem_used);
+    if (nqueues != _nqueues)
+	errh->error("bad queue count: have %d, claim %d", nqueues, _nqueues);
+    int nage = 0;
+    for (Queue *qq = _age_head; qq; qq = qq->age_next) {
+	if (qq->age_next ? qq->age_next->age_prev != qq : _age_tail != qq)
+	    errh->error("bad age list");
+	if (qq->age_next && qq->age_next->last < qq->last)
+	    errh->error("age list out of order");
+	++nage;
+    }
+    if (nage != _nqueues)
+	errh->error("bad age list length: have %d, claim %d", nage, _nqueues);
+    if (source_mem.size() != _source_mem.size())
+	errh->error("bad source count: have %d, claim %d", source_mem.size(), _source_mem.size());
+    for (HashTable<uint32_t, uint32_t>::iterator it = source_mem.begin(); it; ++it)
+	if (_source_mem.get(it.key()) != it.value())
+	    errh->error("bad mem_used for %s: have %u, claim %u", IPAddress(it.key()).unparse().c_str(), it.value(), _source_mem.get(it.key()));
     return 0;
 }
 
@@ -154,46 +193,134 @@ IPReassembler::debug_dump(Element *e, void *)
 	"failed reassemblies: " << r->_stat_failed_assem << "\n"
 	"bad fragments seen:  " << r->_stat_bad_pkts << "\n"
 	"cached chunk data:\n";
-    for (int b = 0; b < NMAP; b++)
-	for (WritablePacket *q = r->_map[b]; q; q = (WritablePacket *)(q->next()))
-	    if (const click_ip *qip = q->ip_header()) {
-		sa << ' ' << IPFlowID(qip) << ' ' << ntohs(qip->ip_id);
-		ChunkLink *chunk = &PACKET_CHUNK(q);
-		while (chunk &&
-		       (chunk->lastoff > chunk->off) &&
-		       (chunk->lastoff <= q->transport_length())) {
-		    sa << " (" << chunk->off << ',' << chunk->lastoff << ')';
-		    chunk = next_chunk(q, chunk);
-		}
-		sa << '\n';
+    for (Queue *qq = r->_age_head; qq; qq = qq->age_next)
+	if (const click_ip *qip = qq->p->ip_header()) {
+	    WritablePacket *q = qq->p;
+	    sa << ' ' << IPFlowID(qip) << ' ' << ntohs(qip->ip_id);
+	    ChunkLink *chunk = &PACKET_CHUNK(q);
+	    while (chunk &&
+		   (chunk->lastoff > chunk->off) &&
+		   (chunk->lastoff <= q->transport_length())) {
+		sa << " (" << chunk->off << ',' << chunk->lastoff << ')';
+		chunk = next_chunk(q, chunk);
 	    }
+	    sa << '\n';
+	}
     return sa.take_string();
 }
 
-WritablePacket *
-IPReassembler::find_queue(Packet *p, WritablePacket ***store_pprev)
+inline void
+IPReassembler::account(const click_ip *iph, int delta)
 {
-    const click_ip *iph = p->ip_header();
-    int bucket = bucketno(iph);
-    WritablePacket **pprev = &_map[bucket];
-    WritablePacket *q;
-    for (q = *pprev; q; pprev = (WritablePacket **)&q->next(), q = *pprev) {
-	const click_ip *qiph = q->ip_header();
-	if (same_segment(iph, qiph)) {
+    _mem_used += delta;
+    if (_source_high_thresh) {
+	uint32_t &m = _source_mem[iph->ip_src.s_addr];
+	m += delta;
+	if (!m)
+	    _source_mem.erase(iph->ip_src.s_addr);
+    }
+}
+
+inline bool
+IPReassembler::source_full(const click_ip *iph, int delta) const
+{
+    return _source_high_thresh
+	&& _source_mem.get(iph->ip_src.s_addr) + delta > _source_high_thresh;
+}
+
+IPReassembler::Queue *
+IPReassembler::find_queue(const click_ip *iph, Queue ***store_pprev)
+{
+    Queue **pprev = &_map[bucketno(iph)];
+    for (Queue *q = *pprev; q; pprev = &q->hash_next, q = *pprev)
+	if (same_segment(iph, q->p->ip_header())) {
 	    *store_pprev = pprev;
 	    return q;
 	}
-    }
-    *store_pprev = &_map[bucket];
+    *store_pprev = pprev;
     return 0;
 }
 
+inline void
+IPReassembler::touch_queue(Queue *q, int now)
+{
+    // Packet timestamps can run backwards; keep the age list ordered.
+    if (_age_tail && now < _age_tail->last)
+	now = _age_tail->last;
+    q->last = now;
+    if (q != _age_tail) {
+	if (q->age_prev || q == _age_head) {
+	    if (q->age_prev)
+		q->age_prev->age_next = q->age_next;
+	    else
+		_age_head = q->age_next;
+	    q->age_next->age_prev = q->age_prev;
+	}
+	q->age_prev = _age_tail;
+	q->age_next = 0;
+	if (_age_tail)
+	    _age_tail->age_next = q;
+	else
+	    _age_head = q;
+	_age_tail = q;
+    }
+}
+
+void
+IPReassembler::unlink_queue(Queue *q, Queue **q_pprev)
+{
+    *q_pprev = q->hash_next;
+    if (q->age_prev)
+	q->age_prev->age_next = q->age_next;
+    else
+	_age_head = q->age_next;
+    if (q->age_next)
+	q->age_next->age_prev = q->age_prev;
+    else
+	_age_tail = q->age_prev;
+    --_nqueues;
+    delete q;
+}
+
+WritablePacket *
+IPReassembler::remove_queue(Queue *q, Queue **q_pprev)
+{
+    if (!q_pprev)
+	for (q_pprev = &_map[bucketno(q->p->ip_header())]; *q_pprev != q;
+	     q_pprev = &(*q_pprev)->hash_next)
+	    /* nada */;
+    WritablePacket *p = q->p;
+    account(p->ip_header(), -(IPH_MEM_USED + p->transport_length()));
+    unlink_queue(q, q_pprev);
+    return p;
+}
+
+void
+IPReassembler::rehash()
+{
+    int nbuckets = _nbuckets * 2;
+    Queue **map = new Queue *[nbuckets];
+    for (int i = 0; i < nbuckets; i++)
+	map[i] = 0;
+    Queue **old_map = _map;
+    int old_nbuckets = _nbuckets;
+    _map = map;
+    _nbuckets = nbuckets;
+    for (int i = 0; i < old_nbuckets; i++)
+	while (Queue *q = old_map[i]) {
+	    old_map[i] = q->hash_next;
+	    Queue **pprev = &_map[bucketno(q->p->ip_header())];
+	    q->hash_next = *pprev;
+	    *pprev = q;
+	}
+    delete[] old_map;
+}
+
 Packet *
-IPReassembler::emit_whole_packet(WritablePacket *q, WritablePacket **q_pprev,
-				 Packet *p_in)
+IPReassembler::emit_whole_packet(Queue *qq, Queue **q_pprev, Packet *p_in)
 {
     ++_stat_good_assem;
-    *q_pprev = (WritablePacket *)q->next();
+    WritablePacket *q = remove_queue(qq, q_pprev);
 
     click_ip *q_iph = q->ip_header();
     q_iph->ip_len = htons(q->network_length());
@@ -206,29 +333,45 @@ IPReassembler::emit_whole_packet(WritablePacket *q, WritablePacket **q_pprev,
     q->set_next(0);
 
     p_in->kill();
-    _mem_used -= IPH_MEM_USED + q->transport_length();
     return q;
 }
 
-void
-IPReassembler::make_queue(Packet *p, WritablePacket **q_pprev)
+bool
+IPReassembler::make_queue(Packet *p, Queue **q_pprev, int now)
 {
     int p_off = IP_BYTE_OFF(p->ip_header());
     int p_lastoff = p_off + PACKET_DLEN(p);
     WritablePacket *q;
 
+    if (source_full(p->ip_header(), IPH_MEM_USED + p_lastoff)) {
+	++_stat_source_drops;
+	p->kill();
+	return false;
+    }
+
+    Queue *qq = new Queue;
+    if (!qq) {
+	++_stat_nomem;
+	p->kill();
+	return false;
+    }
+
     if (p_off == 0) {
 	q = p->uniqueify();
 	if (!q) {
+	    delete qq;
+	    ++_stat_nomem;
 	    click_chatter("out of memory");
-	    return;
+	    return false;
 	}
     } else {
 	q = Packet::make(p->headroom() + p->ip_header_offset(), 0, 20 + p_lastoff, 0);
 	if (!q) {
+	    delete qq;
 	    p->kill();
+	    ++_stat_nomem;
 	    click_chatter("out of memory");
-	    return;
+	    return false;
 	}
 	q->set_ip_header((click_ip *)q->data(), 20);
 	memcpy(q->ip_header(), p->ip_header(), 20);
@@ -237,8 +380,6 @@ IPReassembler::make_queue(Packet *p, WritablePacket **q_pprev)
 	p->kill();
     }
 
-    _mem_used += IPH_MEM_USED + p_lastoff;
-
     click_ip *q_iph = q->ip_header();
     q_iph->ip_off = (q_iph->ip_off & ~htons(IP_OFFMASK)); // leave MF, DF, RF
 
@@ -249,10 +390,16 @@ IPReassembler::make_queue(Packet *p, WritablePacket **q_pprev)
     PACKET_CHUNK(q).lastoff = p_lastoff;
 
     // link it up
-    q->set_next(*q_pprev);
-    *q_pprev = q;
-
-    check();
+    qq->p = q;
+    qq->nfrags = 1;
+    qq->hash_next = *q_pprev;
+    *q_pprev = qq;
+    qq->age_prev = qq->age_next = 0;
+    touch_queue(qq, now);
+    account(q_iph, IPH_MEM_USED + p_lastoff);
+    if (++_nqueues > _nbuckets)
+	rehash();
+    return true;
 }
 
 IPReassembler::ChunkLink *
@@ -281,7 +428,7 @@ IPReassembler::simple_action(Packet *p)
 	p->timestamp_anno().assign_now();
 	now = p->timestamp_anno().sec();
     }
-    if (now >= _reap_time)
+    if (_age_head && _age_head->last < now - REAP_TIMEOUT)
 	reap(now);
 
     // calculate packet edges
@@ -306,21 +453,25 @@ IPReassembler::simple_action(Packet *p)
 	reap_overfull(now);
 
     // get its Packet queue
-    WritablePacket **q_pprev;
-    WritablePacket *q = find_queue(p, &q_pprev);
-    if (!q) {			// make a new queue
-	make_queue(p, q_pprev);
+    Queue **q_pprev;
+    Queue *qq = find_queue(iph, &q_pprev);
+    if (!qq) {			// make a new queue
+	make_queue(p, q_pprev, now);
 	return 0;
     }
-    WritablePacket *q_bucket_next = (WritablePacket *)(q->next());
-
-    if (_mtu_anno >= 0 && q->anno_u16(_mtu_anno) < p->network_length())
-	q->set_anno_u16(_mtu_anno, p->network_length());
+    WritablePacket *q = qq->p;
 
     // extend the packet if necessary
     if (p_lastoff > q->transport_length()) {
 	// error if packet already completed
 	if (!(q->ip_header()->ip_off & htons(IP_MF))) {
+	    ++_stat_late;
+	    p->kill();
+	    return 0;
+	}
+	int old_transport_length = q->transport_length();
+	if (source_full(iph, p_lastoff - old_transport_length)) {
+	    ++_stat_source_drops;
 	    p->kill();
 	    return 0;
 	}
@@ -328,7 +479,6 @@ IPReassembler::simple_action(Packet *p)
 	// room for a ChunkLink, and request extra space if this packet has MF
 	// set. XXX This algorithm could result in a number of intermediate
 	// packet copies linear in the final packet length.
-	int old_transport_length = q->transport_length();
 	assert((old_transport_length & 7) == 0);
 	int want_space = p_lastoff - old_transport_length + 8;
 	if (iph->ip_off & htons(IP_MF))
@@ -336,20 +486,26 @@ IPReassembler::simple_action(Packet *p)
 	// request space
 	if (!(q = q->put(want_space))) {
 	    click_chatter("out of memory");
-	    *q_pprev = q_bucket_next;
-	    _mem_used -= IPH_MEM_USED + old_transport_length;
+	    // put() freed the queue's packet
+	    account(iph, -(IPH_MEM_USED + old_transport_length));
+	    unlink_queue(qq, q_pprev);
+	    ++_stat_nomem;
+	    ++_stat_failed_assem;
 	    p->kill();
 	    return 0;
 	}
 	// get rid of extra space
 	q->take(q->transport_length() - p_lastoff);
 	// hook up packet, and add final chunk
-	*q_pprev = q;
+	qq->p = q;
 	ChunkLink *last_chunk = (ChunkLink *)(q->transport_header() + old_transport_length);
 	last_chunk->off = last_chunk->lastoff = p_lastoff;
-	_mem_used += p_lastoff - old_transport_length;
+	account(iph, p_lastoff - old_transport_length);
     }
 
+    if (_mtu_anno >= 0 && q->anno_u16(_mtu_anno) < p->network_length())
+	q->set_anno_u16(_mtu_anno, p->network_length());
+
     // find chunks before and after p
     ChunkLink *chunk = &PACKET_CHUNK(q);
     while (chunk->lastoff < p_off)
@@ -358,6 +514,20 @@ IPReassembler::simple_action(Packet *p)
     while (last && last->lastoff < p_lastoff)
 	last = next_chunk(q, last);
 
+    // Each fragment that adds data adds at most one chunk, and finding a
+    // fragment's place walks the chunk list, so too many such fragments make
+    // each one expensive.  Duplicates add neither data nor chunks.
+    if (_max_frags && (p_off < chunk->off || p_lastoff > chunk->lastoff)
+	&& ++qq->nfrags > _max_frags) {
+	q = remove_queue(qq, q_pprev);
+	q->set_next(0);
+	++_stat_frag_limit;
+	++_stat_failed_assem;
+	checked_output_push(1, q);
+	p->kill();
+	return 0;
+    }
+
     // patch chunks
     assert(chunk && last);
     if (p_lastoff < last->off) {
@@ -380,6 +550,7 @@ IPReassembler::simple_action(Packet *p)
 	    q = q->push(header_delta);
 	else if (header_delta < 0)
 	    q->pull(-header_delta);
+	qq->p = q;
 	q->set_ip_header((click_ip *)(q->data() + p->ip_header_offset()), p->ip_header_length());
         if (p->has_mac_header())
 	    q->set_mac_header((q->data() + p->mac_header_offset()), p->mac_header_length());
@@ -404,68 +575,98 @@ IPReassembler::simple_action(Packet *p)
     if ((q->ip_header()->ip_off & htons(IP_MF)) == 0
 	&& PACKET_CHUNK(q).off == 0
 	&& PACKET_CHUNK(q).lastoff == q->transport_length())
-	return emit_whole_packet(q, q_pprev, p);
+	return emit_whole_packet(qq, q_pprev, p);
 
     // Otherwise, done for now
-    //check();
+    touch_queue(qq, now);
     p->kill();
     return 0;
 }
 
 void
-IPReassembler::reap_overfull(int now)
+IPReassembler::reap_overfull(int)
 {
-    check();
-
-    // First throw away fragments at least 10 seconds old, then at least 5
-    // seconds old, then any fragments.
-    for (int delta = 10; delta >= 0; delta -= 5)
-	for (int bucket = 0; bucket < NMAP; bucket++) {
-	    WritablePacket **pprev = &_map[bucket];
-	    for (WritablePacket *q = *pprev; q; q = *pprev)
-		if (!delta || q->timestamp_anno().sec() < now - delta) {
-		    *pprev = (WritablePacket *)q->next();
-		    _mem_used -= IPH_MEM_USED + q->transport_length();
-		    q->set_next(0);
-		    checked_output_push(1, q);
-		    ++_stat_failed_assem;
-		    if (_mem_used <= _mem_low_thresh)
-			return;
-		} else
-		    pprev = (WritablePacket **)&q->next();
-	}
-
-    click_chatter("IPReassembler: cannot free enough memory!");
+    // Throw away the least recently used datagrams first.
+    while (_age_head && _mem_used > _mem_low_thresh) {
+	WritablePacket *q = remove_queue(_age_head, 0);
+	q->set_next(0);
+	++_stat_evictions;
+	++_stat_failed_assem;
+	checked_output_push(1, q);
+    }
+    if (_mem_used > _mem_low_thresh)
+	click_chatter("IPReassembler: cannot free enough memory!");
 }
 
 void
 IPReassembler::reap(int now)
 {
-    // look at all queues. If no activity for 30 seconds, kill that queue
-
+    // Kill queues with no activity for REAP_TIMEOUT seconds.  They are at the
+    // front of the age list.
     int kill_time = now - REAP_TIMEOUT;
-
-    for (int i = 0; i < NMAP; i++) {
-	WritablePacket **q_pprev = &_map[i];
-	for (WritablePacket *q = *q_pprev; q; ) {
-	    if (q->timestamp_anno().sec() < kill_time) {
-		*q_pprev = (WritablePacket *)q->next();
-		q->set_next(0);
-		_mem_used -= IPH_MEM_USED + q->transport_length();
-		checked_output_push(1, q);
-	    } else
-		q_pprev = (WritablePacket **)&q->next();
-	    q = *q_pprev;
-	}
+    while (_age_head && _age_head->last < kill_time) {
+	WritablePacket *q = remove_queue(_age_head, 0);
+	q->set_next(0);
+	++_stat_timeouts;
+	++_stat_failed_assem;
+	checked_output_push(1, q);
     }
+}
 
-    _reap_time = now + REAP_INTERVAL;
+enum { h_frags, h_reassembled, h_failed, h_bad, h_late, h_timeouts,
+       h_evictions, h_source_drops, h_frag_limit, h_nomem, h_mem_used,
+       h_queues };
+
+String
+IPReassembler::read_handler(Element *e, void *user_data)
+{
+    IPReassembler *r = static_cast<IPReassembler *>(e);
+    switch (reinterpret_cast<intptr_t>(user_data)) {
+    case h_frags:
+	return String(r->_stat_frags_seen);
+    case h_reassembled:
+	return String(r->_stat_good_assem);
+    case h_failed:
+	return String(r->_stat_failed_assem);
+    case h_bad:
+	return String(r->_stat_bad_pkts);
+    case h_late:
+	return String(r->_stat_late);
+    case h_timeouts:
+	return String(r->_stat_timeouts);
+    case h_evictions:
+	return String(r->_stat_evictions);
+    case h_source_drops:
+	return String(r->_stat_source_drops);
+    case h_frag_limit:
+	return String(r->_stat_frag_limit);
+    case h_nomem:
+	return String(r->_stat_nomem);
+    case h_mem_used:
+	return String(r->_mem_used);
+    case h_queues:
+	return String(r->_nqueues);
+    default:
+	return String();
+    }
 }
 
 void
 IPReassembler::add_handlers()
 {
     add_read_handler("dump", debug_dump);
+    add_read_handler("fragments", read_handler, h_frags);
+    add_read_handler("reassembled", read_handler, h_reassembled);
+    add_read_handler("failed", read_handler, h_failed);
+    add_read_handler("bad_drops", read_handler, h_bad);
+    add_read_handler("late_drops", read_handler, h_late);
+    add_read_handler("timeouts", read_handler, h_timeouts);
+    add_read_handler("evictions", read_handler, h_evictions);
+    add_read_handler("source_drops", read_handler, h_source_drops);
+    add_read_handler("frag_limit_drops", read_handler, h_frag_limit);
+    add_read_handler("nomem_drops", read_handler, h_nomem);
+    add_read_handler("mem_used", read_handler, h_mem_used);
+    add_read_handler("queues", read_handler, h_queues);
 }
 
 CLICK_ENDDECLS
@@ -4,7 +4,7 @@
 #include <click/element.hh>
 #include <click/glue.hh>
 #include <clicknet/ip.h>
-#include <click/timer.hh>
+#include <click/hashtable.hh>
 CLICK_DECLS
 
 /*
@@ -27,8 +27,17 @@ outputs, however, a single packet containing all the received fragments at
 their proper offsets is pushed onto output 1.
 
 IPReassembler's memory usage is bounded. When memory consumption rises above
-HIMEM bytes, IPReassembler throws away old fragments until memory consumption
-drops below 3/4*HIMEM bytes. Default HIMEM is 256K.
+HIMEM bytes, IPReassembler throws away the least recently active datagrams
+until memory consumption drops below 3/4*HIMEM bytes. Default HIMEM is 256K.
+The SOURCE_HIMEM keyword also bounds the memory held for any one source
+address, so that one sender cannot push out everyone else's fragments.
+
+Datagrams are found through a hash table, keyed on source, destination, IP
+ID, and protocol, that grows with the number of datagrams.  Expiring and
+throwing away datagrams takes time proportional to the number thrown away.
+Adding a fragment to a datagram, however, walks the list of data chunks
+received so far, so it costs time proportional to the number of fragments
+that have added data to that datagram.  The MAX_FRAGMENTS keyword bounds this cost.
 
 Output packets have the same MAC header as the fragment that contains
 offset 0.  Other than that, input MAC headers are ignored.
@@ -45,6 +54,20 @@ Keyword arguments are:
 
 The upper bound for memory consumption, in bytes. Default is 256K.
 
+=item SOURCE_HIMEM
+
+The upper bound for memory consumption by fragments from any one source
+address, in bytes.  Fragments that would exceed it are dropped.  Default is 0,
+which means no limit.
+
+=item MAX_FRAGMENTS
+
+The upper bound for the number of fragments that add data to any one
+datagram.  A datagram that receives more such fragments is given up on.
+Duplicate fragments, and others wholly covered by data already received, do
+not count.  Default is 128, enough for a 64K datagram sent over 576-byte
+links; 0 means no limit.
+
 =item MAX_MTU_ANNO
 
 Optional. A 2 byte annotation that will be filled with the maximum size of any
@@ -60,6 +83,62 @@ second output.
 
 IPReassembler destroys its input packets' "next packet" annotations.
 
+=h fragments read-only
+
+Returns the number of fragments seen.
+
+=h reassembled read-only
+
+Returns the number of datagrams reassembled.
+
+=h failed read-only
+
+Returns the number of datagrams given up on, for any reason.
+
+=h timeouts read-only
+
+Returns the number of datagrams given up on because they were dormant for 30
+seconds.
+
+=h evictions read-only
+
+Returns the number of datagrams thrown away to get under HIMEM.
+
+=h bad_drops read-only
+
+Returns the number of malformed fragments dropped.
+
+=h late_drops read-only
+
+Returns the number of fragments dropped because they extended past the end of
+a datagram whose last fragment had already arrived.
+
+=h source_drops read-only
+
+Returns the number of fragments dropped because of SOURCE_HIMEM.
+
+=h frag_limit_drops read-only
+
+Returns the number of datagrams given up on because more than MAX_FRAGMENTS
+fragments added data to them.
+
+=h nomem_drops read-only
+
+Returns the number of fragments dropped for lack of memory.
+
+=h mem_used read-only
+
+Returns the number of bytes of memory in use.
+
+=h queues read-only
+
+Returns the number of datagrams in the process of reassembly.
+
+=h dump read-only
+
+Checks IPReassembler's data structures and returns statistics and the chunks
+of data held for each datagram.
+
 =a IPFragmenter */
 
 class IPReassembler : public Element { public:
@@ -89,32 +168,61 @@ class IPReassembler : public Element { public:
   private:
 
     enum { REAP_TIMEOUT = 30, // seconds
-	   REAP_INTERVAL = 10, // seconds
-	   IPH_MEM_USED = 40 };
-
-    enum { NMAP = 256 };
-    WritablePacket *_map[NMAP];
+	   IPH_MEM_USED = 40,
+	   INITIAL_NBUCKETS = 256 };
+
+    // One datagram in the process of reassembly.  Queues are chained in hash
+    // buckets and, least recently used first, in an age list.
+    struct Queue {
+	Queue *hash_next;
+	Queue *age_prev;
+	Queue *age_next;
+	WritablePacket *p;
+	int last;		// seconds, from the latest fragment's timestamp
+	uint32_t nfrags;	// fragments that added data; bounds the chunk count
+    };
 
-    int _reap_time;
+    Queue **_map;
+    int _nbuckets;
+    int _nqueues;
+    uint32_t _hash_seed;
+    Queue *_age_head;
+    Queue *_age_tail;
 
     uint32_t _stat_frags_seen;
     uint32_t _stat_good_assem;
     uint32_t _stat_failed_assem;
     uint32_t _stat_bad_pkts;
+    uint32_t _stat_late;
+    uint32_t _stat_timeouts;
+    uint32_t _stat_evictions;
+    uint32_t _stat_source_drops;
+    uint32_t _stat_frag_limit;
+    uint32_t _stat_nomem;
 
     uint32_t _mem_used;
     uint32_t _mem_high_thresh;	// defaults to 256K
     uint32_t _mem_low_thresh;	// defaults to 3/4 * _mem_high_thresh
+    uint32_t _source_high_thresh; // 0 means no limit
+    uint32_t _max_frags;	// 0 means no limit
+    HashTable<uint32_t, uint32_t> _source_mem;
     int8_t _mtu_anno;
 
-    static inline int bucketno(const click_ip *);
+    inline int bucketno(const click_ip *) const;
     static inline bool same_segment(const click_ip *, const click_ip *);
     static String debug_dump(Element *e, void *);
-
-    WritablePacket *find_queue(Packet *, WritablePacket ***);
-    void make_queue(Packet *, WritablePacket **);
+    static String read_handler(Element *e, void *);
+
+    Queue *find_queue(const click_ip *, Queue ***);
+    bool make_queue(Packet *, Queue **, int);
+    void unlink_queue(Queue *, Queue **);
+    WritablePacket *remove_queue(Queue *, Queue **);
+    inline void touch_queue(Queue *, int);
+    void rehash();
+    inline void account(const click_ip *, int);
+    inline bool source_full(const click_ip *, int) const;
     static ChunkLink *next_chunk(WritablePacket *, ChunkLink *);
-    Packet *emit_whole_packet(WritablePacket *, WritablePacket **, Packet *);
+    Packet *emit_whole_packet(Queue *, Queue **, Packet *);
     void reap_overfull(int);
     void reap(int);
     static void check_error(ErrorHandler *, int, const Packet *, const char *, ...);
@@ -123,9 +231,13 @@ class IPReassembler : public Element { public:
 
 
 inline int
-IPReassembler::bucketno(const click_ip *h)
+IPReassembler::bucketno(const click_ip *h) const
 {
-    return (h->ip_id % NMAP);
+    uint32_t x = h->ip_src.s_addr ^ _hash_seed;
+    x = (x ^ (x >> 16)) * 0x85EBCA6BU + h->ip_dst.s_addr;
+    x = (x ^ (x >> 13)) * 0xC2B2AE35U + ((h->ip_id << 8) | h->ip_p);
+    x = (x ^ (x >> 16)) * 0x85EBCA6BU;
+    return (x ^ (x >> 13)) & (_nbuckets - 1);
 }
 
 inline bool
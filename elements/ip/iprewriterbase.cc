@@ -68,17 +68,20 @@ IPMapper::rewrite_flowid(IPRewriterInput *, const IPFlowID &, IPFlowID &,
 //
 
 IPRewriterBase::IPRewriterBase()
-    : _map(0), _heap(new IPRewriterHeap), _gc_timer(gc_timer_hook, this)
+    : _maps(0), _nshards(1), _heap(new IPRewriterHeap),
+      _gc_timer(gc_timer_hook, this), _gc_retry(false)
 {
     _timeouts[0] = default_timeout;
     _timeouts[1] = default_guarantee;
     _gc_interval_sec = default_gc_interval;
+    _reap_budget = default_reap_budget;
 }
 
 IPRewriterBase::~IPRewriterBase()
 {
     if (_heap)
 	_heap->unuse();
+    delete[] _maps;
 }
 
 
@@ -126,6 +129,8 @@ IPRewriterBase::parse_input_spec(const String &line, IPRewriterInput &is,
 	if ((unsigned) is.foutput >= (unsigned) noutputs()
 	    || (unsigned) is.routput >= (unsigned) is.reply_element->noutputs())
 	    return cerrh.error("output port out of range");
+	if (_nshards > 1 && !is.u.pattern->shardable())
+	    return cerrh.error("with SHARDS, a pattern needs a range of ports or addresses");
 	is.u.pattern->use();
 	is.kind = IPRewriterInput::i_pattern;
 
@@ -135,6 +140,8 @@ IPRewriterBase::parse_input_spec(const String &line, IPRewriterInput &is,
 	    return cerrh.error("syntax error, expected element name");
 	else if (!mapper)
 	    return cerrh.error("element is not an IPMapper");
+	else if (_nshards > 1)
+	    return cerrh.error("mappers do not support SHARDS");
 	else {
 	    is.kind = IPRewriterInput::i_mapper;
 	    is.u.mapper = mapper;
@@ -158,9 +165,13 @@ IPRewriterBase::configure(Vector<String> &conf, ErrorHandler *errh)
 	.read("GUARANTEE", SecondsArg(), _timeouts[1])
 	.read("REAP_INTERVAL", SecondsArg(), _gc_interval_sec)
 	.read("REAP_TIME", Args::deprecated, SecondsArg(), _gc_interval_sec)
+	.read("REAP_BUDGET", _reap_budget)
 	.consume() < 0)
 	return -1;
 
+    // Subclasses that support sharding have already read SHARDS.
+    _maps = new Map[_nshards];
+
     if (capacity_word) {
 	Element *e;
 	IPRewriterBase *rwb;
@@ -174,6 +185,10 @@ IPRewriterBase::configure(Vector<String> &conf, ErrorHandler *errh)
 	} else
 	    return errh->error("bad MAPPING_CAPACITY");
     }
+    // A shared heap takes its shards from the rewriter that configures it
+    // last; initialize() checks that they all agree.
+    if (_nshards != _heap->_nshards)
+	_heap->set_nshards(_nshards);
 
     if (conf.size() != ninputs())
 	return errh->error("need %d arguments, one per input port", ninputs());
@@ -197,18 +212,29 @@ IPRewriterBase::initialize(ErrorHandler *errh)
 	PrefixErrorHandler cerrh(errh, "input spec " + String(i) + ": ");
 	if (_input_specs[i].reply_element->_heap != _heap)
 	    cerrh.error("reply element %<%s%> must share this MAPPING_CAPACITY", i, _input_specs[i].reply_element->name().c_str());
+	else if (_input_specs[i].reply_element->_nshards != _nshards)
+	    cerrh.error("reply element %<%s%> must have the same SHARDS", _input_specs[i].reply_element->name().c_str());
 	if (_input_specs[i].kind == IPRewriterInput::i_mapper)
 	    _input_specs[i].u.mapper->notify_rewriter(this, &_input_specs[i], &cerrh);
     }
+    if (_heap->_nshards != _nshards)
+	errh->error("rewriters sharing MAPPING_CAPACITY must have the same SHARDS");
     _gc_timer.initialize(this);
-    if (_gc_interval_sec)
+    if (_gc_interval_sec) {
 	_gc_timer.schedule_after_sec(_gc_interval_sec);
+	// With several shards, only one timer may mark and sweep them, or
+	// one rewriter's timer could sweep a shard another just marked.
+	if (!_heap->_gc_owner)
+	    _heap->_gc_owner = this;
+    }
     return errh->nerrors() ? -1 : 0;
 }
 
 void
 IPRewriterBase::cleanup(CleanupStage)
 {
+    if (_heap->_gc_owner == this)
+	_heap->_gc_owner = 0;
     shrink_heap(true);
     for (int i = 0; i < _input_specs.size(); ++i)
 	if (_input_specs[i].kind == IPRewriterInput::i_pattern)
@@ -219,7 +245,7 @@ IPRewriterBase::cleanup(CleanupStage)
 IPRewriterEntry *
 IPRewriterBase::get_entry(int ip_p, const IPFlowID &flowid, int input)
 {
-    IPRewriterEntry *m = _map.get(flowid);
+    IPRewriterEntry *m = _maps[shard_of(flowid)].get(flowid);
     if (m && ip_p && m->flow()->ip_p() && m->flow()->ip_p() != ip_p)
 	return 0;
     if (!m && (unsigned) input < (unsigned) _input_specs.size()) {
@@ -233,33 +259,45 @@ IPRewriterBase::get_entry(int ip_p, const IPFlowID &flowid, int input)
 
 IPRewriterEntry *
 IPRewriterBase::store_flow(IPRewriterFlow *flow, int input,
-			   Map &map, Map *reply_map_ptr)
+			   Map *maps, Map *reply_maps)
 {
     IPRewriterBase *reply_element = _input_specs[input].reply_element;
+    int shard = shard_of(flow->entry(false).hashkey());
+    flow->_shard = shard;
     if ((unsigned) flow->entry(false).output() >= (unsigned) noutputs()
 	|| (unsigned) flow->entry(true).output() >= (unsigned) reply_element->noutputs()) {
 	flow->owner()->owner->destroy_flow(flow);
 	return 0;
     }
 
+    // Both directions of a flow must live in one shard, or replies would
+    // reach a thread that cannot see the mapping.
+    if (unlikely(shard_of(flow->entry(true).hashkey()) != shard)) {
+	flow->owner()->owner->destroy_flow(flow);
+	++_input_specs[input].failures;
+	return 0;
+    }
+    Map &map = maps[shard];
+
     IPRewriterEntry *old = map.set(&flow->entry(false));
     assert(!old);
 
-    if (!reply_map_ptr)
-	reply_map_ptr = &reply_element->_map;
-    old = reply_map_ptr->set(&flow->entry(true));
+    if (!reply_maps)
+	reply_maps = reply_element->_maps;
+    Map &reply_map = reply_maps[shard];
+    old = reply_map.set(&flow->entry(true));
     if (unlikely(old)) {		// Assume every map has the same heap.
 	if (likely(old->flow() != flow))
 	    old->flow()->destroy(_heap);
     }
 
-    Vector<IPRewriterFlow *> &myheap = _heap->_heaps[flow->guaranteed()];
+    Vector<IPRewriterFlow *> &myheap = _heap->heap(shard, flow->guaranteed());
     myheap.push_back(flow);
     push_heap(myheap.begin(), myheap.end(),
 	      IPRewriterFlow::heap_less(), IPRewriterFlow::heap_place());
     ++_input_specs[input].count;
 
-    if (unlikely(_heap->size() > _heap->capacity())) {
+    if (unlikely(_heap->size(shard) > _heap->capacity(shard))) {
 	// This may destroy the newly added mapping, if it has the lowest
 	// expiration time.  How can we tell?  If (1) flows are added to the
 	// heap one at a time, so the heap was formerly no bigger than the
@@ -267,7 +305,7 @@ IPRewriterBase::store_flow(IPRewriterFlow *flow, int input,
 	// destroy 'flow' if it's the top of the heap.
 	click_jiffies_t now_j = click_jiffies();
 	assert(click_jiffies_less(now_j, flow->expiry())
-	       && _heap->size() == _heap->capacity() + 1);
+	       && _heap->size(shard) == _heap->capacity(shard) + 1);
 	if (shrink_heap_for_new_flow(flow, now_j)) {
 	    ++_input_specs[input].failures;
 	    return 0;
@@ -276,16 +314,16 @@ IPRewriterBase::store_flow(IPRewriterFlow *flow, int input,
 
     if (map.unbalanced())
 	map.rehash(map.bucket_count() + 1);
-    if (reply_map_ptr != &map && reply_map_ptr->unbalanced())
-	reply_map_ptr->rehash(reply_map_ptr->bucket_count() + 1);
+    if (&reply_map != &map && reply_map.unbalanced())
+	reply_map.rehash(reply_map.bucket_count() + 1);
     return &flow->entry(false);
 }
 
 void
-IPRewriterBase::shift_heap_best_effort(click_jiffies_t now_j)
+IPRewriterBase::shift_heap_best_effort(int shard, click_jiffies_t now_j)
 {
     // Shift flows with expired guarantees to the best-effort heap.
-    Vector<IPRewriterFlow *> &guaranteed_heap = _heap->_heaps[1];
+    Vector<IPRewriterFlow *> &guaranteed_heap = _heap->heap(shard, true);
     while (guaranteed_heap.size() && guaranteed_heap[0]->expired(now_j)) {
 	IPRewriterFlow *mf = guaranteed_heap[0];
 	click_jiffies_t new_expiry = mf->owner()->owner->best_effort_expiry(mf);
@@ -297,44 +335,169 @@ bool
 IPRewriterBase::shrink_heap_for_new_flow(IPRewriterFlow *flow,
 					 click_jiffies_t now_j)
 {
-    shift_heap_best_effort(now_j);
+    int shard = flow->shard();
+    shift_heap_best_effort(shard, now_j);
     // At this point, all flows in the guarantee heap expire in the future.
     // So remove the next-to-expire best-effort flow, unless there are none.
     // In that case we always remove the current flow to honor previous
     // guarantees (= admission control).
+    Vector<IPRewriterFlow *> &best_effort_heap = _heap->heap(shard, false);
     IPRewriterFlow *deadf;
-    if (_heap->_heaps[0].empty()) {
+    if (best_effort_heap.empty()) {
 	assert(flow->guaranteed());
 	deadf = flow;
     } else
-	deadf = _heap->_heaps[0][0];
+	deadf = best_effort_heap[0];
     deadf->destroy(_heap);
     return deadf == flow;
 }
 
+/** @brief Expire at most @a budget flows from @a shard.
+ * @return true if expired flows remain
+ *
+ * Shifting a flow with an expired guarantee to the best-effort heap counts
+ * against the budget, as does destroying an expired best-effort flow.  A
+ * @a budget of 0 means no limit. */
+bool
+IPRewriterBase::reap_shard(int shard, click_jiffies_t now_j, uint32_t budget)
+{
+    Vector<IPRewriterFlow *> &guaranteed_heap = _heap->heap(shard, true);
+    Vector<IPRewriterFlow *> &best_effort_heap = _heap->heap(shard, false);
+    for (uint32_t n = 0; !budget || n < budget; ++n) {
+	if (guaranteed_heap.size() && guaranteed_heap[0]->expired(now_j)) {
+	    IPRewriterFlow *mf = guaranteed_heap[0];
+	    click_jiffies_t new_expiry = mf->owner()->owner->best_effort_expiry(mf);
+	    mf->change_expiry(_heap, false, new_expiry);
+	} else if (best_effort_heap.size() && best_effort_heap[0]->expired(now_j))
+	    best_effort_heap[0]->destroy(_heap);
+	else
+	    return false;
+    }
+    return (guaranteed_heap.size() && guaranteed_heap[0]->expired(now_j))
+	|| (best_effort_heap.size() && best_effort_heap[0]->expired(now_j));
+}
+
+static uint32_t
+count_expired(IPRewriterFlow * const *heap, int size, int i,
+	      click_jiffies_t now_j, bool guaranteed)
+{
+    // Heaps are ordered by expiry, so no flow below an unexpired one has
+    // expired either.
+    if (i >= size || !heap[i]->expired(now_j))
+	return 0;
+    uint32_t n = 1;
+    if (guaranteed) {
+	IPRewriterFlow *mf = heap[i];
+	click_jiffies_t expiry = mf->owner()->owner->best_effort_expiry(mf);
+	n = !click_jiffies_less(now_j, expiry);
+    }
+    return n + count_expired(heap, size, 2*i + 1, now_j, guaranteed)
+	+ count_expired(heap, size, 2*i + 2, now_j, guaranteed);
+}
+
+/** @brief Return the number of expired flows not yet destroyed.
+ *
+ * Flows whose guarantees have expired count only if their best-effort
+ * timeouts have expired too. */
+uint32_t
+IPRewriterBase::reap_backlog(click_jiffies_t now_j) const
+{
+    uint32_t n = 0;
+    for (int s = 0; s < _heap->_nshards; ++s)
+	for (int which_heap = 0; which_heap < 2; ++which_heap) {
+	    const Vector<IPRewriterFlow *> &myheap = _heap->heap(s, which_heap);
+	    n += count_expired(myheap.begin(), myheap.size(), 0,
+			       now_j, which_heap);
+	}
+    return n;
+}
+
 void
-IPRewriterBase::shrink_heap(bool clear_all)
+IPRewriterBase::shrink_shard(int shard, bool clear_all)
 {
-    click_jiffies_t now_j = click_jiffies();
-    shift_heap_best_effort(now_j);
-    Vector<IPRewriterFlow *> &best_effort_heap = _heap->_heaps[0];
-    while (best_effort_heap.size() && best_effort_heap[0]->expired(now_j))
-	best_effort_heap[0]->destroy(_heap);
-
-    int32_t capacity = clear_all ? 0 : _heap->_capacity;
-    while (_heap->size() > capacity) {
-	IPRewriterFlow *deadf = _heap->_heaps[_heap->_heaps[0].empty()][0];
+    reap_shard(shard, click_jiffies(), 0);
+
+    Vector<IPRewriterFlow *> &best_effort_heap = _heap->heap(shard, false);
+    int32_t capacity = clear_all ? 0 : _heap->capacity(shard);
+    while (_heap->size(shard) > capacity) {
+	IPRewriterFlow *deadf = _heap->heap(shard, best_effort_heap.empty())[0];
 	deadf->destroy(_heap);
     }
 }
 
+void
+IPRewriterBase::shrink_heap(bool clear_all)
+{
+    for (int s = 0; s < _heap->_nshards; ++s)
+	shrink_shard(s, clear_all);
+}
+
+/** @brief Reap @a shard on behalf of the GC timer.
+ *
+ * Called by check_gc() from the shard's packet path. */
+void
+IPRewriterBase::claim_gc(int shard)
+{
+    atomic_uint32_t &state = _heap->_shards[shard].gc_state;
+    while (1) {
+	uint32_t s = state.value();
+	if (s == IPRewriterHeap::gc_idle)
+	    return;
+	else if (s == IPRewriterHeap::gc_busy)
+	    click_relax_fence();
+	else if (state.compare_swap(s, IPRewriterHeap::gc_busy) == s) {
+	    bool more = reap_shard(shard, click_jiffies(), _reap_budget);
+	    state = more ? IPRewriterHeap::gc_backlog : IPRewriterHeap::gc_idle;
+	    return;
+	}
+    }
+}
+
+/** @brief Advance the GC timer's work on @a shard.
+ * @return true if the timer should come back soon to sweep more
+ *
+ * At each interval the timer marks the shard, and the shard's next packet
+ * reaps it.  A shard still marked at the following interval has started
+ * no packets for a whole interval, so the timer sweeps it itself; any
+ * packet that arrives meanwhile waits in claim_gc().  On @a retry, the
+ * timer only continues its own unfinished sweeps. */
+bool
+IPRewriterBase::sweep_shard(int shard, click_jiffies_t now_j, bool retry)
+{
+    atomic_uint32_t &state = _heap->_shards[shard].gc_state;
+    uint32_t s = state.value();
+    if (s == IPRewriterHeap::gc_swept
+	|| (s == IPRewriterHeap::gc_marked && !retry)) {
+	if (state.compare_swap(s, IPRewriterHeap::gc_busy) != s)
+	    return false;	// a packet got there first
+	bool more = reap_shard(shard, now_j, _reap_budget);
+	state = more ? IPRewriterHeap::gc_swept : IPRewriterHeap::gc_idle;
+	return more;
+    } else if (!retry && s != IPRewriterHeap::gc_busy)
+	state.compare_swap(s, IPRewriterHeap::gc_marked);
+    return false;
+}
+
 void
 IPRewriterBase::gc_timer_hook(Timer *t, void *user_data)
 {
     IPRewriterBase *rw = static_cast<IPRewriterBase *>(user_data);
-    rw->shrink_heap(false);
-    if (rw->_gc_interval_sec)
+    // Reap at most REAP_BUDGET flows per tick.  If more remain, come back
+    // soon rather than holding up the packet path.
+    bool more = false;
+    if (rw->_heap->_nshards == 1)
+	more = rw->reap_shard(0, click_jiffies(), rw->_reap_budget);
+    else if (rw->_heap->_gc_owner == rw) {
+	click_jiffies_t now_j = click_jiffies();
+	for (int s = 0; s < rw->_heap->_nshards; ++s)
+	    if (rw->sweep_shard(s, now_j, rw->_gc_retry))
+		more = true;
+    }
+    if (more)
+	t->schedule_after_msec(reap_retry_msec);
+    else if (rw->_gc_interval_sec)
 	t->reschedule_after_sec(rw->_gc_interval_sec);
+    rw->_gc_retry = more;
 }
 
 String
@@ -365,6 +528,9 @@ IPRewriterBase::read_handler(Element *e, void *user_data)
     case h_capacity:
 	sa << rw->_heap->_capacity;
 	break;
+    case h_reap_backlog:
+	sa << rw->reap_backlog(click_jiffies());
+	break;
     default:
 	for (int i = 0; i < rw->_input_specs.size(); ++i) {
 	    if (what != h_patterns && what != i)
@@ -425,15 +591,16 @@ IPRewriterBase::pattern_write_handler(const String &str, Element *e, void *user_
 	IPRewriterInput *spec = &rw->_input_specs[what];
 
 	// remove all existing flows created by this input
-	for (int which_heap = 0; which_heap < 2; ++which_heap) {
-	    Vector<IPRewriterFlow *> &myheap = rw->_heap->_heaps[which_heap];
-	    for (int i = myheap.size() - 1; i >= 0; --i)
-		if (myheap[i]->owner() == spec) {
-		    myheap[i]->destroy(rw->_heap);
-		    if (i < myheap.size())
-			++i;
-		}
-	}
+	for (int s = 0; s < rw->_heap->_nshards; ++s)
+	    for (int which_heap = 0; which_heap < 2; ++which_heap) {
+		Vector<IPRewriterFlow *> &myheap = rw->_heap->heap(s, which_heap);
+		for (int i = myheap.size() - 1; i >= 0; --i)
+		    if (myheap[i]->owner() == spec) {
+			myheap[i]->destroy(rw->_heap);
+			if (i < myheap.size())
+			    ++i;
+		    }
+	    }
 
 	// change pattern
 	if (spec->kind == IPRewriterInput::i_pattern)
@@ -454,6 +621,7 @@ IPRewriterBase::add_rewriter_handlers(bool writable_patterns)
     add_read_handler("capacity", read_handler, h_capacity);
     add_write_handler("capacity", write_handler, h_capacity);
     add_write_handler("clear", write_handler, h_clear);
+    add_read_handler("reap_backlog", read_handler, h_reap_backlog);
     for (int i = 0; i < ninputs(); ++i) {
 	String name = "pattern" + String(i);
 	add_read_handler(name, read_handler, i);
@@ -2,6 +2,7 @@
 #ifndef CLICK_IPREWRITERBASE_HH
 #define CLICK_IPREWRITERBASE_HH
 #include <click/timer.hh>
+#include <click/atomic.hh>
 #include "elements/ip/iprwmapping.hh"
 #include <click/bitvector.hh>
 CLICK_DECLS
@@ -18,15 +19,17 @@ class IPRewriterInput { public:
     int foutput;
     IPRewriterBase *reply_element;
     int routput;
-    uint32_t count;
-    uint32_t failures;
+    atomic_uint32_t count;
+    atomic_uint32_t failures;
     union {
 	IPRewriterPattern *pattern;
 	IPMapper *mapper;
     } u;
 
     IPRewriterInput()
-	: kind(i_drop), foutput(-1), routput(-1), count(0), failures(0) {
+	: kind(i_drop), foutput(-1), routput(-1) {
+	count = 0;
+	failures = 0;
 	u.pattern = 0;
     }
 
@@ -42,10 +45,12 @@ class IPRewriterInput { public:
 class IPRewriterHeap { public:
 
     IPRewriterHeap()
-	: _capacity(0x7FFFFFFF), _use_count(1) {
+	: _shards(new Shard[1]), _nshards(1), _capacity(0x7FFFFFFF),
+	  _use_count(1), _gc_owner(0) {
     }
     ~IPRewriterHeap() {
 	assert(size() == 0);
+	delete[] _shards;
     }
 
     void use() {
@@ -57,21 +62,63 @@ class IPRewriterHeap { public:
 	    delete this;
     }
 
+    int nshards() const {
+	return _nshards;
+    }
+    Vector<IPRewriterFlow *>::size_type size(int shard) const {
+	return _shards[shard].heaps[0].size() + _shards[shard].heaps[1].size();
+    }
     Vector<IPRewriterFlow *>::size_type size() const {
-	return _heaps[0].size() + _heaps[1].size();
+	Vector<IPRewriterFlow *>::size_type n = 0;
+	for (int s = 0; s < _nshards; ++s)
+	    n += size(s);
+	return n;
     }
     int32_t capacity() const {
 	return _capacity;
     }
+    // Each shard gets an equal part of the capacity.
+    int32_t capacity(int shard) const {
+	return _capacity / _nshards + (shard < _capacity % _nshards);
+    }
 
   private:
 
     enum {
 	h_best_effort = 0, h_guarantee = 1
     };
-    Vector<IPRewriterFlow *> _heaps[2];
+    enum {			// Shard::gc_state values
+	gc_idle = 0,		// nothing left for the GC timer
+	gc_marked = 1,		// marked by the GC timer; not touched since
+	gc_backlog = 2,		// reaped by a packet; expired flows remain
+	gc_swept = 3,		// swept by the GC timer; expired flows remain
+	gc_busy = 4		// being reaped
+    };
+    struct Shard {
+	Vector<IPRewriterFlow *> heaps[2];
+	atomic_uint32_t gc_state;
+	Shard() {
+	    gc_state = gc_idle;
+	}
+    };
+    Shard *_shards;
+    int _nshards;
     int32_t _capacity;
     uint32_t _use_count;
+    IPRewriterBase *_gc_owner;	// whose GC timer sweeps the shards
+
+    Vector<IPRewriterFlow *> &heap(int shard, bool guaranteed) {
+	return _shards[shard].heaps[guaranteed];
+    }
+    const Vector<IPRewriterFlow *> &heap(int shard, bool guaranteed) const {
+	return _shards[shard].heaps[guaranteed];
+    }
+    void set_nshards(int nshards) {
+	assert(size() == 0);
+	delete[] _shards;
+	_shards = new Shard[nshards];
+	_nshards = nshards;
+    }
 
     friend class IPRewriterBase;
     friend class IPRewriterFlow;
@@ -110,8 +157,27 @@ class IPRewriterBase : public Element { public:
     IPRewriterBase *reply_element(int input) const {
 	return _input_specs[input].reply_element;
     }
-    virtual HashContainer<IPRewriterEntry> *get_map(int mapid) {
-	return likely(mapid == IPRewriterInput::mapid_default) ? &_map : 0;
+    virtual HashContainer<IPRewriterEntry> *get_map(int mapid, int shard) {
+	return likely(mapid == IPRewriterInput::mapid_default) ? &_maps[shard] : 0;
+    }
+
+    /** @brief Return the shard of @a flowid among @a nshards shards.
+     *
+     * The hash is symmetric, so a flow ID and its reverse share a shard. */
+    static inline int flow_shard(const IPFlowID &flowid, int nshards) {
+	if (nshards == 1)
+	    return 0;
+	uint32_t h = flowid.saddr().addr() ^ flowid.daddr().addr()
+	    ^ (flowid.sport() ^ flowid.dport());
+	h = (h ^ (h >> 16)) * 0x85EBCA6BU;
+	h = (h ^ (h >> 13)) * 0xC2B2AE35U;
+	return ((uint64_t) (h ^ (h >> 16)) * nshards) >> 32;
+    }
+    int nshards() const {
+	return _nshards;
+    }
+    int shard_of(const IPFlowID &flowid) const {
+	return flow_shard(flowid, _nshards);
     }
 
     enum {
@@ -131,19 +197,25 @@ class IPRewriterBase : public Element { public:
 
   protected:
 
-    Map _map;
+    Map *_maps;			// one per shard
+    int _nshards;
 
     Vector<IPRewriterInput> _input_specs;
 
     IPRewriterHeap *_heap;
     uint32_t _timeouts[2];
     uint32_t _gc_interval_sec;
+    uint32_t _reap_budget;
     Timer _gc_timer;
+    bool _gc_retry;
 
     enum {
 	default_timeout = 300,	   // 5 minutes
 	default_guarantee = 5,	   // 5 seconds
-	default_gc_interval = 60 * 15 // 15 minutes
+	default_gc_interval = 60 * 15, // 15 minutes
+	default_reap_budget = 1024,
+	reap_retry_msec = 1,
+	max_shards = 256
     };
 
     static uint32_t relevant_timeout(const uint32_t timeouts[2]) {
@@ -151,9 +223,10 @@ class IPRewriterBase : public Element { public:
     }
 
     IPRewriterEntry *store_flow(IPRewriterFlow *flow, int input,
-				Map &map, Map *reply_map_ptr = 0);
+				Map *maps, Map *reply_maps = 0);
     inline void unmap_flow(IPRewriterFlow *flow,
-			   Map &map, Map *reply_map_ptr = 0);
+			   Map *maps, Map *reply_maps = 0);
+    inline void check_gc(int shard);
 
     static void gc_timer_hook(Timer *t, void *user_data);
 
@@ -162,7 +235,7 @@ class IPRewriterBase : public Element { public:
 
     enum {			// < 0 because individual patterns are >= 0
 	h_nmappings = -1, h_mapping_failures = -2, h_patterns = -3,
-	h_size = -4, h_capacity = -5, h_clear = -6
+	h_size = -4, h_capacity = -5, h_clear = -6, h_reap_backlog = -7
     };
     static String read_handler(Element *e, void *user_data) CLICK_COLD;
     static int write_handler(const String &str, Element *e, void *user_data, ErrorHandler *errh) CLICK_COLD;
@@ -173,8 +246,13 @@ class IPRewriterBase : public Element { public:
 
   private:
 
-    void shift_heap_best_effort(click_jiffies_t now_j);
+    void shift_heap_best_effort(int shard, click_jiffies_t now_j);
     bool shrink_heap_for_new_flow(IPRewriterFlow *flow, click_jiffies_t now_j);
+    bool reap_shard(int shard, click_jiffies_t now_j, uint32_t budget);
+    void claim_gc(int shard);
+    bool sweep_shard(int shard, click_jiffies_t now_j, bool retry);
+    uint32_t reap_backlog(click_jiffies_t now_j) const;
+    void shrink_shard(int shard, bool clear_all);
     void shrink_heap(bool clear_all);
 
     friend class IPRewriterFlow;
@@ -210,12 +288,15 @@ IPRewriterInput::rewrite_flowid(const IPFlowID &flowid,
 	rewritten_flowid = flowid;
 	return IPRewriterBase::rw_addmap;
     case i_pattern: {
+	int nshards = reply_element->_nshards;
+	int shard = IPRewriterBase::flow_shard(flowid, nshards);
 	HashContainer<IPRewriterEntry> *reply_map;
 	if (likely(mapid == mapid_default))
-	    reply_map = &reply_element->_map;
+	    reply_map = &reply_element->_maps[shard];
 	else
-	    reply_map = reply_element->get_map(mapid);
-	i = u.pattern->rewrite_flowid(flowid, rewritten_flowid, *reply_map);
+	    reply_map = reply_element->get_map(mapid, shard);
+	i = u.pattern->rewrite_flowid(flowid, rewritten_flowid, *reply_map,
+				      shard, nshards);
 	goto check_for_failure;
     }
     case i_mapper:
@@ -231,18 +312,34 @@ IPRewriterInput::rewrite_flowid(const IPFlowID &flowid,
 }
 
 inline void
-IPRewriterBase::unmap_flow(IPRewriterFlow *flow, Map &map,
-			   Map *reply_map_ptr)
+IPRewriterBase::unmap_flow(IPRewriterFlow *flow, Map *maps,
+			   Map *reply_maps)
 {
     //click_chatter("kill %s", hashkey().s().c_str());
-    if (!reply_map_ptr)
-	reply_map_ptr = &flow->owner()->reply_element->_map;
+    if (!reply_maps)
+	reply_maps = flow->owner()->reply_element->_maps;
+    Map &map = maps[flow->shard()];
+    Map &reply_map = reply_maps[flow->shard()];
     Map::iterator it = map.find(flow->entry(0).hashkey());
     if (it.get() == &flow->entry(0))
 	map.erase(it);
-    it = reply_map_ptr->find(flow->entry(1).hashkey());
+    it = reply_map.find(flow->entry(1).hashkey());
     if (it.get() == &flow->entry(1))
-	reply_map_ptr->erase(it);
+	reply_map.erase(it);
+}
+
+/** @brief Run garbage collection that the GC timer left for @a shard.
+ *
+ * With more than one shard, the GC timer cannot touch shards that other
+ * threads are using, so it marks them instead.  Call this with a shard
+ * before touching its flows.  Each call reaps at most REAP_BUDGET flows;
+ * the shard stays marked until its backlog is gone.  If the GC timer is
+ * sweeping the shard, waits for it to finish. */
+inline void
+IPRewriterBase::check_gc(int shard)
+{
+    if (unlikely(_heap->_shards[shard].gc_state.value() != IPRewriterHeap::gc_idle))
+	claim_gc(shard);
 }
 
 CLICK_ENDDECLS
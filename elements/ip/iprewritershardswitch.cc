@@ -0,0 +1,67 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * iprewritershardswitch.{cc,hh} -- steers packets by rewriter shard
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "iprewritershardswitch.hh"
+#include "elements/ip/iprewriterbase.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <clicknet/ip.h>
+CLICK_DECLS
+
+IPRewriterShardSwitch::IPRewriterShardSwitch()
+    : _rewriter(0)
+{
+}
+
+int
+IPRewriterShardSwitch::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    Element *e = 0;
+    if (Args(conf, this, errh)
+	.read("REWRITER", e)
+	.complete() < 0)
+	return -1;
+    if (e && !(_rewriter = (IPRewriterBase *) e->cast("IPRewriterBase")))
+	return errh->error("REWRITER must be an IP rewriter");
+    return 0;
+}
+
+int
+IPRewriterShardSwitch::initialize(ErrorHandler *errh)
+{
+    // The rewriter has read its SHARDS by now.
+    if (_rewriter && _rewriter->nshards() != noutputs())
+	return errh->error("%<%s%> has %d shards, but I have %d output%s", _rewriter->name().c_str(), _rewriter->nshards(), noutputs(), noutputs() == 1 ? "" : "s");
+    return 0;
+}
+
+void
+IPRewriterShardSwitch::push(int, Packet *p)
+{
+    const click_ip *iph = p->ip_header();
+    int shard;
+    if ((iph->ip_p == IP_PROTO_TCP || iph->ip_p == IP_PROTO_UDP)
+	&& IP_FIRSTFRAG(iph) && p->transport_length() >= 8)
+	shard = IPRewriterBase::flow_shard(IPFlowID(p), noutputs());
+    else
+	shard = IPRewriterBase::flow_shard(IPFlowID(iph->ip_src, 0, iph->ip_dst, 0), noutputs());
+    output(shard).push(p);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(IPRewriterBase)
+EXPORT_ELEMENT(IPRewriterShardSwitch)
+ELEMENT_MT_SAFE(IPRewriterShardSwitch)
@@ -0,0 +1,79 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_IPREWRITERSHARDSWITCH_HH
+#define CLICK_IPREWRITERSHARDSWITCH_HH
+#include <click/element.hh>
+CLICK_DECLS
+class IPRewriterBase;
+
+/*
+=c
+
+IPRewriterShardSwitch([I<keywords> REWRITER])
+
+=s nat
+
+steers packets to a sharded rewriter's threads
+
+=d
+
+Expects IP packets.  Emits each packet on the output numbered by its
+rewriter shard, computed exactly as IPRewriter, TCPRewriter, and UDPRewriter
+do for their SHARDS, where the number of shards is the number of outputs.
+The shard hash is symmetric, and rewriter patterns choose rewritten ports and
+addresses whose replies land in the original flow's shard, so an
+IPRewriterShardSwitch on each side of a NAT sends both directions of every
+rewritten flow to the same output.
+
+Packets that are not TCP or UDP, or that are not first fragments, are
+steered by their addresses alone.
+
+Keyword arguments are:
+
+=over 8
+
+=item REWRITER
+
+Optional.  A sharded rewriter.  IPRewriterShardSwitch checks that it has as
+many shards as this element has outputs.
+
+=back
+
+=e
+
+This configuration gives each of two shards its own queue, and so its own
+thread, on both sides of the NAT:
+
+  rw :: IPRewriter(pattern 2.0.0.1 1024-65535 - - 0 1, drop, SHARDS 2);
+  in_ss :: IPRewriterShardSwitch(REWRITER rw);
+  out_ss :: IPRewriterShardSwitch(REWRITER rw);
+  FromDevice(eth0) -> ... -> in_ss;
+  FromDevice(eth1) -> ... -> out_ss;
+  in_ss[0] -> q0 :: Queue -> u0 :: Unqueue -> [0] rw;
+  in_ss[1] -> q1 :: Queue -> u1 :: Unqueue -> [0] rw;
+  out_ss[0] -> q2 :: Queue -> u2 :: Unqueue -> [1] rw;
+  out_ss[1] -> q3 :: Queue -> u3 :: Unqueue -> [1] rw;
+  StaticThreadSched(u0 0, u2 0, u1 1, u3 1);
+
+=a IPRewriter, TCPRewriter, UDPRewriter, HashSwitch */
+
+class IPRewriterShardSwitch : public Element { public:
+
+    IPRewriterShardSwitch() CLICK_COLD;
+
+    const char *class_name() const	{ return "IPRewriterShardSwitch"; }
+    const char *port_count() const	{ return "1/1-"; }
+    const char *processing() const	{ return PUSH; }
+
+    int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+    int initialize(ErrorHandler *) CLICK_COLD;
+
+    void push(int port, Packet *);
+
+  private:
+
+    IPRewriterBase *_rewriter;
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -25,7 +25,11 @@
 #include <click/glue.hh>
 #include <click/straccum.hh>
 #include <click/router.hh>
+#include <click/master.hh>
 #include "iproutetable.hh"
+#if CLICK_USERLEVEL
+# include <click/userutils.hh>
+#endif
 CLICK_DECLS
 
 bool
@@ -86,6 +90,11 @@ IPRoute::unparse() const
 }
 
 
+IPRouteTable::IPRouteTable()
+    : _shadow(false), _update_depth(0)
+{
+}
+
 void *
 IPRouteTable::cast(const char *name)
 {
@@ -98,8 +107,21 @@ IPRouteTable::cast(const char *name)
 int
 IPRouteTable::configure(Vector<String> &conf, ErrorHandler *errh)
 {
-    int r = 0, r1, eexist = 0;
+    int r = 0;
     IPRoute route;
+    String filename;
+    if (Args(this, errh).bind(conf)
+	.read("SHADOW", _shadow)
+#if CLICK_USERLEVEL
+	.read("FILE", FilenameArg(), filename)
+#endif
+	.consume() < 0)
+	return -1;
+    if (_shadow && (r = enable_shadow(errh)) < 0)
+	return r;
+
+    // Collect every route first, so the table can be built in one pass.
+    Vector<IPRoute> routes;
     for (int i = 0; i < conf.size(); i++) {
 	if (!cp_ip_route(conf[i], &route, false, this)) {
 	    errh->error("argument %d should be %<ADDR/MASK [GATEWAY] OUTPUT%>", i+1);
@@ -107,16 +129,29 @@ IPRouteTable::configure(Vector<String> &conf, ErrorHandler *errh)
 	} else if (route.port < 0 || route.port >= noutputs()) {
 	    errh->error("argument %d bad OUTPUT", i+1);
 	    r = -EINVAL;
-	} else if ((r1 = add_route(route, false, 0, errh)) < 0) {
-	    if (r1 == -EEXIST)
-		++eexist;
-	    else
-		r = r1;
-	}
+	} else
+	    routes.push_back(route);
     }
-    if (eexist)
-	errh->warning("%d %s replaced by later versions", eexist, eexist > 1 ? "routes" : "route");
-    return r;
+#if CLICK_USERLEVEL
+    if (filename) {
+	int before = errh->nerrors();
+	String text = file_string(filename, errh);
+	ContextErrorHandler cerrh(errh, "While reading %<%s%>:", filename.c_str());
+	if (errh->nerrors() != before || parse_routes(text, routes, &cerrh) < 0)
+	    r = -EINVAL;
+    }
+#endif
+    if (r < 0)
+	return r;
+
+    begin_update();
+    int ndup = load(routes, false, errh);
+    end_update();
+    if (ndup < 0)
+	return ndup;
+    if (ndup)
+	errh->warning("%d duplicate %s ignored", ndup, ndup > 1 ? "routes" : "route");
+    return 0;
 }
 
 int
@@ -133,6 +168,129 @@ IPRouteTable::remove_route(const IPRoute&, IPRoute*, ErrorHandler *errh)
     return errh->error("cannot delete routes from this routing table");
 }
 
+void
+IPRouteTable::flush_table()
+{
+}
+
+int
+IPRouteTable::enable_shadow(ErrorHandler *errh)
+{
+    return errh->error("SHADOW not supported by this routing table");
+}
+
+void
+IPRouteTable::publish_shadow()
+{
+}
+
+int
+IPRouteTable::load_routes(const Vector<IPRoute> &routes, bool allow_replace, ErrorHandler *errh)
+{
+    int ndup = 0;
+    flush_table();
+    for (const IPRoute *rp = routes.begin(); rp != routes.end(); ++rp) {
+	IPRoute old_route;
+	int r = add_route(*rp, allow_replace, &old_route, errh);
+	if (r == -EEXIST && !allow_replace)
+	    ++ndup;
+	else if (r < 0)
+	    return r;
+	else if (old_route.port >= 0)
+	    ++ndup;
+    }
+    return ndup;
+}
+
+void
+IPRouteTable::replay_shadow(const Vector<IPRoute> &changes)
+{
+    ErrorHandler *errh = ErrorHandler::silent_handler();
+    const IPRoute *r = changes.begin();
+    while (r != changes.end())
+	if (r->extra == CMD_REMOVE) {
+	    remove_route(*r, 0, errh);
+	    ++r;
+	} else if (r->extra == CMD_FLUSH) {
+	    // rebuild from a flush and the following additions in one go
+	    Vector<IPRoute> routes;
+	    int command = CMD_SET;
+	    if (r + 1 != changes.end() && r[1].extra == CMD_ADD)
+		command = CMD_ADD;
+	    for (++r; r != changes.end() && r->extra == command; ++r)
+		routes.push_back(*r);
+	    load_routes(routes, command == CMD_SET, errh);
+	} else {
+	    add_route(*r, true, 0, errh);
+	    ++r;
+	}
+}
+
+void
+IPRouteTable::begin_update()
+{
+    if (!_shadow || _update_depth++ > 0)
+	return;
+    // The shadow table was active before the last update.  Once no thread
+    // can still be looking up routes in it, bring it up to date.
+    if (_changes.size()) {
+	master()->wait_quiescent(_publish_epochs);
+	replay_shadow(_changes);
+	_changes.clear();
+    }
+}
+
+int
+IPRouteTable::update(int command, const IPRoute &route, IPRoute *old_route,
+		     ErrorHandler *errh)
+{
+    int r;
+    if (command == CMD_ADD || command == CMD_SET)
+	r = add_route(route, command == CMD_SET, old_route, errh);
+    else if (command == CMD_REMOVE)
+	r = remove_route(route, old_route, errh);
+    else {
+	flush_table();
+	r = 0;
+    }
+    if (r >= 0 && _shadow) {
+	_changes.push_back(route);
+	_changes.back().extra = command;
+    }
+    return r;
+}
+
+int
+IPRouteTable::load(const Vector<IPRoute> &routes, bool allow_replace,
+		   ErrorHandler *errh)
+{
+    int r = load_routes(routes, allow_replace, errh);
+    // Record the load even if it failed, since the table changed anyway.
+    // Earlier changes in this update no longer matter.
+    if (_shadow) {
+	_changes.clear();
+	_changes.push_back(IPRoute());
+	_changes.back().extra = CMD_FLUSH;
+	for (const IPRoute *rp = routes.begin(); rp != routes.end(); ++rp) {
+	    _changes.push_back(*rp);
+	    _changes.back().extra = (allow_replace ? CMD_SET : CMD_ADD);
+	}
+    }
+    return r;
+}
+
+void
+IPRouteTable::end_update()
+{
+    if (!_shadow || --_update_depth > 0)
+	return;
+    if (_changes.size()) {
+	click_write_fence();
+	publish_shadow();
+	master()->quiescent_snapshot(_publish_epochs);
+    }
+}
+
 int
 IPRouteTable::lookup_route(IPAddress, IPAddress&) const
 {
@@ -176,12 +334,7 @@ IPRouteTable::run_command(int command, const String &str, Vector<IPRoute>* old_r
 	return errh->error("bad OUTPUT");
 
     int r, before = errh->nerrors();
-    if (command == CMD_ADD)
-	r = add_route(route, false, &old_route, errh);
-    else if (command == CMD_SET)
-	r = add_route(route, true, &old_route, errh);
-    else
-	r = remove_route(route, &old_route, errh);
+    r = update(command, route, &old_route, errh);
 
     // save old route if in a transaction
     if (r >= 0 && old_routes) {
@@ -208,14 +361,20 @@ int
 IPRouteTable::add_route_handler(const String &conf, Element *e, void *thunk, ErrorHandler *errh)
 {
     IPRouteTable *table = static_cast<IPRouteTable *>(e);
-    return table->run_command((thunk ? CMD_SET : CMD_ADD), conf, 0, errh);
+    table->begin_update();
+    int r = table->run_command((thunk ? CMD_SET : CMD_ADD), conf, 0, errh);
+    table->end_update();
+    return r;
 }
 
 int
 IPRouteTable::remove_route_handler(const String &conf, Element *e, void *, ErrorHandler *errh)
 {
     IPRouteTable *table = static_cast<IPRouteTable *>(e);
-    return table->run_command(CMD_REMOVE, conf, 0, errh);
+    table->begin_update();
+    int r = table->run_command(CMD_REMOVE, conf, 0, errh);
+    table->end_update();
+    return r;
 }
 
 int
@@ -228,6 +387,7 @@ IPRouteTable::ctrl_handler(const String &conf_in, Element *e, void *, ErrorHandl
     Vector<IPRoute> old_routes;
     int r = 0;
 
+    table->begin_update();
     while (s < end) {
 	const char* nl = find(s, end, '\n');
 	String line = conf.substring(s, nl);
@@ -252,22 +412,72 @@ IPRouteTable::ctrl_handler(const String &conf_in, Element *e, void *, ErrorHandl
 
 	s = nl + 1;
     }
+    table->end_update();
     return 0;
 
   rollback:
     while (old_routes.size()) {
 	const IPRoute& rt = old_routes.back();
 	if (rt.extra == CMD_REMOVE)
-	    table->add_route(rt, false, 0, errh);
+	    table->update(CMD_ADD, rt, 0, errh);
 	else if (rt.extra == CMD_ADD)
-	    table->remove_route(rt, 0, errh);
+	    table->update(CMD_REMOVE, rt, 0, errh);
 	else
-	    table->add_route(rt, true, 0, errh);
+	    table->update(CMD_SET, rt, 0, errh);
 	old_routes.pop_back();
     }
+    table->end_update();
+    return r;
+}
+
+int
+IPRouteTable::flush_handler(const String &, Element *e, void *, ErrorHandler *errh)
+{
+    IPRouteTable *table = static_cast<IPRouteTable *>(e);
+    table->begin_update();
+    int r = table->update(CMD_FLUSH, IPRoute(), 0, errh);
+    table->end_update();
     return r;
 }
 
+int
+IPRouteTable::parse_routes(const String &conf_in, Vector<IPRoute> &routes, ErrorHandler *errh)
+{
+    String conf = cp_uncomment(conf_in);
+    const char* s = conf.begin(), *end = conf.end();
+    IPRoute route;
+    for (int line = 1; s < end; ++line) {
+	const char* nl = find(s, end, '\n');
+	String str = conf.substring(s, nl);
+	s = nl + 1;
+	const char* word = cp_skip_space(str.begin(), str.end());
+	if (word == str.end() || *word == '#')
+	    continue;
+	else if (!cp_ip_route(str, &route, false, this))
+	    return errh->error("line %d: expected %<ADDR/MASK [GATEWAY] OUTPUT%>", line);
+	else if (route.port < 0 || route.port >= noutputs())
+	    return errh->error("line %d: bad OUTPUT", line);
+	routes.push_back(route);
+    }
+    return 0;
+}
+
+int
+IPRouteTable::load_handler(const String &conf, Element *e, void *, ErrorHandler *errh)
+{
+    IPRouteTable *table = static_cast<IPRouteTable *>(e);
+
+    // parse everything first, so a bad route leaves the table unchanged
+    Vector<IPRoute> routes;
+    if (table->parse_routes(conf, routes, errh) < 0)
+	return -EINVAL;
+
+    table->begin_update();
+    int r = table->load(routes, true, errh);
+    table->end_update();
+    return r < 0 ? r : 0;
+}
+
 String
 IPRouteTable::table_handler(Element *e, void *)
 {
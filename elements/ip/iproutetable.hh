@@ -113,8 +113,66 @@ there is no route). The default implementation returns -1.
 Returns a textual description of the current routing table. The default
 implementation returns an empty string.
 
+=item C<void B<flush_table>()>
+
+Removes all routes. Used by the `C<flush>' handler. The default
+implementation does nothing.
+
+=item C<int B<load_routes>(const VectorE<lt>IPRouteE<gt> &routes, bool set, ErrorHandler *errh)>
+
+Replaces the table's contents with C<routes>.  If C<routes> contains more
+than one route for a prefix, the last one wins if C<set> is true, and the
+first one otherwise.  Should return the number of such duplicate routes, or
+negative on failure; on failure the table may hold some of C<routes>.  Used
+by B<configure> and the `C<load>' handler.  The default implementation calls
+B<flush_table>, then B<add_route> for each route.  Tables that can build
+their lookup structures faster in one pass should override it.
+
 =back
 
+=head1 SHADOW UPDATES
+
+Normally, route updates change the lookup structures in place, so lookups
+running on other threads can see a partially updated table.  Tables that
+support it accept a C<SHADOW> keyword argument.  If C<SHADOW> is true, the
+element keeps two copies of its lookup structures.  Lookups read the active
+copy and never block; each update -- a handler write, possibly a large
+C<ctrl> or C<load> batch -- changes the shadow copy, then publishes it as the
+active copy with a single pointer store.  The previous active copy becomes
+the shadow.  Before the next update, the element waits until every other
+thread has passed through its driver loop, so no lookup still uses that copy,
+and replays the previous update's changes on it.  Shadow tables double the
+memory used for lookups.
+
+Routing table elements supporting C<SHADOW> override these functions:
+
+=over 4
+
+=item C<int B<enable_shadow>(ErrorHandler *errh)>
+
+Allocates the shadow copy.  Called from B<configure>, before any routes are
+added.  Afterwards, B<add_route>, B<remove_route>, and B<flush_table> should
+change the shadow copy, while B<lookup_route> and B<dump_routes> use the
+active copy.  The default implementation reports an error.
+
+=item C<void B<publish_shadow>()>
+
+Makes the shadow copy active and the active copy the shadow.
+
+=item C<void B<replay_shadow>(const VectorE<lt>IPRouteE<gt> &changes)>
+
+Brings the shadow copy, which was active before the last B<publish_shadow>,
+up to date by applying C<changes>.  Each change's C<extra> field is
+C<CMD_ADD>, C<CMD_SET>, C<CMD_REMOVE>, or C<CMD_FLUSH>.  The default
+implementation calls B<add_route>, B<remove_route>, and B<flush_table>,
+except that it passes a flush followed by a run of additions to
+B<load_routes>.
+
+=back
+
+Other code that changes a shadow table must bracket the changes with
+B<begin_update> and B<end_update>, and make them with B<update> or B<load>.
+
 The following functions, overridden by IPRouteTable, are available for use by
 subclasses.
 
@@ -124,7 +182,9 @@ subclasses.
 
 The default implementation of B<configure> parses C<conf> as a list of routes,
 where each route is the space-separated list `C<address/mask [gateway]
-output>'. The routes are successively added to the element with B<add_route>.
+output>'.  At user level, a C<FILE> keyword argument names a file of further
+routes, one per line.  The routes are passed to B<load_routes> all at once;
+for duplicate prefixes, the first route wins.
 
 =item C<void B<push>(int port, Packet *p)>
 
@@ -155,6 +215,18 @@ up to the `C<ctrl>' handler.
 This read handler callback function returns the element's routing table via
 the B<dump_routes> function. Normally hooked up to the `C<table>' handler.
 
+=item C<static int B<flush_handler>(const String &, Element *, void *, ErrorHandler *)>
+
+This write handler callback function removes all routes with
+B<flush_table>. Normally hooked up to the `C<flush>' handler.
+
+=item C<static int B<load_handler>(const String &, Element *, void *, ErrorHandler *)>
+
+This write handler callback function parses its input as a list of routes,
+one per line, and replaces the routing table with them in one update.  Blank
+lines and lines starting with `C<#>' are ignored.  Normally hooked up to the
+`C<load>' handler.
+
 =back
 
 =a RadixIPLookup, DirectIPLookup, RangeIPLookup, StaticIPLookup,
@@ -187,6 +259,8 @@ struct IPRoute {
 
 class IPRouteTable : public Element { public:
 
+    IPRouteTable();
+
     void* cast(const char*);
     int configure(Vector<String>&, ErrorHandler*) CLICK_COLD;
     void add_handlers() CLICK_COLD;
@@ -195,6 +269,20 @@ class IPRouteTable : public Element { public:
     virtual int remove_route(const IPRoute& route, IPRoute* removed_route, ErrorHandler* errh);
     virtual int lookup_route(IPAddress addr, IPAddress& gw) const = 0;
     virtual String dump_routes();
+    virtual void flush_table();
+    virtual int load_routes(const Vector<IPRoute>& routes, bool allow_replace, ErrorHandler* errh);
+
+    enum { CMD_ADD, CMD_SET, CMD_REMOVE, CMD_FLUSH };
+
+    bool shadow() const			{ return _shadow; }
+    virtual int enable_shadow(ErrorHandler* errh);
+    virtual void publish_shadow();
+    virtual void replay_shadow(const Vector<IPRoute>& changes);
+
+    void begin_update();
+    int update(int command, const IPRoute& route, IPRoute* old_route, ErrorHandler* errh);
+    int load(const Vector<IPRoute>& routes, bool allow_replace, ErrorHandler* errh);
+    void end_update();
 
     void push(int port, Packet* p);
 
@@ -203,11 +291,18 @@ class IPRouteTable : public Element { public:
     static int ctrl_handler(const String&, Element*, void*, ErrorHandler*);
     static int lookup_handler(int operation, String&, Element*, const Handler*, ErrorHandler*);
     static String table_handler(Element*, void*);
+    static int flush_handler(const String&, Element*, void*, ErrorHandler*);
+    static int load_handler(const String&, Element*, void*, ErrorHandler*);
 
   private:
 
-    enum { CMD_ADD, CMD_SET, CMD_REMOVE };
+    bool _shadow;
+    int _update_depth;
+    Vector<IPRoute> _changes;	// published but not yet replayed on shadow
+    Vector<uint32_t> _publish_epochs;
+
     int run_command(int command, const String &, Vector<IPRoute>* old_routes, ErrorHandler*);
+    int parse_routes(const String &, Vector<IPRoute>& routes, ErrorHandler*);
 
 };
 
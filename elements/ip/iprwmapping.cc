@@ -37,7 +37,7 @@ IPRewriterFlow::IPRewriterFlow(IPRewriterInput *owner, const IPFlowID &flowid,
 			       uint8_t ip_p, bool guaranteed,
 			       click_jiffies_t expiry_j)
     : _expiry_j(expiry_j), _ip_p(ip_p), _tflags(0),
-      _guaranteed(guaranteed), _reply_anno(0),
+      _guaranteed(guaranteed), _reply_anno(0), _shard(0),
       _owner(owner)
 {
     _e[0].initialize(flowid, owner->foutput, false);
@@ -93,7 +93,7 @@ void
 IPRewriterFlow::change_expiry(IPRewriterHeap *h, bool guaranteed,
 			      click_jiffies_t expiry_j)
 {
-    Vector<IPRewriterFlow *> &current_heap = h->_heaps[_guaranteed];
+    Vector<IPRewriterFlow *> &current_heap = h->heap(_shard, _guaranteed);
     assert(current_heap[_place] == this);
     _expiry_j = expiry_j;
     if (_guaranteed != guaranteed) {
@@ -102,7 +102,7 @@ IPRewriterFlow::change_expiry(IPRewriterHeap *h, bool guaranteed,
 		    heap_less(), heap_place());
 	current_heap.pop_back();
 	_guaranteed = guaranteed;
-	Vector<IPRewriterFlow *> &new_heap = h->_heaps[_guaranteed];
+	Vector<IPRewriterFlow *> &new_heap = h->heap(_shard, _guaranteed);
 	new_heap.push_back(this);
 	push_heap(new_heap.begin(), new_heap.end(),
 		  heap_less(), heap_place());
@@ -115,7 +115,7 @@ IPRewriterFlow::change_expiry(IPRewriterHeap *h, bool guaranteed,
 void
 IPRewriterFlow::destroy(IPRewriterHeap *heap)
 {
-    Vector<IPRewriterFlow *> &myheap = heap->_heaps[_guaranteed];
+    Vector<IPRewriterFlow *> &myheap = heap->heap(_shard, _guaranteed);
     remove_heap(myheap.begin(), myheap.end(), myheap.begin() + _place,
 		heap_less(), heap_place());
     myheap.pop_back();
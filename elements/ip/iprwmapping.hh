@@ -125,6 +125,11 @@ class IPRewriterFlow { public:
 	return _owner;
     }
 
+    /** @brief Return the flow's shard in its rewriter. */
+    int shard() const {
+	return _shard;
+    }
+
     uint8_t reply_anno() const {
 	return _reply_anno;
     }
@@ -162,6 +167,7 @@ class IPRewriterFlow { public:
     uint8_t _tflags;
     bool _guaranteed;
     uint8_t _reply_anno;
+    uint8_t _shard;
     IPRewriterInput *_owner;
 
     friend class IPRewriterBase;
@@ -39,9 +39,10 @@ IPRewriterPattern::IPRewriterPattern(const IPAddress &saddr, int sport,
 		       bool is_napt, bool sequential, bool same_first,
 		       uint32_t variation_top)
     : _saddr(saddr), _sport(sport), _daddr(daddr), _dport(dport),
-      _variation_top(variation_top), _next_variation(0), _is_napt(is_napt),
+      _variation_top(variation_top), _is_napt(is_napt),
       _sequential(sequential), _same_first(same_first), _refcount(0)
 {
+    _next_variation = 0;
 }
 
 namespace {
@@ -219,8 +220,11 @@ IPRewriterPattern::parse_with_ports(const String &conf, IPRewriterInput *input,
 int
 IPRewriterPattern::rewrite_flowid(const IPFlowID &flowid,
 				  IPFlowID &rewritten_flowid,
-				  const HashContainer<IPRewriterEntry> &reply_map)
+				  const HashContainer<IPRewriterEntry> &reply_map,
+				  int shard, int nshards)
 {
+    // With shards, a rewritten flow is usable only if replies to it hash
+    // to the original flow's shard; searching the variations finds one.
     rewritten_flowid = flowid;
     if (_saddr)
 	rewritten_flowid.set_saddr(_saddr);
@@ -239,13 +243,19 @@ IPRewriterPattern::rewrite_flowid(const IPFlowID &flowid,
 	if (_same_first
 	    && (val = ntohs(flowid.sport()) - base) <= _variation_top) {
 	    lookup.set_dport(flowid.sport());
-	    if (!reply_map.find(lookup))
+	    if (IPRewriterBase::flow_shard(lookup, nshards) == shard
+		&& !reply_map.find(lookup))
 		goto found_variation;
 	}
 
-	if (_sequential)
-	    val = (_next_variation > _variation_top ? 0 : _next_variation);
-	else
+	// With several shards, other threads may be updating _next_variation
+	// too.  It is only a hint, so a stale value costs at most a longer
+	// search.
+	if (_sequential) {
+	    val = _next_variation.value();
+	    if (val > _variation_top)
+		val = 0;
+	} else
 	    val = click_random(0, _variation_top);
 
 	for (uint32_t count = 0; count <= _variation_top;
@@ -254,7 +264,8 @@ IPRewriterPattern::rewrite_flowid(const IPFlowID &flowid,
 		lookup.set_dport(htons(base + val));
 	    else
 		lookup.set_daddr(htonl(base + val));
-	    if (!reply_map.find(lookup))
+	    if (IPRewriterBase::flow_shard(lookup, nshards) == shard
+		&& !reply_map.find(lookup))
 		goto found_variation;
 	}
 
@@ -266,7 +277,8 @@ IPRewriterPattern::rewrite_flowid(const IPFlowID &flowid,
 	else
 	    rewritten_flowid.set_saddr(lookup.daddr());
 	_next_variation = val + 1;
-    }
+    } else if (IPRewriterBase::flow_shard(rewritten_flowid, nshards) != shard)
+	return IPRewriterBase::rw_drop;
 
     return IPRewriterBase::rw_addmap;
 }
@@ -4,6 +4,7 @@
 #include <click/element.hh>
 #include <click/hashcontainer.hh>
 #include <click/ipflowid.hh>
+#include <click/atomic.hh>
 CLICK_DECLS
 class IPRewriterFlow;
 class IPRewriterEntry;
@@ -36,9 +37,15 @@ class IPRewriterPattern { public:
     IPAddress daddr() const {
 	return _daddr;
     }
+    // With several shards, a pattern that changes flows must be able to
+    // choose among rewritten flows to keep replies in the flow's shard.
+    bool shardable() const {
+	return _variation_top || !*this;
+    }
 
     int rewrite_flowid(const IPFlowID &flowid, IPFlowID &rewritten_flowid,
-		       const HashContainer<IPRewriterEntry> &reply_map);
+		       const HashContainer<IPRewriterEntry> &reply_map,
+		       int shard = 0, int nshards = 1);
 
     String unparse() const;
 
@@ -50,7 +57,7 @@ class IPRewriterPattern { public:
     int _dport;			// net byte order
 
     uint32_t _variation_top;
-    uint32_t _next_variation;
+    atomic_uint32_t _next_variation; // shared by all shards' threads
 
     bool _is_napt;
     bool _sequential;
@@ -84,16 +84,6 @@ const int RadixIPLookup::Radix::_bitshift [5] = {16, 12, 8, 4, 0};
 // (2^16).(2^4)^4 = 2^32.
 const int RadixIPLookup::Radix::_nbuckets [5] = {65536, 16, 16, 16, 16};
     
-int
-RadixIPLookup::find_lookup_key(IPAddress gw, int32_t port) {
-    for(int i=0; i  < _lookup.size(); i++) {
-	if(_lookup[i].gw == gw  &&
-	   _lookup[i].port == port) 
-	    return (i + 1);
-    }
-    return 0;
-}
-
 RadixIPLookup::Radix*
 RadixIPLookup::Radix::make_radix(int level)
 {
@@ -160,23 +150,66 @@ RadixIPLookup::Radix::change(uint32_t addr, uint32_t mask, int key, bool set, in
 }
 
 
+RadixIPLookup::Table::Table()
+    : vfree(-1), default_key(0), radix(0)
+{
+}
+
+int
+RadixIPLookup::Table::find_lookup_key(IPAddress gw, int32_t port) const
+{
+    for (int i = 0; i < lookup.size(); i++)
+	if (lookup[i].gw == gw && lookup[i].port == port)
+	    return i + 1;
+    return 0;
+}
+
+void
+RadixIPLookup::Table::clear()
+{
+    int level = 0;
+    v.clear();
+    lookup.clear();
+    if (radix)
+	Radix::free_radix(radix, level);
+    radix = 0;
+    vfree = -1;
+    default_key = 0;
+}
+
+
 RadixIPLookup::RadixIPLookup()
-    : _vfree(-1), _default_key(0), _radix(Radix::make_radix(0))
+    : _active(&_t), _writer(&_t)
 {
+    _t.radix = Radix::make_radix(0);
 }
 
 RadixIPLookup::~RadixIPLookup()
 {
 }
 
+int
+RadixIPLookup::enable_shadow(ErrorHandler *errh)
+{
+    if (!(_shadow_t.radix = Radix::make_radix(0)))
+	return errh->error("out of memory");
+    _writer = &_shadow_t;
+    return 0;
+}
+
+void
+RadixIPLookup::publish_shadow()
+{
+    Table *t = _active;
+    _active = _writer;
+    _writer = t;
+}
 
 void
 RadixIPLookup::cleanup(CleanupStage)
 {
-    int level = 0;
-    _v.clear();
-    Radix::free_radix(_radix, level);
-    _radix = 0;
+    _t.clear();
+    _shadow_t.clear();
 }
 
 void
@@ -184,17 +217,19 @@ RadixIPLookup::add_handlers()
 {
     IPRouteTable::add_handlers();
     add_write_handler("flush", flush_handler, 0, Handler::BUTTON);
+    add_write_handler("load", load_handler, 0);
 }
 
 String
 RadixIPLookup::dump_routes()
 {
+    Table &t = *_active;
     StringAccum sa;
-    for (int j = _vfree; j >= 0; j = _v[j].extra)
-	_v[j].kill();
-    for (int i = 0; i < _v.size(); i++)
-	if (_v[i].real())
-	    _v[i].unparse(sa, true) << '\n';
+    for (int j = t.vfree; j >= 0; j = t.v[j].extra)
+	t.v[j].kill();
+    for (int i = 0; i < t.v.size(); i++)
+	if (t.v[i].real())
+	    t.v[i].unparse(sa, true) << '\n';
     return sa.take_string();
 }
 
@@ -202,45 +237,46 @@ RadixIPLookup::dump_routes()
 int
 RadixIPLookup::add_route(const IPRoute &route, bool set, IPRoute *old_route, ErrorHandler *)
 {
-    int found = (_vfree < 0 ? _v.size() : _vfree), last_key;
-    int lookup_key = find_lookup_key(route.gw, route.port);
+    Table &t = *_writer;
+    int found = (t.vfree < 0 ? t.v.size() : t.vfree), last_key;
+    int lookup_key = t.find_lookup_key(route.gw, route.port);
     if(!lookup_key) 
-	lookup_key = _lookup.size() + 1;
+	lookup_key = t.lookup.size() + 1;
 		    
     if (route.mask) {
 	uint32_t addr = ntohl(route.addr.addr());
 	uint32_t mask = ntohl(route.mask.addr());
 	int level = 0;
-	last_key = _radix->change(addr, mask, combine_key(found + 1, lookup_key), set, level);
+	last_key = t.radix->change(addr, mask, combine_key(found + 1, lookup_key), set, level);
 	// The key returned by change is the combined key, we need only the _v key.
 	last_key = get_key(last_key);
     } else {
-	last_key = get_key(_default_key);
+	last_key = get_key(t.default_key);
 	if (!last_key || set)
-	    _default_key = combine_key(found + 1, lookup_key);
+	    t.default_key = combine_key(found + 1, lookup_key);
     }
 
     if (last_key && old_route)
-	*old_route = _v[last_key - 1];
+	*old_route = t.v[last_key - 1];
     if (last_key && !set)
 	return -EEXIST;
 
-    if (lookup_key == (_lookup.size() + 1)) {
+    if (lookup_key == (t.lookup.size() + 1)) {
 	GWPort gw_port = {route.gw, route.port};
-	_lookup.push_back(gw_port);
+	t.lookup.push_back(gw_port);
     }
 
-    if (found == _v.size())
-	_v.push_back(route);
+    if (found == t.v.size())
+	t.v.push_back(route);
     else {
-	_vfree = _v[found].extra;
-	_v[found] = route;
+	t.vfree = t.v[found].extra;
+	t.v[found] = route;
     }
-    _v[found].extra = -1;
+    t.v[found].extra = -1;
 
     if (last_key) {
-	_v[last_key - 1].extra = _vfree;
-	_vfree = last_key - 1;
+	t.v[last_key - 1].extra = t.vfree;
+	t.vfree = last_key - 1;
     }
 
     return 0;
@@ -249,42 +285,44 @@ RadixIPLookup::add_route(const IPRoute &route, bool set, IPRoute *old_route, Err
 int
 RadixIPLookup::remove_route(const IPRoute& route, IPRoute* old_route, ErrorHandler*)
 {
+    Table &t = *_writer;
     int last_key;
     if (route.mask) {
 	uint32_t addr = ntohl(route.addr.addr());
 	uint32_t mask = ntohl(route.mask.addr());
 	int level = 0;
 	// NB: this will never actually make changes
-	last_key = get_key(_radix->change(addr, mask, 0, false, level));
+	last_key = get_key(t.radix->change(addr, mask, 0, false, level));
     } else
-	last_key = get_key(_default_key);
+	last_key = get_key(t.default_key);
 
     if (last_key && old_route)
-	*old_route = _v[last_key - 1];
-    if (!last_key || !route.match(_v[last_key - 1]))
+	*old_route = t.v[last_key - 1];
+    if (!last_key || !route.match(t.v[last_key - 1]))
 	return -ENOENT;
-    _v[last_key - 1].extra = _vfree;
-    _vfree = last_key - 1;
+    t.v[last_key - 1].extra = t.vfree;
+    t.vfree = last_key - 1;
 
     if (route.mask) {
 	uint32_t addr = ntohl(route.addr.addr());
 	uint32_t mask = ntohl(route.mask.addr());
 	int level = 0;
-	(void) _radix->change(addr, mask, 0, true, level);
+	(void) t.radix->change(addr, mask, 0, true, level);
     } else
-	_default_key = 0;
+	t.default_key = 0;
     return 0;
 }
 
 int
 RadixIPLookup::lookup_route(IPAddress addr, IPAddress &gw) const
 {
+    const Table *t = _active;
     int level = 0;    
-    int key = Radix::lookup(_radix, _default_key, ntohl(addr.addr()), level);
+    int key = Radix::lookup(t->radix, t->default_key, ntohl(addr.addr()), level);
     int lookup_key = get_lookup_key(key);
     if (lookup_key) {
-	gw = _lookup[lookup_key - 1].gw;
-	return _lookup[lookup_key - 1].port;
+	gw = t->lookup[lookup_key - 1].gw;
+	return t->lookup[lookup_key - 1].port;
     } else {
 	gw = 0;
 	return -1;
@@ -294,20 +332,8 @@ RadixIPLookup::lookup_route(IPAddress addr, IPAddress &gw) const
 void
 RadixIPLookup::flush_table()
 {
-    int level = 0;
-    _v.clear();
-    Radix::free_radix(_radix, level);
-    _radix = Radix::make_radix(0);
-    _vfree = -1;
-    _default_key = 0;
-}
-
-int
-RadixIPLookup::flush_handler(const String &, Element *e, void *, ErrorHandler *)
-{
-    RadixIPLookup *t = static_cast<RadixIPLookup *>(e);
-    t->flush_table();
-    return 0;
+    _writer->clear();
+    _writer->radix = Radix::make_radix(0);
 }
 
 CLICK_ENDDECLS
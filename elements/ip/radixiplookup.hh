@@ -31,6 +31,24 @@ gateway IP address, and an output port.
 
 Uses the IPRouteTable interface; see IPRouteTable for description.
 
+Keyword arguments are:
+
+=over 8
+
+=item FILE
+
+Filename. Read more routes from this file, one `C<ADDR/MASK [GW] OUT>' per
+line, after those in the arguments.  Only available at user level.
+
+=item SHADOW
+
+Boolean. If true, route updates go to a shadow copy of the trie, which is
+then published atomically, so updates never disturb lookups running on other
+threads.  This doubles the memory used for lookups.  See IPRouteTable for
+details.  Defaults to false.
+
+=back
+
 =h table read-only
 
 Outputs a human-readable version of the current routing table.
@@ -59,6 +77,17 @@ add a route, and `C<remove ADDR/MASK>' to remove a route. You can supply
 multiple commands, one per line; all commands are executed as one atomic
 operation.
 
+=h flush write-only
+
+Clears the entire routing table in a single atomic operation.
+
+=h load write-only
+
+Replaces the routing table with the routes written, one `C<ADDR/MASK [GW]
+OUT>' per line.  If several routes have the same prefix, the last one wins.
+With SHADOW, lookups see either the old table or the new one, never a
+mix.
+
 =n
 
 See IPRouteTable for a performance comparison of the various IP routing
@@ -85,8 +114,11 @@ class RadixIPLookup : public IPRouteTable { public:
     int add_route(const IPRoute&, bool, IPRoute*, ErrorHandler *);
     int remove_route(const IPRoute&, IPRoute*, ErrorHandler *);
     int lookup_route(IPAddress, IPAddress&) const;
-    int find_lookup_key(IPAddress gw, int port);
     String dump_routes();
+    void flush_table();
+
+    int enable_shadow(ErrorHandler *errh);
+    void publish_shadow();
 
   private:
 	struct GWPort {
@@ -109,21 +141,28 @@ class RadixIPLookup : public IPRouteTable { public:
 	return ((comb & 0xff000000) >> 24);
     }
 
-    void flush_table();
+    class Radix;
 
-    static int flush_handler(const String &, Element *, void *, ErrorHandler *);
+    struct Table {
+	// Simple routing table
+	Vector<IPRoute> v;
+	int vfree;
 
-    class Radix;
+	// Compressed routing table holding unique values of (gw, port).
+	Vector<GWPort> lookup;
+
+	int default_key;
+	Radix *radix;
 
-    // Simple routing table
-    Vector<IPRoute> _v;
-    int _vfree;
-    
-    // Compressed routing table holding unique values of (gw, port).
-    Vector<GWPort> _lookup;
+	Table();
+	int find_lookup_key(IPAddress gw, int port) const;
+	void clear();
+    };
 
-    int _default_key;
-    Radix *_radix;
+    Table _t;
+    Table _shadow_t;
+    Table * volatile _active;	// lookups use this table
+    Table *_writer;		// updates change this table
 
 };
 
@@ -26,35 +26,86 @@
 #include <click/error.hh>
 CLICK_DECLS
 
+int
+RangeIPLookup::Ranges::initialize()
+{
+    base = (uint32_t *) CLICK_LALLOC((1 << KICKSTART_BITS) * sizeof(uint32_t));
+    len = (uint32_t *) CLICK_LALLOC((1 << KICKSTART_BITS) * sizeof(uint32_t));
+    t = (uint32_t *) CLICK_LALLOC(RANGES_MAX * sizeof(uint32_t));
+    if (!base || !len || !t)
+	return -ENOMEM;
+    memset(base, 0, (1 << KICKSTART_BITS) * sizeof(uint32_t));
+    memset(len, 0, (1 << KICKSTART_BITS) * sizeof(uint32_t));
+    memset(t, 0, RANGES_MAX * sizeof(uint32_t));
+    return 0;
+}
+
+void
+RangeIPLookup::Ranges::cleanup()
+{
+    CLICK_LFREE(base, (1 << KICKSTART_BITS) * sizeof(uint32_t));
+    CLICK_LFREE(len, (1 << KICKSTART_BITS) * sizeof(uint32_t));
+    CLICK_LFREE(t, RANGES_MAX * sizeof(uint32_t));
+    CLICK_LFREE(vport, vport_capacity * sizeof(DirectIPLookup::VirtualPort));
+    base = len = t = 0;
+    vport = 0;
+    vport_capacity = 0;
+}
+
+
 RangeIPLookup::RangeIPLookup()
-    : _range_base((uint32_t *) CLICK_LALLOC((1 << KICKSTART_BITS) * sizeof(uint32_t))),
-      _range_len((uint32_t *) CLICK_LALLOC((1 << KICKSTART_BITS) * sizeof(uint32_t))),
-      _range_t((uint32_t *) CLICK_LALLOC(RANGES_MAX * sizeof(uint32_t))),
-      _active(false)
+    : _cur(&_ranges), _next(&_ranges), _active(false)
 {
 }
 
 RangeIPLookup::~RangeIPLookup()
 {
-    CLICK_LFREE(_range_base, (1 << KICKSTART_BITS) * sizeof(uint32_t));
-    CLICK_LFREE(_range_len, (1 << KICKSTART_BITS) * sizeof(uint32_t));
-    CLICK_LFREE(_range_t, RANGES_MAX * sizeof(uint32_t));
 }
 
 int
 RangeIPLookup::configure(Vector<String> &conf, ErrorHandler *errh)
 {
     int r;
-    if ((r = _helper.initialize()) < 0)
+    if ((r = _helper.initialize()) < 0 || (r = _ranges.initialize()) < 0)
 	return r;
-    flush_table();
+    _helper.flush();
     return IPRouteTable::configure(conf, errh);
 }
 
 int
-RangeIPLookup::initialize(ErrorHandler *)
+RangeIPLookup::enable_shadow(ErrorHandler *errh)
+{
+    if (_shadow_ranges.initialize() < 0)
+	return errh->error("out of memory");
+    _next = &_shadow_ranges;
+    return 0;
+}
+
+void
+RangeIPLookup::publish_shadow()
 {
-    expand();
+    // The lookup structure is distilled from _helper as a whole, so a batch
+    // of updates costs a single expansion.
+    if (expand(*_next) < 0)
+	return;
+    Ranges *r = _cur;
+    click_write_fence();
+    _cur = _next;
+    _next = r;
+}
+
+void
+RangeIPLookup::replay_shadow(const Vector<IPRoute> &)
+{
+    // _helper is always current, and the next publish_shadow() rebuilds the
+    // shadow ranges from scratch.
+}
+
+int
+RangeIPLookup::initialize(ErrorHandler *errh)
+{
+    if (expand(*_cur) < 0)
+	return errh->error("out of memory");
     _active = true;
     return 0;
 }
@@ -63,6 +114,8 @@ void
 RangeIPLookup::cleanup(CleanupStage)
 {
     _helper.cleanup();
+    _ranges.cleanup();
+    _shadow_ranges.cleanup();
 }
 
 void
@@ -90,21 +143,22 @@ RangeIPLookup::push(int, Packet *p)
 int
 RangeIPLookup::lookup_route(IPAddress dest, IPAddress &gw) const
 {
+    const Ranges *r = _cur;
     uint32_t ip_addr = ntohl(dest.addr());
     uint32_t lowerbound, upperbound, middle;
     uint32_t i = ip_addr >> RANGE_SHIFT; // kickstart table index = MS bits
     uint16_t vport_i;
 
-    lowerbound = _range_base[i];
-    upperbound = lowerbound + _range_len[i];
+    lowerbound = r->base[i];
+    upperbound = lowerbound + r->len[i];
     i = ip_addr & RANGE_MASK;		// Compare only masked LS bits
 
     // Binary search for a matching range
     while (upperbound > lowerbound) {
 	middle = (upperbound + lowerbound) >> 1;
-	if (i < (_range_t[middle] & RANGE_MASK))
+	if (i < (r->t[middle] & RANGE_MASK))
 	    upperbound = middle;
-	else if (i < (_range_t[middle + 1] & RANGE_MASK)) {
+	else if (i < (r->t[middle + 1] & RANGE_MASK)) {
 	    lowerbound = middle;
 	    break;
 	} else
@@ -112,9 +166,9 @@ RangeIPLookup::lookup_route(IPAddress dest, IPAddress &gw) const
     }
 
     // MS bits of the found range contain an index into the output port table
-    vport_i = _range_t[lowerbound] >> RANGE_SHIFT;
-    gw = _helper._vport[vport_i].gw;
-    return _helper._vport[vport_i].port;
+    vport_i = r->t[lowerbound] >> RANGE_SHIFT;
+    gw = r->vport[vport_i].gw;
+    return r->vport[vport_i].port;
 }
 
 void
@@ -122,14 +176,15 @@ RangeIPLookup::add_handlers()
 {
     IPRouteTable::add_handlers();
     add_write_handler("flush", flush_handler, 0, Handler::BUTTON);
+    add_write_handler("load", load_handler, 0);
 }
 
 int
 RangeIPLookup::add_route(const IPRoute& route, bool allow_replace, IPRoute* old_route, ErrorHandler *errh)
 {
     int error = _helper.add_route(route, allow_replace, old_route, errh);
-    if (error == 0 && _active)
-	expand();
+    if (error == 0 && _active && !shadow())
+	error = expand(*_cur);
     return error;
 }
 
@@ -137,8 +192,8 @@ int
 RangeIPLookup::remove_route(const IPRoute& route, IPRoute* old_route, ErrorHandler *errh)
 {
     int error = _helper.remove_route(route, old_route, errh);
-    if (error == 0 && _active)
-	expand();
+    if (error == 0 && _active && !shadow())
+	error = expand(*_cur);
     return error;
 }
 
@@ -150,9 +205,20 @@ RangeIPLookup::remove_route(const IPRoute& route, IPRoute* old_route, ErrorHandl
  * more efficient method for updating range-based lookup structures in
  * the future, which would not depend on huge directiplookup tables.
  */
-void
-RangeIPLookup::expand()
+int
+RangeIPLookup::expand(Ranges &r)
 {
+    // copy the virtual ports, which lookups use to map ranges to routes
+    if (r.vport_capacity < _helper._vport_capacity) {
+	DirectIPLookup::VirtualPort *vport = (DirectIPLookup::VirtualPort *) CLICK_LALLOC(_helper._vport_capacity * sizeof(DirectIPLookup::VirtualPort));
+	if (!vport)
+	    return -ENOMEM;
+	CLICK_LFREE(r.vport, r.vport_capacity * sizeof(DirectIPLookup::VirtualPort));
+	r.vport = vport;
+	r.vport_capacity = _helper._vport_capacity;
+    }
+    memcpy(r.vport, _helper._vport, _helper._vport_size * sizeof(DirectIPLookup::VirtualPort));
+
     uint32_t range_t_index = 0;
     uint32_t tbl_0_23_index = 0;
     uint32_t range_base;
@@ -162,7 +228,7 @@ RangeIPLookup::expand()
 	uint16_t vport_i, vport_i1;
 
 	vport_i = 0xffff;       // Duh!
-	_range_base[range_base] = range_t_index;
+	r.base[range_base] = range_t_index;
 
 	for (range_len = 0;
 	  tbl_0_23_index < ((range_base + 1) << (24 - KICKSTART_BITS));
@@ -175,7 +241,7 @@ RangeIPLookup::expand()
 		    vport_i1 = _helper._tbl_24_31[tbl_24_31_index + j];
 		    if (vport_i != vport_i1) {
 			vport_i = vport_i1;
-			_range_t[range_t_index] =
+			r.t[range_t_index] =
 					vport_i << (32 - KICKSTART_BITS) |
 					(((tbl_0_23_index << 8) + j) &
 					(0xffffffff >> KICKSTART_BITS));
@@ -187,7 +253,7 @@ RangeIPLookup::expand()
 		vport_i1 = _helper._tbl_0_23[tbl_0_23_index];
 		if (vport_i != vport_i1) {
 		    vport_i = vport_i1;
-		    _range_t[range_t_index] =
+		    r.t[range_t_index] =
 					vport_i << (32 - KICKSTART_BITS) |
 					((tbl_0_23_index << 8) &
 					(0xffffffff >> KICKSTART_BITS));
@@ -196,32 +262,35 @@ RangeIPLookup::expand()
 		}
 	    }
 	}
-	_range_len[range_base] = range_len - 1;
+	r.len[range_base] = range_len - 1;
     }
 
 #ifdef RANGEIPLOOKUP_VERBOSE
     click_chatter("Range expansion done: %d ranges using %d + %d bytes",
-		  range_t_index, sizeof(_range_base) + sizeof(_range_len),
+		  range_t_index, sizeof(r.base) + sizeof(r.len),
 		  range_t_index * sizeof(uint32_t));
 #endif
+    return 0;
 }
 
 void
 RangeIPLookup::flush_table()
 {
     _helper.flush();
-    memset(_range_base, 0, (1 << KICKSTART_BITS) * sizeof(*_range_base));
-    memset(_range_len, 0, (1 << KICKSTART_BITS) * sizeof(*_range_len));
-    memset(_range_t, 0, RANGES_MAX * sizeof(*_range_t));
+    if (_active && !shadow())
+	expand(*_cur);
 }
 
 int
-RangeIPLookup::flush_handler(const String &, Element *e, void *,
-                                ErrorHandler *)
+RangeIPLookup::load_routes(const Vector<IPRoute> &routes, bool allow_replace, ErrorHandler *errh)
 {
-    RangeIPLookup *t = static_cast<RangeIPLookup *>(e);
-    t->flush_table();
-    return 0;
+    int r = _helper.load(routes, allow_replace, errh);
+    if (r >= 0 && _active && !shadow()) {
+	int error = expand(*_cur);
+	if (error < 0)
+	    r = error;
+    }
+    return r;
 }
 
 String
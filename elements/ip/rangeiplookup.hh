@@ -38,6 +38,25 @@ RangeIPLookup maintains a large DirectIPLookup table as well as its own
 tables.  Although this subsidiary table is only accessed during route updates,
 it significantly adds to RangeIPLookup's total memory footprint.
 
+Keyword arguments are:
+
+=over 8
+
+=item FILE
+
+Filename. Read more routes from this file, one `C<ADDR/MASK [GW] OUT>' per
+line, after those in the arguments.  Only available at user level.
+
+=item SHADOW
+
+Boolean. If true, each update builds a shadow copy of the range table, which
+is then published atomically, so updates never disturb lookups running on
+other threads.  A C<ctrl> or C<load> batch is expanded into the range table
+once, rather than once per route.  See IPRouteTable for details.  Defaults
+to false.
+
+=back
+
 =h table read-only
 
 Outputs a human-readable version of the current routing table.
@@ -70,6 +89,13 @@ operation.
 
 Clears the entire routing table in a single atomic operation.
 
+=h load write-only
+
+Replaces the routing table with the routes written, one `C<ADDR/MASK [GW]
+OUT>' per line.  If several routes have the same prefix, the last one wins.
+With SHADOW, lookups see either the old table or the new one, never a
+mix.  The range table is expanded once, after all routes are loaded.
+
 =n
 
 See IPRouteTable for a performance comparison of the various IP routing
@@ -99,22 +125,40 @@ class RangeIPLookup : public IPRouteTable { public:
     int remove_route(const IPRoute&, IPRoute*, ErrorHandler *);
     int lookup_route(IPAddress, IPAddress&) const;
     String dump_routes();
+    void flush_table();
+    int load_routes(const Vector<IPRoute>&, bool, ErrorHandler *);
 
-    static int flush_handler(const String &, Element *, void *, ErrorHandler *);
+    int enable_shadow(ErrorHandler *errh);
+    void publish_shadow();
+    void replay_shadow(const Vector<IPRoute> &changes);
 
   protected:
 
-    void flush_table();
-    void expand();
-
     enum { KICKSTART_BITS = 12 };
     enum { RANGES_MAX = 256 * 1024 };
     enum { RANGE_MASK = 0xffffffff >> KICKSTART_BITS };
     enum { RANGE_SHIFT = 32 - KICKSTART_BITS };
 
-    uint32_t *_range_base;
-    uint32_t *_range_len;
-    uint32_t *_range_t;
+    struct Ranges {
+	uint32_t *base;
+	uint32_t *len;
+	uint32_t *t;
+	DirectIPLookup::VirtualPort *vport; // copy of _helper's vports
+	uint32_t vport_capacity;
+
+	Ranges()
+	    : base(0), len(0), t(0), vport(0), vport_capacity(0) {
+	}
+	int initialize();
+	void cleanup();
+    };
+
+    int expand(Ranges &r);
+
+    Ranges _ranges;
+    Ranges _shadow_ranges;
+    Ranges * volatile _cur;	// lookups use these ranges
+    Ranges *_next;		// with SHADOW, the next update builds these
     bool _active;
 
     DirectIPLookup::Table _helper;
@@ -0,0 +1,792 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * tuplespaceipfilter.{cc,hh} -- filters IP packets using tuple space search
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "tuplespaceipfilter.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/straccum.hh>
+#include <click/nameinfo.hh>
+#include <clicknet/ip.h>
+#include <clicknet/udp.h>
+CLICK_DECLS
+
+namespace {
+enum { max_alternatives = 4096 };
+enum { SD_SRC = 1, SD_DST = 2, SD_AND = 3, SD_OR = 4 };
+enum { T_NONE = 0, T_HOST, T_NET, T_PROTO, T_PORT };
+}
+
+hashcode_t
+TupleSpaceIPFilter::Key::hashcode() const
+{
+    uint32_t h = src ^ (dst * 0x9E3779B1U)
+	^ ((((uint32_t) sport << 16) | dport) * 0x85EBCA6BU) ^ proto;
+    h *= 0xC2B2AE35U;
+    return h ^ (h >> 16);
+}
+
+TupleSpaceIPFilter::TupleSpaceIPFilter()
+    : _nentries(0), _max_entries(1 << 20)
+{
+}
+
+TupleSpaceIPFilter::~TupleSpaceIPFilter()
+{
+}
+
+
+//
+// PARSING
+//
+
+static void
+separate_words(const String &text, Vector<String> &words)
+{
+    const char *s = text.begin(), *end = text.end();
+    while (s != end) {
+	if (isspace((unsigned char) *s)) {
+	    ++s;
+	    continue;
+	}
+	const char *t = s + 1;
+	if (*s == '(' || *s == ')')
+	    /* one character */;
+	else if (*s == '&' || *s == '|') {
+	    if (t != end && *t == *s)
+		++t;
+	} else if (*s == '<' || *s == '>' || *s == '!' || *s == '=') {
+	    if (t != end && *t == '=')
+		++t;
+	} else
+	    while (t != end && !isspace((unsigned char) *t)
+		   && !strchr("()&|<>!=", *t))
+		++t;
+	words.push_back(text.substring(s, t));
+	s = t;
+    }
+}
+
+struct TupleSpaceIPFilter::Parser {
+
+    const Vector<String> &_words;
+    int _pos;
+    const Element *_context;
+    ErrorHandler *_errh;
+    // the previous primitive, which a bare value continues
+    int _prev_type;
+    int _prev_srcdst;
+    int _prev_proto;
+    String _prev_op;
+
+    Parser(const Vector<String> &words, const Element *context,
+	   ErrorHandler *errh)
+	: _words(words), _pos(0), _context(context), _errh(errh),
+	  _prev_type(T_NONE), _prev_srcdst(0), _prev_proto(-1) {
+    }
+
+    bool at(const char *word) const {
+	return _pos < _words.size() && _words[_pos] == word;
+    }
+    bool at_end() const {
+	return _pos >= _words.size();
+    }
+
+    static void match_all(Match &m);
+    static bool intersect(Match &a, const Match &b);
+    int conjoin(Vector<Match> &a, const Vector<Match> &b);
+
+    int parse_expr(Vector<Match> &out);
+    int parse_term(Vector<Match> &out);
+    int parse_factor(Vector<Match> &out);
+    int parse_primitive(Vector<Match> &out);
+    int parse_port(const String &word, int proto, uint32_t &lo, uint32_t &hi);
+
+};
+
+void
+TupleSpaceIPFilter::Parser::match_all(Match &m)
+{
+    m.src = m.src_mask = m.dst = m.dst_mask = 0;
+    m.proto = -1;
+    m.has_ports = false;
+    m.sport_lo = m.dport_lo = 0;
+    m.sport_hi = m.dport_hi = 0xFFFF;
+}
+
+bool
+TupleSpaceIPFilter::Parser::intersect(Match &a, const Match &b)
+{
+    // masks are prefixes, so the longer of two overlapping masks wins
+    if (((a.src ^ b.src) & a.src_mask & b.src_mask)
+	|| ((a.dst ^ b.dst) & a.dst_mask & b.dst_mask))
+	return false;
+    a.src |= b.src;
+    a.src_mask |= b.src_mask;
+    a.dst |= b.dst;
+    a.dst_mask |= b.dst_mask;
+    if (a.proto >= 0 && b.proto >= 0 && a.proto != b.proto)
+	return false;
+    if (b.proto >= 0)
+	a.proto = b.proto;
+    a.has_ports = a.has_ports || b.has_ports;
+    a.sport_lo = a.sport_lo > b.sport_lo ? a.sport_lo : b.sport_lo;
+    a.sport_hi = a.sport_hi < b.sport_hi ? a.sport_hi : b.sport_hi;
+    a.dport_lo = a.dport_lo > b.dport_lo ? a.dport_lo : b.dport_lo;
+    a.dport_hi = a.dport_hi < b.dport_hi ? a.dport_hi : b.dport_hi;
+    return a.sport_lo <= a.sport_hi && a.dport_lo <= a.dport_hi;
+}
+
+int
+TupleSpaceIPFilter::Parser::conjoin(Vector<Match> &a, const Vector<Match> &b)
+{
+    Vector<Match> out;
+    for (const Match *x = a.begin(); x != a.end(); ++x)
+	for (const Match *y = b.begin(); y != b.end(); ++y) {
+	    Match m = *x;
+	    if (intersect(m, *y))
+		out.push_back(m);
+	}
+    if (out.size() > max_alternatives)
+	return _errh->error("pattern too complex");
+    a.swap(out);
+    return 0;
+}
+
+int
+TupleSpaceIPFilter::Parser::parse_expr(Vector<Match> &out)
+{
+    if (parse_term(out) < 0)
+	return -1;
+    while (at("or") || at("||")) {
+	++_pos;
+	Vector<Match> alt;
+	if (parse_term(alt) < 0)
+	    return -1;
+	for (const Match *m = alt.begin(); m != alt.end(); ++m)
+	    out.push_back(*m);
+	if (out.size() > max_alternatives)
+	    return _errh->error("pattern too complex");
+    }
+    return 0;
+}
+
+int
+TupleSpaceIPFilter::Parser::parse_term(Vector<Match> &out)
+{
+    if (parse_factor(out) < 0)
+	return -1;
+    // "and" may be implicit, as in "tcp dst port 80"
+    while (!at_end() && !at("or") && !at("||") && !at(")")) {
+	if (at("and") || at("&&"))
+	    ++_pos;
+	Vector<Match> next;
+	if (parse_factor(next) < 0 || conjoin(out, next) < 0)
+	    return -1;
+    }
+    return 0;
+}
+
+int
+TupleSpaceIPFilter::Parser::parse_factor(Vector<Match> &out)
+{
+    if (at_end())
+	return _errh->error("pattern ends unexpectedly");
+    else if (at("(")) {
+	++_pos;
+	if (parse_expr(out) < 0)
+	    return -1;
+	if (!at(")"))
+	    return _errh->error("missing %<)%>");
+	++_pos;
+	return 0;
+    } else if (at("not") || at("!"))
+	return _errh->error("negation not supported");
+    else if (at("all") || at("true") || at("-")) {
+	++_pos;
+	Match m;
+	match_all(m);
+	out.push_back(m);
+	return 0;
+    } else
+	return parse_primitive(out);
+}
+
+int
+TupleSpaceIPFilter::Parser::parse_port(const String &word, int proto,
+				       uint32_t &lo, uint32_t &hi)
+{
+    int dash = word.find_left('-', 1);
+    if (dash > 0) {
+	uint32_t x;
+	if (parse_port(word.substring(0, dash), proto, lo, x) < 0
+	    || parse_port(word.substring(dash + 1), proto, x, hi) < 0)
+	    return -1;
+	if (lo > hi)
+	    return _errh->error("bad port range %<%s%>", word.c_str());
+	return 0;
+    }
+    int32_t value;
+    if ((IntArg().parse(word, value)
+	 || (proto != IP_PROTO_UDP
+	     && NameInfo::query_int(NameInfo::T_TCP_PORT, _context, word, &value))
+	 || (proto != IP_PROTO_TCP
+	     && NameInfo::query_int(NameInfo::T_UDP_PORT, _context, word, &value)))
+	&& value >= 0 && value <= 0xFFFF) {
+	lo = hi = value;
+	return 0;
+    }
+    return _errh->error("bad port %<%s%>", word.c_str());
+}
+
+int
+TupleSpaceIPFilter::Parser::parse_primitive(Vector<Match> &out)
+{
+    int proto = -1, srcdst = 0, type = T_NONE;
+    bool continued = false;
+    int32_t value;
+
+    // qualifiers
+    if (at("ip")) {
+	++_pos;
+	if (!at("proto"))
+	    return _errh->error("expected %<ip proto%>");
+	++_pos;
+	type = T_PROTO;
+    } else if (at("proto")) {
+	++_pos;
+	type = T_PROTO;
+    } else if (!at_end() && isalpha((unsigned char) _words[_pos][0])
+	       && NameInfo::query_int(NameInfo::T_IP_PROTO, _context,
+				      _words[_pos], &value)) {
+	proto = value;
+	++_pos;
+	if (!at("src") && !at("dst") && !at("port")) {
+	    Match m;
+	    match_all(m);
+	    m.proto = proto;
+	    out.push_back(m);
+	    _prev_type = T_PROTO;
+	    return 0;
+	}
+    }
+    if (type == T_NONE) {
+	if (at("src") || at("dst")) {
+	    srcdst = at("src") ? SD_SRC : SD_DST;
+	    ++_pos;
+	    if (_pos + 1 < _words.size() && (at("or") || at("and"))
+		&& _words[_pos + 1] == (srcdst == SD_SRC ? "dst" : "src")) {
+		srcdst = at("or") ? SD_OR : SD_AND;
+		_pos += 2;
+	    }
+	}
+	if (at("host")) {
+	    type = T_HOST;
+	    ++_pos;
+	} else if (at("net")) {
+	    type = T_NET;
+	    ++_pos;
+	} else if (at("port")) {
+	    type = T_PORT;
+	    ++_pos;
+	} else if (srcdst)
+	    type = T_NET;	// "src ADDR" or "src ADDR/LEN"
+	else if (proto >= 0)
+	    return _errh->error("expected %<src%>, %<dst%>, or %<port%>");
+	else if (_prev_type == T_NONE)
+	    return _errh->error("unknown word %<%s%>", _words[_pos].c_str());
+	else {
+	    // a bare value continues the previous primitive
+	    type = _prev_type;
+	    srcdst = _prev_srcdst;
+	    proto = _prev_proto;
+	    continued = true;
+	}
+    }
+
+    String op = continued ? _prev_op : String("=");
+    if (type == T_PORT && (at("=") || at("==") || at("!=") || at("<")
+			   || at(">") || at("<=") || at(">="))) {
+	op = _words[_pos];
+	++_pos;
+    }
+    if (at_end())
+	return _errh->error("pattern ends unexpectedly");
+    String word = _words[_pos];
+    ++_pos;
+
+    Match m;
+    match_all(m);
+    if (type == T_PROTO) {
+	if (!IntArg().parse(word, value)
+	    && !NameInfo::query_int(NameInfo::T_IP_PROTO, _context, word, &value))
+	    return _errh->error("bad protocol %<%s%>", word.c_str());
+	if (value < 0 || value > 255)
+	    return _errh->error("bad protocol %<%s%>", word.c_str());
+	m.proto = value;
+	out.push_back(m);
+    } else if (type == T_HOST || type == T_NET) {
+	IPAddress addr, mask;
+	if (type == T_NET && at("mask") && _pos + 1 < _words.size()) {
+	    if (!IPAddressArg().parse(word, addr, _context)
+		|| !IPAddressArg().parse(_words[_pos + 1], mask, _context))
+		return _errh->error("bad network %<%s mask %s%>",
+				    word.c_str(), _words[_pos + 1].c_str());
+	    _pos += 2;
+	} else if (type == T_HOST) {
+	    if (!IPAddressArg().parse(word, addr, _context))
+		return _errh->error("bad address %<%s%>", word.c_str());
+	    mask = IPAddress(0xFFFFFFFFU);
+	} else if (!IPPrefixArg(true).parse(word, addr, mask, _context))
+	    return _errh->error("bad network %<%s%>", word.c_str());
+	if (mask.mask_to_prefix_len() < 0)
+	    return _errh->error("%<%s%> is not a prefix", mask.unparse().c_str());
+	addr &= mask;
+	if (srcdst == 0)
+	    srcdst = SD_OR;
+	// keep a qualifying protocol, as in "tcp src host ADDR"
+	m.proto = proto;
+	if (srcdst == SD_SRC || srcdst == SD_OR || srcdst == SD_AND) {
+	    m.src = addr.addr();
+	    m.src_mask = mask.addr();
+	}
+	if (srcdst == SD_OR) {
+	    out.push_back(m);
+	    m.src = m.src_mask = 0;
+	}
+	if (srcdst == SD_DST || srcdst == SD_OR || srcdst == SD_AND) {
+	    m.dst = addr.addr();
+	    m.dst_mask = mask.addr();
+	}
+	out.push_back(m);
+    } else {
+	if (proto >= 0 && proto != IP_PROTO_TCP && proto != IP_PROTO_UDP)
+	    return _errh->error("ports require %<tcp%> or %<udp%>");
+	uint32_t lo, hi;
+	if (parse_port(word, proto, lo, hi) < 0)
+	    return -1;
+	// each range of allowed ports, as "lo hi" pairs
+	uint32_t ranges[4];
+	int nranges = 1;
+	ranges[0] = lo, ranges[1] = hi;
+	if (op == "!=") {
+	    if (lo != hi)
+		return _errh->error("%<!=%> needs a single port");
+	    nranges = 0;
+	    if (lo > 0)
+		ranges[0] = 0, ranges[1] = lo - 1, nranges = 1;
+	    if (lo < 0xFFFF) {
+		ranges[2 * nranges] = lo + 1, ranges[2 * nranges + 1] = 0xFFFF;
+		++nranges;
+	    }
+	} else if (op != "=" && op != "==") {
+	    if (lo != hi)
+		return _errh->error("%<%s%> needs a single port", op.c_str());
+	    if (op == "<")
+		ranges[0] = 0, ranges[1] = lo - 1, nranges = (lo > 0);
+	    else if (op == "<=")
+		ranges[0] = 0, ranges[1] = lo;
+	    else if (op == ">")
+		ranges[0] = lo + 1, ranges[1] = 0xFFFF, nranges = (lo < 0xFFFF);
+	    else
+		ranges[0] = lo, ranges[1] = 0xFFFF;
+	}
+	if (srcdst == 0)
+	    srcdst = SD_OR;
+	m.proto = proto;
+	m.has_ports = true;
+	for (int i = 0; i < nranges; ++i) {
+	    Match x = m;
+	    if (srcdst == SD_SRC || srcdst == SD_OR || srcdst == SD_AND)
+		x.sport_lo = ranges[2 * i], x.sport_hi = ranges[2 * i + 1];
+	    if (srcdst == SD_OR) {
+		out.push_back(x);
+		x = m;
+	    }
+	    if (srcdst == SD_DST || srcdst == SD_OR || srcdst == SD_AND)
+		x.dport_lo = ranges[2 * i], x.dport_hi = ranges[2 * i + 1];
+	    out.push_back(x);
+	}
+    }
+
+    _prev_type = type;
+    _prev_op = op;
+    _prev_srcdst = srcdst;
+    _prev_proto = proto;
+    return 0;
+}
+
+// Cover [lo, hi] with the fewest aligned port prefixes.
+static void
+port_prefixes(uint32_t lo, uint32_t hi, Vector<uint32_t> &values,
+	      Vector<int> &lens)
+{
+    while (lo <= hi) {
+	int len = 16;
+	while (len > 0) {
+	    uint32_t size = 1 << (16 - len + 1);
+	    if ((lo & (size - 1)) || lo + size - 1 > hi)
+		break;
+	    --len;
+	}
+	values.push_back(lo);
+	lens.push_back(len);
+	lo += 1 << (16 - len);
+    }
+}
+
+static inline uint16_t
+port_mask(int len)
+{
+    return htons(len ? (0xFFFF << (16 - len)) & 0xFFFF : 0);
+}
+
+int
+TupleSpaceIPFilter::parse_rule(const String &text, Rule *r,
+			       Vector<Spec> &specs, ErrorHandler *errh) const
+{
+    Vector<String> words;
+    separate_words(text, words);
+    if (!words.size())
+	return errh->error("empty filter");
+
+    const String &action = words[0];
+    if (action == "allow")
+	r->action = 0;
+    else if (action == "drop" || action == "deny")
+	r->action = -1;
+    else if (IntArg().parse(action, r->action) && r->action >= 0) {
+	if (r->action >= noutputs())
+	    return errh->error("output %d out of range", r->action);
+    } else
+	return errh->error("unknown action %<%s%>", action.c_str());
+    words.pop_front();
+    if (!words.size())
+	return errh->error("missing pattern");
+
+    Vector<Match> matches;
+    Parser parser(words, this, errh);
+    if (parser.parse_expr(matches) < 0)
+	return -1;
+    if (!parser.at_end())
+	return errh->error("garbage after pattern at %<%s%>",
+			   words[parser._pos].c_str());
+
+    // A port test without a protocol means TCP or UDP; then each port
+    // range becomes prefixes.
+    Vector<uint32_t> svalues, dvalues;
+    Vector<int> slens, dlens;
+    for (int i = 0; i < matches.size(); ++i) {
+	if (matches[i].has_ports && matches[i].proto < 0) {
+	    matches[i].proto = IP_PROTO_TCP;
+	    Match udp = matches[i];
+	    udp.proto = IP_PROTO_UDP;
+	    matches.push_back(udp);
+	}
+	const Match &m = matches[i];
+	svalues.clear(), slens.clear(), dvalues.clear(), dlens.clear();
+	port_prefixes(m.sport_lo, m.sport_hi, svalues, slens);
+	port_prefixes(m.dport_lo, m.dport_hi, dvalues, dlens);
+	for (int si = 0; si < svalues.size(); ++si)
+	    for (int di = 0; di < dvalues.size(); ++di) {
+		Spec s;
+		s.shape.src_len = IPAddress(m.src_mask).mask_to_prefix_len();
+		s.shape.dst_len = IPAddress(m.dst_mask).mask_to_prefix_len();
+		s.shape.sport_len = slens[si];
+		s.shape.dport_len = dlens[di];
+		s.shape.has_proto = m.proto >= 0;
+		s.shape.has_ports = m.has_ports;
+		s.key.src = m.src;
+		s.key.dst = m.dst;
+		s.key.sport = htons(svalues[si]);
+		s.key.dport = htons(dvalues[di]);
+		s.key.proto = m.proto >= 0 ? m.proto : 0;
+		specs.push_back(s);
+	    }
+	if (specs.size() > _max_entries)
+	    return errh->error("filter needs too many entries");
+    }
+
+    r->text = text.trim_space();
+    return 0;
+}
+
+
+//
+// TABLES
+//
+
+TupleSpaceIPFilter::Tuple *
+TupleSpaceIPFilter::find_tuple(const Shape &shape)
+{
+    for (Tuple **tp = _tuples.begin(); tp != _tuples.end(); ++tp)
+	if ((*tp)->shape == shape)
+	    return *tp;
+    Tuple *t = new Tuple;
+    t->shape = shape;
+    t->mask.src = IPAddress::make_prefix(shape.src_len).addr();
+    t->mask.dst = IPAddress::make_prefix(shape.dst_len).addr();
+    t->mask.sport = port_mask(shape.sport_len);
+    t->mask.dport = port_mask(shape.dport_len);
+    t->mask.proto = shape.has_proto ? 0xFFFFFFFFU : 0;
+    t->best = 0;
+    _tuples.push_back(t);
+    return t;
+}
+
+void
+TupleSpaceIPFilter::renumber(int from)
+{
+    for (int i = from; i < _rules.size(); ++i)
+	_rules[i]->pos = i;
+}
+
+void
+TupleSpaceIPFilter::sort_tuples()
+{
+    // insertion sort: tuples are few, and usually nearly in order already
+    for (int i = 1; i < _tuples.size(); ++i) {
+	Tuple *t = _tuples[i];
+	int j = i;
+	for (; j > 0 && _tuples[j - 1]->best->pos > t->best->pos; --j)
+	    _tuples[j] = _tuples[j - 1];
+	_tuples[j] = t;
+    }
+}
+
+int
+TupleSpaceIPFilter::insert_rule(const String &text, int pos,
+				ErrorHandler *errh)
+{
+    Rule *r = new Rule;
+    Vector<Spec> specs;
+    if (parse_rule(text, r, specs, errh) < 0) {
+	delete r;
+	return -1;
+    }
+    if (_nentries + specs.size() > _max_entries) {
+	delete r;
+	return errh->error("too many entries (MAX_ENTRIES is %d)", _max_entries);
+    }
+
+    r->hits = 0;
+    _rules.insert(_rules.begin() + pos, r);
+    renumber(pos);
+    for (const Spec *s = specs.begin(); s != specs.end(); ++s) {
+	Tuple *t = find_tuple(s->shape);
+	Vector<Rule *> &v = t->table[s->key];
+	Rule **rp = v.begin();
+	while (rp != v.end() && (*rp)->pos < r->pos)
+	    ++rp;
+	if (rp != v.end() && *rp == r)
+	    continue;		// the same entry twice
+	v.insert(rp, r);
+	if (!t->best || r->pos < t->best->pos)
+	    t->best = r;
+	Entry e;
+	e.tuple = t;
+	e.key = s->key;
+	r->entries.push_back(e);
+	++_nentries;
+    }
+    sort_tuples();
+    return 0;
+}
+
+void
+TupleSpaceIPFilter::remove_rule(int pos)
+{
+    Rule *r = _rules[pos];
+    for (const Entry *e = r->entries.begin(); e != r->entries.end(); ++e) {
+	Tuple *t = e->tuple;
+	HashTable<Key, Vector<Rule *> >::iterator it = t->table.find(e->key);
+	Vector<Rule *> &v = it.value();
+	for (Rule **rp = v.begin(); rp != v.end(); ++rp)
+	    if (*rp == r) {
+		v.erase(rp);
+		break;
+	    }
+	if (!v.size())
+	    t->table.erase(it);
+	--_nentries;
+    }
+    _rules.erase(_rules.begin() + pos);
+    renumber(pos);
+
+    // find new best rules, and drop empty tuples
+    for (int i = 0; i < _tuples.size(); ) {
+	Tuple *t = _tuples[i];
+	if (t->best == r) {
+	    t->best = 0;
+	    for (HashTable<Key, Vector<Rule *> >::iterator it = t->table.begin();
+		 it.live(); ++it)
+		if (!t->best || it.value()[0]->pos < t->best->pos)
+		    t->best = it.value()[0];
+	    if (!t->best) {
+		delete t;
+		_tuples.erase(_tuples.begin() + i);
+		continue;
+	    }
+	}
+	++i;
+    }
+    delete r;
+    sort_tuples();
+}
+
+
+//
+// RUNNING
+//
+
+inline int
+TupleSpaceIPFilter::lookup(const Packet *p) const
+{
+    const click_ip *iph = p->ip_header();
+    Key k;
+    k.src = iph->ip_src.s_addr;
+    k.dst = iph->ip_dst.s_addr;
+    k.proto = iph->ip_p;
+    bool has_ports = (k.proto == IP_PROTO_TCP || k.proto == IP_PROTO_UDP)
+	&& IP_FIRSTFRAG(iph) && p->transport_length() >= 4;
+    if (has_ports) {
+	const click_udp *udph = p->udp_header();
+	k.sport = udph->uh_sport;
+	k.dport = udph->uh_dport;
+    } else
+	k.sport = k.dport = 0;
+
+    // Tuples are sorted by their best rules, so once a tuple's best rule
+    // comes after the best match so far, no later tuple can do better.
+    Rule *best = 0;
+    for (Tuple *const *tp = _tuples.begin(); tp != _tuples.end(); ++tp) {
+	const Tuple *t = *tp;
+	if (best && t->best->pos >= best->pos)
+	    break;
+	if (t->shape.has_ports && !has_ports)
+	    continue;
+	Key m;
+	m.src = k.src & t->mask.src;
+	m.dst = k.dst & t->mask.dst;
+	m.sport = k.sport & t->mask.sport;
+	m.dport = k.dport & t->mask.dport;
+	m.proto = k.proto & t->mask.proto;
+	HashTable<Key, Vector<Rule *> >::const_iterator it = t->table.find(m);
+	if (it.live() && (!best || it.value()[0]->pos < best->pos))
+	    best = it.value()[0];
+    }
+
+    if (!best)
+	return -1;
+    ++best->hits;
+    return best->action;
+}
+
+void
+TupleSpaceIPFilter::push(int, Packet *p)
+{
+    checked_output_push(lookup(p), p);
+}
+
+
+//
+// CONFIGURATION
+//
+
+int
+TupleSpaceIPFilter::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    if (Args(this, errh).bind(conf)
+	.read("MAX_ENTRIES", _max_entries)
+	.consume() < 0)
+	return -1;
+    int before = errh->nerrors();
+    for (int i = 0; i < conf.size(); ++i) {
+	ContextErrorHandler cerrh(errh, "pattern %d:", i);
+	insert_rule(conf[i], _rules.size(), &cerrh);
+    }
+    return errh->nerrors() == before ? 0 : -1;
+}
+
+void
+TupleSpaceIPFilter::cleanup(CleanupStage)
+{
+    for (Rule **rp = _rules.begin(); rp != _rules.end(); ++rp)
+	delete *rp;
+    for (Tuple **tp = _tuples.begin(); tp != _tuples.end(); ++tp)
+	delete *tp;
+    _rules.clear();
+    _tuples.clear();
+    _nentries = 0;
+}
+
+String
+TupleSpaceIPFilter::read_handler(Element *e, void *user_data)
+{
+    TupleSpaceIPFilter *f = static_cast<TupleSpaceIPFilter *>(e);
+    StringAccum sa;
+    if (user_data)
+	sa << "rules " << f->_rules.size() << '\n'
+	   << "tuples " << f->_tuples.size() << '\n'
+	   << "entries " << f->_nentries << '\n';
+    else
+	for (int i = 0; i < f->_rules.size(); ++i)
+	    sa << i << '\t' << f->_rules[i]->hits << '\t'
+	       << f->_rules[i]->text << '\n';
+    return sa.take_string();
+}
+
+int
+TupleSpaceIPFilter::write_handler(const String &str, Element *e,
+				  void *user_data, ErrorHandler *errh)
+{
+    TupleSpaceIPFilter *f = static_cast<TupleSpaceIPFilter *>(e);
+    int pos;
+    switch ((uintptr_t) user_data) {
+    case 0:
+	return f->insert_rule(str, f->_rules.size(), errh);
+    case 1: {
+	String text = str;
+	if (!IntArg().parse(cp_shift_spacevec(text), pos)
+	    || pos < 0 || pos > f->_rules.size())
+	    return errh->error("bad position");
+	return f->insert_rule(text, pos, errh);
+    }
+    case 2:
+	if (!IntArg().parse(cp_uncomment(str), pos)
+	    || pos < 0 || pos >= f->_rules.size())
+	    return errh->error("bad position");
+	f->remove_rule(pos);
+	return 0;
+    default:
+	for (Rule **rp = f->_rules.begin(); rp != f->_rules.end(); ++rp)
+	    (*rp)->hits = 0;
+	return 0;
+    }
+}
+
+void
+TupleSpaceIPFilter::add_handlers()
+{
+    add_read_handler("rules", read_handler, 0);
+    add_read_handler("stats", read_handler, 1);
+    add_write_handler("add", write_handler, 0);
+    add_write_handler("insert", write_handler, 1);
+    add_write_handler("remove", write_handler, 2);
+    add_write_handler("reset_counts", write_handler, 3, Handler::BUTTON);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(TupleSpaceIPFilter)
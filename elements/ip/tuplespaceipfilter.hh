@@ -0,0 +1,233 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_TUPLESPACEIPFILTER_HH
+#define CLICK_TUPLESPACEIPFILTER_HH
+#include <click/element.hh>
+#include <click/hashtable.hh>
+#include <click/vector.hh>
+#include <click/ipaddress.hh>
+CLICK_DECLS
+
+/*
+=c
+
+TupleSpaceIPFilter(ACTION_1 PATTERN_1, ..., ACTION_N PATTERN_N [, I<keywords>])
+
+=s ip
+
+filters IP packets by 5-tuple, scaling to large rule sets
+
+=d
+
+Filters IP packets like IPFilter, but is designed for access control lists
+with thousands of rules.  Each filter is an ACTION-PATTERN pair with
+IPFilter's syntax.  Packets are tested against the filters in order, and are
+processed according to the ACTION in the first filter that matched; packets
+that match no filter are dropped.  ACTION is a port number, 'C<allow>'
+(equivalent to 'C<0>'), or 'C<drop>' or 'C<deny>'.
+
+Where IPFilter compiles its filters into one decision tree, which grows
+quickly with the number of port ranges and prefixes, TupleSpaceIPFilter
+uses tuple space search.  Each filter becomes one or more entries that fix a
+prefix of the source address, the destination address, the source port, and
+the destination port, and optionally the IP protocol.  Entries with the same
+prefix lengths share a hash table (a "tuple").  A lookup probes one hash
+table per tuple, skipping tuples whose best filter comes after the best
+match found so far.  Memory is proportional to the number of entries, and
+filters can be added and removed through handlers without rebuilding.
+
+PATTERNs may use only these IPFilter primitives, combined with 'C<and>' or
+'C<&&>', 'C<or>' or 'C<||>', and parentheses:
+
+=over 5
+
+=item 'C<[PROTO] [src | dst | src or dst | src and dst] [host] ADDR>'
+
+=item 'C<[PROTO] [src | dst | src or dst | src and dst] net NETADDR>'
+
+NETADDR is 'C<ADDR/LEN>' or 'C<ADDR mask MASK>'.  A protocol name PROTO, as
+in 'C<tcp src host ADDR>', also requires that protocol.
+
+=item 'C<ip proto PROTO>', 'C<tcp>', 'C<udp>', 'C<icmp>', and other
+protocol names
+
+=item 'C<[tcp | udp] [src | dst | src or dst | src and dst] port [OP] PORT>'
+
+OP is 'C<=>', 'C<==>', 'C<!=>', 'C<E<lt>>', 'C<E<gt>>', 'C<E<lt>=>', or
+'C<E<gt>=>'.  As an extension to IPFilter's syntax, PORT may also be a range
+'C<LO-HI>'.  As with IPFilter, a port test without 'C<tcp>' or 'C<udp>'
+matches either protocol, and only first fragments have ports.
+
+=item 'C<all>', 'C<true>', or 'C<->'
+
+=back
+
+As in IPFilter, a bare value continues the previous primitive, so 'C<dst
+port 80 or 443>' means 'C<dst port 80 or dst port 443>'.  Other IPFilter
+primitives, such as TCP flags and negation, are not supported; use IPFilter
+for those.
+
+A port range becomes up to 30 port prefixes, and a filter with 'C<or>'
+becomes an entry per alternative, so a single filter can produce many
+entries.  The MAX_ENTRIES keyword bounds the total.
+
+Input packets must have their IP header annotation set; CheckIPHeader and
+MarkIPHeader do this.
+
+Keyword arguments are:
+
+=over 8
+
+=item MAX_ENTRIES
+
+Integer.  The maximum number of entries across all filters.  Configuration
+fails, or an C<add> or C<insert> write fails, if a filter would exceed it.
+Default is 1048576.
+
+=back
+
+=e
+
+  TupleSpaceIPFilter(allow src 10.0.0.0/8 && tcp dst port 22,
+                     drop dst port 6000-6063,
+                     allow udp dst port 53 or 123,
+                     deny all);
+
+=h rules read-only
+
+Returns the current filters in order, one per line, each preceded by its
+position and the number of packets it has matched.
+
+=h add write-only
+
+Appends a filter, 'C<ACTION PATTERN>', after all current filters.
+
+=h insert write-only
+
+Inserts a filter before the filter at a given position.  Format is 'C<POS
+ACTION PATTERN>'; position 0 is first.
+
+=h remove write-only
+
+Removes the filter at a given position.
+
+=h reset_counts write-only
+
+Resets the per-filter match counts.
+
+=h stats read-only
+
+Returns the number of filters, tuples, and entries.
+
+=a
+
+IPFilter, IPClassifier, CheckIPHeader, MarkIPHeader */
+
+class TupleSpaceIPFilter : public Element { public:
+
+    TupleSpaceIPFilter() CLICK_COLD;
+    ~TupleSpaceIPFilter() CLICK_COLD;
+
+    const char *class_name() const	{ return "TupleSpaceIPFilter"; }
+    const char *port_count() const	{ return "1/-"; }
+    const char *processing() const	{ return PUSH; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh) CLICK_COLD;
+    void cleanup(CleanupStage stage) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
+
+    void push(int port, Packet *p);
+
+  private:
+
+    // Header fields, masked to a tuple's prefix lengths; addresses and
+    // ports are in network byte order.
+    struct Key {
+	uint32_t src;
+	uint32_t dst;
+	uint16_t sport;
+	uint16_t dport;
+	uint32_t proto;
+	hashcode_t hashcode() const;
+	bool operator==(const Key &x) const {
+	    return src == x.src && dst == x.dst && sport == x.sport
+		&& dport == x.dport && proto == x.proto;
+	}
+    };
+
+    struct Rule;
+
+    // what an entry fixes: prefix lengths, and whether it needs a protocol
+    // and ports
+    struct Shape {
+	int src_len;
+	int dst_len;
+	int sport_len;
+	int dport_len;
+	bool has_proto;
+	bool has_ports;
+	bool operator==(const Shape &x) const {
+	    return src_len == x.src_len && dst_len == x.dst_len
+		&& sport_len == x.sport_len && dport_len == x.dport_len
+		&& has_proto == x.has_proto && has_ports == x.has_ports;
+	}
+    };
+
+    struct Tuple {
+	Shape shape;
+	Key mask;
+	Rule *best;		// rule with the best position in the table
+	HashTable<Key, Vector<Rule *> > table;	// sorted by position
+    };
+
+    struct Entry {
+	Tuple *tuple;
+	Key key;
+    };
+
+    struct Spec {
+	Shape shape;
+	Key key;
+    };
+
+    struct Rule {
+	String text;
+	int action;		// output port, or -1 to drop
+	int pos;
+	uint64_t hits;
+	Vector<Entry> entries;
+    };
+
+    // a conjunction of field constraints, before port ranges become prefixes
+    struct Match {
+	uint32_t src, src_mask;
+	uint32_t dst, dst_mask;
+	int proto;		// -1 means any
+	bool has_ports;
+	uint16_t sport_lo, sport_hi;
+	uint16_t dport_lo, dport_hi;
+    };
+
+    struct Parser;
+
+    Vector<Rule *> _rules;	// in order
+    Vector<Tuple *> _tuples;	// in order of their best rules
+    int _nentries;
+    int _max_entries;
+
+    int parse_rule(const String &text, Rule *r, Vector<Spec> &specs,
+		   ErrorHandler *errh) const;
+    int insert_rule(const String &text, int pos, ErrorHandler *errh);
+    void remove_rule(int pos);
+    Tuple *find_tuple(const Shape &shape);
+    void renumber(int from);
+    void sort_tuples();
+    int lookup(const Packet *p) const;
+
+    static String read_handler(Element *e, void *user_data) CLICK_COLD;
+    static int write_handler(const String &str, Element *e, void *user_data,
+			     ErrorHandler *errh) CLICK_COLD;
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -162,6 +162,16 @@ LookupIP6Route::remove_route(IP6Address addr, IP6Address mask,
   return 0;
 }
 
+int
+LookupIP6Route::lookup_route(const IP6Address &addr, IP6Address &gw) const
+{
+  int port;
+  if (_t.lookup(addr, gw, port))
+    return port;
+  else
+    return -1;
+}
+
 void
 LookupIP6Route::add_handlers()
 {
@@ -169,6 +179,7 @@ LookupIP6Route::add_handlers()
     add_write_handler("remove", remove_route_handler, 0);
     add_write_handler("ctrl", ctrl_handler, 0);
     add_read_handler("table", table_handler, 0);
+    set_handler("lookup", Handler::OP_READ | Handler::READ_PARAM, lookup_handler);
 }
 
 CLICK_ENDDECLS
@@ -37,6 +37,29 @@ CLICK_DECLS
  *   rt[2] -> ... -> ToDevice(eth1);
  *   ...
  *
+ * =n
+ *
+ * LookupIP6Route scans the whole table for every lookup, so it is best for
+ * small tables.  TreeBitmapIP6Lookup handles large tables.
+ *
+ * =h table read-only
+ * Outputs a human-readable version of the current routing table.
+ *
+ * =h lookup read-only
+ * Reports the OUTput port and GW corresponding to an address.
+ *
+ * =h add write-only
+ * Adds a route to the table, replacing any route for the same prefix.
+ * Format should be `C<ADDR/MASK [GW] OUT>'.
+ *
+ * =h remove write-only
+ * Removes a route from the table. Format should be `C<ADDR/MASK>'.
+ *
+ * =h ctrl write-only
+ * Write `C<add ADDR/MASK [GW] OUT>' to add a route, and
+ * `C<remove ADDR/MASK>' to remove a route.
+ *
+ * =a TreeBitmapIP6Lookup
  */
 
 class LookupIP6Route : public IP6RouteTable {
@@ -56,6 +79,7 @@ public:
 
   int add_route(IP6Address, IP6Address, IP6Address, int, ErrorHandler *);
   int remove_route(IP6Address, IP6Address, ErrorHandler *);
+  int lookup_route(const IP6Address &, IP6Address &) const;
   String dump_routes()				{ return _t.dump(); };
 
 private:
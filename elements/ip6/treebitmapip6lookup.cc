@@ -0,0 +1,323 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * treebitmapip6lookup.{cc,hh} -- looks up IPv6 routes using a tree bitmap
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "treebitmapip6lookup.hh"
+#include <click/ip6address.hh>
+#include <click/straccum.hh>
+#include <click/error.hh>
+#include <click/integers.hh>
+CLICK_DECLS
+
+uint64_t TreeBitmapIP6Lookup::match_mask[1 << stride];
+
+TreeBitmapIP6Lookup::TreeBitmapIP6Lookup()
+    : _vfree(-1), _nnodes(1)
+{
+    memset(&_root, 0, sizeof(_root));
+}
+
+TreeBitmapIP6Lookup::~TreeBitmapIP6Lookup()
+{
+}
+
+void
+TreeBitmapIP6Lookup::static_initialize()
+{
+    // match_mask[C] marks every internal bitmap position whose prefix
+    // matches chunk C
+    for (int c = 0; c < (1 << stride); ++c) {
+	match_mask[c] = 0;
+	for (int len = 0; len < stride; ++len)
+	    match_mask[c] |= uint64_t(1) << ((1 << len) - 1 + (c >> (stride - len)));
+    }
+}
+
+int
+TreeBitmapIP6Lookup::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    int r = 0;
+    for (int i = 0; i < conf.size(); ++i) {
+	ContextErrorHandler cerrh(errh, "argument %d:", i + 1);
+	if (add_route_handler(conf[i], this, 0, &cerrh) < 0)
+	    r = -EINVAL;
+    }
+    return r;
+}
+
+void
+TreeBitmapIP6Lookup::cleanup(CleanupStage)
+{
+    flush_table();
+}
+
+static inline void
+split_address(const IP6Address &a, uint64_t &hi, uint64_t &lo)
+{
+    const uint32_t *d = a.data32();
+    hi = (uint64_t(ntohl(d[0])) << 32) | ntohl(d[1]);
+    lo = (uint64_t(ntohl(d[2])) << 32) | ntohl(d[3]);
+}
+
+static inline void
+shift_address(uint64_t &hi, uint64_t &lo, int n)
+{
+    hi = (hi << n) | (lo >> (64 - n));
+    lo <<= n;
+}
+
+int
+TreeBitmapIP6Lookup::lookup_route(const IP6Address &addr, IP6Address &gw) const
+{
+    uint64_t hi, lo;
+    split_address(addr, hi, lo);
+
+    // Remember the deepest node with a matching route, and only look at
+    // its route array at the end; this saves a cache miss per level.
+    const Node *n = &_root, *best = 0;
+    uint64_t best_m = 0;
+    while (1) {
+	int c = hi >> (64 - stride);
+	if (uint64_t m = n->internal & match_mask[c]) {
+	    best = n;
+	    best_m = m;
+	}
+	if (!(n->external & (uint64_t(1) << c)))
+	    break;
+	n = &n->children[rank(n->external, c)];
+	shift_address(hi, lo, stride);
+    }
+
+    if (!best)
+	return -1;
+    int bit = 64 - ffs_msb(best_m); // the longest matching prefix
+    const Route &r = _v[best->routes[rank(best->internal, bit)]];
+    gw = r.gw;
+    return r.port;
+}
+
+void
+TreeBitmapIP6Lookup::push(int, Packet *p)
+{
+    IP6Address gw;
+    int port = lookup_route(DST_IP6_ANNO(p), gw);
+    if (port >= 0) {
+	if (gw)
+	    SET_DST_IP6_ANNO(p, gw);
+	output(port).push(p);
+    } else
+	p->kill();
+}
+
+int
+TreeBitmapIP6Lookup::insert(uint64_t hi, uint64_t lo, int prefix_len, int route)
+{
+    Node *n = &_root;
+    for (; prefix_len >= stride; prefix_len -= stride) {
+	int c = hi >> (64 - stride);
+	int pos = rank(n->external, c);
+	if (!(n->external & (uint64_t(1) << c))) {
+	    int nchildren = popcount(n->external);
+	    Node *children = new Node[nchildren + 1];
+	    if (nchildren) {
+		memcpy(children, n->children, pos * sizeof(Node));
+		memcpy(children + pos + 1, n->children + pos,
+		       (nchildren - pos) * sizeof(Node));
+		delete[] n->children;
+	    }
+	    memset(&children[pos], 0, sizeof(Node));
+	    n->children = children;
+	    n->external |= uint64_t(1) << c;
+	    ++_nnodes;
+	}
+	n = &n->children[pos];
+	shift_address(hi, lo, stride);
+    }
+
+    int bit = (1 << prefix_len) - 1 + (prefix_len ? hi >> (64 - prefix_len) : 0);
+    int pos = rank(n->internal, bit);
+    if (n->internal & (uint64_t(1) << bit)) {
+	int old = n->routes[pos];
+	n->routes[pos] = route;
+	return old;
+    }
+    int nroutes = popcount(n->internal);
+    int *routes = new int[nroutes + 1];
+    if (nroutes) {
+	memcpy(routes, n->routes, pos * sizeof(int));
+	memcpy(routes + pos + 1, n->routes + pos, (nroutes - pos) * sizeof(int));
+	delete[] n->routes;
+    }
+    routes[pos] = route;
+    n->routes = routes;
+    n->internal |= uint64_t(1) << bit;
+    return -1;
+}
+
+int
+TreeBitmapIP6Lookup::remove(Node *n, uint64_t hi, uint64_t lo, int prefix_len)
+{
+    if (prefix_len >= stride) {
+	int c = hi >> (64 - stride);
+	if (!(n->external & (uint64_t(1) << c)))
+	    return -1;
+	int pos = rank(n->external, c);
+	Node *child = &n->children[pos];
+	shift_address(hi, lo, stride);
+	int old = remove(child, hi, lo, prefix_len - stride);
+	if (old >= 0 && !child->internal && !child->external) {
+	    // drop the empty child
+	    int nchildren = popcount(n->external);
+	    memmove(child, child + 1, (nchildren - pos - 1) * sizeof(Node));
+	    n->external &= ~(uint64_t(1) << c);
+	    if (nchildren == 1) {
+		delete[] n->children;
+		n->children = 0;
+	    }
+	    --_nnodes;
+	}
+	return old;
+    }
+
+    int bit = (1 << prefix_len) - 1 + (prefix_len ? hi >> (64 - prefix_len) : 0);
+    if (!(n->internal & (uint64_t(1) << bit)))
+	return -1;
+    int pos = rank(n->internal, bit);
+    int old = n->routes[pos];
+    int nroutes = popcount(n->internal);
+    memmove(n->routes + pos, n->routes + pos + 1, (nroutes - pos - 1) * sizeof(int));
+    n->internal &= ~(uint64_t(1) << bit);
+    if (nroutes == 1) {
+	delete[] n->routes;
+	n->routes = 0;
+    }
+    return old;
+}
+
+int
+TreeBitmapIP6Lookup::add_route(IP6Address addr, IP6Address mask, IP6Address gw,
+			       int port, ErrorHandler *errh)
+{
+    int prefix_len = mask.mask_to_prefix_len();
+    if (prefix_len < 0)
+	return errh->error("mask not a prefix");
+
+    int ri;
+    if (_vfree >= 0) {
+	ri = _vfree;
+	_vfree = _v[ri].port;
+    } else {
+	ri = _v.size();
+	_v.push_back(Route());
+    }
+    Route &r = _v[ri];
+    r.addr = addr & mask;
+    r.gw = gw;
+    r.prefix_len = prefix_len;
+    r.port = port;
+
+    uint64_t hi, lo;
+    split_address(r.addr, hi, lo);
+    int old = insert(hi, lo, prefix_len, ri);
+    if (old >= 0) {
+	_v[old].prefix_len = -1;
+	_v[old].port = _vfree;
+	_vfree = old;
+    }
+    return 0;
+}
+
+int
+TreeBitmapIP6Lookup::remove_route(IP6Address addr, IP6Address mask,
+				  ErrorHandler *errh)
+{
+    int prefix_len = mask.mask_to_prefix_len();
+    if (prefix_len < 0)
+	return errh->error("mask not a prefix");
+
+    uint64_t hi, lo;
+    split_address(addr & mask, hi, lo);
+    int old = remove(&_root, hi, lo, prefix_len);
+    if (old < 0)
+	return errh->error("no route for %s/%d", (addr & mask).unparse().c_str(), prefix_len);
+    _v[old].prefix_len = -1;
+    _v[old].port = _vfree;
+    _vfree = old;
+    return 0;
+}
+
+String
+TreeBitmapIP6Lookup::dump_routes()
+{
+    StringAccum sa;
+    for (const Route *r = _v.begin(); r != _v.end(); ++r)
+	if (r->prefix_len >= 0) {
+	    if (sa.length() == 0)
+		sa << "# Active routes\n";
+	    sa << r->addr << '/' << r->prefix_len << '\t' << r->gw
+	       << '\t' << r->port << '\n';
+	}
+    return sa.take_string();
+}
+
+void
+TreeBitmapIP6Lookup::free_node(Node *n)
+{
+    int nchildren = popcount(n->external);
+    for (int i = 0; i < nchildren; ++i)
+	free_node(&n->children[i]);
+    delete[] n->children;
+    delete[] n->routes;
+    memset(n, 0, sizeof(Node));
+}
+
+void
+TreeBitmapIP6Lookup::flush_table()
+{
+    free_node(&_root);
+    _nnodes = 1;
+    _v.clear();
+    _vfree = -1;
+}
+
+int
+TreeBitmapIP6Lookup::flush_handler(const String &, Element *e, void *,
+				   ErrorHandler *)
+{
+    static_cast<TreeBitmapIP6Lookup *>(e)->flush_table();
+    return 0;
+}
+
+String
+TreeBitmapIP6Lookup::nodes_handler(Element *e, void *)
+{
+    return String(static_cast<TreeBitmapIP6Lookup *>(e)->_nnodes);
+}
+
+void
+TreeBitmapIP6Lookup::add_handlers()
+{
+    add_write_handler("add", add_route_handler, 0);
+    add_write_handler("remove", remove_route_handler, 0);
+    add_write_handler("ctrl", ctrl_handler, 0);
+    add_write_handler("flush", flush_handler, 0, Handler::BUTTON);
+    add_read_handler("table", table_handler, 0);
+    add_read_handler("nodes", nodes_handler, 0);
+    set_handler("lookup", Handler::OP_READ | Handler::READ_PARAM, lookup_handler);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(IP6RouteTable)
+EXPORT_ELEMENT(TreeBitmapIP6Lookup)
@@ -0,0 +1,152 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_TREEBITMAPIP6LOOKUP_HH
+#define CLICK_TREEBITMAPIP6LOOKUP_HH
+#include <click/element.hh>
+#include <click/vector.hh>
+#include "ip6routetable.hh"
+CLICK_DECLS
+
+/*
+=c
+
+TreeBitmapIP6Lookup(ADDR1/MASK1 [GW1] OUT1, ADDR2/MASK2 [GW2] OUT2, ...)
+
+=s ip6
+
+IPv6 lookup using a tree bitmap
+
+=d
+
+Performs IPv6 longest-prefix-match lookup using a tree bitmap, a compressed
+multibit trie.  Each trie node covers 6 bits of address.  A node stores two
+bitmaps, one marking which of its 63 possible prefixes are routes and one
+marking which of its 64 children exist; routes and children are packed into
+arrays indexed by counting bits.  A lookup visits one node per 6 bits of
+prefix, so its cost depends on the length of the matching prefixes (at most
+22 nodes), not on the size of the table, and memory grows with the number of
+routes.
+
+Expects a destination IPv6 address annotation with each packet.  Looks up
+that address, sets the destination annotation to the corresponding GW (if
+non-zero), and emits the packet on the indicated OUTput port.  Packets with
+no matching route are dropped.
+
+Each argument is a route, specifying a destination and mask, an optional
+gateway IPv6 address, and an output port.  A later route for the same prefix
+replaces an earlier one.
+
+=h table read-only
+
+Outputs a human-readable version of the current routing table.
+
+=h lookup read-only
+
+Reports the OUTput port and GW corresponding to an address.
+
+=h add write-only
+
+Adds a route to the table, replacing any route for the same prefix.  Format
+should be `C<ADDR/MASK [GW] OUT>'.
+
+=h remove write-only
+
+Removes a route from the table. Format should be `C<ADDR/MASK>'.
+
+=h ctrl write-only
+
+Write `C<add ADDR/MASK [GW] OUT>' to add a route, and `C<remove ADDR/MASK>'
+to remove a route.
+
+=h flush write-only
+
+Clears the table.
+
+=h nodes read-only
+
+Returns the number of trie nodes.
+
+=e
+
+   rt :: TreeBitmapIP6Lookup(3ffe:1ce1:2::/48 0,
+                             3ffe:1ce1:2:0:200::/80 1,
+                             ::/0 3ffe:1ce1:2::2 1);
+
+=a LookupIP6Route, IP6LookupBenchmark, RadixIPLookup */
+
+class TreeBitmapIP6Lookup : public IP6RouteTable { public:
+
+    TreeBitmapIP6Lookup() CLICK_COLD;
+    ~TreeBitmapIP6Lookup() CLICK_COLD;
+
+    const char *class_name() const		{ return "TreeBitmapIP6Lookup"; }
+    const char *port_count() const		{ return "1/-"; }
+    const char *processing() const		{ return PUSH; }
+
+    static void static_initialize();
+
+    int configure(Vector<String> &conf, ErrorHandler *errh) CLICK_COLD;
+    void cleanup(CleanupStage stage) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
+
+    void push(int port, Packet *p);
+
+    int add_route(IP6Address, IP6Address, IP6Address, int, ErrorHandler *);
+    int remove_route(IP6Address, IP6Address, ErrorHandler *);
+    int lookup_route(const IP6Address &, IP6Address &) const;
+    String dump_routes();
+
+  private:
+
+    enum { stride = 6 };
+
+    // Bit (1 << len) - 1 + V of a node's internal bitmap marks the route for
+    // the len-bit prefix V within the node's 6 bits; bit C of its external
+    // bitmap marks the child for 6-bit chunk C.  Routes and children are
+    // stored in bitmap order.
+    struct Node {
+	uint64_t internal;
+	uint64_t external;
+	Node *children;
+	int *routes;
+    };
+
+    struct Route {
+	IP6Address addr;
+	IP6Address gw;
+	int prefix_len;
+	int port;
+    };
+
+    Node _root;
+    Vector<Route> _v;
+    int _vfree;
+    int _nnodes;
+
+    static uint64_t match_mask[1 << stride];
+
+    static inline int rank(uint64_t bitmap, int bit) {
+	return popcount(bitmap & ((uint64_t(1) << bit) - 1));
+    }
+    static inline int popcount(uint64_t x) {
+#if __GNUC__
+	return __builtin_popcountll(x);
+#else
+	x = x - ((x >> 1) & 0x5555555555555555ULL);
+	x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+	x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+	return (x * 0x0101010101010101ULL) >> 56;
+#endif
+    }
+
+    int insert(uint64_t hi, uint64_t lo, int prefix_len, int route);
+    int remove(Node *n, uint64_t hi, uint64_t lo, int prefix_len);
+    void free_node(Node *n);
+    void flush_table();
+
+    static int flush_handler(const String &, Element *, void *, ErrorHandler *);
+    static String nodes_handler(Element *, void *);
+
+};
+
+CLICK_ENDDECLS
+#endif
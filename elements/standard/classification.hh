@@ -1,6 +1,12 @@
 #ifndef CLICK_CLASSIFICATION_HH
 #define CLICK_CLASSIFICATION_HH 1
 #define CLICK_CLASSIFICATION_WORDWISE_DOMINATOR_FASTPRED 1
+#if CLICK_USERLEVEL && ALLOW_MMAP && defined(__x86_64__)
+# define CLICK_CLASSIFICATION_WORDWISE_JIT 1
+#endif
+#if CLICK_USERLEVEL && defined(__x86_64__) && (__GNUC__ >= 5 || defined(__clang__))
+# define CLICK_CLASSIFICATION_WORDWISE_SIMD 1
+#endif
 #include <click/packet.hh>
 #include <click/vector.hh>
 CLICK_DECLS
@@ -199,6 +205,20 @@ class Program { public:
 
     int match(const Packet *p);
 
+    /** @brief Match @a n packets, storing the output for @a p[i] in
+     * @a outputs[i].
+     *
+     * On CPUs with AVX2, eight packets step through the program together:
+     * each step gathers every packet's instruction and data word and
+     * compares them all at once.  A packet that reaches an output leaves
+     * its lane to the next packet in @a p.  Packets shorter than
+     * safe_length(), and batches on other CPUs, are matched one by one. */
+    void match_batch(const Packet *const *p, int n, int *outputs);
+
+    /** @brief Return true iff match_batch() evaluates packets in parallel
+     * on this CPU. */
+    static bool simd_available();
+
     String unparse() const;
 
   private:
@@ -211,6 +231,9 @@ class Program { public:
     void redirect_subtree(int first, int next, int success, int failure);
 
     int length_checked_match(const Packet *p);
+#if CLICK_CLASSIFICATION_WORDWISE_SIMD
+    void simd_match_batch(const Packet *const *p, int n, int *outputs);
+#endif
     static inline int map_offset(int offset, const int *begin, const int *end);
     static int hard_map_offset(int offset, const int *begin, const int *end);
 
@@ -260,6 +283,65 @@ class CompressedProgram { public:
 };
 
 
+/** @brief A CompressedProgram translated into native machine code.
+ *
+ * The generated function performs the same tests as CompressedProgram's
+ * interpreter, but with every offset, mask, value, and jump compiled in.
+ * Like the interpreters' fast paths, it never checks packet length, so
+ * callers must use it only for packets at least safe_length() long.
+ *
+ * A program offset is relative to one of up to three data pointers.  Offset
+ * @a off uses the pointer with the largest @a base_offsets entry not greater
+ * than @a off, and reads the word at that pointer plus @a off minus the
+ * entry.
+ *
+ * Code generation is only available at user level on x86-64; elsewhere,
+ * compile() always fails, and callers should keep interpreting. */
+class CompiledProgram { public:
+
+    typedef int (*function_type)(const unsigned char *data0,
+				 const unsigned char *data1,
+				 const unsigned char *data2);
+
+    CompiledProgram()
+	: _f(0), _code(0), _size(0) {
+    }
+    ~CompiledProgram() {
+	clear();
+    }
+
+    /** @brief Compile @a zprog, replacing any previous code.
+     * @return true on success, false if @a zprog has no tests or code
+     *   generation is unavailable */
+    bool compile(const CompressedProgram &zprog,
+		 const int *base_offsets, int nbases);
+    void clear();
+
+    bool compiled() const {
+	return _f;
+    }
+    size_t code_size() const {
+	return _size;
+    }
+
+    int operator()(const unsigned char *data0,
+		   const unsigned char *data1 = 0,
+		   const unsigned char *data2 = 0) const {
+	return _f(data0, data1, data2);
+    }
+
+  private:
+
+    function_type _f;
+    void *_code;
+    size_t _size;
+
+    CompiledProgram(const CompiledProgram &);
+    CompiledProgram &operator=(const CompiledProgram &);
+
+};
+
+
 class DominatorOptimizer { public:
 
     DominatorOptimizer(Program *p);
@@ -23,6 +23,7 @@
 #include <click/glue.hh>
 #include <click/error.hh>
 #include <click/confparse.hh>
+#include <click/args.hh>
 #include <click/straccum.hh>
 #if !HAVE_INDIFFERENT_ALIGNMENT
 #include <click/router.hh>
@@ -31,6 +32,7 @@
 CLICK_DECLS
 
 Classifier::Classifier()
+    : _use_jit(true), _use_simd(true), _simd(false), _cycles(0), _cycle_packets(0)
 {
 }
 
@@ -230,11 +232,29 @@ Classifier::configure(Vector<String> &conf, ErrorHandler *errh)
     if (!errh->nerrors()) {
 	prog.warn_unused_outputs(noutputs(), errh);
 	_prog = prog;
+	prepare_matchers();
 	return 0;
     } else
 	return -1;
 }
 
+void
+Classifier::prepare_matchers()
+{
+    _jit.clear();
+    if (_use_jit) {
+	Classification::Wordwise::CompressedProgram zprog;
+	zprog.compile(_prog, false, 0);
+	static const int base_offset = 0;
+	_jit.compile(zprog, &base_offset, 1);
+    }
+    // Machine code beats stepping several packets at once, which in turn
+    // beats the plain interpreter only when packets take many steps.
+    _simd = _use_simd && !_jit.compiled()
+	&& _prog.ninsn() >= simd_min_insns
+	&& Classification::Wordwise::Program::simd_available();
+}
+
 String
 Classifier::program_string(Element *element, void *)
 {
@@ -242,16 +262,93 @@ Classifier::program_string(Element *element, void *)
     return c->_prog.unparse();
 }
 
+String
+Classifier::read_handler(Element *element, void *user_data)
+{
+    Classifier *c = static_cast<Classifier *>(element);
+    switch ((uintptr_t) user_data) {
+    case 0:
+	return String(c->_jit.compiled());
+    case 1:
+	return String(c->_cycle_packets ? c->_cycles / c->_cycle_packets : 0);
+    default:
+	return String(c->_simd);
+    }
+}
+
+int
+Classifier::write_handler(const String &str, Element *element,
+			  void *user_data, ErrorHandler *errh)
+{
+    Classifier *c = static_cast<Classifier *>(element);
+    bool on;
+    if (!BoolArg().parse(str, on))
+	return errh->error("syntax error");
+    if (user_data)
+	c->_use_simd = on;
+    else
+	c->_use_jit = on;
+    c->prepare_matchers();
+    c->_cycles = c->_cycle_packets = 0;
+    return 0;
+}
+
 void
 Classifier::add_handlers()
 {
     add_read_handler("program", Classifier::program_string, 0, Handler::CALM);
+    add_read_handler("jit", read_handler, 0);
+    add_write_handler("jit", write_handler, 0);
+    add_read_handler("simd", read_handler, 2);
+    add_write_handler("simd", write_handler, 1);
+    add_read_handler("cycles", read_handler, 1);
+}
+
+inline int
+Classifier::classify(const Packet *p)
+{
+    if (_jit.compiled() && p->length() >= _prog.safe_length())
+	return _jit(p->data() - _prog.align_offset());
+    else
+	return _prog.match(p);
 }
 
 void
 Classifier::push(int, Packet *p)
 {
-    checked_output_push(_prog.match(p), p);
+    checked_output_push(classify(p), p);
+}
+
+void
+Classifier::push_batch(int, PacketBatch &batch)
+{
+    // Classify a chunk of packets at a time, timing just the classification.
+    // Then forward runs of consecutive packets bound for the same output as
+    // one batch, which keeps packet order intact across outputs.
+    Packet *p[batch_chunk];
+    int port[batch_chunk];
+    PacketBatch run;
+    int run_port = -1;
+    while (!batch.empty()) {
+	int n = 0;
+	while (n < batch_chunk && (p[n] = batch.pop_front()))
+	    ++n;
+	click_cycles_t c0 = click_get_cycles();
+	if (_simd && n > 1)
+	    _prog.match_batch(p, n, port);
+	else
+	    for (int i = 0; i < n; ++i)
+		port[i] = classify(p[i]);
+	_cycles += click_get_cycles() - c0;
+	_cycle_packets += n;
+	for (int i = 0; i < n; ++i) {
+	    if (port[i] != run_port && !run.empty())
+		checked_output_push_batch(run_port, run);
+	    run_port = port[i];
+	    run.push_back(p[i]);
+	}
+    }
+    checked_output_push_batch(run_port, run);
 }
 
 CLICK_ENDDECLS
@@ -42,6 +42,17 @@ CLICK_DECLS
  * The IPClassifier and IPFilter elements have a friendlier syntax if you are
  * classifying IP packets.
  *
+ * At user level on x86-64, Classifier translates its program into machine
+ * code at configuration time, which classifies packets much faster than
+ * interpreting the program, and about as fast as the C++ that
+ * click-fastclassifier generates.  Packets shorter than the program's safe
+ * length are still interpreted.  If code generation fails, or is turned off
+ * with the C<jit> handler, Classifier interprets every packet.  On CPUs with
+ * AVX2, it then interprets packets that arrive in batches eight at a time,
+ * stepping them through the program together.  This pays off only when
+ * packets take many steps, so Classifier does it only for programs of at
+ * least 16 steps.
+ *
  * =e
  * For example,
  *
@@ -70,6 +81,20 @@ CLICK_DECLS
  *   safe length 22
  *   alignment offset 0
  *
+ * =h jit read/write
+ * Returns true if Classifier is running its program as machine code.  Write
+ * false to interpret the program instead, or true to compile it again.
+ *
+ * =h simd read/write
+ * Returns true if Classifier interprets batches of packets eight at a time.
+ * This happens only for long programs that are not running as machine code.
+ * Write false to interpret batches one packet at a time.
+ *
+ * =h cycles read-only
+ * Returns the average number of CPU cycles Classifier has spent classifying
+ * each packet.  Only packets that arrive in batches are timed.  Writing the
+ * C<jit> or C<simd> handler resets the average.
+ *
  * =a IPClassifier, IPFilter */
 
 class Classifier : public Element { public:
@@ -87,6 +112,7 @@ class Classifier : public Element { public:
     void add_handlers() CLICK_COLD;
 
     void push(int port, Packet *);
+    void push_batch(int port, PacketBatch &batch);
 
     Classification::Wordwise::Program empty_program(ErrorHandler *errh) const;
     static void parse_program(Classification::Wordwise::Program &prog,
@@ -95,8 +121,21 @@ class Classifier : public Element { public:
   protected:
 
     Classification::Wordwise::Program _prog;
+    Classification::Wordwise::CompiledProgram _jit;
+    bool _use_jit;
+    bool _use_simd;
+    bool _simd;
+    click_cycles_t _cycles;
+    uint64_t _cycle_packets;
+
+    enum { batch_chunk = 32, simd_min_insns = 16 };
+
+    inline int classify(const Packet *p);
+    void prepare_matchers();
 
     static String program_string(Element *, void *);
+    static String read_handler(Element *, void *);
+    static int write_handler(const String &, Element *, void *, ErrorHandler *);
 
 };
 
@@ -107,6 +107,14 @@ Counter::simple_action(Packet *p)
   return p;
 }
 
+void
+Counter::push_batch(int, PacketBatch &batch)
+{
+    for (Packet *p = batch.front(); p; p = p->next())
+	(void) Counter::simple_action(p);
+    output(0).push_batch(batch);
+}
+
 
 enum { H_COUNT, H_BYTE_COUNT, H_RATE, H_BIT_RATE, H_BYTE_RATE, H_RESET,
        H_COUNT_CALL, H_BYTE_COUNT_CALL };
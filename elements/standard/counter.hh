@@ -114,6 +114,7 @@ class Counter : public Element { public:
     int llrpc(unsigned, void *);
 
     Packet *simple_action(Packet *);
+    void push_batch(int port, PacketBatch &batch);
 
   private:
 
@@ -63,6 +63,7 @@ class Discard : public Element { public:
     void add_handlers() CLICK_COLD;
 
     void push(int, Packet *);
+    void push_batch(int, PacketBatch &);
     bool run_task(Task *);
 
   protected:
@@ -76,6 +76,67 @@ FullNoteQueue::pull(int)
 	return pull_failure();
 }
 
+void
+FullNoteQueue::push_batch(int, PacketBatch &batch)
+{
+    Storage::index_type h = _head, t = _tail, nt = next_i(t);
+    Packet *p;
+
+    while (nt != h && (p = batch.pop_front())) {
+	_q[t] = p;
+	t = nt;
+	nt = next_i(nt);
+    }
+
+    if (t != _tail) {
+	packet_memory_barrier(_q[prev_i(t)], _tail);
+	_tail = t;
+
+	int s = size(h, t);
+	if (s > _highwater_length)
+	    _highwater_length = s;
+
+	_empty_note.wake();
+
+	if (s == capacity()) {
+	    _full_note.sleep();
+#if HAVE_MULTITHREAD
+	    // See push_success().
+	    if (size() < capacity())
+		_full_note.wake();
+#endif
+	}
+    }
+
+    while ((p = batch.pop_front()))
+	push_failure(p);
+}
+
+PacketBatch
+FullNoteQueue::pull_batch(int, unsigned max)
+{
+    PacketBatch batch;
+    Storage::index_type h = _head, t = _tail;
+
+    if (h == t || !max) {
+	if (max)
+	    pull_failure();
+	return batch;
+    }
+
+    do {
+	batch.push_back(_q[h]);
+	h = next_i(h);
+    } while (h != t && --max);
+
+    packet_memory_barrier(_q[prev_i(h)], _head);
+    _head = h;
+
+    _sleepiness = 0;
+    _full_note.wake();
+    return batch;
+}
+
 #if CLICK_DEBUG_SCHEDULING
 String
 FullNoteQueue::read_handler(Element *e, void *)
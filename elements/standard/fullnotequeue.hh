@@ -29,6 +29,10 @@ notifies interested parties that it is non-full, and when a formerly-full
 queue gains some free space.  In all respects but notification, Queue behaves
 exactly like SimpleQueue.
 
+Queue accepts and emits packet batches natively: a pushed batch is enqueued
+with one tail update and one notification, and a batch pull dequeues up to
+the requested number of packets with one head update.
+
 You may also use the old element name "FullNoteQueue".
 
 B<Multithreaded Click note:> Queue is designed to be used in an environment
@@ -80,6 +84,8 @@ class FullNoteQueue : public NotifierQueue { public:
 
     void push(int port, Packet *p);
     Packet *pull(int port);
+    void push_batch(int port, PacketBatch &batch);
+    PacketBatch pull_batch(int port, unsigned max);
 
   protected:
 
@@ -40,6 +40,14 @@ Strip::simple_action(Packet *p)
     return p;
 }
 
+void
+Strip::push_batch(int, PacketBatch &batch)
+{
+    for (Packet *p = batch.front(); p; p = p->next())
+	p->pull(_nbytes);
+    output(0).push_batch(batch);
+}
+
 CLICK_ENDDECLS
 EXPORT_ELEMENT(Strip)
 ELEMENT_MT_SAFE(Strip)
@@ -28,6 +28,7 @@ class Strip : public Element { public:
     int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
 
     Packet *simple_action(Packet *);
+    void push_batch(int port, PacketBatch &batch);
 
   private:
 
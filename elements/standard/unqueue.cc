@@ -61,26 +61,20 @@ Unqueue::run_task(Task *)
     if (!_active)
 	return false;
 
-    int worked = 0, limit = _burst;
+    int limit = _burst;
     if (_limit >= 0 && _count + limit >= (uint32_t) _limit) {
 	limit = _limit - _count;
 	if (limit <= 0)
 	    return false;
     }
 
-    while (worked < limit && _active) {
-	if (Packet *p = input(0).pull()) {
-	    ++worked;
-	    ++_count;
-	    output(0).push(p);
-	} else if (!_signal)
-	    goto out;
-	else
-	    break;
-    }
+    PacketBatch batch = input(0).pull_batch(limit);
+    int worked = batch.count();
+    _count += worked;
+    output(0).push_batch(batch);
 
-    _task.fast_reschedule();
-  out:
+    if (worked == limit || _signal)
+	_task.fast_reschedule();
     return worked > 0;
 }
 
@@ -19,7 +19,8 @@ pull-to-push converter
 Pulls packets whenever they are available, then pushes them out
 its single output. Pulls a maximum of BURST packets every time
 it is scheduled. Default BURST is 1. If BURST
-is less than 0, pull until nothing comes back.
+is less than 0, pull until nothing comes back. The packets pulled
+in one scheduling are pushed downstream as a single packet batch.
 
 Keyword arguments are:
 
@@ -39,6 +39,16 @@ Unstrip::simple_action(Packet *p)
   return p->push(_nbytes);
 }
 
+void
+Unstrip::push_batch(int, PacketBatch &batch)
+{
+  PacketBatch out;
+  while (Packet *p = batch.pop_front())
+    if (Packet *q = p->push(_nbytes))
+      out.push_back(q);
+  output(0).push_batch(out);
+}
+
 CLICK_ENDDECLS
 EXPORT_ELEMENT(Unstrip)
 ELEMENT_MT_SAFE(Unstrip)
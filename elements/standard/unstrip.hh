@@ -32,6 +32,7 @@ class Unstrip : public Element {
   int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
 
   Packet *simple_action(Packet *);
+  void push_batch(int port, PacketBatch &batch);
 
 };
 
@@ -29,12 +29,14 @@
 CLICK_DECLS
 
 IPRewriter::IPRewriter()
-    : _udp_map(0)
+    : _udp_maps(0), _udp_allocators(0)
 {
 }
 
 IPRewriter::~IPRewriter()
 {
+    delete[] _udp_maps;
+    delete[] _udp_allocators;
 }
 
 void *
@@ -70,7 +72,11 @@ IPRewriter::configure(Vector<String> &conf, ErrorHandler *errh)
     _udp_timeouts[1] *= CLICK_HZ;
     _udp_streaming_timeout *= CLICK_HZ; // IPRewriterBase handles the others
 
-    return TCPRewriter::configure(conf, errh);
+    // TCPRewriter reads SHARDS
+    int r = TCPRewriter::configure(conf, errh);
+    _udp_maps = new Map[_nshards];
+    _udp_allocators = new SizedHashAllocator<sizeof(UDPFlow)>[_nshards];
+    return r;
 }
 
 inline IPRewriterEntry *
@@ -80,7 +86,7 @@ IPRewriter::get_entry(int ip_p, const IPFlowID &flowid, int input)
 	return TCPRewriter::get_entry(ip_p, flowid, input);
     if (ip_p != IP_PROTO_UDP)
 	return 0;
-    IPRewriterEntry *m = _udp_map.get(flowid);
+    IPRewriterEntry *m = _udp_maps[shard_of(flowid)].get(flowid);
     if (!m && (unsigned) input < (unsigned) _input_specs.size()) {
 	IPRewriterInput &is = _input_specs[input];
 	IPFlowID rewritten_flowid = IPFlowID::uninitialized_t();
@@ -98,7 +104,7 @@ IPRewriter::add_flow(int ip_p, const IPFlowID &flowid,
 	return TCPRewriter::add_flow(ip_p, flowid, rewritten_flowid, input);
 
     void *data;
-    if (!(data = _udp_allocator.allocate()))
+    if (!(data = _udp_allocators[shard_of(flowid)].allocate()))
 	return 0;
 
     IPRewriterInput *rwinput = &_input_specs[input];
@@ -106,7 +112,7 @@ IPRewriter::add_flow(int ip_p, const IPFlowID &flowid,
 	(rwinput, flowid, rewritten_flowid, ip_p,
 	 !!_udp_timeouts[1], click_jiffies() + relevant_timeout(_udp_timeouts));
 
-    return store_flow(flow, input, _udp_map, &reply_udp_map(rwinput));
+    return store_flow(flow, input, _udp_maps, reply_udp_maps(rwinput));
 }
 
 void
@@ -128,8 +134,10 @@ IPRewriter::push(int port, Packet *p_in)
     }
 
     IPFlowID flowid(p);
-    HashContainer<IPRewriterEntry> *map = (iph->ip_p == IP_PROTO_TCP ? &_map : &_udp_map);
-    IPRewriterEntry *m = map->get(flowid);
+    int shard = shard_of(flowid);
+    check_gc(shard);
+    Map *maps = (iph->ip_p == IP_PROTO_TCP ? _maps : _udp_maps);
+    IPRewriterEntry *m = maps[shard].get(flowid);
 
     if (!m) {			// create new mapping
 	IPRewriterInput &is = _input_specs.unchecked_at(port);
@@ -171,10 +179,11 @@ IPRewriter::udp_mappings_handler(Element *e, void *)
     IPRewriter *rw = (IPRewriter *)e;
     click_jiffies_t now = click_jiffies();
     StringAccum sa;
-    for (Map::iterator iter = rw->_udp_map.begin(); iter.live(); ++iter) {
-	iter->flow()->unparse(sa, iter->direction(), now);
-	sa << '\n';
-    }
+    for (int s = 0; s < rw->_nshards; ++s)
+	for (Map::iterator iter = rw->_udp_maps[s].begin(); iter.live(); ++iter) {
+	    iter->flow()->unparse(sa, iter->direction(), now);
+	    sa << '\n';
+	}
     return sa.take_string();
 }
 
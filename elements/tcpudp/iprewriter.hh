@@ -158,12 +158,44 @@ UDP connection mappings are guaranteed to exist for I<time> seconds after each s
 
 Reap timed-out connections every I<time> seconds. Default is 15 minutes.
 
+=item REAP_BUDGET I<n>
+
+Reap at most I<n> timed-out connections at a time, so that a large backlog
+of expired mappings does not stall packet processing.  If more remain, the
+rewriter reaps the next I<n> after a millisecond (or, with more than one
+shard, on the shard's next packet) until the backlog is gone.  0 means no
+limit.  Default is 1024.
+
 =item MAPPING_CAPACITY I<capacity>
 
 Set the maximum number of mappings this rewriter can hold to I<capacity>.
 I<Capacity> can either be an integer or the name of another rewriter-like
 element, in which case this element will share the other element's capacity.
 
+=item SHARDS I<n>
+
+Split the mapping table into I<n> shards, each with its own mappings, flow
+set, and share of the capacity, so that up to I<n> threads can rewrite
+packets without locking.  A packet's shard is a symmetric hash of its
+addresses and ports, so both directions of a flow hash alike, and patterns
+choose rewritten ports (or addresses) whose replies hash to the original
+flow's shard.  Each candidate has about a 1 in I<n> chance of hashing to
+the right shard, so patterns should offer many more ports or addresses than
+there are shards.  Patterns that change flows without offering a range to
+choose from, and mappers, are errors with more than one shard.  The
+configuration must send each shard's packets to at most one thread at a
+time; IPRewriterShardSwitch computes the shard for this.  Rewriters that share
+MAPPING_CAPACITY, or that are each other's reply elements, must have the same
+SHARDS.  With more than one shard, the reap timer cannot touch a shard that
+another thread may be using, so it marks each shard, and the shard's next
+packet reaps it.  A shard that receives no packets for a whole REAP_INTERVAL
+is reaped by the timer.  Among rewriters that share MAPPING_CAPACITY, only
+the first one initialized with a nonzero REAP_INTERVAL runs this reaping.
+Handlers that read or change the mapping tables, namely the table, lookup,
+'size', 'reap_backlog', and 'clear' handlers and writes to 'capacity' and the
+pattern handlers, do not synchronize with packet threads.  Use them only when no
+packets are flowing.  Default is 1.
+
 =item DST_ANNO
 
 Boolean. If true, then set the destination IP address annotation on passing
@@ -173,7 +205,7 @@ packets to the rewritten destination address. Default is true.
 
 =h table_size r
 
-Returns the number of mappings in this IPRewriter's tables.
+Returns the number of mappings in this IPRewriter's tables, over all shards.
 
 =h mapping_failures r
 
@@ -193,6 +225,11 @@ space-separated numbers, where the first is the capacity and the second is the
 short-term flow reservation.  When writing, the short-term reservation can be
 omitted; it is then set to the minimum of 50 and one-eighth the capacity.
 
+=h reap_backlog r
+
+Returns the number of timed-out mappings, over all shards, that have not yet
+been reaped.
+
 =h tcp_table read-only
 
 Returns a human-readable description of the IPRewriter's current TCP mapping
@@ -213,7 +250,7 @@ Takes a TCP flow as a space-separated
 and attempts to find a forward mapping for that flow. If found, rewrites the
 flow and returns in the same format.  Otherwise, returns nothing.
 
-=a TCPRewriter, IPAddrRewriter, IPAddrPairRewriter, IPRewriterPatterns,
+=a IPRewriterShardSwitch, TCPRewriter, IPAddrRewriter, IPAddrPairRewriter, IPRewriterPatterns,
 RoundRobinIPMapper, FTPPortMapper, ICMPRewriter, ICMPPingRewriter */
 
 class IPRewriter : public TCPRewriter { public:
@@ -229,11 +266,11 @@ class IPRewriter : public TCPRewriter { public:
     int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
 
     IPRewriterEntry *get_entry(int ip_p, const IPFlowID &flowid, int input);
-    HashContainer<IPRewriterEntry> *get_map(int mapid) {
+    HashContainer<IPRewriterEntry> *get_map(int mapid, int shard) {
 	if (mapid == IPRewriterInput::mapid_default)
-	    return &_map;
+	    return &_maps[shard];
 	else if (mapid == IPRewriterInput::mapid_iprewriter_udp)
-	    return &_udp_map;
+	    return &_udp_maps[shard];
 	else
 	    return 0;
     }
@@ -253,8 +290,8 @@ class IPRewriter : public TCPRewriter { public:
 
   private:
 
-    Map _udp_map;
-    SizedHashAllocator<sizeof(UDPFlow)> _udp_allocator;
+    Map *_udp_maps;		// one per shard
+    SizedHashAllocator<sizeof(UDPFlow)> *_udp_allocators;
     uint32_t _udp_timeouts[2];
     uint32_t _udp_streaming_timeout;
 
@@ -265,9 +302,9 @@ class IPRewriter : public TCPRewriter { public:
 	    return _udp_timeouts[0];
     }
 
-    static inline Map &reply_udp_map(IPRewriterInput *rwinput) {
+    static inline Map *reply_udp_maps(IPRewriterInput *rwinput) {
 	IPRewriter *x = static_cast<IPRewriter *>(rwinput->reply_element);
-	return x->_udp_map;
+	return x->_udp_maps;
     }
     static String udp_mappings_handler(Element *e, void *user_data);
 
@@ -280,9 +317,10 @@ IPRewriter::destroy_flow(IPRewriterFlow *flow)
     if (flow->ip_p() == IP_PROTO_TCP)
 	TCPRewriter::destroy_flow(flow);
     else {
-	unmap_flow(flow, _udp_map, &reply_udp_map(flow->owner()));
+	unmap_flow(flow, _udp_maps, reply_udp_maps(flow->owner()));
+	int shard = flow->shard();
 	flow->~IPRewriterFlow();
-	_udp_allocator.deallocate(flow);
+	_udp_allocators[shard].deallocate(flow);
     }
 }
 
@@ -235,11 +235,13 @@ TCPRewriter::TCPFlow::unparse(StringAccum &sa, bool direction, click_jiffies_t n
 // TCPRewriter
 
 TCPRewriter::TCPRewriter()
+    : _allocators(0)
 {
 }
 
 TCPRewriter::~TCPRewriter()
 {
+    delete[] _allocators;
 }
 
 void *
@@ -271,12 +273,14 @@ TCPRewriter::configure(Vector<String> &conf, ErrorHandler *errh)
 	.read("TCP_DONE_TIMEOUT", SecondsArg(), _tcp_done_timeout)
 	.read("DST_ANNO", dst_anno)
 	.read("REPLY_ANNO", AnnoArg(1), reply_anno).read_status(has_reply_anno)
+	.read("SHARDS", BoundedIntArg(1, (int) max_shards), _nshards)
 	.consume() < 0)
 	return -1;
 
     _annos = (dst_anno ? 1 : 0) + (has_reply_anno ? 2 + (reply_anno << 2) : 0);
     _tcp_data_timeout *= CLICK_HZ; // IPRewriterBase handles the others
     _tcp_done_timeout *= CLICK_HZ;
+    _allocators = new SizedHashAllocator<sizeof(TCPFlow)>[_nshards];
 
     return IPRewriterBase::configure(conf, errh);
 }
@@ -286,14 +290,14 @@ TCPRewriter::add_flow(int /*ip_p*/, const IPFlowID &flowid,
 		      const IPFlowID &rewritten_flowid, int input)
 {
     void *data;
-    if (!(data = _allocator.allocate()))
+    if (!(data = _allocators[shard_of(flowid)].allocate()))
 	return 0;
 
     TCPFlow *flow = new(data) TCPFlow
 	(&_input_specs[input], flowid, rewritten_flowid,
 	 !!_timeouts[1], click_jiffies() + relevant_timeout(_timeouts));
 
-    return store_flow(flow, input, _map);
+    return store_flow(flow, input, _maps);
 }
 
 void
@@ -315,7 +319,9 @@ TCPRewriter::push(int port, Packet *p_in)
     }
 
     IPFlowID flowid(p);
-    IPRewriterEntry *m = _map.get(flowid);
+    int shard = shard_of(flowid);
+    check_gc(shard);
+    IPRewriterEntry *m = _maps[shard].get(flowid);
 
     if (!m) {			// create new mapping
 	IPRewriterInput &is = _input_specs.unchecked_at(port);
@@ -349,11 +355,12 @@ TCPRewriter::tcp_mappings_handler(Element *e, void *)
     TCPRewriter *rw = (TCPRewriter *)e;
     click_jiffies_t now = click_jiffies();
     StringAccum sa;
-    for (Map::iterator iter = rw->_map.begin(); iter.live(); ++iter) {
-	TCPFlow *f = static_cast<TCPFlow *>(iter->flow());
-	f->unparse(sa, iter->direction(), now);
-	sa << '\n';
-    }
+    for (int s = 0; s < rw->_nshards; ++s)
+	for (Map::iterator iter = rw->_maps[s].begin(); iter.live(); ++iter) {
+	    TCPFlow *f = static_cast<TCPFlow *>(iter->flow());
+	    f->unparse(sa, iter->direction(), now);
+	    sa << '\n';
+	}
     return sa.take_string();
 }
 
@@ -372,12 +379,12 @@ TCPRewriter::tcp_lookup_handler(int, String &str, Element *e, const Handler *, E
 	.complete() < 0)
 	return -1;
 
-    HashContainer<IPRewriterEntry> *map = rw->get_map(IPRewriterInput::mapid_default);
+    IPFlowID flow(saddr, htons(sport), daddr, htons(dport));
+    HashContainer<IPRewriterEntry> *map = rw->get_map(IPRewriterInput::mapid_default, rw->shard_of(flow));
     if (!map)
 	return errh->error("no map!");
 
     StringAccum sa;
-    IPFlowID flow(saddr, htons(sport), daddr, htons(dport));
     if (Map::iterator iter = map->find(flow)) {
 	TCPFlow *f = static_cast<TCPFlow *>(iter->flow());
 	const IPFlowID &flowid = f->entry(iter->direction()).rewritten_flowid();
@@ -62,12 +62,22 @@ dropped if an TCPRewriter's mapping table is full of guaranteed flows.
 
 Reap timed-out connections every I<time> seconds. Default is 15 minutes.
 
+=item REAP_BUDGET I<n>
+
+Reap at most I<n> timed-out connections at a time. Default is 1024. See
+IPRewriter.
+
 =item MAPPING_CAPACITY I<capacity>
 
 Set the maximum number of mappings this rewriter can hold to I<capacity>.
 I<Capacity> can either be an integer or the name of another rewriter-like
 element, in which case this element will share the other element's capacity.
 
+=item SHARDS I<n>
+
+Split the mapping table into I<n> shards. Default is 1. See IPRewriter,
+which also lists the handlers that are unsafe with more than one shard.
+
 =item DST_ANNO
 
 Boolean. If true, then set the destination IP address annotation on passing
@@ -175,7 +185,7 @@ class TCPRewriter : public IPRewriterBase { public:
 
  protected:
 
-    SizedHashAllocator<sizeof(TCPFlow)> _allocator;
+    SizedHashAllocator<sizeof(TCPFlow)> *_allocators;	// one per shard
     unsigned _annos;
     uint32_t _tcp_data_timeout;
     uint32_t _tcp_done_timeout;
@@ -197,9 +207,10 @@ class TCPRewriter : public IPRewriterBase { public:
 inline void
 TCPRewriter::destroy_flow(IPRewriterFlow *flow)
 {
-    unmap_flow(flow, _map);
+    unmap_flow(flow, _maps);
+    int shard = flow->shard();
     static_cast<TCPFlow *>(flow)->~TCPFlow();
-    _allocator.deallocate(flow);
+    _allocators[shard].deallocate(flow);
 }
 
 inline tcp_seq_t
@@ -67,11 +67,13 @@ UDPRewriter::UDPFlow::apply(WritablePacket *p, bool direction, unsigned annos)
 }
 
 UDPRewriter::UDPRewriter()
+    : _allocators(0)
 {
 }
 
 UDPRewriter::~UDPRewriter()
 {
+    delete[] _allocators;
 }
 
 void *
@@ -101,6 +103,7 @@ UDPRewriter::configure(Vector<String> &conf, ErrorHandler *errh)
 	.read("UDP_STREAMING_TIMEOUT", SecondsArg(), _udp_streaming_timeout).read_status(has_udp_streaming_timeout)
 	.read("STREAMING_TIMEOUT", SecondsArg(), _udp_streaming_timeout).read_status(has_streaming_timeout)
 	.read("UDP_GUARANTEE", SecondsArg(), _timeouts[1])
+	.read("SHARDS", BoundedIntArg(1, (int) max_shards), _nshards)
 	.consume() < 0)
 	return -1;
 
@@ -108,6 +111,7 @@ UDPRewriter::configure(Vector<String> &conf, ErrorHandler *errh)
     if (!has_udp_streaming_timeout && !has_streaming_timeout)
 	_udp_streaming_timeout = _timeouts[0];
     _udp_streaming_timeout *= CLICK_HZ; // IPRewriterBase handles the others
+    _allocators = new SizedHashAllocator<sizeof(UDPFlow)>[_nshards];
 
     return IPRewriterBase::configure(conf, errh);
 }
@@ -117,14 +121,14 @@ UDPRewriter::add_flow(int ip_p, const IPFlowID &flowid,
 		      const IPFlowID &rewritten_flowid, int input)
 {
     void *data;
-    if (!(data = _allocator.allocate()))
+    if (!(data = _allocators[shard_of(flowid)].allocate()))
 	return 0;
 
     UDPFlow *flow = new(data) UDPFlow
 	(&_input_specs[input], flowid, rewritten_flowid, ip_p,
 	 !!_timeouts[1], click_jiffies() + relevant_timeout(_timeouts));
 
-    return store_flow(flow, input, _map);
+    return store_flow(flow, input, _maps);
 }
 
 void
@@ -149,7 +153,9 @@ UDPRewriter::push(int port, Packet *p_in)
     }
 
     IPFlowID flowid(p);
-    IPRewriterEntry *m = _map.get(flowid);
+    int shard = shard_of(flowid);
+    check_gc(shard);
+    IPRewriterEntry *m = _maps[shard].get(flowid);
 
     if (!m) {			// create new mapping
 	IPRewriterInput &is = _input_specs.unchecked_at(port);
@@ -183,10 +189,11 @@ UDPRewriter::dump_mappings_handler(Element *e, void *)
     UDPRewriter *rw = (UDPRewriter *)e;
     click_jiffies_t now = click_jiffies();
     StringAccum sa;
-    for (Map::iterator iter = rw->_map.begin(); iter.live(); ++iter) {
-	iter->flow()->unparse(sa, iter->direction(), now);
-	sa << '\n';
-    }
+    for (int s = 0; s < rw->_nshards; ++s)
+	for (Map::iterator iter = rw->_maps[s].begin(); iter.live(); ++iter) {
+	    iter->flow()->unparse(sa, iter->direction(), now);
+	    sa << '\n';
+	}
     return sa.take_string();
 }
 
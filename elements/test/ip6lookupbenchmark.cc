@@ -0,0 +1,191 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * ip6lookupbenchmark.{cc,hh} -- benchmark and cross-check IPv6 route tables
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "ip6lookupbenchmark.hh"
+#include <click/glue.hh>
+#include <click/error.hh>
+#include <click/args.hh>
+#include <click/router.hh>
+#include "elements/ip6/ip6routetable.hh"
+CLICK_DECLS
+
+IP6LookupBenchmark::IP6LookupBenchmark()
+    : _mismatches(0)
+{
+}
+
+IP6LookupBenchmark::~IP6LookupBenchmark()
+{
+}
+
+int
+IP6LookupBenchmark::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    _nroutes = 200000;
+    _nlookups = 1000000;
+    _limit = Timestamp(5);
+    _stop = true;
+    if (Args(this, errh).bind(conf)
+	.read("ROUTES", _nroutes)
+	.read("LOOKUPS", _nlookups)
+	.read("LIMIT", _limit)
+	.read("STOP", _stop)
+	.consume() < 0)
+	return -1;
+    for (int i = 0; i < conf.size(); ++i) {
+	IP6RouteTable *t;
+	if (!ElementCastArg("IP6RouteTable").parse(conf[i], t, Args(this, errh)))
+	    return errh->error("argument %d should be an IPv6 routing table", i + 1);
+	_tables.push_back(t);
+    }
+    if (!_tables.size())
+	return errh->error("no routing tables");
+    if (_nroutes <= 0 || _nlookups <= 0)
+	return errh->error("ROUTES and LOOKUPS must be positive");
+    return 0;
+}
+
+IP6Address
+IP6LookupBenchmark::random_address()
+{
+    IP6Address a;
+    uint32_t *d = a.data32();
+    for (int i = 0; i < 4; ++i)
+	d[i] = click_random(0, 0xFFFFFFFFU);
+    d[0] = htonl((ntohl(d[0]) & 0x1FFFFFFFU) | 0x20000000U);
+    return a;
+}
+
+int
+IP6LookupBenchmark::random_prefix_len()
+{
+    // roughly the prefix length mix of a default-free IPv6 table
+    uint32_t r = click_random(0, 99);
+    if (r < 45)
+	return 48;
+    else if (r < 60)
+	return 32;
+    else if (r < 70)
+	return 44;
+    else if (r < 78)
+	return 40;
+    else if (r < 83)
+	return 36;
+    else if (r < 98)
+	return click_random(16, 64);
+    else
+	return click_random(65, 128);
+}
+
+int
+IP6LookupBenchmark::initialize(ErrorHandler *errh)
+{
+    // Prefixes cluster below a few thousand allocation blocks, as real
+    // prefixes cluster below the registries' allocations.
+    Vector<IP6Address> blocks;
+    for (int i = 0; i < 4096; ++i)
+	blocks.push_back(random_address() & IP6Address::make_prefix(20));
+
+    Vector<IP6Address> addrs, masks, gws;
+    Vector<int> ports;
+    for (int i = 0; i < _nroutes; ++i) {
+	int len = random_prefix_len();
+	IP6Address a = random_address();
+	if (len > 20) {
+	    IP6Address block = blocks[click_random(0, blocks.size() - 1)];
+	    a = block | (a & IP6Address::make_inverted_prefix(20));
+	}
+	IP6Address mask = IP6Address::make_prefix(len);
+	addrs.push_back(a & mask);
+	masks.push_back(mask);
+	gws.push_back(click_random(0, 1) ? random_address() : IP6Address());
+	ports.push_back(click_random(0, 255));
+    }
+
+    Vector<IP6Address> keys;
+    for (int i = 0; i < _nlookups; ++i) {
+	IP6Address a = random_address();
+	if (click_random(0, 3)) {
+	    int ri = click_random(0, _nroutes - 1);
+	    a = addrs[ri] | (a & ~masks[ri]);
+	}
+	keys.push_back(a);
+    }
+
+    Vector<int> results0;
+    Vector<IP6Address> gws0;
+    for (int ti = 0; ti < _tables.size(); ++ti) {
+	IP6RouteTable *t = _tables[ti];
+	int noutputs = t->noutputs() ? t->noutputs() : 1;
+
+	Timestamp t0 = Timestamp::now();
+	for (int i = 0; i < _nroutes; ++i)
+	    if (t->add_route(addrs[i], masks[i], gws[i], ports[i] % noutputs, errh) < 0)
+		return -1;
+	Timestamp t1 = Timestamp::now();
+
+	// lookups run in chunks so a slow table can stop early
+	Vector<int> results(_nlookups, -1);
+	Vector<IP6Address> rgws(_nlookups, IP6Address());
+	Timestamp stop = t1 + _limit;
+	int n = 0;
+	while (n < _nlookups) {
+	    int end = n + 1024 < _nlookups ? n + 1024 : _nlookups;
+	    for (; n < end; ++n)
+		results[n] = t->lookup_route(keys[n], rgws[n]);
+	    if (Timestamp::now() >= stop)
+		break;
+	}
+	Timestamp t2 = Timestamp::now();
+
+	click_chatter("%p{element}: %p{element}: %d routes, add %d ns, lookup %d ns, %d lookups",
+		      this, t, _nroutes,
+		      (int) ((t1 - t0).nsecval() / _nroutes),
+		      (int) ((t2 - t1).nsecval() / n), n);
+
+	if (ti == 0) {
+	    results0.swap(results);
+	    gws0.swap(rgws);
+	    results0.resize(n);
+	} else
+	    for (int i = 0; i < n && i < results0.size(); ++i)
+		if (results[i] != results0[i] || rgws[i] != gws0[i])
+		    ++_mismatches;
+    }
+
+    if (_tables.size() > 1)
+	click_chatter("%p{element}: %u mismatches", this, _mismatches);
+    if (_stop)
+	router()->please_stop_driver();
+    return 0;
+}
+
+String
+IP6LookupBenchmark::read_handler(Element *e, void *)
+{
+    IP6LookupBenchmark *b = static_cast<IP6LookupBenchmark *>(e);
+    return String(b->_mismatches);
+}
+
+void
+IP6LookupBenchmark::add_handlers()
+{
+    add_read_handler("mismatches", read_handler, 0);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(IP6RouteTable)
+EXPORT_ELEMENT(IP6LookupBenchmark)
@@ -0,0 +1,219 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * selectsettest.{cc,hh} -- regression test element for SelectSet
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "selectsettest.hh"
+#include <click/error.hh>
+#include <click/args.hh>
+#include <click/selectset.hh>
+#include <click/master.hh>
+#include <click/standard/scheduleinfo.hh>
+#include <click/timestamp.hh>
+#include <sys/resource.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+CLICK_DECLS
+
+SelectSetTest::SelectSetTest()
+    : _task(this), _benchmark(0), _active(1), _rounds(1000)
+{
+}
+
+int
+SelectSetTest::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    if (Args(conf, this, errh)
+	.read("BENCHMARK", _benchmark)
+	.read("ACTIVE", _active)
+	.read("ROUNDS", _rounds)
+	.complete() < 0)
+	return -1;
+    if (_benchmark > 0 && (_active < 1 || _active > _benchmark))
+	return errh->error("ACTIVE must be between 1 and BENCHMARK");
+    return 0;
+}
+
+void
+SelectSetTest::selected(int fd, int mask)
+{
+    ++_nselected;
+    _selected_fd = fd;
+    _selected_mask = mask;
+}
+
+void
+SelectSetTest::run(SelectSet &ss)
+{
+    // wake_immediate() guarantees run_selects() returns even if no test
+    // file descriptor is ready
+    _nselected = 0;
+    _selected_fd = _selected_mask = -1;
+    ss.wake_immediate();
+    ss.run_selects(home_thread());
+}
+
+#define CHECK(x) if (!(x)) return errh->error("%s:%d: %s: test %<%s%> failed", __FILE__, __LINE__, ss.mechanism(), #x);
+
+int
+SelectSetTest::test(SelectSet &ss, ErrorHandler *errh)
+{
+    int p[2];
+    if (pipe(p) < 0)
+	return errh->error("pipe: %s", strerror(errno));
+    fcntl(p[0], F_SETFL, O_NONBLOCK);
+
+    CHECK(ss.add_select(p[0], this, SELECT_READ) == 0);
+    CHECK(ss.add_select(p[0], this, SELECT_READ) == 0);
+    run(ss);
+    CHECK(_nselected == 0);
+
+    CHECK(write(p[1], "x", 1) == 1);
+    run(ss);
+    CHECK(_nselected == 1);
+    CHECK(_selected_fd == p[0] && _selected_mask == SELECT_READ);
+    // level-triggered: still readable until drained
+    run(ss);
+    CHECK(_nselected == 1);
+
+    CHECK(ss.add_select(p[1], this, SELECT_WRITE) == 0);
+    run(ss);
+    CHECK(_nselected == 2);
+
+    CHECK(ss.remove_select(p[0], this, SELECT_READ) == 0);
+    CHECK(ss.remove_select(p[0], this, SELECT_READ) == -1);
+    run(ss);
+    CHECK(_nselected == 1);
+    CHECK(_selected_fd == p[1] && _selected_mask == SELECT_WRITE);
+
+    CHECK(ss.add_select(p[0], this, SELECT_READ) == 0);
+    char c;
+    CHECK(read(p[0], &c, 1) == 1);
+    CHECK(ss.remove_select(p[1], this, SELECT_WRITE) == 0);
+    run(ss);
+    CHECK(_nselected == 0);
+
+    CHECK(ss.remove_select(p[0], this, SELECT_READ) == 0);
+    close(p[0]);
+    close(p[1]);
+    return 0;
+}
+
+#undef CHECK
+
+int
+SelectSetTest::benchmark(SelectSet &ss, const Vector<int> &fds, ErrorHandler *errh)
+{
+    for (int i = 0; i < fds.size(); ++i)
+	if (ss.add_select(fds[i], this, SELECT_READ) < 0)
+	    return errh->error("%s: cannot add fd %d", ss.mechanism(), fds[i]);
+
+    _nselected = 0;
+    Timestamp start = Timestamp::now_steady();
+    for (int r = 0; r < _rounds; ++r)
+	ss.run_selects(home_thread());
+    Timestamp delta = Timestamp::now_steady() - start;
+
+    errh->message("%s: %d fds, %d active, %d rounds: %p{timestamp}s", ss.mechanism(), _benchmark, _active, _rounds, &delta);
+    if (_nselected != _active * _rounds)
+	errh->warning("%s: %d events, expected %d", ss.mechanism(), _nselected, _active * _rounds);
+
+    for (int i = 0; i < fds.size(); ++i)
+	ss.remove_select(fds[i], this, SELECT_READ);
+    return 0;
+}
+
+int
+SelectSetTest::initialize(ErrorHandler *)
+{
+    // The master is paused during initialization, and a paused SelectSet
+    // never waits, so run the tests from a task.
+    ScheduleInfo::initialize_task(this, &_task, true, ErrorHandler::default_handler());
+    return 0;
+}
+
+bool
+SelectSetTest::run_task(Task *)
+{
+    ErrorHandler *errh = ErrorHandler::default_handler();
+
+    // Benchmark descriptors: ACTIVE readable pipes, plus dup()s of one idle
+    // pipe's read end, so that BENCHMARK descriptors cost about BENCHMARK
+    // file table entries.
+    Vector<int> fds, to_close;
+    int r = 0;
+    if (_benchmark > 0) {
+	struct rlimit rl;
+	rlim_t want = _benchmark + _active + 64;
+	if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < want) {
+	    rl.rlim_cur = (rl.rlim_max == RLIM_INFINITY || rl.rlim_max > want ? want : rl.rlim_max);
+	    setrlimit(RLIMIT_NOFILE, &rl);
+	}
+	int p[2];
+	for (int i = 0; i <= _active && r >= 0; ++i)
+	    if (pipe(p) < 0)
+		r = errh->error("pipe: %s", strerror(errno));
+	    else {
+		to_close.push_back(p[0]);
+		to_close.push_back(p[1]);
+		if (i < _active) {
+		    fds.push_back(p[0]);
+		    ignore_result(write(p[1], "x", 1));
+		}
+	    }
+	while (fds.size() < _benchmark && r >= 0) {
+	    int fd = dup(to_close[2 * _active]);
+	    if (fd < 0)
+		r = errh->error("dup: %s", strerror(errno));
+	    else {
+		fds.push_back(fd);
+		to_close.push_back(fd);
+	    }
+	}
+    }
+
+    const char *first_mechanism = 0;
+    for (int variant = 0; variant < 2 && r >= 0; ++variant) {
+	SelectSet ss;
+	if (variant == 1) {
+#if HAVE_ALLOW_EPOLL
+	    // rerun with the poll or select fallback
+	    if (strcmp(first_mechanism, "epoll") != 0)
+		break;
+	    ss.disable_epoll();
+#else
+	    break;
+#endif
+	}
+	ss.initialize();
+	first_mechanism = ss.mechanism();
+	if (_benchmark > 0)
+	    r = benchmark(ss, fds, errh);
+	else
+	    r = test(ss, errh);
+    }
+
+    for (int i = 0; i < to_close.size(); ++i)
+	close(to_close[i]);
+    if (r >= 0 && _benchmark <= 0)
+	errh->message("All tests pass!");
+    router()->please_stop_driver();
+    return true;
+}
+
+EXPORT_ELEMENT(SelectSetTest)
+ELEMENT_REQUIRES(userlevel)
+CLICK_ENDDECLS
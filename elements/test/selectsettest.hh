@@ -0,0 +1,87 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_SELECTSETTEST_HH
+#define CLICK_SELECTSETTEST_HH
+#include <click/element.hh>
+#include <click/task.hh>
+CLICK_DECLS
+class SelectSet;
+
+/*
+=c
+
+SelectSetTest([I<keywords> BENCHMARK, ACTIVE, ROUNDS])
+
+=s test
+
+runs regression tests for SelectSet
+
+=d
+
+SelectSetTest runs regression tests for Click's SelectSet class once the
+router starts running, then stops the driver.  The tests run once for each
+available mechanism for waiting on file descriptors; on Linux, that is epoll
+and poll.  SelectSetTest does not route packets.
+
+Keyword arguments are:
+
+=over 8
+
+=item BENCHMARK
+
+Integer.  If positive, then SelectSetTest runs a benchmark instead of the
+regression tests.  The benchmark registers BENCHMARK file descriptors for
+reading, makes ACTIVE of them readable, and times ROUNDS waits with each
+available mechanism.  Default is 0 (no benchmark).
+
+=item ACTIVE
+
+Integer.  The number of readable pipes during the benchmark.  Default is 1.
+
+=item ROUNDS
+
+Integer.  The number of waits timed by the benchmark.  Default is 1000.
+
+=back
+
+=e
+
+  SelectSetTest(BENCHMARK 10000, ACTIVE 10)
+
+might print
+
+  epoll: 10000 fds, 10 active, 1000 rounds: 0.001251s
+  poll: 10000 fds, 10 active, 1000 rounds: 0.083516s
+
+*/
+
+class SelectSetTest : public Element { public:
+
+    SelectSetTest() CLICK_COLD;
+
+    const char *class_name() const		{ return "SelectSetTest"; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh) CLICK_COLD;
+    int initialize(ErrorHandler *errh) CLICK_COLD;
+
+    bool run_task(Task *task);
+    void selected(int fd, int mask);
+
+  private:
+
+    Task _task;
+    int _benchmark;
+    int _active;
+    int _rounds;
+
+    int _nselected;
+    int _selected_fd;
+    int _selected_mask;
+
+    void run(SelectSet &ss);
+    int test(SelectSet &ss, ErrorHandler *errh);
+    int benchmark(SelectSet &ss, const Vector<int> &fds, ErrorHandler *errh);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,192 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * timerstress.{cc,hh} -- benchmark and check large numbers of timers
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "timerstress.hh"
+#include <click/glue.hh>
+#include <click/error.hh>
+#include <click/args.hh>
+#include <click/router.hh>
+#include <click/master.hh>
+CLICK_DECLS
+
+TimerStress::TimerStress()
+    : _end_timer(this), _timers(0), _fires(0), _early(0), _misordered(0)
+{
+}
+
+TimerStress::~TimerStress()
+{
+}
+
+int
+TimerStress::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    String mode;
+    _ntimers = 100000;
+    _noperations = -1;
+    _span = Timestamp(1);
+    _duration = Timestamp(1);
+    _stop = true;
+    if (Args(conf, this, errh)
+	.read("TIMERS", _ntimers)
+	.read("OPERATIONS", _noperations)
+	.read("SPAN", _span)
+	.read("DURATION", _duration)
+	.read("MODE", WordArg(), mode)
+	.read("STOP", _stop)
+	.complete() < 0)
+	return -1;
+    if (_ntimers <= 0)
+	return errh->error("TIMERS must be positive");
+    if (_noperations < 0)
+	_noperations = 10 * _ntimers;
+    if (!_span)
+	return errh->error("SPAN must be positive");
+    if (!mode)
+	_mode = -1;
+    else if (mode == "HEAP")
+	_mode = TimerSet::mode_heap;
+    else if (mode == "WHEEL")
+	_mode = TimerSet::mode_wheel;
+    else
+	return errh->error("bad MODE");
+    return 0;
+}
+
+inline const Timestamp &
+TimerStress::next_delay()
+{
+    if (++_next_delay == _delays.size())
+	_next_delay = 0;
+    return _delays[_next_delay];
+}
+
+int
+TimerStress::initialize(ErrorHandler *errh)
+{
+    _end_timer.initialize(this);
+    TimerSet &ts = _end_timer.thread()->timer_set();
+    if (_mode >= 0)
+	ts.set_mode(_mode);
+
+    // precompute random delays so the timings measure only the TimerSet
+    _delays.resize(_ntimers * 4);
+    uint32_t span_usec = _span.usecval();
+    for (Timestamp *dp = _delays.begin(); dp != _delays.end(); ++dp)
+	*dp = Timestamp::make_usec(click_random(0, span_usec));
+    _next_delay = 0;
+
+    _timers = new Timer[_ntimers];
+    if (!_timers)
+	return errh->error("out of memory");
+    for (int i = 0; i < _ntimers; ++i) {
+	_timers[i].assign(fire_hook, this);
+	_timers[i].initialize(this);
+    }
+
+    Timestamp now = Timestamp::now_steady();
+    Timestamp t0 = Timestamp::now();
+    for (int i = 0; i < _ntimers; ++i)
+	_timers[i].schedule_at_steady(now + next_delay());
+    Timestamp t1 = Timestamp::now();
+    for (int i = 0; i < _noperations; ++i)
+	_timers[click_random(0, _ntimers - 1)].schedule_at_steady(now + next_delay());
+    Timestamp t2 = Timestamp::now();
+    // refreshes push timers past all others, like per-flow timeouts
+    Timestamp refresh = now + _span;
+    for (int i = 0; i < _noperations; ++i) {
+	refresh += Timestamp::epsilon();
+	_timers[click_random(0, _ntimers - 1)].schedule_at_steady(refresh);
+    }
+    Timestamp t3 = Timestamp::now();
+    for (int i = 0; i < _ntimers; ++i)
+	_timers[i].unschedule();
+    Timestamp t4 = Timestamp::now();
+
+    int nops = _noperations ? _noperations : 1;
+    click_chatter("%p{element}: %s, %d timers: schedule %d ns, reschedule %d ns, refresh %d ns, unschedule %d ns",
+		  this, ts.mode() == TimerSet::mode_wheel ? "WHEEL" : "HEAP", _ntimers,
+		  (int) ((t1 - t0).nsecval() / _ntimers),
+		  (int) ((t2 - t1).nsecval() / nops),
+		  (int) ((t3 - t2).nsecval() / nops),
+		  (int) ((t4 - t3).nsecval() / _ntimers));
+
+    if (_duration) {
+	now = Timestamp::now_steady();
+	for (int i = 0; i < _ntimers; ++i)
+	    _timers[i].schedule_at_steady(now + next_delay());
+	_end_timer.schedule_at_steady(now + _duration);
+    } else
+	run_timer(&_end_timer);
+    return 0;
+}
+
+void
+TimerStress::fire_hook(Timer *t, void *user_data)
+{
+    TimerStress *ts = static_cast<TimerStress *>(user_data);
+    Timestamp now = Timestamp::now_steady();
+    ++ts->_fires;
+    if (now < t->expiry_steady())
+	++ts->_early;
+    if (t->expiry_steady() < ts->_last_expiry)
+	++ts->_misordered;
+    ts->_last_expiry = t->expiry_steady();
+    t->schedule_at_steady(now + ts->next_delay());
+}
+
+void
+TimerStress::run_timer(Timer *)
+{
+    for (int i = 0; i < _ntimers; ++i)
+	_timers[i].unschedule();
+    click_chatter("%p{element}: %u fires, %u early, %u out of order",
+		  this, _fires, _early, _misordered);
+    if (_stop)
+	router()->please_stop_driver();
+}
+
+void
+TimerStress::cleanup(CleanupStage)
+{
+    delete[] _timers;
+    _timers = 0;
+}
+
+String
+TimerStress::read_handler(Element *e, void *user_data)
+{
+    TimerStress *ts = static_cast<TimerStress *>(e);
+    switch ((uintptr_t) user_data) {
+    case 0:
+	return String(ts->_fires);
+    case 1:
+	return String(ts->_early);
+    default:
+	return String(ts->_misordered);
+    }
+}
+
+void
+TimerStress::add_handlers()
+{
+    add_read_handler("fires", read_handler, 0);
+    add_read_handler("early", read_handler, 1);
+    add_read_handler("misordered", read_handler, 2);
+}
+
+CLICK_ENDDECLS
+EXPORT_ELEMENT(TimerStress)
@@ -0,0 +1,124 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_TIMERSTRESS_HH
+#define CLICK_TIMERSTRESS_HH
+#include <click/element.hh>
+#include <click/timer.hh>
+CLICK_DECLS
+
+/*
+=c
+
+TimerStress([I<keywords>])
+
+=s test
+
+benchmarks and checks large numbers of timers
+
+=d
+
+TimerStress measures how fast its thread's TimerSet schedules, reschedules,
+and unschedules TIMERS timers, then checks how they fire.
+
+At initialization, TimerStress schedules every timer at a random time within
+SPAN, performs OPERATIONS random reschedules, and unschedules every timer,
+timing each phase.  It then schedules the timers again and lets the router
+run for DURATION.  Each timer reschedules itself a random time within SPAN
+after firing, much like a per-flow timeout that is refreshed by traffic.
+TimerStress counts timers that fire before their expiration time, or before
+a timer that expires earlier; both counts should be zero.  At the end it
+prints a report, such as:
+
+   ts :: TimerStress: WHEEL, 100000 timers: schedule 52 ns, reschedule 60 ns, unschedule 21 ns
+   ts :: TimerStress: 49877 fires, 0 early, 0 out of order
+
+TimerStress does not route packets.
+
+Keyword arguments are:
+
+=over 8
+
+=item TIMERS
+
+Integer. Number of timers. Defaults to 100000.
+
+=item OPERATIONS
+
+Integer. Number of reschedules to time. Defaults to 10 times TIMERS.
+
+=item SPAN
+
+Timestamp. Timers are scheduled up to SPAN in the future. Defaults to 1s.
+
+=item DURATION
+
+Timestamp. How long to let timers fire. Defaults to 1s; 0 means skip this
+phase.
+
+=item MODE
+
+Either HEAP or WHEEL. If set, switch the thread's TimerSet to this mode
+before starting. Defaults to the TimerSet's current mode.
+
+=item STOP
+
+Boolean. If true, stop the driver after the report. Defaults to true.
+
+=back
+
+=h fires read-only
+
+Returns the number of timer fires so far.
+
+=h early read-only
+
+Returns the number of timers that fired before their expiration time.
+
+=h misordered read-only
+
+Returns the number of timers that fired before an earlier-expiring timer.
+
+=a
+
+TimerTest, click(1) --timer-wheel */
+
+class TimerStress : public Element { public:
+
+    TimerStress() CLICK_COLD;
+    ~TimerStress() CLICK_COLD;
+
+    const char *class_name() const		{ return "TimerStress"; }
+
+    int configure(Vector<String> &conf, ErrorHandler *errh) CLICK_COLD;
+    int initialize(ErrorHandler *errh) CLICK_COLD;
+    void cleanup(CleanupStage stage) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
+
+    void run_timer(Timer *t);
+
+  private:
+
+    Timer _end_timer;
+    Timer *_timers;
+    int _ntimers;
+    int _noperations;
+    int _mode;
+    Timestamp _span;
+    Timestamp _duration;
+    bool _stop;
+
+    Vector<Timestamp> _delays;
+    int _next_delay;
+
+    uint32_t _fires;
+    uint32_t _early;
+    uint32_t _misordered;
+    Timestamp _last_expiry;
+
+    inline const Timestamp &next_delay();
+    static void fire_hook(Timer *t, void *user_data);
+    static String read_handler(Element *e, void *user_data) CLICK_COLD;
+
+};
+
+CLICK_ENDDECLS
+#endif
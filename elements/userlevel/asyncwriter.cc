@@ -0,0 +1,450 @@
+// -*- c-basic-offset: 4 -*-
+/*
+ * asyncwriter.{cc,hh} -- buffered, optionally asynchronous trace file writer
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "asyncwriter.hh"
+#include <click/args.hh>
+#include <click/error.hh>
+#include <click/element.hh>
+#include <click/userutils.hh>
+CLICK_DECLS
+
+AsyncWriter::AsyncWriter()
+    : _f(0), _pipe(false), _async(false), _block(false),
+      _buffer_size(1048576), _max_buffered(16777216), _rotate_size(0),
+      _file(0), _file_bytes(0), _drops(0), _rotations(0), _fill(0)
+{
+    _errno = 0;
+#if HAVE_USER_MULTITHREAD
+    pthread_mutex_init(&_lock, 0);
+    pthread_cond_init(&_cond, 0);
+    _running = _stop = false;
+    _queue_head = _free = 0;
+    _queue_tail = &_queue_head;
+    _nbuffers = _max_buffers = 0;
+    _queued = 0;
+    _written_file = 0;
+#endif
+}
+
+int
+AsyncWriter::configure_keywords(Vector<String> &conf, Element *e, ErrorHandler *errh)
+{
+    if (Args(e, errh).bind(conf)
+	.read("ASYNC", _async)
+	.read("BLOCK", _block)
+	.read("BUFFER_SIZE", _buffer_size)
+	.read("MAX_BUFFERED", _max_buffered)
+	.read("ROTATE_SIZE", _rotate_size)
+	.read("ROTATE_INTERVAL", _rotate_interval)
+	.consume() < 0)
+	return -1;
+#if !HAVE_USER_MULTITHREAD
+    if (_async)
+	return errh->error("ASYNC requires multithreaded Click");
+#endif
+    if (_buffer_size < 4096)
+	_buffer_size = 4096;
+    if (_max_buffered < 2 * _buffer_size)
+	_max_buffered = 2 * _buffer_size;
+    return 0;
+}
+
+FILE *
+AsyncWriter::open_file(uint32_t file)
+{
+    String name = _base_filename;
+    if (file)
+	name += "." + String(file);
+    return fopen(name.c_str(), "wb");
+}
+
+int
+AsyncWriter::initialize(const String &filename, bool allow_compress, ErrorHandler *errh)
+{
+    assert(!_f);
+    _base_filename = _filename = filename;
+    if (filename == "-") {
+	_f = stdout;
+	_filename = "<stdout>";
+    } else if (allow_compress && compressed_filename(filename) > 0) {
+	_f = open_compress_pipe(filename, errh);
+	_pipe = true;
+    } else
+	_f = open_file(0);
+    if (!_f)
+	return errh->error("%s: %s", _filename.c_str(), strerror(errno));
+    if ((_rotate_size || _rotate_interval) && (_f == stdout || _pipe))
+	return errh->error("%s: cannot rotate output", _filename.c_str());
+    if (_rotate_interval)
+	_rotate_at = Timestamp::now_steady() + _rotate_interval;
+#if HAVE_USER_MULTITHREAD
+    if (_async)
+	start_thread();
+#endif
+    return 0;
+}
+
+void
+AsyncWriter::set_header(const String &header)
+{
+    _header = header;
+    if (header)
+	write(header.data(), header.length());
+}
+
+void
+AsyncWriter::check_rotate(size_t len)
+{
+    if (_file_bytes <= (uint64_t) _header.length())
+	return;
+    if (_rotate_size && _file_bytes + len > _rotate_size)
+	/* rotate */;
+    else if (_rotate_interval && Timestamp::recent_steady() >= _rotate_at)
+	/* rotate */;
+    else
+	return;
+
+    if (_rotate_interval)
+	_rotate_at = Timestamp::recent_steady() + _rotate_interval;
+    ++_file;
+    ++_rotations;
+    _file_bytes = 0;
+#if HAVE_USER_MULTITHREAD
+    if (_running) {
+	pthread_mutex_lock(&_lock);
+	if (_fill && _fill->len)
+	    queue_fill();
+	else if (_fill)
+	    _fill->file = _file;
+	if (_header)
+	    append(_header.data(), _header.length(), 0, 0);
+	pthread_mutex_unlock(&_lock);
+	return;
+    }
+#endif
+    FILE *f = open_file(_file);
+    if (!f) {
+	_errno = errno;
+	return;
+    }
+    fclose(_f);
+    _f = f;
+    if (_header)
+	write_direct(_header.data(), _header.length(), 0, 0);
+}
+
+int
+AsyncWriter::write_direct(const void *a, size_t alen, const void *b, size_t blen)
+{
+    if ((alen && fwrite(a, 1, alen, _f) != alen)
+	|| (blen && fwrite(b, 1, blen, _f) != blen)) {
+	if (errno == EAGAIN) {
+	    ++_drops;
+	    return 0;
+	}
+	_errno = errno;
+	return -1;
+    }
+    _file_bytes += alen + blen;
+    return 1;
+}
+
+int
+AsyncWriter::write(const void *a, size_t alen, const void *b, size_t blen)
+{
+#if HAVE_USER_MULTITHREAD
+    // While the writer thread runs, it owns _f; check only its error.
+    if (_running) {
+	if (unlikely(_errno.value()))
+	    return -1;
+	if (_rotate_size || _rotate_interval)
+	    check_rotate(alen + blen);
+	// flush() may queue _fill from another thread, so touch it only
+	// under _lock.
+	size_t len = alen + blen;
+	int r = 1;
+	pthread_mutex_lock(&_lock);
+	if ((!_fill || _fill->cap - _fill->len < len)
+	    && !next_fill(len, false)) {
+	    ++_drops;
+	    r = _errno ? -1 : 0;
+	} else
+	    append(a, alen, b, blen);
+	pthread_mutex_unlock(&_lock);
+	return r;
+    }
+#endif
+    if (unlikely(_errno.value()) || !_f)
+	return -1;
+    if (_rotate_size || _rotate_interval) {
+	check_rotate(alen + blen);
+	if (unlikely(_errno.value()))
+	    return -1;
+    }
+    return write_direct(a, alen, b, blen);
+}
+
+int
+AsyncWriter::flush()
+{
+#if HAVE_USER_MULTITHREAD
+    if (_running) {
+	pthread_mutex_lock(&_lock);
+	if (_fill && _fill->len)
+	    queue_fill();
+	while (_queued && !_errno)
+	    pthread_cond_wait(&_cond, &_lock);
+	pthread_mutex_unlock(&_lock);
+	return _errno ? -1 : 0;
+    }
+#endif
+    if (_f && fflush(_f) != 0)
+	_errno = errno;
+    return _errno ? -1 : 0;
+}
+
+String
+AsyncWriter::error() const
+{
+    return String(strerror(_errno.value()));
+}
+
+#if HAVE_USER_MULTITHREAD
+// Appends a record to the fill buffer.  Must be called with _lock held.
+void
+AsyncWriter::append(const void *a, size_t alen, const void *b, size_t blen)
+{
+    if ((!_fill || _fill->cap - _fill->len < alen + blen)
+	&& !next_fill(alen + blen, true)) {
+	++_drops;
+	return;
+    }
+    memcpy(_fill->data + _fill->len, a, alen);
+    if (blen)
+	memcpy(_fill->data + _fill->len + alen, b, blen);
+    _fill->len += alen + blen;
+    _file_bytes += alen + blen;
+}
+
+// Hands the fill buffer to the writer thread.  Must be called with _lock
+// held.
+void
+AsyncWriter::queue_fill()
+{
+    Buffer *b = _fill;
+    _fill = 0;
+    b->next = 0;
+    *_queue_tail = b;
+    _queue_tail = &b->next;
+    _queued += b->len;
+    pthread_cond_broadcast(&_cond);
+}
+
+/* Replaces the fill buffer with an empty one that can hold @a len bytes.
+   Returns false if none is available; with @a force, exceeds MAX_BUFFERED
+   rather than fail.  Must be called with _lock held. */
+bool
+AsyncWriter::next_fill(size_t len, bool force)
+{
+    if (_fill && _fill->len)
+	queue_fill();
+    if (!_fill) {
+	while (!_free && _nbuffers >= _max_buffers && !force
+	       && _block && !_errno)
+	    pthread_cond_wait(&_cond, &_lock);
+	if (_free) {
+	    _fill = _free;
+	    _free = _fill->next;
+	} else if (_nbuffers < _max_buffers || force) {
+	    if ((_fill = new Buffer)) {
+		_fill->data = 0;
+		_fill->cap = 0;
+		++_nbuffers;
+	    }
+	}
+	if (_fill)
+	    _fill->len = 0;
+    }
+
+    if (_fill && _fill->cap < len) {
+	size_t cap = len > _buffer_size ? len : _buffer_size;
+	char *data = (char *) realloc(_fill->data, cap);
+	if (!data)
+	    return false;
+	_fill->data = data;
+	_fill->cap = cap;
+    }
+    if (_fill)
+	_fill->file = _file;
+    return _fill != 0;
+}
+
+void *
+AsyncWriter::thread_main(void *arg)
+{
+    AsyncWriter *w = static_cast<AsyncWriter *>(arg);
+    pthread_mutex_lock(&w->_lock);
+    while (1) {
+	Buffer *b = w->_queue_head;
+	if (!b) {
+	    if (w->_stop)
+		break;
+	    pthread_cond_wait(&w->_cond, &w->_lock);
+	    continue;
+	}
+	if (!(w->_queue_head = b->next))
+	    w->_queue_tail = &w->_queue_head;
+	int err = w->_errno.value();
+	pthread_mutex_unlock(&w->_lock);
+
+	if (!err && b->file != w->_written_file) {
+	    if (FILE *f = w->open_file(b->file)) {
+		fclose(w->_f);
+		w->_f = f;
+		w->_written_file = b->file;
+	    } else
+		err = errno;
+	}
+	if (!err && (fwrite(b->data, 1, b->len, w->_f) != b->len
+		     || fflush(w->_f) != 0))
+	    err = errno;
+
+	pthread_mutex_lock(&w->_lock);
+	if (err && !w->_errno)
+	    w->_errno = err;
+	w->_queued -= b->len;
+	b->next = w->_free;
+	w->_free = b;
+	pthread_cond_broadcast(&w->_cond);
+    }
+    pthread_mutex_unlock(&w->_lock);
+    return 0;
+}
+
+void
+AsyncWriter::start_thread()
+{
+    _max_buffers = _max_buffered / _buffer_size;
+    _written_file = _file;
+    _stop = false;
+    if (pthread_create(&_thread, 0, thread_main, this) == 0)
+	_running = true;
+}
+
+// Writes all queued records and stops the writer thread.
+void
+AsyncWriter::stop_thread()
+{
+    if (!_running)
+	return;
+    pthread_mutex_lock(&_lock);
+    if (_fill && _fill->len)
+	queue_fill();
+    _stop = true;
+    pthread_cond_broadcast(&_cond);
+    pthread_mutex_unlock(&_lock);
+    pthread_join(_thread, 0);
+    _running = false;
+    _file = _written_file;
+}
+#endif
+
+void
+AsyncWriter::cleanup()
+{
+#if HAVE_USER_MULTITHREAD
+    stop_thread();
+    while (Buffer *b = _free) {
+	_free = b->next;
+	free(b->data);
+	delete b;
+    }
+    _nbuffers = 0;
+#endif
+    if (_fill) {
+	free(_fill->data);
+	delete _fill;
+	_fill = 0;
+    }
+    if (_f && _f != stdout)
+	fclose(_f);
+    _f = 0;
+}
+
+void
+AsyncWriter::take_state(AsyncWriter &o)
+{
+#if HAVE_USER_MULTITHREAD
+    o.stop_thread();
+#endif
+    _f = o._f;
+    o._f = 0;
+    _filename = o._filename;
+    _base_filename = o._base_filename;
+    _pipe = o._pipe;
+    _header = o._header;
+    _file = o._file;
+    _file_bytes = o._file_bytes;
+    _rotate_at = o._rotate_at;
+    _drops = o._drops;
+    _rotations = o._rotations;
+    _errno = o._errno.value();
+#if HAVE_USER_MULTITHREAD
+    if (_async && _f)
+	start_thread();
+#endif
+}
+
+String
+AsyncWriter::queued_handler(Element *e, void *thunk)
+{
+    AsyncWriter *w = reinterpret_cast<AsyncWriter *>((uint8_t *)e + (intptr_t)thunk);
+#if HAVE_USER_MULTITHREAD
+    pthread_mutex_lock(&w->_lock);
+    uint64_t queued = (w->_fill ? w->_fill->len : 0) + w->_queued;
+    pthread_mutex_unlock(&w->_lock);
+#else
+    uint64_t queued = w->_fill ? w->_fill->len : 0;
+#endif
+    return String(queued);
+}
+
+String
+AsyncWriter::drops_handler(Element *e, void *thunk)
+{
+    AsyncWriter *w = reinterpret_cast<AsyncWriter *>((uint8_t *)e + (intptr_t)thunk);
+    return String(w->_drops);
+}
+
+String
+AsyncWriter::rotations_handler(Element *e, void *thunk)
+{
+    AsyncWriter *w = reinterpret_cast<AsyncWriter *>((uint8_t *)e + (intptr_t)thunk);
+    return String(w->_rotations);
+}
+
+void
+AsyncWriter::add_handlers(Element *e) const
+{
+    intptr_t offset = (const uint8_t *)this - (const uint8_t *)e;
+    e->add_read_handler("queued_bytes", queued_handler, (void *)offset);
+    e->add_read_handler("write_drops", drops_handler, (void *)offset);
+    e->add_read_handler("rotations", rotations_handler, (void *)offset);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel|ns)
+ELEMENT_PROVIDES(AsyncWriter)
@@ -0,0 +1,121 @@
+// -*- c-basic-offset: 4 -*-
+#ifndef CLICK_ASYNCWRITER_HH
+#define CLICK_ASYNCWRITER_HH
+#include <click/string.hh>
+#include <click/vector.hh>
+#include <click/timestamp.hh>
+#include <click/atomic.hh>
+#include <stdio.h>
+#if HAVE_USER_MULTITHREAD
+# include <pthread.h>
+#endif
+CLICK_DECLS
+class ErrorHandler;
+class Element;
+
+/* Writes trace records to a file for ToDump and ToIPSummaryDump.
+
+   By default, records go through stdio from the calling thread.  With ASYNC,
+   records are appended to large buffers, and a separate thread writes full
+   buffers to the file, so a slow disk stalls only that thread.  At most
+   MAX_BUFFERED bytes of buffers exist at once; when they are all full, a
+   record is dropped, or, with BLOCK, the caller waits.
+
+   ROTATE_SIZE and ROTATE_INTERVAL start new files named FILENAME.1,
+   FILENAME.2, and so forth.  Each new file starts with the header supplied
+   to set_header().  Records are never split across files. */
+class AsyncWriter { public:
+
+    AsyncWriter();
+    ~AsyncWriter()			{ cleanup(); }
+
+    int configure_keywords(Vector<String> &conf, Element *, ErrorHandler *);
+    int initialize(const String &filename, bool allow_compress, ErrorHandler *);
+    void add_handlers(Element *) const;
+    void cleanup();
+    void take_state(AsyncWriter &);
+
+    const String &filename() const	{ return _filename; }
+    FILE *stdio() const			{ return _f; }	// only if !async()
+    bool async() const			{ return _async; }
+
+    void set_header(const String &header);
+
+    // Returns 1 if the record was written, 0 if it was dropped, and -1 on
+    // error; error() then describes the problem.
+    inline int write(const void *data, size_t len);
+    int write(const void *a, size_t alen, const void *b, size_t blen);
+    int flush();
+    String error() const;
+
+  private:
+
+    struct Buffer {
+	char *data;
+	size_t len;
+	size_t cap;
+	uint32_t file;		// file index for this buffer's records
+	Buffer *next;
+    };
+
+    String _filename;
+    String _base_filename;
+    FILE *_f;
+    bool _pipe;
+    bool _async;
+    bool _block;
+    size_t _buffer_size;
+    size_t _max_buffered;
+    uint64_t _rotate_size;
+    Timestamp _rotate_interval;
+
+    String _header;
+    uint32_t _file;		// index of the file being filled
+    uint64_t _file_bytes;	// bytes assigned to that file
+    Timestamp _rotate_at;
+
+    uint64_t _drops;
+    uint32_t _rotations;
+    atomic_uint32_t _errno;	// set by the writer thread under _lock
+
+    Buffer *_fill;
+#if HAVE_USER_MULTITHREAD
+    pthread_t _thread;
+    pthread_mutex_t _lock;
+    pthread_cond_t _cond;
+    bool _running;
+    bool _stop;
+    Buffer *_queue_head;
+    Buffer **_queue_tail;
+    Buffer *_free;
+    int _nbuffers;
+    int _max_buffers;
+    uint64_t _queued;
+    uint32_t _written_file;	// index of the thread's file
+
+    static void *thread_main(void *);
+    void start_thread();
+    void stop_thread();
+    void queue_fill();
+    bool next_fill(size_t len, bool force);
+    void append(const void *a, size_t alen, const void *b, size_t blen);
+#endif
+
+    FILE *open_file(uint32_t file);
+    void check_rotate(size_t len);
+    int write_direct(const void *a, size_t alen, const void *b, size_t blen);
+
+    static String queued_handler(Element *, void *);
+    static String drops_handler(Element *, void *);
+    static String rotations_handler(Element *, void *);
+
+};
+
+inline int
+AsyncWriter::write(const void *data, size_t len)
+{
+    return write(data, len, 0, 0);
+}
+
+CLICK_ENDDECLS
+#endif
@@ -90,6 +90,13 @@ FromDevice::configure(Vector<String> &conf, ErrorHandler *errh)
     _force_ip = false;
     _burst = 1;
     String bpf_filter, capture, encap_type;
+#if FROMDEVICE_ALLOW_LINUX
+    _ring_blocks = 64;
+    _ring_block_size = 1 << 18;
+    _ring_timeout = 1;
+    _fanout = -1;
+    String fanout_mode = "HASH";
+#endif
     bool has_encap;
     if (Args(conf, this, errh)
 	.read_mp("DEVNAME", _ifname)
@@ -105,6 +112,13 @@ FromDevice::configure(Vector<String> &conf, ErrorHandler *errh)
 	.read("ENCAP", WordArg(), encap_type).read_status(has_encap)
 	.read("BURST", _burst)
 	.read("TIMESTAMP", timestamp)
+#if FROMDEVICE_ALLOW_LINUX
+	.read("RING_BLOCKS", _ring_blocks)
+	.read("RING_BLOCK_SIZE", _ring_block_size)
+	.read("RING_TIMEOUT", _ring_timeout)
+	.read("FANOUT", _fanout)
+	.read("FANOUT_MODE", WordArg(), fanout_mode)
+#endif
 	.complete() < 0)
 	return -1;
     if (_snaplen > 8190 || _snaplen < 14)
@@ -113,6 +127,16 @@ FromDevice::configure(Vector<String> &conf, ErrorHandler *errh)
 	return errh->error("HEADROOM out of range");
     if (_burst <= 0)
 	return errh->error("BURST out of range");
+#if FROMDEVICE_ALLOW_LINUX
+    if (_ring_blocks < 2)
+	return errh->error("RING_BLOCKS out of range");
+    if (_ring_block_size < (unsigned) _snaplen + _headroom + 128)
+	return errh->error("RING_BLOCK_SIZE too small for SNAPLEN");
+    if (_fanout > 0xFFFF)
+	return errh->error("FANOUT out of range");
+    if ((_fanout_mode = PacketMmapRx::parse_fanout_mode(fanout_mode)) < 0)
+	return errh->error("bad FANOUT_MODE");
+#endif
 
 #if FROMDEVICE_ALLOW_PCAP
     _bpf_filter = bpf_filter;
@@ -138,6 +162,8 @@ FromDevice::configure(Vector<String> &conf, ErrorHandler *errh)
 #if FROMDEVICE_ALLOW_LINUX
     else if (capture == "LINUX")
 	_method = method_linux;
+    else if (capture == "PACKET_MMAP")
+	_method = method_packet_mmap;
 #endif
 #if FROMDEVICE_ALLOW_PCAP
     else if (capture == "PCAP")
@@ -152,6 +178,10 @@ FromDevice::configure(Vector<String> &conf, ErrorHandler *errh)
 
     if (bpf_filter && _method != method_pcap)
 	errh->warning("not using METHOD PCAP, BPF filter ignored");
+#if FROMDEVICE_ALLOW_LINUX
+    if (_fanout >= 0 && _method != method_packet_mmap)
+	errh->warning("not using METHOD PACKET_MMAP, FANOUT ignored");
+#endif
 
     _sniffer = sniffer;
     _promisc = promisc;
@@ -370,9 +400,36 @@ FromDevice::initialize(ErrorHandler *errh)
 	} else
 	    _was_promisc = promisc_ok;
 
+	if (_rx.configure(_burst, _headroom, _snaplen, _timestamp) < 0)
+	    return errh->error("out of memory");
+#ifdef SO_TIMESTAMP
+	int one = 1;
+	if (_timestamp && setsockopt(_fd, SOL_SOCKET, SO_TIMESTAMP, &one, sizeof(one)) < 0)
+	    errh->warning("setsockopt(SO_TIMESTAMP): %s", strerror(errno));
+#endif
+
 	_datalink = FAKE_DLT_EN10MB;
 	_method = method_linux;
     }
+
+    if (_method == method_packet_mmap) {
+	_fd = _mmap.open(_ifname, _ring_block_size, _ring_blocks,
+			 _ring_timeout, _headroom, errh);
+	if (_fd < 0)
+	    return -1;
+	if (_fanout >= 0 && _mmap.set_fanout(_fanout, _fanout_mode, errh) < 0)
+	    return -1;
+
+	int promisc_ok = set_promiscuous(_fd, _ifname, _promisc);
+	if (promisc_ok < 0) {
+	    if (_promisc)
+		errh->warning("cannot set promiscuous mode");
+	    _was_promisc = -1;
+	} else
+	    _was_promisc = promisc_ok;
+
+	_datalink = FAKE_DLT_EN10MB;
+    }
 #endif
 
 #if FROMDEVICE_ALLOW_PCAP || FROMDEVICE_ALLOW_NETMAP
@@ -402,10 +459,16 @@ FromDevice::cleanup(CleanupStage stage)
 #endif
 #if FROMDEVICE_ALLOW_LINUX
     if (_fd >= 0 && _method == method_linux) {
+	_rx.clear();
 	if (_was_promisc >= 0)
 	    set_promiscuous(_fd, _ifname, _was_promisc);
 	close(_fd);
     }
+    if (_method == method_packet_mmap) {
+	if (_fd >= 0 && _was_promisc >= 0)
+	    set_promiscuous(_fd, _ifname, _was_promisc);
+	_mmap.close();
+    }
 #endif
 #if FROMDEVICE_ALLOW_PCAP
     if (_pcap)
@@ -435,7 +498,7 @@ FromDevice::emit_packet(WritablePacket *p, int extra_len, const Timestamp &ts)
     SET_EXTRA_LENGTH_ANNO(p, extra_len);
 
     if (!_force_ip || fake_pcap_force_ip(p, _datalink))
-	output(0).push(p);
+	_batch.push_back(p);
     else
 	checked_output_push(1, p);
 }
@@ -470,6 +533,7 @@ FromDevice::selected(int, int)
 	// Read and push() at most one burst of packets.
 	int r = _netmap.dispatch(_burst,
 		reinterpret_cast<nm_cb_t>(FromDevice_get_packet), (u_char *) this);
+	output(0).push_batch(_batch);
 	if (r > 0) {
 	    _count += r;
 	    _task.reschedule();
@@ -482,6 +546,7 @@ FromDevice::selected(int, int)
     if (_method == method_pcap) {
 	// Read and push() at most one burst of packets.
 	int r = pcap_dispatch(_pcap, _burst, FromDevice_get_packet, (u_char *) this);
+	output(0).push_batch(_batch);
 	if (r > 0) {
 	    _count += r;
 	    _task.reschedule();
@@ -490,32 +555,45 @@ FromDevice::selected(int, int)
     }
 #endif
 #if FROMDEVICE_ALLOW_LINUX
-    int nlinux = 0;
-    while (_method == method_linux && nlinux < _burst) {
-	struct sockaddr_ll sa;
-	socklen_t fromlen = sizeof(sa);
-	WritablePacket *p = Packet::make(_headroom, 0, _snaplen, 0);
-	int len = recvfrom(_fd, p->data(), p->length(), MSG_TRUNC, (sockaddr *)&sa, &fromlen);
-	if (len > 0 && (sa.sll_pkttype != PACKET_OUTGOING || _outbound)) {
-	    if (len > _snaplen) {
-		assert(p->length() == (uint32_t)_snaplen);
-		SET_EXTRA_LENGTH_ANNO(p, len - _snaplen);
-	    } else
-		p->take(_snaplen - len);
-	    p->set_packet_type_anno((Packet::PacketType)sa.sll_pkttype);
-	    p->timestamp_anno().set_timeval_ioctl(_fd, SIOCGSTAMP);
+    if (_method == method_linux) {
+	// Read at most one burst of packets with one system call.
+	int n = _rx.receive(_fd, _burst);
+	for (int i = 0; i < n; ++i) {
+	    const struct sockaddr_ll *sa = reinterpret_cast<const struct sockaddr_ll *>(_rx.name(i));
+	    if (_rx.length(i) == 0
+		|| (sa->sll_pkttype == PACKET_OUTGOING && !_outbound))
+		continue;	// the slot's packet is reused
+	    WritablePacket *p = _rx.take(i);
+	    p->set_packet_type_anno((Packet::PacketType)sa->sll_pkttype);
+	    if (_timestamp && !_rx.timestamp(i, p->timestamp_anno()))
+		p->timestamp_anno().set_timeval_ioctl(_fd, SIOCGSTAMP);
 	    p->set_mac_header(p->data());
-	    ++nlinux;
 	    ++_count;
 	    if (!_force_ip || fake_pcap_force_ip(p, _datalink))
-		output(0).push(p);
+		_batch.push_back(p);
 	    else
 		checked_output_push(1, p);
-	} else {
-	    p->kill();
-	    if (len <= 0 && errno != EAGAIN)
-		click_chatter("FromDevice(%s): recvfrom: %s", _ifname.c_str(), strerror(errno));
-	    break;
+	}
+	if (n < 0 && errno != EAGAIN)
+	    click_chatter("FromDevice(%s): recvmmsg: %s", _ifname.c_str(), strerror(errno));
+	output(0).push_batch(_batch);
+    }
+
+    if (_method == method_packet_mmap) {
+	// Read at most BURST ring blocks, pushing each as one batch.
+	PacketBatch block;
+	for (int b = 0; b < _burst; ++b) {
+	    if (_mmap.receive_block(block, _snaplen, _outbound, _timestamp) == 0)
+		break;
+	    while (Packet *p = block.pop_front()) {
+		p->set_mac_header(p->data());
+		++_count;
+		if (!_force_ip || fake_pcap_force_ip(p, _datalink))
+		    _batch.push_back(p);
+		else
+		    checked_output_push(1, p);
+	    }
+	    output(0).push_batch(_batch);
 	}
     }
 #endif
@@ -544,6 +622,7 @@ FromDevice::run_task(Task *)
 	    ErrorHandler::default_handler()->error("%p{element}: %s", this, pcap_geterr(_pcap));
     }
 # endif
+    output(0).push_batch(_batch);
     if (r > 0) {
 	_count += r;
 	_task.fast_reschedule();
@@ -586,6 +665,14 @@ FromDevice::read_handler(Element* e, void *thunk)
 	    return "??";
     } else if (thunk == (void *) 1)
 	return String(fake_pcap_unparse_dlt(fd->_datalink));
+#if FROMDEVICE_ALLOW_LINUX
+    else if (thunk == (void *) 3)
+	return mmsg_unparse_average(fd->_rx.packets(), fd->_rx.calls());
+    else if (thunk == (void *) 4)
+	return String(fd->_mmap.blocks());
+    else if (thunk == (void *) 5)
+	return String(fd->_mmap.copies());
+#endif
     else
 	return String(fd->_count);
 }
@@ -595,6 +682,9 @@ FromDevice::write_handler(const String &, Element *e, void *, ErrorHandler *)
 {
     FromDevice* fd = static_cast<FromDevice*>(e);
     fd->_count = 0;
+#if FROMDEVICE_ALLOW_LINUX
+    fd->_rx.reset_stats();
+#endif
     return 0;
 }
 
@@ -604,9 +694,14 @@ FromDevice::add_handlers()
     add_read_handler("kernel_drops", read_handler, 0);
     add_read_handler("encap", read_handler, 1);
     add_read_handler("count", read_handler, 2);
+#if FROMDEVICE_ALLOW_LINUX
+    add_read_handler("recv_per_syscall", read_handler, 3);
+    add_read_handler("ring_blocks", read_handler, 4);
+    add_read_handler("ring_copies", read_handler, 5);
+#endif
     add_write_handler("reset_counts", write_handler, 0, Handler::BUTTON);
 }
 
 CLICK_ENDDECLS
-ELEMENT_REQUIRES(userlevel FakePcap KernelFilter NetmapInfo)
+ELEMENT_REQUIRES(userlevel FakePcap KernelFilter NetmapInfo MmsgBatch PacketMmap)
 EXPORT_ELEMENT(FromDevice)
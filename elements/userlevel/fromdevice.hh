@@ -5,6 +5,8 @@
 
 #ifdef __linux__
 # define FROMDEVICE_ALLOW_LINUX 1
+# include "elements/userlevel/mmsgbatch.hh"
+# include "elements/userlevel/packetmmap.hh"
 #endif
 
 #if HAVE_PCAP
@@ -93,8 +95,45 @@ but the IP header annotation has been set appropriately.) Default is false.
 =item METHOD
 
 Word.  Defines the capture method FromDevice will use to read packets from the
-device.  Linux targets generally support PCAP and LINUX; other targets support
-only PCAP.  Defaults to PCAP.
+device.  Linux targets generally support PCAP, LINUX, and PACKET_MMAP; other
+targets support only PCAP.  Defaults to PCAP.
+
+PACKET_MMAP reads packets from a memory-mapped TPACKET_V3 receive ring shared
+with the kernel.  The kernel fills the ring a block at a time, and FromDevice
+pushes each block's packets as one batch without copying them: emitted packets
+point into the ring, and a block returns to the kernel when its last packet
+is freed.  Packets held for long, for instance in a Queue, pin their blocks.
+While half the ring's blocks are pinned, or for good once the kernel has had
+to wait for a pinned block, FromDevice copies packets out of the ring
+instead.
+
+=item RING_BLOCKS
+
+Unsigned. Number of blocks in the PACKET_MMAP receive ring. Defaults to 64.
+
+=item RING_BLOCK_SIZE
+
+Unsigned. Size of each PACKET_MMAP ring block in bytes; must be a multiple of
+the page size. Defaults to 256 kB.
+
+=item RING_TIMEOUT
+
+Unsigned. Milliseconds after which the kernel hands over a partly filled
+PACKET_MMAP block. Lower values reduce latency at low packet rates. Defaults
+to 1.
+
+=item FANOUT
+
+Integer. With METHOD PACKET_MMAP, join PACKET_FANOUT group FANOUT.  The kernel
+spreads the device's packets among all sockets in a group, so several
+FromDevice elements, typically on different threads, can share one device.
+Defaults to -1, meaning no fanout group.
+
+=item FANOUT_MODE
+
+Word. How a FANOUT group spreads packets: HASH (by flow), LB (round-robin),
+CPU (by receiving CPU), ROLLOVER, RANDOM, or QUEUE (by receive queue).
+Defaults to HASH.
 
 =item BPF_FILTER
 
@@ -121,6 +160,10 @@ to roughly 28.
 =item BURST
 
 Integer. Maximum number of packets to read per scheduling. Defaults to 1.
+The packets read in one burst are pushed to output 0 as a single batch.
+With METHOD LINUX, a burst is read with a single recvmmsg() system call
+where available.  With METHOD PACKET_MMAP, BURST is the maximum number of ring
+blocks to read per scheduling.
 
 =item TIMESTAMP
 
@@ -140,9 +183,23 @@ FromDevice sets packets' extra length annotations as appropriate.
 
 Returns the number of packets read by the device.
 
+=h recv_per_syscall read-only
+
+Returns the average number of packets read per receiving system call.  Only
+meaningful with METHOD LINUX.
+
+=h ring_blocks read-only
+
+Returns the number of PACKET_MMAP ring blocks read.
+
+=h ring_copies read-only
+
+Returns the number of packets copied out of the PACKET_MMAP ring because too
+many ring blocks were held.
+
 =h reset_counts write-only
 
-Resets "count" to zero.
+Resets "count" and "recv_per_syscall" to zero.
 
 =h kernel_drops read-only
 
@@ -191,6 +248,7 @@ class FromDevice : public Element { public:
 
 #if FROMDEVICE_ALLOW_LINUX
     int linux_fd() const		{ return _method == method_linux ? _fd : -1; }
+    bool packet_mmap() const		{ return _method == method_packet_mmap; }
     static int open_packet_socket(String, ErrorHandler *);
     static int set_promiscuous(int, String, bool);
 #endif
@@ -215,6 +273,13 @@ class FromDevice : public Element { public:
 #endif
 #if FROMDEVICE_ALLOW_LINUX
     unsigned char *_linux_packetbuf;
+    MmsgReceiver _rx;
+    PacketMmapRx _mmap;
+    unsigned _ring_blocks;
+    unsigned _ring_block_size;
+    unsigned _ring_timeout;
+    int _fanout;
+    int _fanout_mode;
 #endif
 #if FROMDEVICE_ALLOW_PCAP || FROMDEVICE_ALLOW_NETMAP
     void emit_packet(WritablePacket *p, int extra_len, const Timestamp &ts);
@@ -233,6 +298,7 @@ class FromDevice : public Element { public:
     int netmap_dispatch();
 #endif
 
+    PacketBatch _batch;
     bool _force_ip;
     int _burst;
     int _datalink;
@@ -252,7 +318,8 @@ class FromDevice : public Element { public:
     int _was_promisc : 2;
     int _snaplen;
     unsigned _headroom;
-    enum { method_default, method_netmap, method_pcap, method_linux };
+    enum { method_default, method_netmap, method_pcap, method_linux,
+	   method_packet_mmap };
     int _method;
 #if FROMDEVICE_ALLOW_PCAP
     String _bpf_filter;
@@ -12,7 +12,7 @@ class HandlerCall;
 /*
 =c
 
-FromDump(FILENAME [, I<keywords> STOP, TIMING, SAMPLE, FORCE_IP, START, START_AFTER, END, END_AFTER, INTERVAL, END_CALL, FILEPOS, MMAP])
+FromDump(FILENAME [, I<keywords> STOP, TIMING, SAMPLE, FORCE_IP, START, START_AFTER, END, END_AFTER, INTERVAL, END_CALL, FILEPOS, MMAP, DECOMPRESS])
 
 =s traces
 
@@ -24,8 +24,11 @@ Reads packets from a file produced by `tcpdump -w FILENAME' or ToDump and
 emits them from the output, optionally stopping the driver when there are no
 more packets.
 
-FromDump also transparently reads gzip- and bzip2-compressed tcpdump files, if
-you have zcat(1) and bzcat(1) installed.
+FromDump also transparently reads gzip- and bzip2-compressed tcpdump files.  It
+decompresses them in-process when Click was built with zlib and libbz2, and
+otherwise runs zcat(1) or bzcat(1), if installed.  In-process decompression
+works on the standard input too, and, with multithreaded Click, runs in a
+separate thread that decompresses ahead of the reader.
 
 Keyword arguments are:
 
@@ -101,6 +104,12 @@ this (uncompressed) file position. This is dangerous; there's no cheap way
 to check whether you got the offset wrong, and if you did get it wrong,
 FromDump will emit garbage.
 
+=item DECOMPRESS
+
+Boolean. If true, then FromDump decompresses gzip- and bzip2-compressed files
+itself, rather than running zcat(1) or bzcat(1).  This requires a Click built
+with zlib and libbz2.  Default is true.
+
 =item MMAP
 
 Boolean. If true, then FromDump will use mmap(2) to access the tcpdump file.
@@ -159,6 +168,12 @@ Returns the filename supplied to FromDump.
 Returns the length of the FromDump file, in bytes, or "-" if that length
 cannot be determined (because the file was compressed, for example).
 
+=h decompress_rate read-only
+
+Returns the rate at which FromDump has decompressed the file, in
+uncompressed bytes per second of decompression time, or "-" if the file is
+not being decompressed in-process.
+
 =h filepos read/write
 
 Returns or sets FromDump's position in the (uncompressed) file, in bytes.
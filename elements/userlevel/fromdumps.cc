@@ -0,0 +1,482 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+/*
+ * fromdumps.{cc,hh} -- element reads packets from several tcpdump files,
+ * merging them by timestamp
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "fromdumps.hh"
+#include <click/args.hh>
+#include <click/router.hh>
+#include <click/error.hh>
+#include <click/heap.hh>
+#include <click/packet_anno.hh>
+#include <click/standard/scheduleinfo.hh>
+#include "fakepcap.hh"
+CLICK_DECLS
+
+#define	SWAPLONG(y) \
+	((((y)&0xff)<<24) | (((y)&0xff00)<<8) | (((y)&0xff0000)>>8) | (((y)>>24)&0xff))
+#define	SWAPSHORT(y) \
+	( (((y)&0xff)<<8) | ((u_short)((y)&0xff00)>>8) )
+
+// Remembers the last error a reader reports, so that FromDumps's own
+// thread can print it.
+class FromDumps::SourceErrorHandler : public ErrorHandler { public:
+    void *emit(const String &str, void *, bool) {
+	_msg = str;
+	return 0;
+    }
+    String _msg;
+};
+
+FromDumps::FromDumps()
+    : _linktype(FAKE_DLT_NONE), _well_ordered(true), _task(this),
+      _timer(&_task), _count(0), _lag_sum(0), _lag_count(0)
+{
+#if HAVE_USER_MULTITHREAD
+    pthread_mutex_init(&_lock, 0);
+    pthread_cond_init(&_cond, 0);
+    _threads_stop = false;
+#endif
+}
+
+FromDumps::~FromDumps()
+{
+#if HAVE_USER_MULTITHREAD
+    pthread_cond_destroy(&_cond);
+    pthread_mutex_destroy(&_lock);
+#endif
+}
+
+int
+FromDumps::configure(Vector<String> &conf, ErrorHandler *errh)
+{
+    _active = true;
+    _stop = _timing = _force_ip = false;
+    _speedup = 1;
+    _burst = 32;
+    _batch = 256;
+    _prefetch = 4;
+    _nthreads = 4;
+
+    if (Args(this, errh).bind(conf)
+	.read("STOP", _stop)
+	.read("TIMING", _timing)
+	.read("SPEEDUP", _speedup)
+	.read("BURST", _burst)
+	.read("BATCH", _batch)
+	.read("PREFETCH", _prefetch)
+	.read("THREADS", _nthreads)
+	.read("FORCE_IP", _force_ip)
+	.read("ACTIVE", _active)
+	.consume() < 0)
+	return -1;
+
+    for (int i = 0; i < conf.size(); ++i) {
+	String filename;
+	if (!FilenameArg().parse(cp_uncomment(conf[i]), filename))
+	    return errh->error("argument %d should be a filename", i + 1);
+	_filenames.push_back(filename);
+    }
+    if (!_filenames.size())
+	return errh->error("no files specified");
+    if (_speedup <= 0)
+	return errh->error("SPEEDUP must be positive");
+    if (_burst < 1 || _batch < 1 || _prefetch < 1)
+	return errh->error("BURST, BATCH, and PREFETCH must be positive");
+    return 0;
+}
+
+static void
+swap_file_header(const fake_pcap_file_header *hp, fake_pcap_file_header *outp)
+{
+    outp->magic = SWAPLONG(hp->magic);
+    outp->version_major = SWAPSHORT(hp->version_major);
+    outp->version_minor = SWAPSHORT(hp->version_minor);
+    outp->thiszone = SWAPLONG(hp->thiszone);
+    outp->sigfigs = SWAPLONG(hp->sigfigs);
+    outp->snaplen = SWAPLONG(hp->snaplen);
+    outp->linktype = SWAPLONG(hp->linktype);
+}
+
+static void
+swap_packet_header(const fake_pcap_pkthdr *hp, fake_pcap_pkthdr *outp)
+{
+    outp->ts.tv.tv_sec = SWAPLONG(hp->ts.tv.tv_sec);
+    outp->ts.tv.tv_usec = SWAPLONG(hp->ts.tv.tv_usec);
+    outp->caplen = SWAPLONG(hp->caplen);
+    outp->len = SWAPLONG(hp->len);
+}
+
+int
+FromDumps::open_source(Source *s, ErrorHandler *errh)
+{
+    if (s->ff.initialize(errh) < 0)
+	return -1;
+
+    fake_pcap_file_header swapped_fh;
+    const fake_pcap_file_header *fh = (const fake_pcap_file_header *) s->ff.get_aligned(sizeof(fake_pcap_file_header), &swapped_fh);
+    if (!fh)
+	return s->ff.error(errh, "not a tcpdump file (too short)");
+
+    if (fh->magic == FAKE_PCAP_MAGIC || fh->magic == FAKE_MODIFIED_PCAP_MAGIC)
+	s->swapped = false;
+    else {
+	swap_file_header(fh, &swapped_fh);
+	s->swapped = true;
+	fh = &swapped_fh;
+    }
+    if (fh->magic != FAKE_PCAP_MAGIC && fh->magic != FAKE_MODIFIED_PCAP_MAGIC)
+	return s->ff.error(errh, "not a tcpdump file (bad magic number)");
+    s->extra_pkthdr_crap = (fh->magic == FAKE_PCAP_MAGIC ? 0 : sizeof(fake_modified_pcap_pkthdr) - sizeof(fake_pcap_pkthdr));
+    if (fh->version_major != FAKE_PCAP_VERSION_MAJOR)
+	return s->ff.error(errh, "unknown major version %d", fh->version_major);
+    s->minor_version = fh->version_minor;
+    s->linktype = fake_pcap_canonical_dlt(fh->linktype, true);
+    return 0;
+}
+
+int
+FromDumps::initialize(ErrorHandler *errh)
+{
+    for (int i = 0; i < _filenames.size(); ++i) {
+	Source *s = new Source;
+	s->ring = new Packet *[_prefetch];
+	s->ring_head = s->ring_count = 0;
+	s->eof = s->read_done = false;
+	s->cur = 0;
+	s->index = i;
+	s->ff.filename() = _filenames[i];
+	_sources.push_back(s);
+	if (open_source(s, errh) < 0)
+	    return -1;
+	if (i == 0)
+	    _linktype = s->linktype;
+	else if (s->linktype != _linktype)
+	    return s->ff.error(errh, "link type %s differs from %s's",
+			       fake_pcap_unparse_dlt(s->linktype),
+			       _sources[0]->ff.print_filename().c_str());
+    }
+
+    if (_force_ip && !fake_pcap_dlt_force_ipable(_linktype))
+	return errh->error("unknown linktype %d; can't force IP packets", _linktype);
+    else if (_linktype == FAKE_DLT_RAW)
+	_force_ip = true;
+
+#if HAVE_USER_MULTITHREAD
+    int nthreads = _nthreads < _sources.size() ? _nthreads : _sources.size();
+    _threads.resize(nthreads > 0 ? nthreads : 0);
+    for (int i = 0; i < _threads.size(); ++i) {
+	_threads[i].fd = this;
+	_threads[i].id = i;
+	if (pthread_create(&_threads[i].pthread, 0, thread_main, &_threads[i]) != 0) {
+	    _threads.resize(i);
+	    break;
+	}
+    }
+#endif
+
+    // wait for each file's first batch
+    for (int i = 0; i < _sources.size(); ++i)
+	if (next_batch(_sources[i])) {
+	    _heap.push_back(_sources[i]);
+	    push_heap(_heap.begin(), _heap.end(), source_less());
+	} else if (_sources[i]->error)
+	    errh->warning("%s", _sources[i]->error.c_str());
+
+    ScheduleInfo::initialize_task(this, &_task, _active, errh);
+    _timer.initialize(this);
+    return 0;
+}
+
+/* Reads up to BATCH packets from @a s, returning them linked by next().
+   Sets s->read_done at end of file.  Called by one thread per source. */
+Packet *
+FromDumps::read_batch(Source *s)
+{
+    SourceErrorHandler errh;
+    Packet *head = 0, **tailp = &head;
+    int n = 0;
+
+    while (n < _batch) {
+	fake_pcap_pkthdr swapped_ph;
+	const fake_pcap_pkthdr *ph = reinterpret_cast<const fake_pcap_pkthdr *>(s->ff.get_aligned(sizeof(*ph), &swapped_ph, &errh));
+	if (!ph)
+	    break;
+	if (s->swapped) {
+	    swap_packet_header(ph, &swapped_ph);
+	    ph = &swapped_ph;
+	}
+
+	// may need to swap 'caplen' and 'len' fields at or before version 2.3
+	int len, caplen, skiplen = 0;
+	if (s->minor_version > 3 || (s->minor_version == 3 && ph->caplen <= ph->len)) {
+	    len = ph->len;
+	    caplen = ph->caplen;
+	} else {
+	    len = ph->caplen;
+	    caplen = ph->len;
+	}
+	if (caplen > 65535) {
+	    s->ff.error(&errh, "bad packet header; giving up");
+	    break;
+	} else if (caplen > len) {
+	    skiplen = caplen - len;
+	    caplen = len;
+	}
+	s->ff.shift_pos(s->extra_pkthdr_crap);
+
+	Timestamp ts = fake_bpf_timeval_union::make_timestamp(&ph->ts);
+	Packet *p = s->ff.get_packet(caplen, ts.sec(), ts.subsec(), &errh);
+	if (!p)
+	    break;
+	SET_EXTRA_LENGTH_ANNO(p, len - caplen);
+	s->ff.shift_pos(skiplen);
+	p->set_mac_header(p->data());
+
+	if (_force_ip && !fake_pcap_force_ip(p, s->linktype)) {
+	    p->kill();
+	    continue;
+	}
+	*tailp = p;
+	tailp = &p->next();
+	++n;
+    }
+
+    *tailp = 0;
+    if (n < _batch) {
+	s->read_done = true;
+	s->error = errh._msg;
+    }
+    return head;
+}
+
+#if HAVE_USER_MULTITHREAD
+void *
+FromDumps::thread_main(void *arg)
+{
+    Thread *t = static_cast<Thread *>(arg);
+    FromDumps *fd = t->fd;
+    int nthreads = fd->_threads.size();
+
+    pthread_mutex_lock(&fd->_lock);
+    while (!fd->_threads_stop) {
+	// find one of our files with room for another batch
+	Source *s = 0;
+	for (int i = t->id; i < fd->_sources.size(); i += nthreads) {
+	    Source *x = fd->_sources[i];
+	    if (!x->read_done && x->ring_count < fd->_prefetch) {
+		s = x;
+		break;
+	    }
+	}
+	if (!s) {
+	    pthread_cond_wait(&fd->_cond, &fd->_lock);
+	    continue;
+	}
+	pthread_mutex_unlock(&fd->_lock);
+
+	Packet *batch = fd->read_batch(s);
+
+	pthread_mutex_lock(&fd->_lock);
+	if (batch) {
+	    s->ring[(s->ring_head + s->ring_count) % fd->_prefetch] = batch;
+	    ++s->ring_count;
+	}
+	s->eof = s->read_done;
+	pthread_cond_broadcast(&fd->_cond);
+    }
+    pthread_mutex_unlock(&fd->_lock);
+    return 0;
+}
+
+void
+FromDumps::stop_threads()
+{
+    pthread_mutex_lock(&_lock);
+    _threads_stop = true;
+    pthread_cond_broadcast(&_cond);
+    pthread_mutex_unlock(&_lock);
+    for (int i = 0; i < _threads.size(); ++i)
+	pthread_join(_threads[i].pthread, 0);
+    _threads.clear();
+}
+#endif
+
+/* Sets s->cur to the file's next batch.  Returns false at end of file. */
+bool
+FromDumps::next_batch(Source *s)
+{
+#if HAVE_USER_MULTITHREAD
+    if (_threads.size()) {
+	pthread_mutex_lock(&_lock);
+	while (!s->ring_count && !s->eof)
+	    pthread_cond_wait(&_cond, &_lock);
+	if (s->ring_count) {
+	    s->cur = s->ring[s->ring_head];
+	    s->ring_head = (s->ring_head + 1) % _prefetch;
+	    --s->ring_count;
+	    pthread_cond_broadcast(&_cond);
+	}
+	pthread_mutex_unlock(&_lock);
+	return s->cur != 0;
+    }
+#endif
+    while (!s->cur && !s->read_done)
+	s->cur = read_batch(s);
+    return s->cur != 0;
+}
+
+bool
+FromDumps::run_task(Task *)
+{
+    if (!_active)
+	return false;
+
+    int n = 0;
+    while (n < _burst && _heap.size()) {
+	Source *s = _heap[0];
+	Packet *p = s->cur;
+	const Timestamp &ts = p->timestamp_anno();
+
+	if (_timing) {
+	    Timestamp now = Timestamp::now_steady();
+	    if (!_timing_base) {
+		_timing_base = now;
+		_first_ts = ts;
+	    }
+	    Timestamp t = _timing_base;
+	    if (ts > _first_ts)
+		t += Timestamp((ts - _first_ts).doubleval() / _speedup);
+	    if (now < t) {
+		_timer.schedule_at_steady(t);
+		return n > 0;
+	    }
+	    Timestamp lag = now - t;
+	    _lag_sum += lag.doubleval();
+	    ++_lag_count;
+	    if (lag > _lag_max)
+		_lag_max = lag;
+	}
+
+	if (_last_emission && ts < _last_emission)
+	    _well_ordered = false;
+	_last_emission = ts;
+
+	s->cur = p->next();
+	p->set_next(0);
+	if (s->cur || next_batch(s))
+	    change_heap(_heap.begin(), _heap.end(), _heap.begin(), source_less());
+	else {
+	    if (s->error)
+		click_chatter("%p{element}: %s", this, s->error.c_str());
+	    pop_heap(_heap.begin(), _heap.end(), source_less());
+	    _heap.pop_back();
+	}
+
+	output(0).push(p);
+	++_count;
+	++n;
+    }
+
+    if (!_heap.size()) {
+	if (_stop)
+	    router()->please_stop_driver();
+	return n > 0;
+    }
+    _task.fast_reschedule();
+    return n > 0;
+}
+
+void
+FromDumps::cleanup(CleanupStage)
+{
+#if HAVE_USER_MULTITHREAD
+    stop_threads();
+#endif
+    for (int i = 0; i < _sources.size(); ++i) {
+	Source *s = _sources[i];
+	for (; s->ring_count; --s->ring_count, s->ring_head = (s->ring_head + 1) % _prefetch)
+	    while (Packet *p = s->ring[s->ring_head]) {
+		s->ring[s->ring_head] = p->next();
+		p->kill();
+	    }
+	while (Packet *p = s->cur) {
+	    s->cur = p->next();
+	    p->kill();
+	}
+	delete[] s->ring;
+	delete s;
+    }
+    _sources.clear();
+    _heap.clear();
+}
+
+enum { H_COUNT, H_RESET_COUNTS, H_ACTIVE, H_ENCAP, H_LAG_AVG, H_LAG_MAX };
+
+String
+FromDumps::read_handler(Element *e, void *thunk)
+{
+    FromDumps *fd = static_cast<FromDumps *>(e);
+    switch ((intptr_t) thunk) {
+    case H_ENCAP:
+	return String(fake_pcap_unparse_dlt(fd->_linktype));
+    case H_LAG_AVG:
+	return Timestamp(fd->_lag_count ? fd->_lag_sum / fd->_lag_count : 0).unparse();
+    case H_LAG_MAX:
+	return fd->_lag_max.unparse();
+    default:
+	return "<error>";
+    }
+}
+
+int
+FromDumps::write_handler(const String &s, Element *e, void *thunk, ErrorHandler *errh)
+{
+    FromDumps *fd = static_cast<FromDumps *>(e);
+    switch ((intptr_t) thunk) {
+    case H_ACTIVE:
+	if (!BoolArg().parse(cp_uncomment(s), fd->_active))
+	    return errh->error("type mismatch");
+	if (fd->_active && !fd->_task.scheduled())
+	    fd->_task.reschedule();
+	return 0;
+    case H_RESET_COUNTS:
+	fd->_count = 0;
+	fd->_lag_sum = 0;
+	fd->_lag_count = 0;
+	fd->_lag_max = Timestamp();
+	return 0;
+    default:
+	return -EINVAL;
+    }
+}
+
+void
+FromDumps::add_handlers()
+{
+    add_data_handlers("count", Handler::OP_READ, &_count);
+    add_write_handler("reset_counts", write_handler, H_RESET_COUNTS, Handler::BUTTON);
+    add_data_handlers("active", Handler::OP_READ | Handler::CHECKBOX, &_active);
+    add_write_handler("active", write_handler, H_ACTIVE);
+    add_read_handler("encap", read_handler, H_ENCAP);
+    add_data_handlers("well_ordered", Handler::OP_READ | Handler::CHECKBOX, &_well_ordered);
+    add_read_handler("lag_avg", read_handler, H_LAG_AVG);
+    add_read_handler("lag_max", read_handler, H_LAG_MAX);
+    add_task_handlers(&_task);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel FakePcap)
+EXPORT_ELEMENT(FromDumps)
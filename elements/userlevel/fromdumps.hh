@@ -0,0 +1,229 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+#ifndef CLICK_FROMDUMPS_HH
+#define CLICK_FROMDUMPS_HH
+#include <click/element.hh>
+#include <click/task.hh>
+#include <click/timer.hh>
+#include <click/fromfile.hh>
+#if HAVE_USER_MULTITHREAD
+# include <pthread.h>
+#endif
+CLICK_DECLS
+
+/*
+=c
+
+FromDumps(FILENAME1, FILENAME2, ... [, I<keywords> STOP, TIMING, SPEEDUP, BURST, BATCH, PREFETCH, THREADS, FORCE_IP, ACTIVE])
+
+=s traces
+
+reads packets from several tcpdump files, merged by timestamp
+
+=d
+
+Reads packets from the tcpdump files FILENAME1, FILENAME2, and so forth, and
+pushes them out its output in timestamp order.  Each file should be sorted by
+timestamp, as captures are; see the C<well_ordered> handler.  This is like
+connecting several FromDump elements to a TimeSortedSched, but cheaper for
+many files.
+
+FromDumps reads each file in batches of BATCH packets, keeping up to PREFETCH
+batches per file ahead of the merge.  In multithreaded user-level Click, up
+to THREADS helper threads read and parse the files, so FromDumps's own thread
+only merges, using a heap keyed by each file's next timestamp.  Otherwise,
+FromDumps reads batches itself as it needs them.  Files are read with the
+same machinery as FromDump, so compressed files work too.
+
+Every file must have the same link type.
+
+Keyword arguments are:
+
+=over 8
+
+=item STOP
+
+Boolean.  If true, then FromDumps stops the driver when all files are
+exhausted.  Default is false.
+
+=item TIMING
+
+Boolean.  If true, then FromDumps tries to emit packets at the times implied
+by their timestamps, starting from the first packet.  Default is false.
+
+=item SPEEDUP
+
+Number.  With TIMING, replay this many times faster than real time.  For
+example, SPEEDUP 2 replays a one-minute trace in 30 seconds.  Default is 1.
+
+=item BURST
+
+Integer.  The maximum number of packets emitted per task invocation.
+Default is 32.
+
+=item BATCH
+
+Integer.  The number of packets read from a file at a time.  Default is 256.
+
+=item PREFETCH
+
+Integer.  The number of batches read ahead per file.  Default is 4.
+
+=item THREADS
+
+Integer.  The maximum number of helper threads.  Each thread reads a fixed
+subset of the files.  Default is 4.
+
+=item FORCE_IP
+
+Boolean.  If true, then drop non-IP packets, and set the IP header annotation
+on the rest, as FromDump does.  Default is false.
+
+=item ACTIVE
+
+Boolean.  If false, then FromDumps will not emit packets until its C<active>
+handler is set to true.  Default is true.
+
+=back
+
+This element is only available at user level.
+
+=e
+
+  FromDumps(link1.pcap, link2.pcap, link3.pcap.gz, TIMING true, SPEEDUP 10)
+    -> Queue -> ToDevice(eth0);
+
+=h count read-only
+
+Returns the number of packets emitted so far.
+
+=h reset_counts write-only
+
+Resets C<count> and the timing statistics.
+
+=h active read/write
+
+Returns or sets the ACTIVE setting.
+
+=h encap read-only
+
+Returns the files' encapsulation type.
+
+=h well_ordered read-only
+
+Returns "false" if FromDumps emitted packets out of timestamp order because
+some file was not sorted.
+
+=h lag_avg read-only
+
+With TIMING, returns the average delay between the time a packet should have
+been emitted and the time it was, in seconds.  A large value means FromDumps
+cannot keep up.
+
+=h lag_max read-only
+
+With TIMING, returns the largest such delay, in seconds.
+
+=a
+
+FromDump, TimeSortedSched, ToDump */
+
+class FromDumps : public Element { public:
+
+    FromDumps() CLICK_COLD;
+    ~FromDumps() CLICK_COLD;
+
+    const char *class_name() const	{ return "FromDumps"; }
+    const char *port_count() const	{ return PORTS_0_1; }
+    const char *processing() const	{ return PUSH; }
+
+    int configure(Vector<String> &, ErrorHandler *) CLICK_COLD;
+    int initialize(ErrorHandler *) CLICK_COLD;
+    void cleanup(CleanupStage) CLICK_COLD;
+    void add_handlers() CLICK_COLD;
+
+    bool run_task(Task *);
+
+  private:
+
+    class SourceErrorHandler;
+
+    struct Source {
+	FromFile ff;
+	bool swapped;
+	int minor_version;
+	int extra_pkthdr_crap;
+	int linktype;
+
+	Packet **ring;		// prefetched batches, linked by next()
+	int ring_head;
+	int ring_count;
+	bool eof;		// no more batches after those in ring
+	bool read_done;		// reader has seen the end of the file
+	String error;
+
+	Packet *cur;		// batch being merged
+	int index;
+    };
+
+    struct source_less {
+	inline bool operator()(const Source *a, const Source *b) const {
+	    return a->cur->timestamp_anno() < b->cur->timestamp_anno()
+		|| (a->cur->timestamp_anno() == b->cur->timestamp_anno()
+		    && a->index < b->index);
+	}
+    };
+
+    Vector<String> _filenames;
+    Vector<Source *> _sources;
+    Vector<Source *> _heap;
+    int _linktype;
+
+    bool _active;
+    bool _stop;
+    bool _timing;
+    bool _force_ip;
+    bool _well_ordered;
+    double _speedup;
+    int _burst;
+    int _batch;
+    int _prefetch;
+    int _nthreads;
+
+    Task _task;
+    Timer _timer;
+
+    uint64_t _count;
+    Timestamp _last_emission;
+    Timestamp _timing_base;
+    Timestamp _first_ts;
+    double _lag_sum;
+    Timestamp _lag_max;
+    uint64_t _lag_count;
+
+#if HAVE_USER_MULTITHREAD
+    struct Thread {
+	FromDumps *fd;
+	int id;
+	pthread_t pthread;
+    };
+
+    Vector<Thread> _threads;
+    pthread_mutex_t _lock;
+    pthread_cond_t _cond;
+    bool _threads_stop;
+
+    static void *thread_main(void *);
+    void stop_threads();
+#endif
+
+    int open_source(Source *s, ErrorHandler *errh);
+    Packet *read_batch(Source *s);
+    bool next_batch(Source *s);
+
+    static String read_handler(Element *, void *) CLICK_COLD;
+    static int write_handler(const String &, Element *, void *, ErrorHandler *) CLICK_COLD;
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,281 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+/*
+ * mmsgbatch.{cc,hh} -- receive and send datagram vectors with recvmmsg()
+ * and sendmmsg()
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "mmsgbatch.hh"
+#include <click/packet_anno.hh>
+#include <click/string.hh>
+#include <string.h>
+#include <errno.h>
+#include <stdio.h>
+CLICK_DECLS
+
+MmsgReceiver::MmsgReceiver()
+    : _vlen(0), _headroom(0), _snaplen(0), _controllen(0),
+      _msgs(0), _iov(0), _names(0), _control(0), _p(0),
+      _calls(0), _packets(0)
+{
+}
+
+MmsgReceiver::~MmsgReceiver()
+{
+    clear();
+    delete[] _msgs;
+    delete[] _iov;
+    delete[] _names;
+    delete[] _control;
+    delete[] _p;
+}
+
+int
+MmsgReceiver::configure(int vlen, uint32_t headroom, int snaplen, bool control)
+{
+    clear();
+    delete[] _msgs;
+    delete[] _iov;
+    delete[] _names;
+    delete[] _control;
+    delete[] _p;
+    _vlen = vlen;
+    _headroom = headroom;
+    _snaplen = snaplen;
+    _controllen = control ? CMSG_SPACE(sizeof(struct timeval)) : 0;
+    _msgs = new click_mmsghdr[vlen];
+    _iov = new struct iovec[vlen];
+    _names = new struct sockaddr_storage[vlen];
+    _control = _controllen ? new char[vlen * _controllen] : 0;
+    _p = new WritablePacket *[vlen];
+    if (!_msgs || !_iov || !_names || (_controllen && !_control) || !_p) {
+	_vlen = 0;
+	return -ENOMEM;
+    }
+    memset(_msgs, 0, sizeof(click_mmsghdr) * vlen);
+    for (int i = 0; i < vlen; ++i)
+	_p[i] = 0;
+    return 0;
+}
+
+/** @brief Receive up to @a n datagrams from @a fd.
+ * @return the number of datagrams received, or -1 with errno set
+ *
+ * Datagram @a i is retrieved with take(i).  Packets for slots not taken
+ * are reused by the next receive(). */
+int
+MmsgReceiver::receive(int fd, int n, int flags)
+{
+    if (n > _vlen)
+	n = _vlen;
+    for (int i = 0; i < n; ++i) {
+	if (!_p[i] && !(_p[i] = Packet::make(_headroom, 0, _snaplen, 0))) {
+	    n = i;
+	    break;
+	}
+	_iov[i].iov_base = _p[i]->data();
+	_iov[i].iov_len = _p[i]->length();
+	struct msghdr &m = _msgs[i].msg_hdr;
+	m.msg_name = &_names[i];
+	m.msg_namelen = sizeof(_names[i]);
+	m.msg_iov = &_iov[i];
+	m.msg_iovlen = 1;
+	m.msg_control = _controllen ? _control + i * _controllen : 0;
+	m.msg_controllen = _controllen;
+	m.msg_flags = 0;
+    }
+    if (n == 0) {
+	errno = ENOMEM;
+	return -1;
+    }
+
+#if HAVE_RECVMMSG
+    int r = recvmmsg(fd, _msgs, n, flags, 0);
+    if (r > 0)
+	++_calls;
+#else
+    int r = 0;
+    while (r < n) {
+	ssize_t len = recvmsg(fd, &_msgs[r].msg_hdr, flags);
+	if (len < 0)
+	    break;
+	_msgs[r].msg_len = len;
+	++_calls;
+	++r;
+    }
+    if (r == 0)
+	r = -1;
+#endif
+    if (r > 0)
+	_packets += r;
+    return r;
+}
+
+/** @brief Return the packet for datagram @a i of the last receive().
+ *
+ * The packet is trimmed to the datagram's length.  If the datagram was
+ * longer than the snap length, the packet's extra length annotation holds
+ * the number of bytes cut off.  The caller owns the returned packet. */
+WritablePacket *
+MmsgReceiver::take(int i)
+{
+    WritablePacket *p = _p[i];
+    _p[i] = 0;
+    int len = _msgs[i].msg_len;
+    if (len > _snaplen) {
+	assert(p->length() == (uint32_t) _snaplen);
+	SET_EXTRA_LENGTH_ANNO(p, len - _snaplen);
+    } else
+	p->take(_snaplen - len);
+    return p;
+}
+
+/** @brief Find datagram @a i's SO_TIMESTAMP control message.
+ * @return true and set @a ts if the datagram carried a timestamp */
+bool
+MmsgReceiver::timestamp(int i, Timestamp &ts) const
+{
+    const struct msghdr &m = _msgs[i].msg_hdr;
+    if (!m.msg_control)
+	return false;
+    for (struct cmsghdr *c = CMSG_FIRSTHDR(&m); c;
+	 c = CMSG_NXTHDR(const_cast<struct msghdr *>(&m), c))
+	if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_TIMESTAMP) {
+	    struct timeval tv;
+	    memcpy(&tv, CMSG_DATA(c), sizeof(tv));
+	    ts = Timestamp(tv);
+	    return true;
+	}
+    return false;
+}
+
+/** @brief Free the preallocated receive packets. */
+void
+MmsgReceiver::clear()
+{
+    for (int i = 0; i < _vlen; ++i)
+	if (_p[i]) {
+	    _p[i]->kill();
+	    _p[i] = 0;
+	}
+}
+
+
+MmsgSender::MmsgSender()
+    : _vlen(0), _msgs(0), _iov(0), _names(0), _calls(0), _packets(0)
+{
+}
+
+MmsgSender::~MmsgSender()
+{
+    delete[] _msgs;
+    delete[] _iov;
+    delete[] _names;
+}
+
+int
+MmsgSender::configure(int vlen)
+{
+    delete[] _msgs;
+    delete[] _iov;
+    delete[] _names;
+    _vlen = vlen;
+    _msgs = new click_mmsghdr[vlen];
+    _iov = new struct iovec[vlen];
+    _names = new struct sockaddr_storage[vlen];
+    if (!_msgs || !_iov || !_names) {
+	_vlen = 0;
+	return -ENOMEM;
+    }
+    memset(_msgs, 0, sizeof(click_mmsghdr) * vlen);
+    return 0;
+}
+
+void
+MmsgSender::set_name(int i, const void *name, socklen_t namelen)
+{
+    assert(i >= 0 && i < _vlen && namelen <= sizeof(_names[i]));
+    memcpy(&_names[i], name, namelen);
+    _msgs[i].msg_hdr.msg_namelen = namelen;
+}
+
+/** @brief Send datagrams from the front of @a batch to @a fd.
+ * @return the number of datagrams sent, or -1 with errno set
+ *
+ * At most vlen() datagrams are sent.  Sent packets are removed from @a
+ * batch and freed; unsent packets stay in @a batch.  Destination addresses
+ * set with set_name() apply to this send only. */
+int
+MmsgSender::send(int fd, PacketBatch &batch)
+{
+    int n = batch.count() < _vlen ? batch.count() : _vlen;
+    if (n == 0)
+	return 0;
+    Packet *p = batch.front();
+    for (int i = 0; i < n; ++i, p = p->next()) {
+	_iov[i].iov_base = const_cast<unsigned char *>(p->data());
+	_iov[i].iov_len = p->length();
+	struct msghdr &m = _msgs[i].msg_hdr;
+	m.msg_name = m.msg_namelen ? &_names[i] : 0;
+	m.msg_iov = &_iov[i];
+	m.msg_iovlen = 1;
+	m.msg_control = 0;
+	m.msg_controllen = 0;
+	m.msg_flags = 0;
+    }
+
+    int r;
+#if HAVE_SENDMMSG
+    do {
+	r = sendmmsg(fd, _msgs, n, 0);
+    } while (r < 0 && errno == EINTR);
+    if (r > 0)
+	++_calls;
+#else
+    r = 0;
+    while (r < n) {
+	ssize_t len = sendmsg(fd, &_msgs[r].msg_hdr, 0);
+	if (len < 0 && errno == EINTR)
+	    continue;
+	else if (len < 0)
+	    break;
+	++_calls;
+	++r;
+    }
+    if (r == 0)
+	r = -1;
+#endif
+
+    for (int i = 0; i < n; ++i)
+	_msgs[i].msg_hdr.msg_namelen = 0;
+    for (int i = 0; i < r; ++i)
+	batch.pop_front()->kill();
+    if (r > 0)
+	_packets += r;
+    return r;
+}
+
+
+String
+mmsg_unparse_average(uint64_t packets, uint64_t calls)
+{
+    if (!calls)
+	return String::make_stable("0", 1);
+    char buf[40];
+    snprintf(buf, sizeof(buf), "%.2f", (double) packets / calls);
+    return String(buf);
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel)
+ELEMENT_PROVIDES(MmsgBatch)
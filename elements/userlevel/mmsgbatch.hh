@@ -0,0 +1,145 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+#ifndef CLICK_MMSGBATCH_HH
+#define CLICK_MMSGBATCH_HH
+#include <click/packetbatch.hh>
+#include <click/timestamp.hh>
+#include <sys/socket.h>
+#include <sys/uio.h>
+CLICK_DECLS
+
+/*
+ * MmsgReceiver and MmsgSender move up to a vector's worth of datagrams
+ * across a socket with one recvmmsg() or sendmmsg() system call.  Where
+ * those calls are unavailable they fall back to one recvmsg() or sendmsg()
+ * per datagram, so callers need no conditional code.  Both count system
+ * calls and datagrams so elements can report packets per system call.
+ */
+
+#if HAVE_RECVMMSG || HAVE_SENDMMSG
+typedef struct mmsghdr click_mmsghdr;
+#else
+struct click_mmsghdr {
+    struct msghdr msg_hdr;
+    unsigned msg_len;
+};
+#endif
+
+class MmsgReceiver { public:
+
+    MmsgReceiver();
+    ~MmsgReceiver();
+
+    /** @brief Set the vector length and the shape of received packets.
+     * @param vlen maximum datagrams per system call
+     * @param headroom headroom of each received packet
+     * @param snaplen maximum received datagram length
+     * @param control if true, collect SO_TIMESTAMP control messages
+     * @return 0 on success, -ENOMEM on failure
+     *
+     * Call before any receive(). */
+    int configure(int vlen, uint32_t headroom, int snaplen, bool control);
+
+    int vlen() const {
+	return _vlen;
+    }
+
+    int receive(int fd, int n, int flags = MSG_TRUNC);
+    WritablePacket *take(int i);
+
+    /** @brief Return datagram @a i's full length, which may exceed the snap
+     * length. */
+    unsigned length(int i) const {
+	return _msgs[i].msg_len;
+    }
+    /** @brief Return datagram @a i's source address. */
+    const struct sockaddr *name(int i) const {
+	return reinterpret_cast<const struct sockaddr *>(&_names[i]);
+    }
+    /** @brief Return the length of datagram @a i's source address. */
+    socklen_t namelen(int i) const {
+	return _msgs[i].msg_hdr.msg_namelen;
+    }
+    bool timestamp(int i, Timestamp &ts) const;
+
+    void clear();
+
+    uint64_t calls() const {
+	return _calls;
+    }
+    uint64_t packets() const {
+	return _packets;
+    }
+    void reset_stats() {
+	_calls = _packets = 0;
+    }
+
+  private:
+
+    int _vlen;
+    uint32_t _headroom;
+    int _snaplen;
+    int _controllen;
+    click_mmsghdr *_msgs;
+    struct iovec *_iov;
+    struct sockaddr_storage *_names;
+    char *_control;
+    WritablePacket **_p;
+    uint64_t _calls;
+    uint64_t _packets;
+
+    MmsgReceiver(const MmsgReceiver &);
+    MmsgReceiver &operator=(const MmsgReceiver &);
+
+};
+
+class MmsgSender { public:
+
+    MmsgSender();
+    ~MmsgSender();
+
+    /** @brief Set the vector length.
+     * @return 0 on success, -ENOMEM on failure */
+    int configure(int vlen);
+
+    int vlen() const {
+	return _vlen;
+    }
+
+    /** @brief Set the destination address of the @a i'th packet of the
+     * next send().
+     *
+     * If no address is set, the datagram goes to the socket's connected
+     * peer. */
+    void set_name(int i, const void *name, socklen_t namelen);
+
+    int send(int fd, PacketBatch &batch);
+
+    uint64_t calls() const {
+	return _calls;
+    }
+    uint64_t packets() const {
+	return _packets;
+    }
+    void reset_stats() {
+	_calls = _packets = 0;
+    }
+
+  private:
+
+    int _vlen;
+    click_mmsghdr *_msgs;
+    struct iovec *_iov;
+    struct sockaddr_storage *_names;
+    uint64_t _calls;
+    uint64_t _packets;
+
+    MmsgSender(const MmsgSender &);
+    MmsgSender &operator=(const MmsgSender &);
+
+};
+
+/** @brief Return a packets-per-system-call average as a string. */
+String mmsg_unparse_average(uint64_t packets, uint64_t calls);
+
+CLICK_ENDDECLS
+#endif
@@ -0,0 +1,483 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+/*
+ * packetmmap.{cc,hh} -- memory-mapped AF_PACKET rings (TPACKET_V3)
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, subject to the conditions
+ * listed in the Click LICENSE file. These conditions include: you must
+ * preserve this copyright notice, and you cannot mention the copyright
+ * holders in advertising related to the Software without their permission.
+ * The Software is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This
+ * notice is a summary of the Click LICENSE file; the license in that file is
+ * legally binding.
+ */
+
+#include <click/config.h>
+#include "packetmmap.hh"
+#include <click/error.hh>
+#include <click/atomic.hh>
+#include <click/packet_anno.hh>
+#include <click/timestamp.hh>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <net/if.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#ifdef __linux__
+# include <linux/if_packet.h>
+# include <linux/if_ether.h>
+#endif
+CLICK_DECLS
+
+#ifdef TPACKET3_HDRLEN
+
+struct PacketMmapRing {
+
+    struct Block {
+	PacketMmapRing *ring;
+	struct tpacket_block_desc *desc;
+	atomic_uint32_t refcount;	// reader + packets pointing into block
+	bool held;			// packets outlived the reader
+    };
+
+    unsigned char *map;
+    size_t maplen;
+    unsigned nblocks;
+    Block *blocks;
+    atomic_uint32_t refcount;		// owner + held blocks
+    atomic_uint32_t nheld;
+
+    void unref() {
+	if (refcount.dec_and_test()) {
+	    munmap(map, maplen);
+	    delete[] blocks;
+	    delete this;
+	}
+    }
+
+    // Return block @a b to the kernel once nothing points into it.
+    void put(Block &b) {
+	if (b.refcount.dec_and_test()) {
+	    bool held = b.held;
+	    b.held = false;
+	    __sync_synchronize();
+	    b.desc->hdr.bh1.block_status = TP_STATUS_KERNEL;
+	    if (held) {
+		--nheld;
+		unref();
+	    }
+	}
+    }
+
+    static void buffer_destructor(unsigned char *, size_t, void *arg) {
+	Block *b = reinterpret_cast<Block *>(arg);
+	b->ring->put(*b);
+    }
+
+};
+
+static int
+open_ring_socket(const String &ifname, int protocol, ErrorHandler *errh)
+{
+    int fd = socket(PF_PACKET, SOCK_RAW, protocol);
+    if (fd < 0)
+	return errh->error("%s: socket: %s", ifname.c_str(), strerror(errno));
+    int version = TPACKET_V3;
+    if (setsockopt(fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0) {
+	int e = errno;
+	::close(fd);
+	return errh->error("%s: TPACKET_V3: %s", ifname.c_str(), strerror(e));
+    }
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    return fd;
+}
+
+// Bind after the ring exists, so no frame arrives outside the ring.
+static int
+bind_ring_socket(int fd, const String &ifname, int protocol, ErrorHandler *errh)
+{
+    struct ifreq ifr;
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, ifname.c_str(), sizeof(ifr.ifr_name) - 1);
+    if (ioctl(fd, SIOCGIFINDEX, &ifr) != 0)
+	return errh->error("%s: SIOCGIFINDEX: %s", ifname.c_str(), strerror(errno));
+    struct sockaddr_ll sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sll_family = AF_PACKET;
+    sa.sll_protocol = protocol;
+    sa.sll_ifindex = ifr.ifr_ifindex;
+    if (bind(fd, (struct sockaddr *) &sa, sizeof(sa)) != 0)
+	return errh->error("%s: bind: %s", ifname.c_str(), strerror(errno));
+    return 0;
+}
+
+#endif
+
+
+PacketMmapRx::PacketMmapRx()
+    : _fd(-1), _ring(0), _cur(0), _headroom(0), _copy_mode(false),
+      _blocks(0), _copies(0)
+{
+}
+
+PacketMmapRx::~PacketMmapRx()
+{
+    close();
+}
+
+/** @brief Open a TPACKET_V3 receive ring on @a ifname.
+ * @param block_size bytes per block, a multiple of the page size
+ * @param nblocks number of blocks
+ * @param timeout_ms time after which the kernel retires a partly full block
+ * @param headroom headroom reserved before each frame
+ * @return the socket file descriptor, or negative on error */
+int
+PacketMmapRx::open(const String &ifname, unsigned block_size, unsigned nblocks,
+		   unsigned timeout_ms, uint32_t headroom, ErrorHandler *errh)
+{
+#ifdef TPACKET3_HDRLEN
+    int protocol = htons(ETH_P_ALL);
+    _fd = open_ring_socket(ifname, protocol, errh);
+    if (_fd < 0)
+	return -1;
+
+    unsigned reserve = headroom;
+    if (setsockopt(_fd, SOL_PACKET, PACKET_RESERVE, &reserve, sizeof(reserve)) < 0) {
+	errh->error("%s: PACKET_RESERVE: %s", ifname.c_str(), strerror(errno));
+	goto fail;
+    }
+    _headroom = headroom;
+
+    struct tpacket_req3 req;
+    memset(&req, 0, sizeof(req));
+    req.tp_block_size = block_size;
+    req.tp_block_nr = nblocks;
+    req.tp_frame_size = TPACKET_ALIGNMENT << 7;
+    req.tp_frame_nr = (block_size / req.tp_frame_size) * nblocks;
+    req.tp_retire_blk_tov = timeout_ms;
+    if (setsockopt(_fd, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0) {
+	errh->error("%s: PACKET_RX_RING: %s", ifname.c_str(), strerror(errno));
+	goto fail;
+    }
+
+    _ring = new PacketMmapRing;
+    _ring->maplen = (size_t) block_size * nblocks;
+    _ring->map = (unsigned char *) mmap(0, _ring->maplen, PROT_READ | PROT_WRITE,
+					MAP_SHARED | MAP_LOCKED, _fd, 0);
+    if (_ring->map == MAP_FAILED)
+	// MAP_LOCKED can fail under RLIMIT_MEMLOCK
+	_ring->map = (unsigned char *) mmap(0, _ring->maplen, PROT_READ | PROT_WRITE,
+					    MAP_SHARED, _fd, 0);
+    if (_ring->map == MAP_FAILED) {
+	errh->error("%s: mmap: %s", ifname.c_str(), strerror(errno));
+	delete _ring;
+	_ring = 0;
+	goto fail;
+    }
+    _ring->nblocks = nblocks;
+    _ring->blocks = new PacketMmapRing::Block[nblocks];
+    for (unsigned i = 0; i < nblocks; ++i) {
+	PacketMmapRing::Block &b = _ring->blocks[i];
+	b.ring = _ring;
+	b.desc = (struct tpacket_block_desc *) (_ring->map + i * block_size);
+	b.refcount = 0;
+	b.held = false;
+    }
+    _ring->refcount = 1;
+    _ring->nheld = 0;
+    _cur = 0;
+    _copy_mode = false;
+
+    if (bind_ring_socket(_fd, ifname, protocol, errh) < 0)
+	goto fail;
+    return _fd;
+
+  fail:
+    close();
+    return -1;
+#else
+    (void) block_size, (void) nblocks, (void) timeout_ms, (void) headroom;
+    return errh->error("%s: PACKET_MMAP is not supported on this platform", ifname.c_str());
+#endif
+}
+
+/** @brief Parse a PACKET_FANOUT mode name.
+ * @return the mode, or -1 if @a str is not a known mode */
+int
+PacketMmapRx::parse_fanout_mode(const String &str)
+{
+#ifdef PACKET_FANOUT
+    static const struct { const char *name; int mode; } modes[] = {
+	{ "HASH", PACKET_FANOUT_HASH }, { "LB", PACKET_FANOUT_LB },
+	{ "CPU", PACKET_FANOUT_CPU },
+# ifdef PACKET_FANOUT_ROLLOVER
+	{ "ROLLOVER", PACKET_FANOUT_ROLLOVER },
+# endif
+# ifdef PACKET_FANOUT_RND
+	{ "RANDOM", PACKET_FANOUT_RND },
+# endif
+# ifdef PACKET_FANOUT_QM
+	{ "QUEUE", PACKET_FANOUT_QM },
+# endif
+    };
+    for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); ++i)
+	if (str.equals(modes[i].name, -1))
+	    return modes[i].mode;
+#else
+    (void) str;
+#endif
+    return -1;
+}
+
+/** @brief Join the socket to PACKET_FANOUT group @a group.
+ *
+ * Every socket in a group, usually one per FromDevice and thread, receives
+ * a share of the device's packets chosen by @a mode. */
+int
+PacketMmapRx::set_fanout(int group, int mode, ErrorHandler *errh)
+{
+#ifdef PACKET_FANOUT
+    int arg = (group & 0xFFFF) | (mode << 16);
+    if (setsockopt(_fd, SOL_PACKET, PACKET_FANOUT, &arg, sizeof(arg)) < 0)
+	return errh->error("PACKET_FANOUT: %s", strerror(errno));
+    return 0;
+#else
+    (void) group, (void) mode;
+    return errh->error("PACKET_FANOUT is not supported on this platform");
+#endif
+}
+
+void
+PacketMmapRx::close()
+{
+    if (_fd >= 0)
+	::close(_fd);
+    _fd = -1;
+#ifdef TPACKET3_HDRLEN
+    // the mapping outlives the socket while packets point into it
+    if (_ring)
+	_ring->unref();
+#endif
+    _ring = 0;
+}
+
+/** @brief Append the packets of the next ready ring block to @a batch.
+ * @param snaplen maximum packet length
+ * @param outbound if false, skip frames this host sent
+ * @param timestamp if true, set timestamp annotations
+ * @return the number of packets appended, 0 if no block is ready
+ *
+ * Packets get packet type and extra length annotations.  Unless the ring is
+ * congested, packet data points into the ring block. */
+int
+PacketMmapRx::receive_block(PacketBatch &batch, int snaplen, bool outbound,
+			    bool timestamp)
+{
+#ifdef TPACKET3_HDRLEN
+    if (!_ring)
+	return 0;
+    PacketMmapRing::Block &b = _ring->blocks[_cur];
+    if (b.refcount.value() != 0) {
+	// The kernel lapped us and waits for a block that packets still
+	// hold, dropping frames meanwhile.  Packets live too long to share
+	// the ring, so copy from now on.
+	_copy_mode = true;
+	return 0;
+    }
+    if (!(b.desc->hdr.bh1.block_status & TP_STATUS_USER))
+	return 0;
+    __sync_synchronize();
+
+    bool copy = _copy_mode || _ring->nheld.value() >= _ring->nblocks / 2;
+    b.refcount = 1;
+    int n = 0;
+    struct tpacket3_hdr *h = (struct tpacket3_hdr *)
+	((unsigned char *) b.desc + b.desc->hdr.bh1.offset_to_first_pkt);
+    for (unsigned i = 0; i < b.desc->hdr.bh1.num_pkts;
+	 ++i, h = (struct tpacket3_hdr *) ((unsigned char *) h + h->tp_next_offset)) {
+	const struct sockaddr_ll *sll = (const struct sockaddr_ll *)
+	    ((unsigned char *) h + TPACKET_ALIGN(sizeof(struct tpacket3_hdr)));
+	if (sll->sll_pkttype == PACKET_OUTGOING && !outbound)
+	    continue;
+
+	unsigned char *data = (unsigned char *) h + h->tp_mac;
+	uint32_t len = h->tp_snaplen;
+	if (len > (uint32_t) snaplen)
+	    len = snaplen;
+	WritablePacket *p;
+	if (copy)
+	    p = Packet::make(_headroom, data, len, 0);
+	else {
+	    ++b.refcount;
+	    p = Packet::make(data - _headroom, _headroom + len,
+			     PacketMmapRing::buffer_destructor, &b);
+	    if (p)
+		p->pull(_headroom);
+	    else
+		--b.refcount;
+	}
+	if (!p)
+	    break;
+
+	p->set_packet_type_anno((Packet::PacketType) sll->sll_pkttype);
+	if (h->tp_len > len)
+	    SET_EXTRA_LENGTH_ANNO(p, h->tp_len - len);
+	if (timestamp)
+	    p->timestamp_anno() = Timestamp::make_nsec(h->tp_sec, h->tp_nsec);
+	batch.push_back(p);
+	++n;
+    }
+
+    if (copy)
+	_copies += n;
+    else if (b.refcount.value() > 1) {
+	b.held = true;
+	++_ring->nheld;
+	++_ring->refcount;
+    }
+    _ring->put(b);
+    ++_blocks;
+    _cur = (_cur + 1) % _ring->nblocks;
+    return n;
+#else
+    (void) batch, (void) snaplen, (void) outbound, (void) timestamp;
+    return 0;
+#endif
+}
+
+
+PacketMmapTx::PacketMmapTx()
+    : _fd(-1), _map(0), _maplen(0), _frame_size(0), _nframes(0), _cur(0),
+      _pending(0)
+{
+}
+
+PacketMmapTx::~PacketMmapTx()
+{
+    close();
+}
+
+/** @brief Open a TPACKET_V3 transmit ring on @a ifname.
+ * @param frame_size bytes per frame, a power of two no smaller than the
+ * largest packet plus about 64 bytes of frame header
+ * @param nframes number of frames
+ * @return the socket file descriptor, or negative on error
+ *
+ * The socket receives no packets. */
+int
+PacketMmapTx::open(const String &ifname, unsigned frame_size, unsigned nframes,
+		   ErrorHandler *errh)
+{
+#ifdef TPACKET3_HDRLEN
+    _fd = open_ring_socket(ifname, 0, errh);
+    if (_fd < 0)
+	return -1;
+
+    long page_size = sysconf(_SC_PAGESIZE);
+    unsigned block_size = frame_size < (unsigned) page_size ? page_size : frame_size;
+    struct tpacket_req3 req;
+    memset(&req, 0, sizeof(req));
+    req.tp_block_size = block_size;
+    req.tp_frame_size = frame_size;
+    req.tp_block_nr = (nframes * frame_size + block_size - 1) / block_size;
+    req.tp_frame_nr = req.tp_block_nr * (block_size / frame_size);
+    if (setsockopt(_fd, SOL_PACKET, PACKET_TX_RING, &req, sizeof(req)) < 0) {
+	errh->error("%s: PACKET_TX_RING: %s", ifname.c_str(), strerror(errno));
+	goto fail;
+    }
+
+    _maplen = (size_t) req.tp_block_size * req.tp_block_nr;
+    _map = (unsigned char *) mmap(0, _maplen, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+    if (_map == MAP_FAILED) {
+	_map = 0;
+	errh->error("%s: mmap: %s", ifname.c_str(), strerror(errno));
+	goto fail;
+    }
+    _frame_size = frame_size;
+    _nframes = req.tp_frame_nr;
+    _cur = _pending = 0;
+
+    if (bind_ring_socket(_fd, ifname, 0, errh) < 0)
+	goto fail;
+    return _fd;
+
+  fail:
+    close();
+    return -1;
+#else
+    (void) frame_size, (void) nframes;
+    return errh->error("%s: PACKET_MMAP is not supported on this platform", ifname.c_str());
+#endif
+}
+
+void
+PacketMmapTx::close()
+{
+    if (_map)
+	munmap(_map, _maplen);
+    _map = 0;
+    if (_fd >= 0)
+	::close(_fd);
+    _fd = -1;
+}
+
+/** @brief Copy @a p into the next free ring frame.
+ * @return 0 on success, or -1 with errno set to ENOBUFS if the ring is full
+ * or EMSGSIZE if @a p does not fit in a frame
+ *
+ * The frame is not sent until flush(). */
+int
+PacketMmapTx::send_packet(Packet *p)
+{
+#ifdef TPACKET3_HDRLEN
+    struct tpacket3_hdr *h = (struct tpacket3_hdr *) (_map + _cur * _frame_size);
+    if (h->tp_status != TP_STATUS_AVAILABLE
+	&& !(h->tp_status & TP_STATUS_WRONG_FORMAT)) {
+	// kernel still owns the frame; kick it and try later
+	flush();
+	errno = ENOBUFS;
+	return -1;
+    }
+    __sync_synchronize();
+    unsigned offset = TPACKET3_HDRLEN - sizeof(struct sockaddr_ll);
+    if (p->length() > _frame_size - offset) {
+	errno = EMSGSIZE;
+	return -1;
+    }
+    memcpy((unsigned char *) h + offset, p->data(), p->length());
+    h->tp_len = h->tp_snaplen = p->length();
+    h->tp_next_offset = 0;
+    __sync_synchronize();
+    h->tp_status = TP_STATUS_SEND_REQUEST;
+    _cur = (_cur + 1) % _nframes;
+    ++_pending;
+    return 0;
+#else
+    (void) p;
+    errno = EINVAL;
+    return -1;
+#endif
+}
+
+/** @brief Ask the kernel to send all frames queued by send_packet().
+ * @return 0 on success, or -1 with errno set */
+int
+PacketMmapTx::flush()
+{
+    if (!_pending)
+	return 0;
+    _pending = 0;
+    if (send(_fd, 0, 0, MSG_DONTWAIT) < 0 && errno != EAGAIN && errno != ENOBUFS)
+	return -1;
+    return 0;
+}
+
+CLICK_ENDDECLS
+ELEMENT_REQUIRES(userlevel)
+ELEMENT_PROVIDES(PacketMmap)
@@ -0,0 +1,102 @@
+// -*- mode: c++; c-basic-offset: 4 -*-
+#ifndef CLICK_PACKETMMAP_HH
+#define CLICK_PACKETMMAP_HH
+#include <click/packetbatch.hh>
+#include <click/string.hh>
+CLICK_DECLS
+class ErrorHandler;
+struct PacketMmapRing;
+
+/*
+ * PacketMmapRx and PacketMmapTx drive Linux memory-mapped AF_PACKET rings
+ * (PACKET_MMAP, TPACKET_V3) for FromDevice and ToDevice METHOD PACKET_MMAP.
+ *
+ * The receive ring is a list of blocks, each holding the frames that
+ * arrived before the block filled or timed out.  PacketMmapRx hands over a
+ * whole block at a time.  Its packets point directly into the ring; the
+ * block goes back to the kernel when the last of them dies.  Packets held
+ * for a long time, for instance in a Queue, therefore hold ring blocks, and
+ * the kernel stops filling the ring when it reaches a held block.  While
+ * half the blocks are held, and for good once the kernel has caught up with
+ * a held block, PacketMmapRx copies new frames into ordinary packets
+ * instead.
+ *
+ * The transmit ring is a list of frames.  PacketMmapTx copies each packet
+ * into the next free frame, and flush() asks the kernel to send all queued
+ * frames with one system call.
+ */
+
+class PacketMmapRx { public:
+
+    PacketMmapRx();
+    ~PacketMmapRx();
+
+    int open(const String &ifname, unsigned block_size, unsigned nblocks,
+	     unsigned timeout_ms, uint32_t headroom, ErrorHandler *errh);
+    int set_fanout(int group, int mode, ErrorHandler *errh);
+    void close();
+
+    int fd() const {
+	return _fd;
+    }
+
+    int receive_block(PacketBatch &batch, int snaplen, bool outbound,
+		      bool timestamp);
+
+    uint64_t blocks() const {
+	return _blocks;
+    }
+    uint64_t copies() const {
+	return _copies;
+    }
+
+    static int parse_fanout_mode(const String &str);
+
+  private:
+
+    int _fd;
+    PacketMmapRing *_ring;
+    unsigned _cur;
+    uint32_t _headroom;
+    bool _copy_mode;
+    uint64_t _blocks;
+    uint64_t _copies;
+
+    PacketMmapRx(const PacketMmapRx &);
+    PacketMmapRx &operator=(const PacketMmapRx &);
+
+};
+
+class PacketMmapTx { public:
+
+    PacketMmapTx();
+    ~PacketMmapTx();
+
+    int open(const String &ifname, unsigned frame_size, unsigned nframes,
+	     ErrorHandler *errh);
+    void close();
+
+    int fd() const {
+	return _fd;
+    }
+
+    int send_packet(Packet *p);
+    int flush();
+
+  private:
+
+    int _fd;
+    unsigned char *_map;
+    size_t _maplen;
+    unsigned _frame_size;
+    unsigned _nframes;
+    unsigned _cur;
+    unsigned _pending;
+
+    PacketMmapTx(const PacketMmapTx &);
+    PacketMmapTx &operator=(const PacketMmapTx &);
+
+};
+
+CLICK_ENDDECLS
+#endif
@@ -48,7 +48,7 @@ CLICK_DECLS
 RawSocket::RawSocket()
   : _task(this), _timer(this),
     _fd(-1), _port_register_socket(-1), _port(0), _snaplen(2048),
-    _headroom(Packet::default_headroom), _rq(0), _wq(0)
+    _headroom(Packet::default_headroom), _burst(1)
 {
 }
 
@@ -69,8 +69,11 @@ RawSocket::configure(Vector<String> &conf, ErrorHandler *errh)
     args.read_p("PORT", _port);
   if (args.read("SNAPLEN", _snaplen)
       .read("HEADROOM", _headroom)
+      .read("BURST", _burst)
       .complete() < 0)
     return -1;
+  if (_burst <= 0)
+    return errh->error("BURST out of range");
 
   return 0;
 }
@@ -141,6 +144,18 @@ RawSocket::initialize(ErrorHandler *errh)
   if (setsockopt(_fd, SOL_SOCKET, SO_BROADCAST, &one, sizeof(one)) < 0)
     return initialize_socket_error(errh, "SO_BROADCAST");
 
+#ifdef SO_TIMESTAMP
+  // timestamp received packets without an ioctl per packet
+  one = 1;
+  (void) setsockopt(_fd, SOL_SOCKET, SO_TIMESTAMP, &one, sizeof(one));
+#endif
+
+  if ((noutputs() && _rx.configure(_burst, _headroom, _snaplen, true) < 0)
+      || (ninputs() && _tx.configure(_burst) < 0)) {
+    errno = ENOMEM;
+    return initialize_socket_error(errh, "configure");
+  }
+
   if (noutputs())
     add_select(_fd, SELECT_READ);
 
@@ -156,10 +171,8 @@ RawSocket::initialize(ErrorHandler *errh)
 void
 RawSocket::cleanup(CleanupStage)
 {
-  if (_rq)
-    _rq->kill();
-  if (_wq)
-    _wq->kill();
+  _rx.clear();
+  _wq.kill();
   if (_fd >= 0) {
     close(_fd);
     remove_select(_fd, SELECT_READ | SELECT_WRITE);
@@ -171,92 +184,75 @@ void
 RawSocket::selected(int fd, int)
 {
   ErrorHandler *errh = ErrorHandler::default_handler();
-  int len;
 
   if (noutputs()) {
-    // read data from socket
-    if (!_rq)
-      _rq = Packet::make(_headroom, (const unsigned char *)0, _snaplen, 0);
-    if (_rq) {
-      len = recv(_fd, _rq->data(), _rq->length(), MSG_TRUNC);
-      if (len > 0) {
-	if (len > _snaplen) {
-	  assert(_rq->length() == (uint32_t)_snaplen);
-	  SET_EXTRA_LENGTH_ANNO(_rq, len - _snaplen);
-	} else
-	  _rq->take(_snaplen - len);
-	// set timestamp
-	(void) ioctl(fd, SIOCGSTAMP, &_rq->timestamp_anno());
-	// set IP annotations
-	if (fake_pcap_force_ip(_rq, FAKE_DLT_RAW))
-	  output(0).push(_rq);
-	else
-	  _rq->kill();
-	_rq = 0;
-      } else {
-	if (len == 0 || errno != EAGAIN) {
-	  if (errno != EAGAIN)
-	    errh->error("recv: %s", strerror(errno));
-	}
-      }
+    // read packets from socket
+    PacketBatch batch;
+    int n = _rx.receive(_fd, _burst);
+    for (int i = 0; i < n; ++i) {
+      if (_rx.length(i) == 0)
+	continue;
+      WritablePacket *p = _rx.take(i);
+      // set timestamp
+      if (!_rx.timestamp(i, p->timestamp_anno()))
+	(void) ioctl(fd, SIOCGSTAMP, &p->timestamp_anno());
+      // set IP annotations
+      if (fake_pcap_force_ip(p, FAKE_DLT_RAW))
+	batch.push_back(p);
+      else
+	p->kill();
     }
+    output(0).push_batch(batch);
+    if (n < 0 && errno != EAGAIN)
+      errh->error("recv: %s", strerror(errno));
   }
 
   if (ninputs()) {
-    // write data to socket
-    Packet *p;
-    if (_wq) {
-      p = _wq;
-      _wq = 0;
-    } else {
-      p = input(0).pull();
-    }
-    if (p) {
+    // write packets to socket
+    while (_wq.count() < _burst) {
+      Packet *p = input(0).pull();
+      if (!p)
+	break;
       // cast to int so very large plen is interpreted as negative
       if ((int)p->length() < (int)sizeof(click_ip)) {
 	errh->error("runt IP packet (%d bytes)", p->length());
 	p->kill();
-      } else {
-	const click_ip *ip = (const click_ip *) p->data();
-	struct sockaddr_in sin;
+      } else
+	_wq.push_back(p);
+    }
+    bool any = !_wq.empty();
 
-	// set up destination
+    while (!_wq.empty()) {
+      // set up destinations
+      int i = 0;
+      for (Packet *p = _wq.front(); p && i < _tx.vlen(); p = p->next(), ++i) {
+	struct sockaddr_in sin;
 	memset(&sin, 0, sizeof(sin));
 	sin.sin_family = PF_INET;
-	sin.sin_addr = ip->ip_dst;
-
-	while (p->length()) {
-	  // send packet
-	  len = sendto(_fd, p->data(), p->length(), 0,
-		       (const struct sockaddr*)&sin, sizeof(sin));
-	  if (len < 0) {
-	    if (errno == ENOBUFS || errno == EAGAIN) {
-	      // socket queue full, try again later
-	      _wq = p;
-	      remove_select(_fd, SELECT_WRITE);
-	      _events &= ~SELECT_WRITE;
-	      _backoff = (!_backoff) ? 1 : _backoff*2;
-	      _timer.schedule_after(Timestamp::make_usec(_backoff));
-	      return;
-	    } else if (errno == EINTR) {
-	      // interrupted by signal, try again immediately
-	      continue;
-	    } else {
-	      // unexpected error: drop packet
-	      errh->error("sendto: %s", strerror(errno));
-	      break;
-	    }
-	  } else {
-	    p->pull(len);
-	  }
+	sin.sin_addr = reinterpret_cast<const click_ip *>(p->data())->ip_dst;
+	_tx.set_name(i, &sin, sizeof(sin));
+      }
+
+      // send packets
+      if (_tx.send(_fd, _wq) < 0) {
+	if (errno == ENOBUFS || errno == EAGAIN) {
+	  // socket queue full, try again later
+	  remove_select(_fd, SELECT_WRITE);
+	  _events &= ~SELECT_WRITE;
+	  _backoff = (!_backoff) ? 1 : _backoff*2;
+	  _timer.schedule_after(Timestamp::make_usec(_backoff));
+	  return;
+	} else {
+	  // unexpected error: drop packet
+	  errh->error("sendto: %s", strerror(errno));
+	  _wq.pop_front()->kill();
 	}
-	_backoff = 0;
-	p->kill();
       }
     }
+    _backoff = 0;
 
     // nothing to write, wait for upstream signal
-    if (!p && !_signal && (_events & SELECT_WRITE)) {
+    if (!any && !_signal && (_events & SELECT_WRITE)) {
       remove_select(_fd, SELECT_WRITE);
       _events &= ~SELECT_WRITE;
     }
@@ -266,7 +262,7 @@ RawSocket::selected(int fd, int)
 void
 RawSocket::run_timer(Timer *)
 {
-  if ((_wq || _signal) && !(_events & SELECT_WRITE) && _fd >= 0) {
+  if ((!_wq.empty() || _signal) && !(_events & SELECT_WRITE) && _fd >= 0) {
     add_select(_fd, SELECT_WRITE);
     _events |= SELECT_WRITE;
     selected(_fd, 0);
@@ -276,7 +272,7 @@ RawSocket::run_timer(Timer *)
 bool
 RawSocket::run_task(Task *)
 {
-  if (!_wq && !(_events & SELECT_WRITE) && _fd >= 0) {
+  if (_wq.empty() && !(_events & SELECT_WRITE) && _fd >= 0) {
     add_select(_fd, SELECT_WRITE);
     _events |= SELECT_WRITE;
     selected(_fd, 0);
@@ -285,12 +281,34 @@ RawSocket::run_task(Task *)
     return false;
 }
 
+String
+RawSocket::read_handler(Element *e, void *thunk)
+{
+  RawSocket *rs = static_cast<RawSocket *>(e);
+  if (thunk == (void *) 0)
+    return mmsg_unparse_average(rs->_rx.packets(), rs->_rx.calls());
+  else
+    return mmsg_unparse_average(rs->_tx.packets(), rs->_tx.calls());
+}
+
+int
+RawSocket::write_handler(const String &, Element *e, void *, ErrorHandler *)
+{
+  RawSocket *rs = static_cast<RawSocket *>(e);
+  rs->_rx.reset_stats();
+  rs->_tx.reset_stats();
+  return 0;
+}
+
 void
 RawSocket::add_handlers()
 {
   add_task_handlers(&_task);
+  add_read_handler("recv_per_syscall", read_handler, 0);
+  add_read_handler("send_per_syscall", read_handler, 1);
+  add_write_handler("reset_counts", write_handler, 0, Handler::BUTTON);
 }
 
 CLICK_ENDDECLS
-ELEMENT_REQUIRES(userlevel linux)
+ELEMENT_REQUIRES(userlevel linux MmsgBatch)
 EXPORT_ELEMENT(RawSocket)
@@ -5,6 +5,7 @@
 #include <click/task.hh>
 #include <click/timer.hh>
 #include <click/notifier.hh>
+#include "mmsgbatch.hh"
 CLICK_DECLS
 
 /*
@@ -47,12 +48,31 @@ by this element. This could be useful for encapsulation protocols
 which add headers to the packet, and can avoid expensive push
 operations later in the packet's life.
 
+=item BURST
+
+Integer. Maximum number of packets received, or sent, per system call.
+Where available, RawSocket uses recvmmsg() and sendmmsg() to move a whole
+burst at once, and pushes the packets received together to its output as
+one batch. Default is 1.
+
 =back
 
 =e
 
   RawSocket(UDP, 53) -> ...
 
+=h recv_per_syscall read-only
+
+Returns the average number of packets received per receiving system call.
+
+=h send_per_syscall read-only
+
+Returns the average number of packets sent per sending system call.
+
+=h reset_counts write-only
+
+Resets "recv_per_syscall" and "send_per_syscall".
+
 =a Socket */
 
 class RawSocket : public Element { public:
@@ -86,15 +106,20 @@ private:
   uint16_t _port;		// (PlanetLab only) port to bind
   int _snaplen;			// maximum received packet length
   unsigned _headroom;           // header length to set aside in the packet
+  int _burst;			// maximum packets per system call
 
   NotifierSignal _signal;	// packet is available to pull()
-  WritablePacket *_rq;		// queue to receive pulled packets
+  MmsgReceiver _rx;		// receive vector
+  MmsgSender _tx;		// send vector
   int _backoff;			// backoff timer for when sendto() blocks
-  Packet *_wq;			// queue to store pulled packet for when sendto() blocks
+  PacketBatch _wq;		// queue to store pulled packets for when sendto() blocks
   int _events;			// keeps track of the events for which select() is waiting
 
   int initialize_socket_error(ErrorHandler *, const char *);
 
+  static String read_handler(Element *, void *) CLICK_COLD;
+  static int write_handler(const String &, Element *, void *, ErrorHandler *) CLICK_COLD;
+
 };
 
 CLICK_ENDDECLS
@@ -41,10 +41,10 @@ CLICK_DECLS
 
 Socket::Socket()
   : _task(this), _timer(this),
-    _fd(-1), _active(-1), _rq(0), _wq(0),
+    _fd(-1), _active(-1), _rq(0),
     _local_port(0), _local_pathname(""),
     _timestamp(true), _sndbuf(-1), _rcvbuf(-1),
-    _snaplen(2048), _headroom(Packet::default_headroom), _nodelay(1),
+    _snaplen(2048), _burst(1), _headroom(Packet::default_headroom), _nodelay(1),
     _verbose(false), _client(false), _proper(false), _allow(0), _deny(0)
 {
 }
@@ -68,6 +68,7 @@ Socket::configure(Vector<String> &conf, ErrorHandler *errh)
   if (args.read("VERBOSE", _verbose)
       .read("SNAPLEN", _snaplen)
       .read("HEADROOM", _headroom)
+      .read("BURST", _burst)
       .read("TIMESTAMP", _timestamp)
       .read("RCVBUF", _rcvbuf)
       .read("SNDBUF", _sndbuf)
@@ -79,6 +80,9 @@ Socket::configure(Vector<String> &conf, ErrorHandler *errh)
       .consume() < 0)
     return -1;
 
+  if (_burst <= 0)
+    return errh->error("BURST out of range");
+
   if (allow && !(_allow = (IPRouteTable *)allow->cast("IPRouteTable")))
     return errh->error("%s is not an IPRouteTable", allow->name().c_str());
 
@@ -252,6 +256,14 @@ Socket::initialize(ErrorHandler *errh)
   fcntl(_fd, F_SETFL, O_NONBLOCK);
   fcntl(_fd, F_SETFD, FD_CLOEXEC);
 
+  // datagram sockets move up to BURST datagrams per system call
+  if (_socktype != SOCK_STREAM
+      && ((noutputs() && _rx.configure(_burst, _headroom, _snaplen, _timestamp) < 0)
+	  || (ninputs() && _tx.configure(_burst) < 0))) {
+    errno = ENOMEM;
+    return initialize_socket_error(errh, "configure");
+  }
+
   if (noutputs())
     add_select(_fd, SELECT_READ);
 
@@ -274,8 +286,8 @@ Socket::cleanup(CleanupStage)
   }
   if (_rq)
     _rq->kill();
-  if (_wq)
-    _wq->kill();
+  _rx.clear();
+  _wq.kill();
   if (_fd >= 0) {
     // shut down the listening socket in case we forked
 #ifdef SHUT_RDWR
@@ -359,58 +371,79 @@ Socket::selected(int fd, int)
       _events = SELECT_READ | SELECT_WRITE;
     }
 
-    // read data from socket
-    if (!_rq)
-      _rq = Packet::make(_headroom, 0, _snaplen, 0);
-    if (_rq) {
-      if (_socktype == SOCK_STREAM)
-	len = read(_active, _rq->data(), _rq->length());
-      else if (_client)
-	len = recv(_active, _rq->data(), _rq->length(), MSG_TRUNC);
-      else {
-	// datagram server, find out who we are talking to
-	len = recvfrom(_active, _rq->data(), _rq->length(), MSG_TRUNC, (struct sockaddr *)&from, &from_len);
-
-	if (_family == AF_INET && !allowed(IPAddress(from.in.sin_addr))) {
-	  if (_verbose)
-	    click_chatter("%s: dropped datagram from %s:%d", declaration().c_str(),
-			  IPAddress(from.in.sin_addr).unparse().c_str(), ntohs(from.in.sin_port));
-	  len = -1;
-	  errno = EAGAIN;
-	} else if (len > 0) {
-	  memcpy(&_remote, &from, from_len);
-	  _remote_len = from_len;
+    // read datagrams from socket
+    if (_socktype != SOCK_STREAM) {
+      PacketBatch batch;
+      int n = _rx.receive(_active, _burst);
+
+      for (int i = 0; i < n; ++i) {
+	if (_rx.length(i) == 0)
+	  continue;
+
+	if (!_client) {
+	  // datagram server, find out who we are talking to
+	  const struct sockaddr_in *sin = reinterpret_cast<const struct sockaddr_in *>(_rx.name(i));
+	  if (_family == AF_INET && !allowed(IPAddress(sin->sin_addr))) {
+	    if (_verbose)
+	      click_chatter("%s: dropped datagram from %s:%d", declaration().c_str(),
+			    IPAddress(sin->sin_addr).unparse().c_str(), ntohs(sin->sin_port));
+	    continue;
+	  }
+	  memcpy(&_remote, _rx.name(i), _rx.namelen(i));
+	  _remote_len = _rx.namelen(i);
 	}
-      }
 
-      // this segment OK
-      if (len > 0) {
-	if (len > _snaplen) {
-	  // truncate packet to max length (should never happen)
-	  assert(_rq->length() == (uint32_t)_snaplen);
-	  SET_EXTRA_LENGTH_ANNO(_rq, len - _snaplen);
-	} else {
-	  // trim packet to actual length
-	  _rq->take(_snaplen - len);
-	}
+	WritablePacket *p = _rx.take(i);
 
 	// set timestamp
-	if (_timestamp)
-	  _rq->timestamp_anno().assign_now();
+	if (_timestamp && !_rx.timestamp(i, p->timestamp_anno()))
+	  p->timestamp_anno().assign_now();
 
-	// push packet
-	output(0).push(_rq);
-	_rq = 0;
+	batch.push_back(p);
       }
 
-      // connection terminated or fatal error
-      else if (len == 0 || errno != EAGAIN) {
-	if (errno != EAGAIN && _verbose)
+      // push datagrams
+      output(0).push_batch(batch);
+
+      // fatal error
+      if (n < 0 && errno != EAGAIN) {
+	if (_verbose)
 	  click_chatter("%s: %s", declaration().c_str(), strerror(errno));
 	close_active();
 	return;
       }
     }
+
+    // read data from stream socket
+    else {
+      if (!_rq)
+	_rq = Packet::make(_headroom, 0, _snaplen, 0);
+      if (_rq) {
+	len = read(_active, _rq->data(), _rq->length());
+
+	// this segment OK
+	if (len > 0) {
+	  // trim packet to actual length
+	  _rq->take(_snaplen - len);
+
+	  // set timestamp
+	  if (_timestamp)
+	    _rq->timestamp_anno().assign_now();
+
+	  // push packet
+	  output(0).push(_rq);
+	  _rq = 0;
+	}
+
+	// connection terminated or fatal error
+	else if (len == 0 || errno != EAGAIN) {
+	  if (errno != EAGAIN && _verbose)
+	    click_chatter("%s: %s", declaration().c_str(), strerror(errno));
+	  close_active();
+	  return;
+	}
+      }
+    }
   }
 
   if (ninputs() && input_is_pull(0))
@@ -494,6 +527,37 @@ Socket::push(int, Packet *p)
     p->kill();
 }
 
+int
+Socket::write_batch()
+{
+  assert(_active >= 0 && _socktype != SOCK_STREAM);
+
+  while (!_wq.empty()) {
+    int i = 0;
+    for (Packet *p = _wq.front(); p && i < _tx.vlen(); p = p->next(), ++i) {
+      if (!IPAddress(_remote_ip) && _client && _family == AF_INET)
+	// If the IP address specified when the element was created is 0.0.0.0,
+	// send the packet to its IP destination annotation address
+	_remote.in.sin_addr = p->dst_ip_anno();
+      _tx.set_name(i, &_remote, _remote_len);
+    }
+
+    if (_tx.send(_active, _wq) < 0) {
+      // out of memory or would block
+      if (errno == ENOBUFS || errno == EAGAIN)
+	return -1;
+
+      // connection probably terminated or other fatal error
+      if (_verbose)
+	click_chatter("%s: %s", declaration().c_str(), strerror(errno));
+      close_active();
+      _wq.kill();
+    }
+  }
+
+  return 0;
+}
+
 bool
 Socket::run_task(Task *)
 {
@@ -501,25 +565,34 @@ Socket::run_task(Task *)
   bool any = false;
 
   if (_active >= 0) {
-    Packet *p = 0;
+    int burst = (_socktype == SOCK_STREAM ? 1 : _burst);
     int err = 0;
 
     // write as much as we can
     do {
-      p = _wq ? _wq : input(0).pull();
-      _wq = 0;
-      if (p) {
-	any = true;
-	err = write_packet(p);
+      while (_wq.count() < burst) {
+	Packet *p = input(0).pull();
+	if (!p)
+	  break;
+	_wq.push_back(p);
       }
-    } while (p && err >= 0);
-
-    if (err < 0) {
-      // queue packet for writing when socket becomes available
-      _wq = p;
-      p = 0;
+      if (_wq.empty())
+	break;
+      any = true;
+      if (_socktype == SOCK_STREAM) {
+	Packet *p = _wq.pop_front();
+	if ((err = write_packet(p)) < 0)
+	  _wq.push_back(p);
+      } else
+	err = write_batch();
+    } while (err >= 0 && _active >= 0);
+
+    if (_active < 0)
+      /* connection closed */;
+    else if (err < 0)
+      // queue packets for writing when socket becomes available
       add_select(_active, SELECT_WRITE);
-    } else if (_signal)
+    else if (_signal)
       // more pending
       // (can't use fast_reschedule() cause selected() calls this)
       _task.reschedule();
@@ -532,12 +605,34 @@ Socket::run_task(Task *)
   return any;
 }
 
+String
+Socket::read_handler(Element *e, void *thunk)
+{
+  Socket *s = static_cast<Socket *>(e);
+  if (thunk == (void *) 0)
+    return mmsg_unparse_average(s->_rx.packets(), s->_rx.calls());
+  else
+    return mmsg_unparse_average(s->_tx.packets(), s->_tx.calls());
+}
+
+int
+Socket::write_handler(const String &, Element *e, void *, ErrorHandler *)
+{
+  Socket *s = static_cast<Socket *>(e);
+  s->_rx.reset_stats();
+  s->_tx.reset_stats();
+  return 0;
+}
+
 void
 Socket::add_handlers()
 {
   add_task_handlers(&_task);
+  add_read_handler("recv_per_syscall", read_handler, 0);
+  add_read_handler("send_per_syscall", read_handler, 1);
+  add_write_handler("reset_counts", write_handler, 0, Handler::BUTTON);
 }
 
 CLICK_ENDDECLS
-ELEMENT_REQUIRES(userlevel IPRouteTable)
+ELEMENT_REQUIRES(userlevel IPRouteTable MmsgBatch)
 EXPORT_ELEMENT(Socket)
@@ -7,6 +7,7 @@
 #include <click/timer.hh>
 #include <click/notifier.hh>
 #include "../ip/iproutetable.hh"
+#include "mmsgbatch.hh"
 #include <sys/un.h>
 CLICK_DECLS
 
@@ -142,6 +143,13 @@ Boolean. PlanetLab specific. If true and Click has been configured
 
 Integer. Per-packet headroom. Defaults to 28.
 
+=item BURST
+
+Integer. Applies to datagram sockets only. Maximum number of datagrams
+received, or sent, per system call. Where available, Socket uses recvmmsg()
+and sendmmsg() to move a whole burst at once, and pushes the datagrams
+received together to its output as one batch. Default is 1.
+
 =back
 
 =e
@@ -167,6 +175,21 @@ Integer. Per-packet headroom. Defaults to 28.
   allow -> deny -> allow; // (makes the configuration valid)
   Socket(TCP, 0.0.0.0, 80, ALLOW allow, DENY deny) -> ...
 
+  // A UDP tunnel endpoint moving up to 32 datagrams per system call
+  ... -> Socket(UDP, 1.2.3.4, 4000, 0.0.0.0, 4000, BURST 32) -> ...
+
+=h recv_per_syscall read-only
+
+Returns the average number of datagrams received per receiving system call.
+
+=h send_per_syscall read-only
+
+Returns the average number of datagrams sent per sending system call.
+
+=h reset_counts write-only
+
+Resets "recv_per_syscall" and "send_per_syscall".
+
 =a RawSocket */
 
 class Socket : public Element { public:
@@ -193,6 +216,7 @@ class Socket : public Element { public:
   bool allowed(IPAddress);
   void close_active(void);
   int write_packet(Packet*);
+  int write_batch();
 
 protected:
   Task _task;
@@ -214,7 +238,9 @@ private:
   NotifierSignal _signal;	// packet is available to pull()
   WritablePacket *_rq;		// queue to receive pulled packets
   int _backoff;			// backoff timer for when sendto() blocks
-  Packet *_wq;			// queue to store pulled packet for when sendto() blocks
+  PacketBatch _wq;		// queue to store pulled packets for when sendto() blocks
+  MmsgReceiver _rx;		// datagram receive vector
+  MmsgSender _tx;		// datagram send vector
   int _events;			// keeps track of the events for which select() is waiting
 
   int _family;			// AF_INET or AF_UNIX
@@ -231,6 +257,7 @@ private:
   int _sndbuf;			// maximum socket send buffer in bytes
   int _rcvbuf;			// maximum socket receive buffer in bytes
   int _snaplen;			// maximum received packet length
+  int _burst;			// maximum datagrams per system call
   unsigned _headroom;
   int _nodelay;			// disable Nagle algorithm
   bool _verbose;		// be verbose
@@ -241,6 +268,9 @@ private:
 
   int initialize_socket_error(ErrorHandler *, const char *);
 
+  static String read_handler(Element *, void *) CLICK_COLD;
+  static int write_handler(const String &, Element *, void *, ErrorHandler *) CLICK_COLD;
+
 };
 
 CLICK_ENDDECLS
@@ -61,7 +61,7 @@
 CLICK_DECLS
 
 ToDevice::ToDevice()
-    : _task(this), _timer(&_task), _q(0), _pulls(0)
+    : _task(this), _timer(&_task), _pulls(0)
 {
 #if TODEVICE_ALLOW_PCAP
     _pcap = 0;
@@ -82,11 +82,17 @@ ToDevice::configure(Vector<String> &conf, ErrorHandler *errh)
 {
     String method;
     _burst = 1;
+#if TODEVICE_ALLOW_LINUX
+    _ring_frames = 1024;
+#endif
     if (Args(conf, this, errh)
 	.read_mp("DEVNAME", _ifname)
 	.read("DEBUG", _debug)
 	.read("METHOD", WordArg(), method)
 	.read("BURST", _burst)
+#if TODEVICE_ALLOW_LINUX
+	.read("RING_FRAMES", _ring_frames)
+#endif
 	.complete() < 0)
 	return -1;
     if (!_ifname)
@@ -108,6 +114,8 @@ ToDevice::configure(Vector<String> &conf, ErrorHandler *errh)
 #if TODEVICE_ALLOW_LINUX
     else if (method == "LINUX")
 	_method = method_linux;
+    else if (method == "PACKET_MMAP")
+	_method = method_packet_mmap;
 #endif
 #if TODEVICE_ALLOW_DEVBPF
     else if (method == "DEVBPF")
@@ -157,6 +165,8 @@ ToDevice::initialize(ErrorHandler *errh)
 #if FROMDEVICE_ALLOW_LINUX && TODEVICE_ALLOW_LINUX
 	if (fd->linux_fd() >= 0)
 	    _method = method_linux;
+	if (fd->packet_mmap())
+	    _method = method_packet_mmap;
 #endif
     }
 
@@ -234,6 +244,12 @@ ToDevice::initialize(ErrorHandler *errh)
 	}
 	_method = method_linux;
     }
+
+    if (_method == method_packet_mmap) {
+	_fd = _mmap.open(_ifname, 2048, _ring_frames, errh);
+	if (_fd < 0)
+	    return -1;
+    }
 #endif
 
 #if TODEVICE_ALLOW_PCAPFD
@@ -261,6 +277,7 @@ ToDevice::initialize(ErrorHandler *errh)
 void
 ToDevice::cleanup(CleanupStage)
 {
+    _q.kill();
 #if TODEVICE_ALLOW_PCAP
     if (_pcap && _my_pcap)
 	pcap_close(_pcap);
@@ -272,6 +289,12 @@ ToDevice::cleanup(CleanupStage)
 	_fd = -1;
     }
 #endif
+#if TODEVICE_ALLOW_LINUX
+    if (_method == method_packet_mmap) {
+	_mmap.close();
+	_fd = -1;
+    }
+#endif
 #if TODEVICE_ALLOW_LINUX || TODEVICE_ALLOW_DEVBPF || TODEVICE_ALLOW_PCAPFD || TODEVICE_ALLOW_NETMAP
     if (_fd >= 0 && _my_fd)
 	close(_fd);
@@ -319,6 +342,8 @@ ToDevice::send_packet(Packet *p)
 #if TODEVICE_ALLOW_LINUX
     if (_method == method_linux)
 	r = send(_fd, p->data(), p->length(), 0);
+    else if (_method == method_packet_mmap)
+	r = _mmap.send_packet(p);
 #endif
 
 #if TODEVICE_ALLOW_DEVBPF
@@ -342,29 +367,30 @@ ToDevice::send_packet(Packet *p)
 bool
 ToDevice::run_task(Task *)
 {
-    Packet *p = _q;
-    _q = 0;
-    int count = 0, r = 0;
-
-    do {
-	if (!p) {
-	    ++_pulls;
-	    if (!(p = input(0).pull()))
-		break;
-	}
-	if ((r = send_packet(p)) >= 0) {
-	    _backoff = 0;
-	    checked_output_push(0, p);
-	    ++count;
-	    p = 0;
-	} else
+    if (_q.empty()) {
+	++_pulls;
+	_q = input(0).pull_batch(_burst);
+    }
+
+    PacketBatch sent;
+    Packet *p;
+    int r = 0;
+
+    while ((p = _q.front())) {
+	if ((r = send_packet(p)) < 0)
 	    break;
-    } while (count < _burst);
+	_backoff = 0;
+	sent.push_back(_q.pop_front());
+    }
+#if TODEVICE_ALLOW_LINUX
+    // PACKET_MMAP sends the whole batch at once
+    if (_method == method_packet_mmap && _mmap.flush() < 0)
+	click_chatter("ToDevice(%s): %s", _ifname.c_str(), strerror(errno));
+#endif
+    int count = sent.count();
+    checked_output_push_batch(0, sent);
 
     if (r == -ENOBUFS || r == -EAGAIN) {
-	assert(!_q);
-	_q = p;
-
 	if (!_backoff) {
 	    _backoff = 1;
 	    add_select(_fd, SELECT_WRITE);
@@ -380,10 +406,10 @@ ToDevice::run_task(Task *)
 	return count > 0;
     } else if (r < 0) {
 	click_chatter("ToDevice(%s): %s", _ifname.c_str(), strerror(-r));
-	checked_output_push(1, p);
+	checked_output_push(1, _q.pop_front());
     }
 
-    if (p || _signal)
+    if (!_q.empty() || r < 0 || _signal)
 	_task.fast_reschedule();
     return count > 0;
 }
@@ -408,7 +434,7 @@ ToDevice::read_param(Element *e, void *thunk)
     case h_pulls:
 	return String(td->_pulls);
     case h_q:
-	return String((bool) td->_q);
+	return String(!td->_q.empty());
     default:
 	return String();
     }
@@ -29,6 +29,7 @@ CLICK_DECLS
  * =item BURST
  *
  * Integer. Maximum number of packets to pull per scheduling. Defaults to 1.
+ * ToDevice pulls the packets for one scheduling as a single batch.
  *
  * =item METHOD
  *
@@ -38,6 +39,15 @@ CLICK_DECLS
  * specified for a matching L<FromDevice(n)>, or the first supported
  * method among NETMAP, PCAP, DEVBPF, LINUX and PCAPFD otherwise.
  *
+ * Linux targets also support PACKET_MMAP, which copies packets into a
+ * memory-mapped TPACKET_V3 transmit ring and hands each pulled batch to the
+ * kernel with a single system call.
+ *
+ * =item RING_FRAMES
+ *
+ * Unsigned. Number of 2048-byte frames in the PACKET_MMAP transmit ring.
+ * Defaults to 1024.
+ *
  * =item DEBUG
  *
  * Boolean.  If true, print out debug messages.
@@ -120,11 +130,16 @@ class ToDevice : public Element { public:
 #if TODEVICE_ALLOW_NETMAP
     NetmapInfo _netmap;
 #endif
-    enum { method_default, method_netmap, method_linux, method_pcap, method_devbpf, method_pcapfd };
+#if TODEVICE_ALLOW_LINUX
+    PacketMmapTx _mmap;
+    unsigned _ring_frames;
+#endif
+    enum { method_default, method_netmap, method_linux, method_pcap, method_devbpf, method_pcapfd,
+	   method_packet_mmap };
     int _method;
     NotifierSignal _signal;
 
-    Packet *_q;
+    PacketBatch _q;
     int _burst;
 
     bool _debug;
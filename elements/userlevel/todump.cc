@@ -34,7 +34,7 @@
 CLICK_DECLS
 
 ToDump::ToDump()
-    : _fp(0), _count(0), _task(this), _use_encap_from(0)
+    : _count(0), _task(this), _use_encap_from(0)
 {
 }
 
@@ -54,6 +54,8 @@ ToDump::configure(Vector<String> &conf, ErrorHandler *errh)
     bool per_node = false;
 #endif
 
+    if (_writer.configure_keywords(conf, this, errh) < 0)
+	return -1;
     if (Args(conf, this, errh)
 	.read_mp("FILENAME", FilenameArg(), _filename)
 	.read_p("SNAPLEN", _snaplen)
@@ -143,21 +145,12 @@ ToDump::initialize(ErrorHandler *errh)
     if (!hotswap_element()) {
 
 	// prepare files
-	assert(!_fp);
-	if (_filename != "-") {
-	    if (compressed_filename(_filename) > 0)
-		_fp = open_compress_pipe(_filename, errh);
-	    else
-		_fp = fopen(_filename.c_str(), "wb");
-	    if (!_fp)
-		return errh->error("%s: %s", _filename.c_str(), strerror(errno));
-	} else {
-	    _fp = stdout;
-	    _filename = "<stdout>";
-	}
+	if (_writer.initialize(_filename, true, errh) < 0)
+	    return -1;
+	_filename = _writer.filename();
 
-	if (_unbuffered)
-	    setvbuf(_fp, (char *) 0, _IONBF, 0);
+	if (_unbuffered && !_writer.async())
+	    setvbuf(_writer.stdio(), (char *) 0, _IONBF, 0);
 
 	struct fake_pcap_file_header h;
 
@@ -170,8 +163,8 @@ ToDump::initialize(ErrorHandler *errh)
 	h.snaplen = _snaplen;
 	h.linktype = _linktype;
 
-	size_t wrote_header = fwrite(&h, sizeof(h), 1, _fp);
-	if (wrote_header != 1)
+	_writer.set_header(String((const char *) &h, sizeof(h)));
+	if (_writer.flush() < 0)
 	    return errh->error("%s: unable to write file header", _filename.c_str());
     }
 
@@ -187,16 +180,13 @@ void
 ToDump::take_state(Element *e, ErrorHandler *)
 {
     ToDump *td = static_cast<ToDump *>(e); // result of hotswap_element()
-    _fp = td->_fp;
-    td->_fp = 0;
+    _writer.take_state(td->_writer);
 }
 
 void
 ToDump::cleanup(CleanupStage)
 {
-    if (_fp && _fp != stdout)
-	fclose(_fp);
-    _fp = 0;
+    _writer.cleanup();
 }
 
 void
@@ -220,15 +210,13 @@ ToDump::write_packet(Packet *p)
 	to_write = _snaplen;
     ph.caplen = to_write;
 
-    // XXX writing to pipe?
-    if (fwrite(&ph, sizeof(ph), 1, _fp) == 0
-	|| (to_write > 0 && fwrite(p->data(), 1, to_write, _fp) == 0)) {
-	if (errno != EAGAIN) {
-	    _active = false;
-	    click_chatter("ToDump(%s): %s", _filename.c_str(), strerror(errno));
-	}
-    } else
+    int r = _writer.write(&ph, sizeof(ph), p->data(), to_write);
+    if (r > 0)
 	_count++;
+    else if (r < 0) {
+	_active = false;
+	click_chatter("ToDump(%s): %s", _filename.c_str(), _writer.error().c_str());
+    }
 }
 
 void
@@ -293,10 +281,11 @@ ToDump::add_handlers()
     add_read_handler("filename", read_handler, H_FILENAME);
     add_read_handler("count", read_handler, H_COUNT);
     add_write_handler("reset_counts", write_handler, H_RESET_COUNTS, Handler::BUTTON);
+    _writer.add_handlers(this);
     if (input_is_pull(0) && noutputs() == 0)
 	add_task_handlers(&_task);
 }
 
 CLICK_ENDDECLS
-ELEMENT_REQUIRES(userlevel|ns FakePcap)
+ELEMENT_REQUIRES(userlevel|ns FakePcap AsyncWriter)
 EXPORT_ELEMENT(ToDump)
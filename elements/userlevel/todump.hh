@@ -5,13 +5,13 @@
 #include <click/element.hh>
 #include <click/task.hh>
 #include <click/notifier.hh>
-#include <stdio.h>
+#include "asyncwriter.hh"
 CLICK_DECLS
 
 /*
 =c
 
-ToDump(FILENAME [, I<keywords> SNAPLEN, ENCAP, USE_ENCAP_FROM, EXTRA_LENGTH])
+ToDump(FILENAME [, I<keywords> SNAPLEN, ENCAP, USE_ENCAP_FROM, EXTRA_LENGTH, ASYNC, ...])
 
 =s traces
 
@@ -66,6 +66,41 @@ Boolean. Set to true if you want ToDump to use unbuffered IO when saving data to
 a file.  This is unlikely to work with compressed dump formats. Default is
 false.
 
+=item ASYNC
+
+Boolean.  If true, then ToDump appends packets to large in-memory buffers, and
+a separate thread writes full buffers to the file, so that a slow disk does
+not stall packet processing.  Requires multithreaded user-level Click.
+Default is false.
+
+=item BUFFER_SIZE
+
+Integer.  The size of each ASYNC buffer, in bytes.  Default is 1048576.
+
+=item MAX_BUFFERED
+
+Integer.  The maximum memory used by ASYNC buffers, in bytes.  When every
+buffer is full and waiting to be written, ToDump drops packets from the dump
+(they are still emitted), or waits if BLOCK is true.  Default is 16777216.
+
+=item BLOCK
+
+Boolean.  If true, then ToDump waits for buffer space, rather than dropping
+packets from the dump, when MAX_BUFFERED is reached.  Default is false.
+
+=item ROTATE_SIZE
+
+Integer.  If nonzero, then ToDump starts a new file when the current one
+would grow past this many bytes.  The files are named FILENAME, FILENAME.1,
+FILENAME.2, and so forth, and each begins with a tcpdump file header.
+Default is 0.
+
+=item ROTATE_INTERVAL
+
+Timestamp.  If nonzero, then ToDump starts a new file, as for ROTATE_SIZE,
+once this much time has passed since the current file was started.
+Default is 0.
+
 =back
 
 This element is only available at user level.
@@ -86,6 +121,19 @@ Resets "count" to 0.
 
 Returns the filename.
 
+=h queued_bytes read-only
+
+Returns the number of bytes buffered but not yet written to the file.
+
+=h write_drops read-only
+
+Returns the number of packets dropped from the dump because no buffer space
+was available.
+
+=h rotations read-only
+
+Returns the number of times ToDump has started a new file.
+
 =a
 
 FromDump, FromDevice.u, ToDevice.u, tcpdump(1) */
@@ -115,7 +163,7 @@ class ToDump : public Element { public:
   private:
 
     String _filename;
-    FILE *_fp;
+    AsyncWriter _writer;
     unsigned _snaplen;
     int _linktype;
     bool _active;
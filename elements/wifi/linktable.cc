@@ -68,6 +68,7 @@ LinkTable::best_route(IPAddress dst, bool from_me)
   if (!dst) {
     return reverse_route;
   }
+  refresh_routes(from_me);
   HostInfo *nfo = _hosts.findp(dst);
 
   if (from_me) {
@@ -156,105 +157,76 @@ void
 LinkTable::dijkstra(bool from_me)
 {
 
-  typedef HashMap<IPAddress, bool> AddressMap;
-  typedef AddressMap::const_iterator AMIter;
+  Timestamp start = Timestamp::now();
 
-  AddressMap addrs;
-
-  for (HTIter iter = _hosts.begin(); iter.live(); iter++) {
-    addrs.insert(iter.value()._address, true);
+  if (!_graph_valid) {
+    build_graph();
   }
 
-  for (AMIter i = addrs.begin(); i.live(); i++) {
+  int n = _graph_hosts.size();
+  for (int i = 0; i < n; i++) {
     /* clear them all initially */
-    HostInfo *n = _hosts.findp(i.key());
-    n->clear(from_me);
+    _graph_hosts[i]->clear(from_me);
   }
-  HostInfo *root_info = _hosts.findp(_ip);
 
-  assert(root_info);
+  int root = graph_index(_ip);
+  assert(root >= 0);
 
-  if (from_me) {
-    root_info->_prev_from_me = root_info->_address;
-    root_info->_metric_from_me = 0;
-  } else {
-    root_info->_prev_to_me = root_info->_address;
-    root_info->_metric_to_me = 0;
-  }
+  Vector<uint32_t> metric(n, 0);
+  Vector<int> prev(n, -1);
+  Vector<bool> marked(n, false);
+  prev[root] = root;
 
-  IPAddress current_min_address = root_info->_address;
-
-  while (current_min_address) {
-    HostInfo *current_min = _hosts.findp(current_min_address);
-    assert(current_min);
-    if (from_me) {
-      current_min->_marked_from_me = true;
-    } else {
-      current_min->_marked_to_me = true;
-    }
+  const Vector<int> &edge_start = from_me ? _graph_out_start : _graph_in_start;
+  const Vector<GraphEdge> &edges = from_me ? _graph_out : _graph_in;
 
+  _graph_heap.clear();
+  _graph_heap.push_back(GraphHeapEntry(0, root));
 
-    for (AMIter i = addrs.begin(); i.live(); i++) {
-      HostInfo *neighbor = _hosts.findp(i.key());
-      assert(neighbor);
-      bool marked = neighbor->_marked_to_me;
-      if (from_me) {
-	marked = neighbor->_marked_from_me;
-      }
+  while (_graph_heap.size()) {
+    GraphHeapEntry top = _graph_heap[0];
+    pop_heap(_graph_heap.begin(), _graph_heap.end(), graph_heap_less());
+    _graph_heap.pop_back();
 
-      if (marked) {
-	continue;
-      }
+    int u = top._node;
+    if (marked[u] || top._metric != metric[u]) {
+      continue;
+    }
+    marked[u] = true;
 
-      AddressPair pair = AddressPair(neighbor->_address, current_min_address);
-      if (from_me) {
-	pair = AddressPair(current_min_address, neighbor->_address);
-      }
-      LinkInfo *lnfo = _links.findp(pair);
-      if (!lnfo || !lnfo->_metric) {
+    for (int e = edge_start[u]; e < edge_start[u + 1]; e++) {
+      int v = edges[e]._node;
+      if (marked[v]) {
 	continue;
       }
-      uint32_t neighbor_metric = neighbor->_metric_to_me;
-      uint32_t current_metric = current_min->_metric_to_me;
-
-      if (from_me) {
-	neighbor_metric = neighbor->_metric_from_me;
-	current_metric = current_min->_metric_from_me;
-      }
-
-
-      uint32_t adjusted_metric = current_metric + lnfo->_metric;
-      if (!neighbor_metric ||
-	  adjusted_metric < neighbor_metric) {
-	if (from_me) {
-	  neighbor->_metric_from_me = adjusted_metric;
-	  neighbor->_prev_from_me = current_min_address;
-	} else {
-	  neighbor->_metric_to_me = adjusted_metric;
-	  neighbor->_prev_to_me = current_min_address;
-	}
-
+      uint32_t adjusted_metric = metric[u] + edges[e]._metric;
+      if (!metric[v] || adjusted_metric < metric[v]) {
+	metric[v] = adjusted_metric;
+	prev[v] = u;
+	_graph_heap.push_back(GraphHeapEntry(adjusted_metric, v));
+	push_heap(_graph_heap.begin(), _graph_heap.end(), graph_heap_less());
       }
     }
+  }
 
-    current_min_address = IPAddress();
-    uint32_t  min_metric = ~0;
-    for (AMIter i = addrs.begin(); i.live(); i++) {
-      HostInfo *nfo = _hosts.findp(i.key());
-      uint32_t metric = nfo->_metric_to_me;
-      bool marked = nfo->_marked_to_me;
-      if (from_me) {
-	metric = nfo->_metric_from_me;
-	marked = nfo->_marked_from_me;
-      }
-      if (!marked && metric &&
-	  metric < min_metric) {
-        current_min_address = nfo->_address;
-        min_metric = metric;
-      }
+  for (int i = 0; i < n; i++) {
+    if (prev[i] < 0) {
+      continue;
+    }
+    HostInfo *nfo = _graph_hosts[i];
+    if (from_me) {
+      nfo->_metric_from_me = metric[i];
+      nfo->_prev_from_me = _graph_addrs[prev[i]];
+      nfo->_marked_from_me = marked[i];
+    } else {
+      nfo->_metric_to_me = metric[i];
+      nfo->_prev_to_me = _graph_addrs[prev[i]];
+      nfo->_marked_to_me = marked[i];
     }
-
   }
+
+  routes_computed(from_me);
+  _dijkstra_time = Timestamp::now() - start;
 }
 
 EXPORT_ELEMENT(LinkTable)
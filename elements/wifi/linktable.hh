@@ -10,6 +10,7 @@
 #include <click/error.hh>
 #include <click/glue.hh>
 #include <click/straccum.hh>
+#include <click/heap.hh>
 #include "path.hh"
 CLICK_DECLS
 
@@ -68,6 +69,20 @@ public:
   virtual void dijkstra(bool) = 0;
   void clear_stale();
 
+  /* incremented whenever hosts, link metrics or the blacklist change, so
+   * users can tell whether a route they cached may be out of date */
+  uint32_t epoch() const { return _epoch; }
+
+  /* links not heard from for this long are dropped */
+  const Timestamp &stale_timeout() const { return _stale_timeout; }
+
+  /* run dijkstra only if a link changed since the last computation */
+  void refresh_routes(bool from_me) {
+    if (from_me ? _routes_dirty_from_me : _routes_dirty_to_me) {
+      dijkstra(from_me);
+    }
+  }
+
   uint32_t get_host_metric_to_me(T s);
   uint32_t get_host_metric_from_me(T s);
   Vector<T> get_hosts();
@@ -215,13 +230,78 @@ protected:
   typedef HashMap<AddressPair, LinkInfo> LTable;
   typedef typename LTable::const_iterator LTIter;
 
+  /* dense snapshot of the link state used by the shortest path engine;
+   * hosts are numbered 0..n-1 and links are kept in per-node adjacency
+   * arrays (edges leaving a node and edges entering a node) */
+  class GraphEdge {
+  public:
+    int _node;
+    uint32_t _metric;
+    uint32_t _channel;
+    int _channel_index;
+    GraphEdge(int node, uint32_t metric, uint32_t channel, int channel_index)
+      : _node(node), _metric(metric), _channel(channel),
+	_channel_index(channel_index) {
+    }
+  };
+
+  /* element of the binary heap driving dijkstra; stale entries are
+   * skipped when popped instead of being removed from the heap */
+  class GraphHeapEntry {
+  public:
+    uint32_t _metric;
+    int _node;
+    GraphHeapEntry(uint32_t metric, int node)
+      : _metric(metric), _node(node) {
+    }
+  };
+  struct graph_heap_less {
+    inline bool operator()(const GraphHeapEntry &a, const GraphHeapEntry &b) {
+      return a._metric < b._metric
+	|| (a._metric == b._metric && a._node < b._node);
+    }
+  };
+
   HTable _hosts;
   LTable _links;
 
+  Vector<T> _graph_addrs;
+  Vector<HostInfo *> _graph_hosts;
+  HashMap<T, int> _graph_index;
+  Vector<int> _graph_out_start;
+  Vector<GraphEdge> _graph_out;
+  Vector<int> _graph_in_start;
+  Vector<GraphEdge> _graph_in;
+  Vector<GraphHeapEntry> _graph_heap;
+  int _graph_nchannels;
+  bool _graph_valid;
+  bool _routes_dirty_from_me;
+  bool _routes_dirty_to_me;
+  uint32_t _epoch;
+
   T _ip;
   Timestamp _stale_timeout;
   Timer _timer;
   Timestamp _dijkstra_time;
+  Timestamp _graph_time;
+
+  void invalidate_graph() {
+    _graph_valid = false;
+    _routes_dirty_from_me = _routes_dirty_to_me = true;
+    _epoch++;
+  }
+  void routes_computed(bool from_me) {
+    if (from_me) {
+      _routes_dirty_from_me = false;
+    } else {
+      _routes_dirty_to_me = false;
+    }
+  }
+  void build_graph();
+  int graph_index(T address) const {
+    int *i = _graph_index.findp(address);
+    return i ? *i : -1;
+  }
 
   static int write_handler(const String &, Element *, void *, ErrorHandler *);
   static String read_handler(Element *, void *);
@@ -230,7 +310,9 @@ protected:
 
 template <typename T, typename U>
 LinkTableBase<T,U>::LinkTableBase()
-  : _timer(this)
+  : _graph_nchannels(0), _graph_valid(false),
+    _routes_dirty_from_me(true), _routes_dirty_to_me(true), _epoch(0),
+    _timer(this)
 {
 }
 
@@ -263,8 +345,8 @@ void
 LinkTableBase<T,U>::run_timer(Timer *)
 {
   clear_stale();
-  dijkstra(true);
-  dijkstra(false);
+  refresh_routes(true);
+  refresh_routes(false);
   _timer.schedule_after_msec(5000);
 }
 
@@ -276,6 +358,7 @@ LinkTableBase<T,U>::take_state(Element *e, ErrorHandler *) {
 
   _hosts = q->_hosts;
   _links = q->_links;
+  invalidate_graph();
   dijkstra(true);
   dijkstra(false);
 }
@@ -286,7 +369,7 @@ LinkTableBase<T,U>::clear()
 {
   _hosts.clear();
   _links.clear();
-
+  invalidate_graph();
 }
 
 template <typename T, typename U>
@@ -305,11 +388,13 @@ LinkTableBase<T,U>::update_link(T from, T to, uint32_t seq, uint32_t age, uint32
   if (!nfrom) {
     _hosts.insert(from, HostInfo(from));
     nfrom = _hosts.findp(from);
+    invalidate_graph();
   }
   HostInfo *nto = _hosts.findp(to);
   if (!nto) {
     _hosts.insert(to, HostInfo(to));
     nto = _hosts.findp(to);
+    invalidate_graph();
   }
 
   assert(nfrom);
@@ -319,8 +404,14 @@ LinkTableBase<T,U>::update_link(T from, T to, uint32_t seq, uint32_t age, uint32
   LinkInfo *lnfo = _links.findp(p);
   if (!lnfo) {
     _links.insert(p, LinkInfo(from, to, seq, age, metric, channel));
+    invalidate_graph();
   } else {
+    uint32_t old_metric = lnfo->_metric;
+    uint32_t old_channel = lnfo->_channel;
     lnfo->update(seq, age, metric, channel);
+    if (lnfo->_metric != old_metric || lnfo->_channel != old_channel) {
+      invalidate_graph();
+    }
   }
   return true;
 }
@@ -343,6 +434,7 @@ LinkTableBase<T,U>::get_host_metric_to_me(T s)
   if (!s) {
     return 0;
   }
+  refresh_routes(false);
   HostInfo *nfo = _hosts.findp(s);
   if (!nfo) {
     return 0;
@@ -357,6 +449,7 @@ LinkTableBase<T,U>::get_host_metric_from_me(T s)
   if (!s) {
     return 0;
   }
+  refresh_routes(true);
   HostInfo *nfo = _hosts.findp(s);
   if (!nfo) {
     return 0;
@@ -516,6 +609,9 @@ LinkTableBase<T,U>::clear_stale() {
       links.insert(AddressPair(nfo._from, nfo._to), nfo);
     }
   }
+  if (links.size() != _links.size()) {
+    invalidate_graph();
+  }
   _links.clear();
   for (LTIter iter = links.begin(); iter.live(); iter++) {
     LinkInfo nfo = iter.value();
@@ -523,6 +619,67 @@ LinkTableBase<T,U>::clear_stale() {
   }
 }
 
+template <typename T, typename U>
+void
+LinkTableBase<T,U>::build_graph()
+{
+  Timestamp start = Timestamp::now();
+
+  int n = 0;
+  _graph_addrs.clear();
+  _graph_hosts.clear();
+  _graph_index.clear();
+  for (typename HTable::iterator iter = _hosts.begin(); iter.live(); iter++) {
+    _graph_addrs.push_back(iter.key());
+    _graph_hosts.push_back(&iter.value());
+    _graph_index.insert(iter.key(), n++);
+  }
+
+  /* count the degree of each node first so that the adjacency arrays
+   * can be laid out contiguously */
+  HashMap<uint32_t, int> channels;
+  _graph_out_start.assign(n + 1, 0);
+  _graph_in_start.assign(n + 1, 0);
+  for (LTIter iter = _links.begin(); iter.live(); iter++) {
+    const LinkInfo &nfo = iter.value();
+    int from = graph_index(nfo._from);
+    int to = graph_index(nfo._to);
+    if (from < 0 || to < 0 || !nfo._metric) {
+      continue;
+    }
+    _graph_out_start[from + 1]++;
+    _graph_in_start[to + 1]++;
+    if (!channels.findp(nfo._channel)) {
+      channels.insert(nfo._channel, channels.size());
+    }
+  }
+  for (int i = 0; i < n; i++) {
+    _graph_out_start[i + 1] += _graph_out_start[i];
+    _graph_in_start[i + 1] += _graph_in_start[i];
+  }
+  _graph_nchannels = channels.size();
+
+  GraphEdge blank(-1, 0, 0, -1);
+  _graph_out.assign(_graph_out_start[n], blank);
+  _graph_in.assign(_graph_in_start[n], blank);
+  Vector<int> out_pos(_graph_out_start);
+  Vector<int> in_pos(_graph_in_start);
+  for (LTIter iter = _links.begin(); iter.live(); iter++) {
+    const LinkInfo &nfo = iter.value();
+    int from = graph_index(nfo._from);
+    int to = graph_index(nfo._to);
+    if (from < 0 || to < 0 || !nfo._metric) {
+      continue;
+    }
+    int channel_index = channels[nfo._channel];
+    _graph_out[out_pos[from]++] = GraphEdge(to, nfo._metric, nfo._channel, channel_index);
+    _graph_in[in_pos[to]++] = GraphEdge(from, nfo._metric, nfo._channel, channel_index);
+  }
+
+  _graph_valid = true;
+  _graph_time = Timestamp::now() - start;
+}
+
 enum {H_HOST_IP,
       H_BLACKLIST,
       H_BLACKLIST_CLEAR,
@@ -536,7 +693,8 @@ enum {H_HOST_IP,
       H_CLEAR,
       H_DIJKSTRA,
       H_UPDATE_LINK,
-      H_DIJKSTRA_TIME};
+      H_DIJKSTRA_TIME,
+      H_GRAPH_TIME};
 
 template <typename T, typename U>
 String 
@@ -561,6 +719,11 @@ LinkTableBase<T,U>::read_handler(Element *e, void *thunk) {
       sa << td->_dijkstra_time << "\n";
       return sa.take_string();
     }
+    case H_GRAPH_TIME: {
+      StringAccum sa;
+      sa << td->_graph_time << "\n";
+      return sa.take_string();
+    }
     default:
       return String();
     }
@@ -618,6 +781,7 @@ LinkTableBase<T,U>::write_handler(const String &in_s, Element *e, void *vparam,
   }
   case H_BLACKLIST_CLEAR: {
     f->_blacklist.clear();
+    f->_epoch++;
     break;
   }
   case H_BLACKLIST_ADD: {
@@ -625,6 +789,7 @@ LinkTableBase<T,U>::write_handler(const String &in_s, Element *e, void *vparam,
     if (!cp_ip_address(s, &m))
       return errh->error("blacklist_add parameter must be ipaddress");
     f->_blacklist.insert(m, m);
+    f->_epoch++;
     break;
   }
   case H_BLACKLIST_REMOVE: {
@@ -632,6 +797,7 @@ LinkTableBase<T,U>::write_handler(const String &in_s, Element *e, void *vparam,
     if (!cp_ip_address(s, &m))
       return errh->error("blacklist_add parameter must be ipaddress");
     f->_blacklist.erase(m);
+    f->_epoch++;
     break;
   }
   case H_CLEAR: f->clear(); break;
@@ -652,6 +818,7 @@ LinkTableBase<T,U>::add_handlers() {
   add_read_handler("hosts", read_handler, H_HOSTS);
   add_read_handler("blacklist", read_handler, H_BLACKLIST);
   add_read_handler("dijkstra_time", read_handler, H_DIJKSTRA_TIME);
+  add_read_handler("graph_time", read_handler, H_GRAPH_TIME);
   add_write_handler("clear", write_handler, H_CLEAR);
   add_write_handler("blacklist_clear", write_handler, H_BLACKLIST_CLEAR);
   add_write_handler("blacklist_add", write_handler, H_BLACKLIST_ADD);
@@ -35,7 +35,7 @@ cp_node_address(String s, NodeAddress *node)
 	return true;
 }
 
-LinkTableMulti::LinkTableMulti() : _beta(20)
+LinkTableMulti::LinkTableMulti() : _beta(20), _debug(false), _lazy(true)
 {
 }
 
@@ -64,6 +64,7 @@ LinkTableMulti::configure(Vector<String> &conf, ErrorHandler *errh) {
           .read_m("IFACES", ifaces)
           .read("BETA", _beta)
           .read("STALE", stale_period)
+          .read("LAZY", _lazy)
           .read("DEBUG", _debug)
           .complete())
       return -1;
@@ -156,8 +157,7 @@ LinkTableMulti::update_link_table(Packet *p) {
 					a.unparse().c_str());
 		}
 	}
-	dijkstra(true);
-	dijkstra(false);
+	links_updated();
 	return true;
 }
 
@@ -168,6 +168,7 @@ LinkTableMulti::best_route(NodeAddress dst, bool from_me)
     if (!dst) {
         return reverse_route;
     }
+    refresh_routes(from_me);
     HostInfo *nfo = _hosts.findp(dst);
     if (from_me) {
         Vector<NodeAddress> raw_path;
@@ -314,7 +315,7 @@ LinkTableMulti::compute_metric(Vector<uint32_t> metrics, Vector<uint32_t> channe
            max=iter.value();
         }
     }
-    return (ett * (100 - _beta) + max * _beta) / 100;
+    return combine_metric(ett, max);
 }
 
 void
@@ -323,134 +324,106 @@ LinkTableMulti::dijkstra(bool from_me)
 
   Timestamp start = Timestamp::now();
 
-  typedef HashMap<NodeAddress, bool> AddressMap;
-  typedef AddressMap::const_iterator AMIter;
-
-  AddressMap addrs;
-
-  for (HTIter iter = _hosts.begin(); iter.live(); iter++) {
-    addrs.insert(iter.value()._address, true);
+  if (!_graph_valid) {
+    build_graph();
   }
 
-  for (AMIter i = addrs.begin(); i.live(); i++) {
+  int n = _graph_hosts.size();
+  int nch = _graph_nchannels;
+
+  for (int i = 0; i < n; i++) {
     /* clear them all initially */
-    HostInfo *n = _hosts.findp(i.key());
-    n->clear(from_me);
+    _graph_hosts[i]->clear(from_me);
   }
 
-  HostInfo *root_info = _hosts.findp(_ip);
-  assert(root_info);
+  int root = graph_index(_ip);
+  assert(root >= 0);
 
-  if (from_me) {
-    root_info->_prev_from_me = root_info->_address;
-    root_info->_metric_from_me = 0;
-  } else {
-    root_info->_prev_to_me = root_info->_address;
-    root_info->_metric_to_me = 0;
-  }
+  /* per-node state of the best path found so far: the metric, the
+   * predecessor, the summed metric of the whole path (ett) and the summed
+   * metric on each channel, so that compute_metric() never needs to walk
+   * back along the predecessor chain */
+  _path_metric.assign(n, 0);
+  _path_prev.assign(n, -1);
+  _path_marked.assign(n, false);
+  _path_ett.assign(n, 0);
+  _path_channel.assign(n * nch, 0);
 
-  NodeAddress current_min_address = root_info->_address;
+  _path_prev[root] = root;
 
-  while (current_min_address) {
+  const Vector<int> &edge_start = from_me ? _graph_out_start : _graph_in_start;
+  const Vector<GraphEdge> &edges = from_me ? _graph_out : _graph_in;
 
-    HostInfo *current_min = _hosts.findp(current_min_address);
-    assert(current_min);
+  _graph_heap.clear();
+  _graph_heap.push_back(GraphHeapEntry(0, root));
 
-    if (from_me) {
-      current_min->_marked_from_me = true;
-    } else {
-      current_min->_marked_to_me = true;
-    }
+  while (_graph_heap.size()) {
 
-    for (AMIter i = addrs.begin(); i.live(); i++) {
+    GraphHeapEntry top = _graph_heap[0];
+    pop_heap(_graph_heap.begin(), _graph_heap.end(), graph_heap_less());
+    _graph_heap.pop_back();
 
-      HostInfo *neighbor = _hosts.findp(i.key());
-      assert(neighbor);
+    int u = top._node;
+    if (_path_marked[u] || top._metric != _path_metric[u]) {
+      continue;
+    }
+    _path_marked[u] = true;
 
-      bool marked = neighbor->_marked_to_me;
-      if (from_me) {
-        marked = neighbor->_marked_from_me;
-      }
+    const uint32_t *u_channel = _path_channel.begin() + u * nch;
 
-      if (marked) {
-        continue;
-      }
+    for (int e = edge_start[u]; e < edge_start[u + 1]; e++) {
 
-      AddressPair pair = AddressPair(neighbor->_address, current_min_address);
-      if (from_me) {
-        pair = AddressPair(current_min_address, neighbor->_address);
-      }
-      LinkInfo *lnfo = _links.findp(pair);
+      const GraphEdge &edge = edges[e];
+      int v = edge._node;
 
-      if (!lnfo || !lnfo->_metric || !lnfo->_channel) {
+      if (_path_marked[v] || !edge._channel) {
         continue;
       }
 
-      Vector<uint32_t> metrics;
-      Vector<uint32_t> channels;
-
-      HostInfo * thi = current_min;
-
-      if (from_me) {
-          while (thi->_prev_from_me != thi->_address) {
-              AddressPair prev = AddressPair(thi->_prev_from_me, thi->_address);
-              LinkInfo *tli = _links.findp(prev);
-              if (tli) {
-                  metrics.push_back(tli->_metric);
-                  channels.push_back(tli->_channel);
-              }
-              thi = _hosts.findp(thi->_prev_from_me);
-          }
-      } else {
-          while (thi->_prev_to_me != thi->_address) {
-              AddressPair prev = AddressPair(thi->_address, thi->_prev_to_me);
-              LinkInfo *tli = _links.findp(prev);
-              if (tli) {
-                  metrics.push_back(tli->_metric);
-                  channels.push_back(tli->_channel);
-              }
-              thi = _hosts.findp(thi->_prev_to_me);
-          }
-      }
-
-      metrics.push_back(lnfo->_metric);
-      channels.push_back(lnfo->_channel);
-
-      uint32_t neighbor_metric = neighbor->_metric_to_me;
-      if (from_me) {
-        neighbor_metric = neighbor->_metric_from_me;
+      uint32_t ett = _path_ett[u] + edge._metric;
+      uint32_t max = 0;
+      for (int c = 0; c < nch; c++) {
+        uint32_t m = u_channel[c];
+        if (c == edge._channel_index) {
+          m += edge._metric;
+        }
+        if (m > max) {
+          max = m;
+        }
       }
 
-      uint32_t adjusted_metric = compute_metric(metrics, channels);
-
-      if (!neighbor_metric || adjusted_metric < neighbor_metric) {
-        if (from_me) {
-          neighbor->_metric_from_me = adjusted_metric;
-          neighbor->_prev_from_me = current_min_address;
-        } else {
-          neighbor->_metric_to_me = adjusted_metric;
-          neighbor->_prev_to_me = current_min_address;
-        }
+      uint32_t adjusted_metric = combine_metric(ett, max);
+
+      if (!_path_metric[v] || adjusted_metric < _path_metric[v]) {
+        _path_metric[v] = adjusted_metric;
+        _path_prev[v] = u;
+        _path_ett[v] = ett;
+        uint32_t *v_channel = _path_channel.begin() + v * nch;
+        memcpy(v_channel, u_channel, nch * sizeof(uint32_t));
+        v_channel[edge._channel_index] += edge._metric;
+        _graph_heap.push_back(GraphHeapEntry(adjusted_metric, v));
+        push_heap(_graph_heap.begin(), _graph_heap.end(), graph_heap_less());
       }
     }
+  }
 
-    current_min_address = NodeAddress();
-    uint32_t  min_metric = ~0;
-    for (AMIter i = addrs.begin(); i.live(); i++) {
-      HostInfo *nfo = _hosts.findp(i.key());
-      uint32_t metric = nfo->_metric_to_me;
-      bool marked = nfo->_marked_to_me;
-      if (from_me) {
-        metric = nfo->_metric_from_me;
-        marked = nfo->_marked_from_me;
-      }
-      if (!marked && metric && metric < min_metric) {
-        current_min_address = nfo->_address;
-        min_metric = metric;
-      }
+  for (int i = 0; i < n; i++) {
+    if (_path_prev[i] < 0) {
+      continue;
+    }
+    HostInfo *nfo = _graph_hosts[i];
+    if (from_me) {
+      nfo->_metric_from_me = _path_metric[i];
+      nfo->_prev_from_me = _graph_addrs[_path_prev[i]];
+      nfo->_marked_from_me = _path_marked[i];
+    } else {
+      nfo->_metric_to_me = _path_metric[i];
+      nfo->_prev_to_me = _graph_addrs[_path_prev[i]];
+      nfo->_marked_to_me = _path_marked[i];
     }
   }
 
+  routes_computed(from_me);
   _dijkstra_time = Timestamp::now() - start;
 
 }
@@ -7,12 +7,22 @@ CLICK_DECLS
 
 /*
  * =c
- * LinkTableMulti(IP Address, [STALE timeout])
+ * LinkTableMulti(IP Address, IFACES interfaces, [BETA beta, STALE timeout, LAZY bool])
  * =s Wifi
  * Keeps a Link state database and calculates Weighted Shortest Path
  * for other elements
  * =d
- * Runs dijkstra's algorithm occasionally.
+ * Runs dijkstra's algorithm occasionally. Routes are computed with a binary
+ * heap over a dense adjacency list snapshot of the link table, which is
+ * rebuilt only when a host or a link metric changes.
+ *
+ * When LAZY is true (the default), link updates only mark the routes as
+ * stale and dijkstra runs on the next route lookup. Otherwise routes are
+ * recomputed as soon as a link changes.
+ * =h dijkstra_time read-only
+ * Time spent in the last shortest path computation.
+ * =h graph_time read-only
+ * Time spent building the adjacency list snapshot of the link table.
  * =a ARPTable
  *
  */
@@ -53,6 +63,13 @@ class LinkTableMulti : public LinkTableBase<NodeAddress, PathMulti> {
 
     bool update_link_table(Packet *);
 
+    inline void links_updated() {
+        if (!_lazy) {
+            refresh_routes(true);
+            refresh_routes(false);
+        }
+    }
+
     inline Vector<int> get_local_interfaces() {
         Vector<int> ifaces;
         for (HTIter iter = _hosts.begin(); iter.live(); iter++) {
@@ -67,11 +84,22 @@ class LinkTableMulti : public LinkTableBase<NodeAddress, PathMulti> {
 
     uint32_t _beta;
     bool _debug;
+    bool _lazy;
 
     static String read_handler(Element *, void *);
     static int write_handler(const String &, Element *, void *, ErrorHandler *);
 
     uint32_t compute_metric(Vector<uint32_t>, Vector<uint32_t>);
+    uint32_t combine_metric(uint32_t ett, uint32_t max) const {
+        return (ett * (100 - _beta) + max * _beta) / 100;
+    }
+
+    /* scratch state for dijkstra(), indexed by dense node index */
+    Vector<uint32_t> _path_metric;
+    Vector<int> _path_prev;
+    Vector<bool> _path_marked;
+    Vector<uint32_t> _path_ett;
+    Vector<uint32_t> _path_channel;
 
 };
 
@@ -3,6 +3,8 @@
 #include <click/element.hh>
 #include <click/deque.hh>
 #include <click/hashmap.hh>
+#include <click/heap.hh>
+#include <click/pair.hh>
 #include <click/packet_anno.hh>
 #include <clicknet/ether.h>
 #include <clicknet/wifi.h>
@@ -21,6 +23,8 @@ public:
 	const char *class_name() const { return "WINGBase"; }
 	const char *processing() const { return AGNOSTIC; }
 
+	int initialize(ErrorHandler *);
+
 	/* handler stuff */
 	void add_handlers();
 
@@ -35,7 +39,7 @@ protected:
 			_count(0),
 			_forwarded(false) {
 		}
-		Seen(T seen, int seq) : _seen(seen), _seq(seq), _count(0), _when(Timestamp::now()) {}
+		Seen(T seen, int seq) : _seen(seen), _seq(seq), _count(0), _when(Timestamp::now()), _forwarded(false) {}
 		T _seen;
 		int _seq;
 		int _count;
@@ -49,7 +53,29 @@ protected:
 	class LinkTableMulti *_link_table;
 	class ARPTableMulti *_arp_table;
 
+	// _seen is a FIFO of at most _max_seen_size entries. Every entry
+	// gets a serial number when appended; _seen_index maps (seen, seq)
+	// to that serial, and _seen[serial - _seen_first] is the entry.
+	typedef Pair<T, int> SeenKey;
 	Deque<Seen> _seen;
+	HashMap<SeenKey, uint32_t> _seen_index;
+	uint32_t _seen_first;
+
+	// Entries waiting for their jittered forwarding time, kept in a heap
+	// ordered by send time and served by a single timer.
+	class SeenPending {
+	public:
+		SeenPending(const Timestamp &to_send, uint32_t serial) : _to_send(to_send), _serial(serial) {}
+		Timestamp _to_send;
+		uint32_t _serial;
+	};
+	struct seen_pending_less {
+		inline bool operator()(const SeenPending &a, const SeenPending &b) {
+			return a._to_send < b._to_send;
+		}
+	};
+	Vector<SeenPending> _seen_pending;
+	Timer _forward_timer;
 
 	unsigned int _jitter; // msecs
 	int _max_seen_size; 
@@ -64,65 +90,104 @@ protected:
 
 	bool process_seen(T, int, bool);
 	void append_seen(T, int);
+	void clear_seen();
 	void forward_seen_hook();
 
-	static void static_forward_seen_hook(Timer *t, void *e) {
-		delete t; ((WINGBase *) e)->forward_seen_hook();
+	Seen *find_seen(T seen, int seq) {
+		uint32_t *serial = _seen_index.findp(SeenKey(seen, seq));
+		return serial ? &_seen[*serial - _seen_first] : 0;
+	}
+	int push_seen(T, int);
+
+	static void static_forward_seen_hook(Timer *, void *e) {
+		((WINGBase *) e)->forward_seen_hook();
 	}
 
 };
 
 template <typename T>
 WINGBase<T>::WINGBase() :
-	_link_table(0), _arp_table(0), _jitter(1000), _max_seen_size(100), _debug(false) {
+	_link_table(0), _arp_table(0), _seen_first(0),
+	_forward_timer(static_forward_seen_hook, this),
+	_jitter(1000), _max_seen_size(100), _debug(false) {
 }
 
 template <typename T>
 WINGBase<T>::~WINGBase() {
 }
 
+template <typename T>
+int
+WINGBase<T>::initialize(ErrorHandler *) {
+	_forward_timer.initialize(this);
+	return 0;
+}
+
 template <typename T>
 void
 WINGBase<T>::forward_seen_hook() {
 	Timestamp now = Timestamp::now();
 	Vector<int> ifs = _link_table->get_local_interfaces();
-	_link_table->dijkstra(false);
-	for (int x = 0; x < _seen.size(); x++) {
-		if (_seen[x]._to_send < now && !_seen[x]._forwarded) {
-			for (int i = 0; i < ifs.size(); i++) {	
-				forward_seen(ifs[i], &_seen[x]);
-			}
-			_seen[x]._forwarded = true;
+	while (_seen_pending.size() && _seen_pending[0]._to_send <= now) {
+		uint32_t serial = _seen_pending[0]._serial;
+		pop_heap(_seen_pending.begin(), _seen_pending.end(), seen_pending_less());
+		_seen_pending.pop_back();
+		/* the entry may have been pushed out of the cache meanwhile */
+		if (serial - _seen_first >= (uint32_t) _seen.size()) {
+			continue;
 		}
+		Seen *s = &_seen[serial - _seen_first];
+		if (s->_forwarded) {
+			continue;
+		}
+		for (int i = 0; i < ifs.size(); i++) {
+			forward_seen(ifs[i], s);
+		}
+		s->_forwarded = true;
+	}
+	if (_seen_pending.size()) {
+		_forward_timer.schedule_at(_seen_pending[0]._to_send);
 	}
 }
 
 template <typename T>
-void
-WINGBase<T>::append_seen(T seen, int seq) {
+int
+WINGBase<T>::push_seen(T seen, int seq) {
 	if (_seen.size() >= _max_seen_size) {
+		const Seen &oldest = _seen.front();
+		_seen_index.erase(SeenKey(oldest._seen, oldest._seq));
 		_seen.pop_front();
+		_seen_first++;
 	}
+	_seen_index.insert(SeenKey(seen, seq), _seen_first + _seen.size());
 	_seen.push_back(Seen(seen, seq));
+	return _seen.size() - 1;
+}
+
+template <typename T>
+void
+WINGBase<T>::append_seen(T seen, int seq) {
+	push_seen(seen, seq);
+}
+
+template <typename T>
+void
+WINGBase<T>::clear_seen() {
+	_seen_first += _seen.size();
+	_seen.clear();
+	_seen_index.clear();
+	_seen_pending.clear();
+	_forward_timer.unschedule();
 }
 
 template <typename T>
 bool
 WINGBase<T>::process_seen(T seen, int seq, bool schedule) {
-	int si = 0;
-	for (si = 0; si < _seen.size(); si++) {
-		if (seen == _seen[si]._seen && seq == _seen[si]._seq) {
-			_seen[si]._count++;
-			return false;
-		}
+	if (Seen *s = find_seen(seen, seq)) {
+		s->_count++;
+		return false;
 	}
-	if (si == _seen.size()) {
-		if (_seen.size() >= _max_seen_size) {
-			_seen.pop_front();
-			si--;
-		}
-		_seen.push_back(Seen(seen, seq));
-	}		
+	int si = push_seen(seen, seq);
 	_seen[si]._count++;
 	_seen[si]._when = Timestamp::now();
 	/* schedule timer */
@@ -130,9 +195,11 @@ WINGBase<T>::process_seen(T seen, int seq, bool schedule) {
 		int delay = click_random(1, _jitter);
 		_seen[si]._to_send = _seen[si]._when + Timestamp::make_msec(delay);
 		_seen[si]._forwarded = false;
-		Timer *t = new Timer(static_forward_seen_hook, (void *) this);
-		t->initialize(this);
-		t->schedule_after_msec(delay);
+		_seen_pending.push_back(SeenPending(_seen[si]._to_send, _seen_first + si));
+		push_heap(_seen_pending.begin(), _seen_pending.end(), seen_pending_less());
+		if (!_forward_timer.scheduled() || _seen[si]._to_send < _forward_timer.expiry()) {
+			_forward_timer.schedule_at(_seen_pending[0]._to_send);
+		}
 	}
 	return true;
 }
@@ -43,7 +43,9 @@ int WINGGatewaySelector::configure(Vector<String> &conf, ErrorHandler *errh) {
 
 }
 
-int WINGGatewaySelector::initialize(ErrorHandler *) {
+int WINGGatewaySelector::initialize(ErrorHandler *errh) {
+	if (WINGBase<HNAInfo>::initialize(errh) < 0)
+		return -1;
 	_timer.initialize(this);
 	_timer.schedule_now();
 	return 0;
@@ -401,8 +401,7 @@ WINGLinkStat::simple_action(Packet *p) {
 		ptr += entry->num_rates() * sizeof(struct link_info);
 	}
 
-	_link_table->dijkstra(true);
-	_link_table->dijkstra(false);
+	_link_table->links_updated();
 	p->kill();
 
 	return 0;
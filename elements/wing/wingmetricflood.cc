@@ -242,7 +242,7 @@ int WINGMetricFlood::write_handler(const String &in_s, Element *e, void *vparam,
 	String s = cp_uncomment(in_s);
 	switch ((intptr_t) vparam) {
 		case H_CLEAR_SEEN: {
-			f->_seen.clear();
+			f->clear_seen();
 			break;
 		}
 	}
@@ -29,6 +29,9 @@ public:
 		_dst(e._dst) ,
 		_src(e._src) { 
 	}
+	inline uint32_t hashcode() const {
+		return CLICK_NAME(hashcode)(_dst) + CLICK_NAME(hashcode)(_src);
+	}
 	inline bool operator==(QueryInfo other) const {
 		return (other._dst == _dst && other._src == _src);
 	}
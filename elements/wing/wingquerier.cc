@@ -37,7 +37,8 @@ cp_node_airport(String s, NodeAirport *node)
 	return true;
 }
 
-WINGQuerier::WINGQuerier() {
+WINGQuerier::WINGQuerier() :
+	_route_cache_hits(0), _route_cache_misses(0), _timer(this) {
 }
 
 WINGQuerier::~WINGQuerier() {
@@ -59,6 +60,33 @@ int WINGQuerier::configure(Vector<String> &conf, ErrorHandler *errh) {
 
 }
 
+int WINGQuerier::initialize(ErrorHandler *) {
+	_timer.initialize(this);
+	_timer.schedule_after_msec(5000);
+	return 0;
+}
+
+void WINGQuerier::run_timer(Timer *) {
+	clear_stale_routes();
+	_timer.schedule_after_msec(5000);
+}
+
+void WINGQuerier::clear_stale_routes() {
+	/* drop routes to destinations we have not sent to for as long as the
+	 * link table keeps links around */
+	click_jiffies_t now_j = click_jiffies();
+	click_jiffies_t stale_j = _link_table->stale_timeout().sec() * CLICK_HZ;
+	Vector<NodeAddress> stale;
+	for (RouteCache::const_iterator iter = _route_cache.begin(); iter.live(); iter++) {
+		if (click_jiffies_less(iter.value()._used_j + stale_j, now_j)) {
+			stale.push_back(iter.key());
+		}
+	}
+	for (int i = 0; i < stale.size(); i++) {
+		_route_cache.remove(stale[i]);
+	}
+}
+
 Packet *
 WINGQuerier::encap(Packet *p_in, PathMulti best)
 {
@@ -176,6 +204,68 @@ WINGQuerier::encap(Packet *p_in)
 
 }
 
+inline WINGQuerier::RouteCacheEntry *
+WINGQuerier::route_cache_lookup(IPAddress dst) {
+	RouteCacheEntry *rc = _route_cache.findp(NodeAddress(dst));
+	if (!rc) {
+		return 0;
+	}
+	/* refresh the ethernet addresses if the arp table changed, and at
+	 * least once a second so that expired entries are noticed */
+	click_jiffies_t now_j = click_jiffies();
+	if (rc->_arp_generation != _arp_table->generation()
+	    || !click_jiffies_less(now_j, rc->_arp_checked_j + CLICK_HZ)) {
+		return 0;
+	}
+	if (rc->_static || rc->_epoch == _link_table->epoch()
+	    /* the topology changed, keep the current route only until it
+	     * may be switched */
+	    || Timestamp::now() <= rc->_switch_expire) {
+		rc->_used_j = now_j;
+		return rc;
+	}
+	return 0;
+}
+
+Packet *
+WINGQuerier::encap_header(Packet *p_in, const String &header) {
+	int data_len = p_in->length();
+	WritablePacket *p = p_in->push(header.length());
+	if (p == 0) {
+		click_chatter("%{element} :: %s :: cannot encap packet!", this, __func__);
+		return 0;
+	}
+	memcpy(p->data(), header.data(), header.length());
+	click_ether *eh = (click_ether *) p->data();
+	struct wing_data *pk = (struct wing_data *) (eh + 1);
+	pk->set_data_len(data_len);
+	return p;
+}
+
+Packet *
+WINGQuerier::route_cache_encap(Packet *p_in, IPAddress dst, const PathMulti &best, bool is_static, const Timestamp &switch_expire) {
+	/* build the headers once on an empty packet, then cache them */
+	Packet *h = Packet::make(sizeof(click_ether) + wing_data::len_wo_data(best.size() - 1), 0, 0, 0);
+	if (h) {
+		h = encap(h, best);
+	}
+	if (!h) {
+		_route_cache.remove(NodeAddress(dst));
+		p_in->kill();
+		return 0;
+	}
+	RouteCacheEntry &rc = _route_cache.find_force(NodeAddress(dst));
+	rc._p = best;
+	rc._header = String(h->data(), h->length());
+	rc._static = is_static;
+	rc._epoch = _link_table->epoch();
+	rc._switch_expire = switch_expire;
+	rc._arp_generation = _arp_table->generation();
+	rc._arp_checked_j = rc._used_j = click_jiffies();
+	h->kill();
+	return encap_header(p_in, rc._header);
+}
+
 void WINGQuerier::push(int, Packet *p_in) {
 	IPAddress dst = p_in->dst_ip_anno();
 	if (!dst) {	
@@ -186,10 +276,20 @@ void WINGQuerier::push(int, Packet *p_in) {
 		p_in->kill();
 		return;
 	}
+	/* try the route cache first */
+	if (RouteCacheEntry *rc = route_cache_lookup(dst)) {
+		_route_cache_hits++;
+		p_in = encap_header(p_in, rc->_header);
+		if (p_in) {
+			output(0).push(p_in);
+		}
+		return;
+	}
+	_route_cache_misses++;
 	/* look for static routes first */
 	PathMulti *p = _routes.findp(dst);
 	if (p) {
-		p_in = encap(p_in, *p);
+		p_in = route_cache_encap(p_in, dst, *p, true, Timestamp());
 		if (p_in) {
 			output(0).push(p_in);
 		}
@@ -226,12 +326,13 @@ void WINGQuerier::push(int, Packet *p_in) {
 		}
 	}
 	if (nfo->_best_metric) {
-		p_in = encap(p_in, nfo->_p);
+		p_in = route_cache_encap(p_in, dst, nfo->_p, false, nfo->_last_switch + _time_before_switch);
 		if (p_in) {
 			output(0).push(p_in);
 		}
 		return;
 	}
+	_route_cache.remove(NodeAddress(dst));
 	if (_debug) {
 		click_chatter("%{element} :: %s :: no valid route to %s", 
 				this,
@@ -277,8 +378,20 @@ String WINGQuerier::print_routes() {
 	return sa.take_string();
 }
 
+String WINGQuerier::print_route_cache() {
+	StringAccum sa;
+	for (RouteCache::const_iterator iter = _route_cache.begin(); iter.live(); iter++) {
+		const RouteCacheEntry &rc = iter.value();
+		sa << iter.key()._ip << (rc._static ? " static" : " dynamic");
+		sa << " epoch " << rc._epoch;
+		sa << " [ " << route_to_string(rc._p) << " ]\n";
+	}
+	return sa.take_string();
+}
+
 enum {
-	H_RESET, H_QUERIES, H_ROUTES, H_CLEAR_ROUTES, H_CLEAR_QUERIES, H_ADD, H_DEL
+	H_RESET, H_QUERIES, H_ROUTES, H_CLEAR_ROUTES, H_CLEAR_QUERIES, H_ADD, H_DEL,
+	H_ROUTE_CACHE, H_ROUTE_CACHE_STATS
 };
 
 String WINGQuerier::read_handler(Element *e, void *thunk) {
@@ -288,6 +401,13 @@ String WINGQuerier::read_handler(Element *e, void *thunk) {
 		return c->print_queries();
 	case H_ROUTES:
 		return c->print_routes();
+	case H_ROUTE_CACHE:
+		return c->print_route_cache();
+	case H_ROUTE_CACHE_STATS: {
+		StringAccum sa;
+		sa << "hits " << c->_route_cache_hits << " misses " << c->_route_cache_misses << "\n";
+		return sa.take_string();
+	}
 	default:
 		return "<error>\n";
 	}
@@ -318,6 +438,7 @@ int WINGQuerier::write_handler(const String &in_s, Element *e, void *vparam,
 						td->_ip.unparse().c_str());
 		}
 		td->_routes.insert(p[p.size() - 1]._ip, p);
+		td->_route_cache.clear();
 		break;
 	}
 	case H_DEL: {
@@ -328,14 +449,17 @@ int WINGQuerier::write_handler(const String &in_s, Element *e, void *vparam,
 		if (!td->_routes.remove(ip)) {
 			return errh->error("unable to find destination %s", ip.unparse().c_str());
 		}
+		td->_route_cache.clear();
 		break;
 	}
 	case H_CLEAR_ROUTES: {
 		td->_routes.clear();
+		td->_route_cache.clear();
 		break;
 	}
 	case H_CLEAR_QUERIES: {
 		td->_queries.clear();
+		td->_route_cache.clear();
 		break;
 	}
 	}
@@ -345,6 +469,8 @@ int WINGQuerier::write_handler(const String &in_s, Element *e, void *vparam,
 void WINGQuerier::add_handlers() {
 	add_read_handler("queries", read_handler, H_QUERIES);
 	add_read_handler("static_routes", read_handler, H_ROUTES);
+	add_read_handler("route_cache", read_handler, H_ROUTE_CACHE);
+	add_read_handler("route_cache_stats", read_handler, H_ROUTE_CACHE_STATS);
 	add_write_handler("clear_static_routes", write_handler, H_CLEAR_ROUTES);
 	add_write_handler("clear_queries", write_handler, H_CLEAR_QUERIES);
 	add_write_handler("add_static_route", write_handler, H_ADD);
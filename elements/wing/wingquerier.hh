@@ -1,6 +1,7 @@
 #ifndef CLICK_WINGQUERIER_HH
 #define CLICK_WINGQUERIER_HH
 #include <click/element.hh>
+#include <click/timer.hh>
 #include "wingbase.hh"
 CLICK_DECLS
 
@@ -14,10 +15,23 @@ CLICK_DECLS
  * found for a given packet and no valid route is found in the cache a
  * route request message is generated.
  *
+ * The Ethernet and WING headers for each destination are cached together
+ * with the route. A cached route is reused until the link table epoch
+ * changes (and TIME_BEFORE_SWITCH has elapsed since the last switch) or
+ * the ARP table changes, so the common case costs one hash lookup and one
+ * header copy per packet.  Routes unused for longer than the link table's
+ * STALE timeout are dropped from the cache.
+ *
  * =h add write
  * Writing "0:6.0.0.1;1 1:6.0.0.2:0" to this element will make all packets 
  * going from node 6.0.0.1 to node 6.0.0.2, use the first wireless interface
  * on both nodes.
+ *
+ * =h route_cache read-only
+ * Print the cached routes.
+ *
+ * =h route_cache_stats read-only
+ * Print route cache hits and misses.
  * 
  */
 
@@ -33,6 +47,9 @@ public:
 	const char *flow_code() const { return "#/#"; }
 
 	int configure(Vector<String> &, ErrorHandler *);
+	int initialize(ErrorHandler *);
+
+	void run_timer(Timer *);
 
 	/* handler stuff */
 	void add_handlers();
@@ -42,6 +59,7 @@ public:
 	void push(int, Packet *);
 	Packet * encap(Packet *, PathMulti);
 	void encap(Packet *);
+	String print_route_cache();
 
 private:
 
@@ -71,6 +89,32 @@ private:
 	typedef HashMap<IPAddress, PathMulti> RouteTable;
 	RouteTable _routes;
 
+	// Per destination route cache.  _header holds the Ethernet and WING
+	// headers for _p with a zero data length.
+	class RouteCacheEntry {
+	public:
+		RouteCacheEntry() : _static(false), _epoch(0), _arp_generation(0), _arp_checked_j(0), _used_j(0) {}
+		PathMulti _p;
+		String _header;
+		bool _static;
+		uint32_t _epoch;
+		Timestamp _switch_expire;
+		uint32_t _arp_generation;
+		click_jiffies_t _arp_checked_j;
+		click_jiffies_t _used_j;
+	};
+
+	typedef HashMap<NodeAddress, RouteCacheEntry> RouteCache;
+	RouteCache _route_cache;
+	uint32_t _route_cache_hits;
+	uint32_t _route_cache_misses;
+	Timer _timer;
+
+	inline RouteCacheEntry *route_cache_lookup(IPAddress);
+	Packet *route_cache_encap(Packet *, IPAddress, const PathMulti &, bool, const Timestamp &);
+	Packet *encap_header(Packet *, const String &);
+	void clear_stale_routes();
+
 	Timestamp _query_wait;
 	Timestamp _time_before_switch;
 
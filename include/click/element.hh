@@ -5,6 +5,7 @@
 #include <click/vector.hh>
 #include <click/string.hh>
 #include <click/packet.hh>
+#include <click/packetbatch.hh>
 #include <click/handler.hh>
 CLICK_DECLS
 class Router;
@@ -36,6 +37,8 @@ class Element { public:
     virtual void push(int port, Packet *p);
     virtual Packet *pull(int port) CLICK_WARN_UNUSED_RESULT;
     virtual Packet *simple_action(Packet *p);
+    virtual void push_batch(int port, PacketBatch &batch);
+    virtual PacketBatch pull_batch(int port, unsigned max);
 
     virtual bool run_task(Task *task);	// return true iff did useful work
     virtual void run_timer(Timer *timer);
@@ -47,6 +50,7 @@ class Element { public:
 
     inline void checked_output_push(int port, Packet *p) const;
     inline Packet* checked_input_pull(int port) const;
+    inline void checked_output_push_batch(int port, PacketBatch &batch) const;
 
     // ELEMENT CHARACTERISTICS
     virtual const char *class_name() const = 0;
@@ -219,6 +223,8 @@ class Element { public:
 
 	inline void push(Packet* p) const;
 	inline Packet* pull() const;
+	inline void push_batch(PacketBatch &batch) const;
+	inline PacketBatch pull_batch(unsigned max) const;
 
 #if CLICK_STATS >= 1
 	unsigned npackets() const	{ return _packets; }
@@ -684,6 +690,73 @@ Element::Port::pull() const
     return p;
 }
 
+/** @brief Push the packets in @a batch over this port.
+ *
+ * Pushes every packet in @a batch downstream by passing the batch to the next
+ * element's @link Element::push_batch() push_batch() @endlink function.  On
+ * return, @a batch is empty; as with push(), you must not use its packets
+ * after pushing them downstream.
+ *
+ * This port must be an active() push output port.  Elements that do not
+ * override Element::push_batch() receive the packets one at a time through
+ * their push() functions, so push_batch() is always safe to call.
+ */
+inline void
+Element::Port::push_batch(PacketBatch &batch) const
+{
+    assert(_e);
+    if (batch.empty())
+	return;
+#if CLICK_STATS >= 1
+    _packets += batch.count();
+#endif
+#if CLICK_STATS >= 2
+    _e->input(_port)._packets += batch.count();
+    click_cycles_t start_cycles = click_get_cycles(),
+	start_child_cycles = _e->_child_cycles;
+    _e->push_batch(_port, batch);
+    click_cycles_t all_delta = click_get_cycles() - start_cycles,
+	own_delta = all_delta - (_e->_child_cycles - start_child_cycles);
+    _e->_xfer_calls += 1;
+    _e->_xfer_own_cycles += own_delta;
+    _owner->_child_cycles += all_delta;
+#else
+    _e->push_batch(_port, batch);
+#endif
+}
+
+/** @brief Pull up to @a max packets over this port and return them.
+ *
+ * Pulls a batch of packets from upstream by calling the previous element's
+ * @link Element::pull_batch() pull_batch() @endlink function.  The returned
+ * batch holds at most @a max packets, and is empty if no packets were
+ * available.
+ *
+ * This port must be an active() pull input port.
+ */
+inline PacketBatch
+Element::Port::pull_batch(unsigned max) const
+{
+    assert(_e);
+#if CLICK_STATS >= 2
+    click_cycles_t start_cycles = click_get_cycles(),
+	old_child_cycles = _e->_child_cycles;
+    PacketBatch batch = _e->pull_batch(_port, max);
+    _e->output(_port)._packets += batch.count();
+    click_cycles_t all_delta = click_get_cycles() - start_cycles,
+	own_delta = all_delta - (_e->_child_cycles - old_child_cycles);
+    _e->_xfer_calls += 1;
+    _e->_xfer_own_cycles += own_delta;
+    _owner->_child_cycles += all_delta;
+#else
+    PacketBatch batch = _e->pull_batch(_port, max);
+#endif
+#if CLICK_STATS >= 1
+    _packets += batch.count();
+#endif
+    return batch;
+}
+
 /** @brief Push packet @a p to output @a port, or kill it if @a port is out of
  * range.
  *
@@ -724,6 +797,23 @@ Element::checked_input_pull(int port) const
 	return 0;
 }
 
+/** @brief Push the packets in @a batch to output @a port, or kill them if
+ * @a port is out of range.
+ *
+ * @param port output port number
+ * @param batch packets to push
+ *
+ * The batch analogue of checked_output_push().  On return, @a batch is empty.
+ */
+inline void
+Element::checked_output_push_batch(int port, PacketBatch &batch) const
+{
+    if ((unsigned) port < (unsigned) noutputs())
+	_ports[1][port].push_batch(batch);
+    else
+	batch.kill();
+}
+
 #undef PORT_ASSIGN
 CLICK_ENDDECLS
 #endif
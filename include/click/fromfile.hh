@@ -65,6 +65,10 @@ class FromFile { public:
     bool _mmap;
 #endif
 
+    class Decompressor;
+    Decompressor *_decomp;
+    bool _decompress;
+
 #ifdef ALLOW_MMAP
     enum { WANT_MMAP_UNIT = 4194304 }; // 4 MB
     size_t _mmap_unit;
@@ -87,6 +91,7 @@ class FromFile { public:
     static String filename_handler(Element *, void *);
     static String filesize_handler(Element *, void *);
     static String filepos_handler(Element *, void *);
+    static String decompress_handler(Element *, void *);
     static int filepos_write_handler(const String&, Element*, void*, ErrorHandler*);
 
 };
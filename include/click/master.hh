@@ -32,6 +32,10 @@ class Master { public:
     inline RouterThread *thread(int id) const;
     void wake_somebody();
 
+    void quiescent_snapshot(Vector<uint32_t> &epochs) const;
+    bool quiescent_since(const Vector<uint32_t> &epochs) const;
+    void wait_quiescent(const Vector<uint32_t> &epochs);
+
 #if CLICK_USERLEVEL
     int add_signal_handler(int signo, Router *router, String handler);
     int remove_signal_handler(int signo, Router *router, String handler);
@@ -66,6 +66,29 @@ class Packet { public:
 
     static void static_cleanup();
 
+#if HAVE_CLICK_PACKET_POOL
+    /** @brief Packet pool statistics, summed over all threads.
+
+	Counters are plain integers, updated without synchronization by the
+	thread that owns each pool.  In multithreaded drivers they are
+	approximate. */
+    struct PoolStats {
+	uint64_t hits;		///< packets allocated from a thread pool
+	uint64_t data_hits;	///< data buffers allocated from a thread pool
+	uint64_t mallocs;	///< packets allocated with operator new
+	uint64_t data_mallocs;	///< data buffers allocated with operator new
+	uint64_t steals;	///< batches taken from the global pool
+	uint64_t releases;	///< batches given to the global pool
+	uint64_t frees;		///< packets and buffers returned to the system
+	uint64_t pcount;	///< packets currently in thread pools
+	uint64_t pdcount;	///< data buffers currently in thread pools
+    };
+    static void pool_stats(PoolStats &stats);
+    static void pool_reset_stats();
+    static unsigned pool_capacity();
+    static void set_pool_capacity(unsigned capacity);
+#endif
+
     inline void kill();
 
     inline bool shared() const;
@@ -797,9 +820,11 @@ class WritablePacket : public Packet { public:
     static WritablePacket *pool_allocate(uint32_t headroom, uint32_t length,
 					 uint32_t tailroom);
     static void recycle(WritablePacket *p);
+    static void recycle_list(Packet *head);
 #endif
 
     friend class Packet;
+    friend class PacketBatch;
 
 };
 
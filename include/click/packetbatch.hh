@@ -0,0 +1,138 @@
+// -*- c-basic-offset: 4; related-file-name: "../../lib/packet.cc" -*-
+#ifndef CLICK_PACKETBATCH_HH
+#define CLICK_PACKETBATCH_HH
+#include <click/packet.hh>
+CLICK_DECLS
+
+/** @file <click/packetbatch.hh>
+ * @brief A list of packets transferred together.
+ */
+
+/** @class PacketBatch
+ * @brief A FIFO list of packets transferred together over a port.
+ *
+ * A PacketBatch is a singly-linked list of packets threaded through the
+ * packets' next() annotations.  It lets an element hand a burst of packets
+ * to its neighbor with one call to Element::push_batch() or
+ * Element::pull_batch(), rather than one virtual call per packet.
+ *
+ * A PacketBatch does not own its packets in the C++ sense: copying or
+ * destroying a PacketBatch neither clones nor frees anything.  Whoever holds
+ * a batch must account for every packet in it, usually by forwarding the
+ * batch, by storing or freeing the packets one at a time with pop_front(),
+ * or by calling kill().  Packets removed from a batch with pop_front() have
+ * a null next() annotation, so element code can store them or link them into
+ * other lists as usual.
+ *
+ * make() allocates a whole batch in one call, and kill() frees one.  With
+ * Click's packet pool, kill() takes the global pool lock at most once per
+ * batch rather than once per overflowing packet.
+ *
+ * Iterate over a batch without removing packets like this:
+ *
+ * @code
+ * for (Packet *p = batch.front(); p; p = p->next())
+ *     ...;
+ * @endcode
+ */
+class PacketBatch { public:
+
+    /** @brief Construct an empty batch. */
+    PacketBatch()
+	: _head(0), _tail(0), _count(0) {
+    }
+
+    static PacketBatch make(int n, uint32_t headroom, const void *data,
+			    uint32_t length, uint32_t tailroom);
+
+    /** @brief Return the number of packets in the batch. */
+    int count() const {
+	return _count;
+    }
+    /** @brief Return true iff the batch contains no packets. */
+    bool empty() const {
+	return !_head;
+    }
+    /** @brief Return the first packet in the batch, or null. */
+    Packet *front() const {
+	return _head;
+    }
+    /** @brief Return the last packet in the batch, or null. */
+    Packet *back() const {
+	return _tail;
+    }
+
+    inline void push_back(Packet *p);
+    inline void append(PacketBatch &batch);
+    inline Packet *pop_front();
+    inline void clear();
+    void kill();
+
+  private:
+
+    Packet *_head;
+    Packet *_tail;
+    int _count;
+
+};
+
+/** @brief Append packet @a p to the batch.
+ * @pre @a p is not null and not already part of a batch. */
+inline void
+PacketBatch::push_back(Packet *p)
+{
+    assert(p);
+    p->set_next(0);
+    if (_tail)
+	_tail->set_next(p);
+    else
+	_head = p;
+    _tail = p;
+    ++_count;
+}
+
+/** @brief Move all packets in @a batch to the end of this batch.
+ *
+ * On return, @a batch is empty. */
+inline void
+PacketBatch::append(PacketBatch &batch)
+{
+    if (!batch._head)
+	return;
+    if (_tail)
+	_tail->set_next(batch._head);
+    else
+	_head = batch._head;
+    _tail = batch._tail;
+    _count += batch._count;
+    batch.clear();
+}
+
+/** @brief Remove and return the first packet in the batch, or null if the
+ * batch is empty.
+ *
+ * The returned packet's next() annotation is null. */
+inline Packet *
+PacketBatch::pop_front()
+{
+    Packet *p = _head;
+    if (p) {
+	_head = p->next();
+	if (!_head)
+	    _tail = 0;
+	p->set_next(0);
+	--_count;
+    }
+    return p;
+}
+
+/** @brief Forget all packets in the batch without freeing them. */
+inline void
+PacketBatch::clear()
+{
+    _head = _tail = 0;
+    _count = 0;
+}
+
+CLICK_ENDDECLS
+#endif
@@ -117,6 +117,7 @@ class RouterThread { public:
     // LOCAL STATE GROUP
     TaskLink _task_link;
     volatile int _stop_flag;
+    volatile uint32_t _quiescent_epoch;	// odd while driver is not running
 #if HAVE_TASK_HEAP
     Vector<task_heap_element> _task_heap;
 #endif
@@ -13,6 +13,11 @@ class TimerSet { public:
 
     TimerSet();
 
+    enum { mode_heap = 0, mode_wheel = 1 };
+    int mode() const				{ return _mode; }
+    void set_mode(int mode);
+    inline unsigned size() const;
+
     Timestamp timer_expiry_steady() const	{ return _timer_expiry; }
     inline Timestamp timer_expiry_steady_adjusted() const;
 #if CLICK_USERLEVEL
@@ -54,6 +59,20 @@ class TimerSet { public:
 	}
     };
 
+    // Hierarchical timing wheel.  Level L has wheel_size slots of
+    // wheel_size^L milliseconds each.  Slots are doubly linked lists of
+    // indexes into _wheel; a negative prev names the slot whose list the
+    // element heads.  A wheel timer's _schedpos1 is its _wheel index + 1.
+    // Rescheduling a timer later leaves it in its old slot; it is refiled
+    // when the wheel reaches that slot.
+    enum { wheel_bits = 6, wheel_size = 1 << wheel_bits, wheel_levels = 8 };
+    struct wheel_element {
+	Timestamp expiry_s;
+	Timer *t;
+	int next;
+	int prev;
+    };
+
     // Most likely _timer_expiry now fits in a cache line
     Timestamp _timer_expiry CLICK_ALIGNED(8);
 
@@ -62,6 +81,13 @@ class TimerSet { public:
     unsigned _timer_count;
     Vector<heap_element> _timer_heap;
     Vector<Timer *> _timer_runchunk;
+    int _mode;
+    uint64_t _wheel_now;
+    Vector<wheel_element> _wheel;
+    int _wheel_free;
+    unsigned _wheel_count;
+    uint64_t _wheel_bitmap[wheel_levels];
+    int _wheel_head[wheel_levels * wheel_size];
     SimpleSpinlock _timer_lock;
 #if CLICK_LINUXMODULE
     struct task_struct *_timer_task;
@@ -72,15 +98,35 @@ class TimerSet { public:
     uint32_t _timer_check_reports;
 
     inline void run_one_timer(Timer *);
+    void adjust_timer_stride(const Timestamp &first_expiry);
+    void run_timers_heap(RouterThread *thread);
+    void run_timers_wheel(RouterThread *thread);
+    void run_timer_runchunk(RouterThread *thread);
 
     void set_timer_expiry() {
-	if (_timer_heap.size())
+	if (_mode == mode_wheel)
+	    wheel_set_timer_expiry();
+	else if (_timer_heap.size())
 	    _timer_expiry = _timer_heap.unchecked_at(0).expiry_s;
 	else
 	    _timer_expiry = Timestamp();
     }
     void check_timer_expiry(Timer *t);
 
+    static uint64_t wheel_tick(const Timestamp &ts) {
+	return ts.msecval();
+    }
+    void wheel_insert(Timer *t);
+    void wheel_link(int i);
+    void wheel_unlink(int i);
+    void wheel_remove(int i);
+    void wheel_cascade();
+    bool wheel_next_event(uint64_t &tick, unsigned &levels) const;
+    bool wheel_refile(int h, uint64_t end);
+    Timer *wheel_first(Timestamp &expiry);
+    void wheel_set_timer_expiry();
+    void wheel_clear();
+
     inline void lock_timers();
     inline bool attempt_lock_timers();
     inline void unlock_timers();
@@ -142,6 +188,13 @@ TimerSet::unlock_timers()
 #endif
 }
 
+/** @brief Return the number of scheduled timers. */
+inline unsigned
+TimerSet::size() const
+{
+    return _mode == mode_wheel ? _wheel_count : _timer_heap.size();
+}
+
 inline void
 TimerSet::fence()
 {
@@ -153,7 +206,12 @@ inline Timer *
 TimerSet::next_timer()
 {
     lock_timers();
-    Timer *t = _timer_heap.empty() ? 0 : _timer_heap.unchecked_at(0).t;
+    Timer *t;
+    if (_mode == mode_wheel) {
+	Timestamp expiry;
+	t = wheel_first(expiry);
+    } else
+	t = _timer_heap.empty() ? 0 : _timer_heap.unchecked_at(0).t;
     unlock_timers();
     return t;
 }
@@ -2971,6 +2971,50 @@ Element::simple_action(Packet *p)
     return p;
 }
 
+/** @brief Push a batch of packets to push input @a port.
+ *
+ * @param port the input port number on which the packets arrive
+ * @param batch the packets
+ *
+ * An upstream element transferred the packets in @a batch to this element
+ * over a push connection using Port::push_batch().  Like push(), this method
+ * must account for every packet; on return, @a batch must be empty.
+ *
+ * The default implementation removes the packets from @a batch one at a time
+ * and passes each to push(), so every element accepts batches.  Elements on
+ * hot paths override push_batch() to process a whole batch per call and
+ * forward it downstream with Port::push_batch().
+ */
+void
+Element::push_batch(int port, PacketBatch &batch)
+{
+    while (Packet *p = batch.pop_front())
+	push(port, p);
+}
+
+/** @brief Pull up to @a max packets from pull output @a port.
+ *
+ * @param port the output port number receiving the pull request
+ * @param max the maximum number of packets to return
+ * @return a batch of at most @a max packets, empty if none are available
+ *
+ * The default implementation calls pull() until it returns null or @a max
+ * packets have been collected.  Elements that store packets, such as queues,
+ * override pull_batch() to return a burst of packets in one call.
+ */
+PacketBatch
+Element::pull_batch(int port, unsigned max)
+{
+    PacketBatch batch;
+    for (; max; --max) {
+	Packet *p = pull(port);
+	if (!p)
+	    break;
+	batch.push_back(p);
+    }
+    return batch;
+}
+
 /** @brief Run the element's task.
  *
  * @return true if the task accomplished some meaningful work, false otherwise
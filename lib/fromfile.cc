@@ -24,6 +24,7 @@
 #include <click/element.hh>
 #include <click/straccum.hh>
 #include <click/userutils.hh>
+#include <click/timestamp.hh>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -31,13 +32,385 @@
 #ifdef ALLOW_MMAP
 # include <sys/mman.h>
 #endif
+#if HAVE_ZLIB
+# include <zlib.h>
+#endif
+#if HAVE_BZLIB
+# include <bzlib.h>
+#endif
+#if HAVE_USER_MULTITHREAD
+# include <pthread.h>
+#endif
 CLICK_DECLS
 
+#if HAVE_ZLIB || HAVE_BZLIB
+/* Decompresses gzip and bzip2 data in-process.  With multiple threads, a
+   helper thread decompresses ahead of the reader into a few large blocks. */
+class FromFile::Decompressor { public:
+
+    enum { f_gzip = 1, f_bzip2 = 2 };
+
+    static int format(const uint8_t *buf, uint32_t len);
+
+    Decompressor(int fd, int format, const String &initial);
+    ~Decompressor();
+
+    int start();
+    int take(unsigned char *&block);
+    int rewind();
+    const String &error() const		{ return _errmsg; }
+    double rate();
+
+  private:
+
+    enum { IN_SIZE = 262144, BLOCK_SIZE = 1048576, NBLOCKS = 4 };
+
+    int _fd;
+    int _format;
+    unsigned char *_in;
+    uint32_t _in_pos;
+    uint32_t _in_len;
+    bool _in_eof;
+    bool _member_done;
+# if HAVE_ZLIB
+    z_stream _z;
+# endif
+# if HAVE_BZLIB
+    bz_stream _bz;
+# endif
+    String _errmsg;
+    uint64_t _out_bytes;
+    Timestamp _time;
+
+# if HAVE_USER_MULTITHREAD
+    pthread_t _thread;
+    pthread_mutex_t _lock;
+    pthread_cond_t _cond;
+    unsigned char *_blocks[NBLOCKS];
+    int _block_len[NBLOCKS];
+    int _head;
+    int _count;
+    int _status;
+    bool _done;
+    bool _stop;
+    bool _running;
+
+    static void *thread_main(void *);
+    void stop();
+# endif
+
+    int init_stream();
+    void end_stream();
+    int decompress(unsigned char *buf, int len);
+    void account(int r, const Timestamp &start);
+    int fail(const char *msg);
+
+};
+
+int
+FromFile::Decompressor::format(const uint8_t *buf, uint32_t len)
+{
+# if HAVE_ZLIB
+    if (len >= 3 && buf[0] == 037 && buf[1] == 0213)
+	return f_gzip;
+# endif
+# if HAVE_BZLIB
+    if (len >= 3 && buf[0] == 'B' && buf[1] == 'Z' && buf[2] == 'h')
+	return f_bzip2;
+# endif
+    (void) buf, (void) len;
+    return 0;
+}
+
+FromFile::Decompressor::Decompressor(int fd, int format, const String &initial)
+    : _fd(fd), _format(format), _in(new unsigned char[IN_SIZE]),
+      _in_pos(0), _in_len(initial.length()), _in_eof(false),
+      _member_done(false), _out_bytes(0)
+{
+    assert(initial.length() <= IN_SIZE);
+    memcpy(_in, initial.data(), initial.length());
+# if HAVE_USER_MULTITHREAD
+    pthread_mutex_init(&_lock, 0);
+    pthread_cond_init(&_cond, 0);
+    _head = _count = _status = 0;
+    _done = _stop = _running = false;
+# endif
+}
+
+FromFile::Decompressor::~Decompressor()
+{
+# if HAVE_USER_MULTITHREAD
+    stop();
+    pthread_cond_destroy(&_cond);
+    pthread_mutex_destroy(&_lock);
+# endif
+    end_stream();
+    delete[] _in;
+}
+
+int
+FromFile::Decompressor::init_stream()
+{
+# if HAVE_ZLIB
+    if (_format == f_gzip) {
+	memset(&_z, 0, sizeof(_z));
+	// 16 + MAX_WBITS: expect a gzip header
+	if (inflateInit2(&_z, 16 + MAX_WBITS) != Z_OK)
+	    return fail("zlib initialization failed");
+    }
+# endif
+# if HAVE_BZLIB
+    if (_format == f_bzip2) {
+	memset(&_bz, 0, sizeof(_bz));
+	if (BZ2_bzDecompressInit(&_bz, 0, 0) != BZ_OK)
+	    return fail("bzip2 initialization failed");
+    }
+# endif
+    _member_done = false;
+    return 0;
+}
+
+void
+FromFile::Decompressor::end_stream()
+{
+# if HAVE_ZLIB
+    if (_format == f_gzip)
+	inflateEnd(&_z);
+# endif
+# if HAVE_BZLIB
+    if (_format == f_bzip2)
+	BZ2_bzDecompressEnd(&_bz);
+# endif
+}
+
+int
+FromFile::Decompressor::fail(const char *msg)
+{
+    _errmsg = String(msg);
+    return -1;
+}
+
+/* Fills @a buf with up to @a len bytes of decompressed data.  Returns the
+   number of bytes, 0 at end of file, or -1 on error.  Does not touch the
+   rate counters, which the helper thread must update under _lock. */
+int
+FromFile::Decompressor::decompress(unsigned char *buf, int len)
+{
+    int out = 0;
+    while (out < len) {
+	if (_in_pos == _in_len && !_in_eof) {
+	    ssize_t got = ::read(_fd, _in, IN_SIZE);
+	    if (got > 0)
+		_in_pos = 0, _in_len = got;
+	    else if (got == 0)
+		_in_eof = true;
+	    else if (errno != EINTR && errno != EAGAIN)
+		return fail(strerror(errno));
+	    continue;
+	}
+
+	if (_member_done) {
+	    // Concatenated files are concatenated streams; ignore trailing
+	    // garbage, as gzip does.
+	    if (_in_pos == _in_len
+		|| (_format == f_gzip && _in[_in_pos] != 037)) {
+		_in_eof = true;
+		_in_pos = _in_len;
+		break;
+	    }
+	    end_stream();
+	    if (init_stream() < 0)
+		return -1;
+	} else if (_in_pos == _in_len) {
+	    if (out)		// report the error on the next call
+		break;
+	    return fail("compressed data is truncated");
+	}
+
+# if HAVE_ZLIB
+	if (_format == f_gzip) {
+	    _z.next_in = _in + _in_pos;
+	    _z.avail_in = _in_len - _in_pos;
+	    _z.next_out = buf + out;
+	    _z.avail_out = len - out;
+	    int r = inflate(&_z, Z_NO_FLUSH);
+	    _in_pos = _in_len - _z.avail_in;
+	    out = len - _z.avail_out;
+	    if (r == Z_STREAM_END)
+		_member_done = true;
+	    else if (r != Z_OK && r != Z_BUF_ERROR)
+		return fail(_z.msg ? _z.msg : "bad gzip data");
+	}
+# endif
+# if HAVE_BZLIB
+	if (_format == f_bzip2) {
+	    _bz.next_in = reinterpret_cast<char *>(_in + _in_pos);
+	    _bz.avail_in = _in_len - _in_pos;
+	    _bz.next_out = reinterpret_cast<char *>(buf + out);
+	    _bz.avail_out = len - out;
+	    int r = BZ2_bzDecompress(&_bz);
+	    _in_pos = _in_len - _bz.avail_in;
+	    out = len - _bz.avail_out;
+	    if (r == BZ_STREAM_END)
+		_member_done = true;
+	    else if (r != BZ_OK)
+		return fail("bad bzip2 data");
+	}
+# endif
+    }
+    return out;
+}
+
+void
+FromFile::Decompressor::account(int r, const Timestamp &start)
+{
+    if (r > 0)
+	_out_bytes += r;
+    _time += Timestamp::now() - start;
+}
+
+# if HAVE_USER_MULTITHREAD
+void *
+FromFile::Decompressor::thread_main(void *arg)
+{
+    Decompressor *d = static_cast<Decompressor *>(arg);
+    pthread_mutex_lock(&d->_lock);
+    while (!d->_stop) {
+	if (d->_count == NBLOCKS) {
+	    pthread_cond_wait(&d->_cond, &d->_lock);
+	    continue;
+	}
+	pthread_mutex_unlock(&d->_lock);
+
+	Timestamp start = Timestamp::now();
+	unsigned char *block = (unsigned char *) malloc(BLOCK_SIZE);
+	int r = block ? d->decompress(block, BLOCK_SIZE) : d->fail(strerror(ENOMEM));
+
+	pthread_mutex_lock(&d->_lock);
+	d->account(r, start);
+	if (r > 0) {
+	    int i = (d->_head + d->_count) % NBLOCKS;
+	    d->_blocks[i] = block;
+	    d->_block_len[i] = r;
+	    ++d->_count;
+	} else
+	    free(block);
+	if (r <= 0) {
+	    d->_status = r;
+	    d->_done = true;
+	}
+	pthread_cond_broadcast(&d->_cond);
+	if (d->_done)
+	    break;
+    }
+    pthread_mutex_unlock(&d->_lock);
+    return 0;
+}
+
+void
+FromFile::Decompressor::stop()
+{
+    if (_running) {
+	pthread_mutex_lock(&_lock);
+	_stop = true;
+	pthread_cond_broadcast(&_cond);
+	pthread_mutex_unlock(&_lock);
+	pthread_join(_thread, 0);
+	_running = false;
+    }
+    for (; _count; --_count, _head = (_head + 1) % NBLOCKS)
+	free(_blocks[_head]);
+    _head = _status = 0;
+    _done = _stop = false;
+}
+# endif
+
+int
+FromFile::Decompressor::start()
+{
+    if (init_stream() < 0)
+	return -1;
+# if HAVE_USER_MULTITHREAD
+    if (pthread_create(&_thread, 0, thread_main, this) == 0)
+	_running = true;
+# endif
+    return 0;
+}
+
+/* Sets @a block to the next block of decompressed data, which the caller
+   must free().  Returns the block's length, 0 at end of file, or -1 on
+   error. */
+int
+FromFile::Decompressor::take(unsigned char *&block)
+{
+# if HAVE_USER_MULTITHREAD
+    if (_running) {
+	pthread_mutex_lock(&_lock);
+	while (!_count && !_done)
+	    pthread_cond_wait(&_cond, &_lock);
+	int r = _status;
+	if (_count) {
+	    block = _blocks[_head];
+	    r = _block_len[_head];
+	    _head = (_head + 1) % NBLOCKS;
+	    --_count;
+	    pthread_cond_broadcast(&_cond);
+	}
+	pthread_mutex_unlock(&_lock);
+	return r;
+    }
+# endif
+    if (!(block = (unsigned char *) malloc(BLOCK_SIZE)))
+	return fail(strerror(ENOMEM));
+    Timestamp start = Timestamp::now();
+    int r = decompress(block, BLOCK_SIZE);
+    account(r, start);
+    if (r <= 0)
+	free(block);
+    return r;
+}
+
+int
+FromFile::Decompressor::rewind()
+{
+# if HAVE_USER_MULTITHREAD
+    stop();
+# endif
+    if (lseek(_fd, 0, SEEK_SET) != 0)
+	return fail(strerror(errno));
+    _in_pos = _in_len = 0;
+    _in_eof = false;
+    end_stream();
+    return start();
+}
+
+double
+FromFile::Decompressor::rate()
+{
+# if HAVE_USER_MULTITHREAD
+    pthread_mutex_lock(&_lock);
+# endif
+    double t = _time.doubleval();
+    double r = t > 0 ? _out_bytes / t : 0;
+# if HAVE_USER_MULTITHREAD
+    pthread_mutex_unlock(&_lock);
+# endif
+    return r;
+}
+
+static void
+free_destructor(unsigned char *data, size_t, void *)
+{
+    free(data);
+}
+#endif
+
 FromFile::FromFile()
     : _fd(-1), _buffer(0), _data_packet(0),
 #ifdef ALLOW_MMAP
       _mmap(true),
 #endif
+      _decomp(0), _decompress(true),
       _filename(), _pipe(0), _landmark_pattern("%f"), _lineno(0)
 {
 }
@@ -52,6 +425,7 @@ FromFile::configure_keywords(Vector<String> &conf, Element *e, ErrorHandler *err
 #endif
     if (Args(e, errh).bind(conf)
 	.read("MMAP", mmap)
+	.read("DECOMPRESS", _decompress)
 	.consume() < 0)
 	return -1;
 #ifdef ALLOW_MMAP
@@ -185,6 +559,24 @@ FromFile::read_buffer(ErrorHandler *errh)
     if (_fd < 0)
 	return -EBADF;
 
+#if HAVE_ZLIB || HAVE_BZLIB
+    if (_decomp) {
+	unsigned char *block;
+	int r = _decomp->take(block);
+	if (r < 0)
+	    return error(errh, "%s", _decomp->error().c_str());
+	else if (r == 0)
+	    return 0;
+	if (!(_data_packet = Packet::make(block, r, free_destructor, 0))) {
+	    free(block);
+	    return error(errh, "%s", strerror(ENOMEM));
+	}
+	_buffer = _data_packet->data();
+	_len = r;
+	return _len;
+    }
+#endif
+
 #ifdef ALLOW_MMAP
     if (_mmap) {
 	int result = read_buffer_mmap(errh);
@@ -199,7 +591,7 @@ FromFile::read_buffer(ErrorHandler *errh)
 
     _data_packet = Packet::make(0, 0, BUFFER_SIZE, 0);
     if (!_data_packet)
-	return error(errh, strerror(ENOMEM));
+	return error(errh, "%s", strerror(ENOMEM));
     _buffer = _data_packet->data();
     unsigned char *data = _data_packet->data();
     assert(_data_packet->headroom() == 0);
@@ -316,10 +708,33 @@ int
 FromFile::seek(off_t want, ErrorHandler* errh)
 {
     if (want >= _file_offset && want < (off_t) (_file_offset + _len)) {
-	_pos = want;
+	_pos = want - _file_offset;
 	return 0;
     }
 
+#if HAVE_ZLIB || HAVE_BZLIB
+    if (_decomp) {
+	if (want < _file_offset) {
+	    if (_decomp->rewind() < 0)
+		return error(errh, "%s", _decomp->error().c_str());
+	    if (_data_packet)
+		_data_packet->kill();
+	    _data_packet = 0;
+	    _file_offset = 0;
+	    _pos = _len = 0;
+	}
+	while (want >= (off_t) (_file_offset + _len)) {
+	    int r = read_buffer(errh);
+	    if (r < 0)
+		return -1;
+	    else if (r == 0)
+		break;
+	}
+	_pos = want - _file_offset;
+	return 0;
+    }
+#endif
+
 #ifdef ALLOW_MMAP
     if (_mmap) {
 	_mmap_off = (want / _mmap_unit) * _mmap_unit;
@@ -383,9 +798,23 @@ FromFile::initialize(ErrorHandler *errh, bool allow_nonexistent)
     }
 
     // check for a gziped or bzip2d dump
-    if (_fd == STDIN_FILENO || _pipe)
+    if (_pipe || _decomp || !compressed_data(_buffer, _len))
+	/* nothing to do */;
+#if HAVE_ZLIB || HAVE_BZLIB
+    else if (int format = (_decompress ? Decompressor::format(_buffer, _len) : 0)) {
+	// If the file cannot seek, as with stdin, hand over what we read.
+	String initial;
+	if (lseek(_fd, 0, SEEK_SET) != 0)
+	    initial = String((const char *) _buffer, _len);
+	_decomp = new Decompressor(_fd, format, initial);
+	if (_decomp->start() < 0)
+	    return error(errh, "%s", _decomp->error().c_str());
+	goto retry_file;
+    }
+#endif
+    else if (_fd == STDIN_FILENO)
 	/* cannot handle gzip or bzip2 */;
-    else if (compressed_data(_buffer, _len)) {
+    else {
 	close(_fd);
 	_fd = -1;
 	if (!(_pipe = open_uncompress_pipe(_filename, _buffer, _len, errh)))
@@ -411,6 +840,9 @@ FromFile::take_state(FromFile &o, ErrorHandler *errh)
 
     _data_packet = o._data_packet;
     o._data_packet = 0;
+    _decomp = o._decomp;
+    o._decomp = 0;
+    _decompress = o._decompress;
 
 #ifdef ALLOW_MMAP
     if (_mmap != o._mmap)
@@ -428,6 +860,10 @@ FromFile::take_state(FromFile &o, ErrorHandler *errh)
 void
 FromFile::cleanup()
 {
+#if HAVE_ZLIB || HAVE_BZLIB
+    delete _decomp;
+#endif
+    _decomp = 0;
     if (_pipe)
 	pclose(_pipe);
     else if (_fd >= 0 && _fd != STDIN_FILENO)
@@ -557,7 +993,8 @@ FromFile::filesize_handler(Element *e, void *thunk)
 {
     FromFile *fd = reinterpret_cast<FromFile *>((uint8_t *)e + (intptr_t)thunk);
     struct stat s;
-    if (fd->_fd >= 0 && fstat(fd->_fd, &s) >= 0 && S_ISREG(s.st_mode))
+    if (fd->_fd >= 0 && !fd->_decomp
+	&& fstat(fd->_fd, &s) >= 0 && S_ISREG(s.st_mode))
 	return String(s.st_size);
     else
 	return "-";
@@ -570,6 +1007,18 @@ FromFile::filepos_handler(Element* e, void* thunk)
     return String(fd->_file_offset + fd->_pos);
 }
 
+String
+FromFile::decompress_handler(Element *e, void *thunk)
+{
+    FromFile *fd = reinterpret_cast<FromFile *>((uint8_t *)e + (intptr_t)thunk);
+#if HAVE_ZLIB || HAVE_BZLIB
+    if (fd->_decomp)
+	return String(fd->_decomp->rate());
+#endif
+    (void) fd;
+    return "-";
+}
+
 int
 FromFile::filepos_write_handler(const String& str, Element* e, void* thunk, ErrorHandler* errh)
 {
@@ -587,6 +1036,7 @@ FromFile::add_handlers(Element* e, bool filepos_writable) const
     e->add_read_handler("filename", filename_handler, (void *)offset);
     e->add_read_handler("filesize", filesize_handler, (void *)offset);
     e->add_read_handler("filepos", filepos_handler, (void *)offset);
+    e->add_read_handler("decompress_rate", decompress_handler, (void *)offset);
     if (filepos_writable)
 	e->add_write_handler("filepos", filepos_write_handler, (void *)offset);
 }
@@ -113,6 +113,61 @@ Master::unuse()
 	delete this;
 }
 
+
+// QUIESCENT STATES
+
+/** @brief Record every thread's quiescent-state counter in @a epochs.
+ *
+ * A thread passes through a quiescent state, where it runs no element code,
+ * once per driver loop iteration.  Lock-free readers can use this to reclaim
+ * memory: publish a new version of a structure, take a snapshot, and free
+ * the old version once wait_quiescent() on the snapshot returns, since no
+ * thread can still be reading it. */
+void
+Master::quiescent_snapshot(Vector<uint32_t> &epochs) const
+{
+    click_fence();
+    epochs.resize(_nthreads);
+    for (int i = 0; i < _nthreads; ++i)
+	epochs[i] = _threads[i]->_quiescent_epoch;
+}
+
+/** @brief Return true iff every other thread has passed through a quiescent
+ * state since @a epochs was taken with quiescent_snapshot().
+ *
+ * The calling thread is not checked. */
+bool
+Master::quiescent_since(const Vector<uint32_t> &epochs) const
+{
+    for (int i = 0; i < epochs.size() && i < _nthreads; ++i)
+	if (!(epochs[i] & 1)
+	    && _threads[i]->_quiescent_epoch == epochs[i]
+	    && !_threads[i]->current_thread_is_running())
+	    return false;
+    return true;
+}
+
+/** @brief Wait until quiescent_since(@a epochs) is true.
+ *
+ * Wakes sleeping threads so they reach a quiescent state quickly.  Do not
+ * call this while the master is paused, since paused threads may not
+ * advance. */
+void
+Master::wait_quiescent(const Vector<uint32_t> &epochs)
+{
+    if (quiescent_since(epochs))
+	return;
+    for (int i = 0; i < _nthreads; ++i)
+	_threads[i]->wake();
+    while (!quiescent_since(epochs)) {
+#if CLICK_LINUXMODULE
+	schedule();
+#else
+	click_relax_fence();
+#endif
+    }
+}
+
 void
 Master::pause()
 {
@@ -22,6 +22,7 @@
 #define CLICK_PACKET_DEPRECATED_ENUM
 #include <click/packet.hh>
 #include <click/packet_anno.hh>
+#include <click/packetbatch.hh>
 #include <click/glue.hh>
 #include <click/sync.hh>
 #if CLICK_USERLEVEL
@@ -255,9 +256,14 @@ struct PacketPool {
 #  if HAVE_MULTITHREAD
     PacketPool* thread_pool_next; // link to next per-thread pool
 #  endif
+    Packet::PoolStats stats;    // updated only by the owning thread, unlocked
 };
 }
 
+// Maximum # packets (and # data buffers) kept in each thread's pool.
+// Adjustable at run time with Packet::set_pool_capacity().
+static unsigned packet_pool_capacity = CLICK_PACKET_POOL_SIZE;
+
 #  if HAVE_MULTITHREAD
 static __thread PacketPool *thread_packet_pool;
 
@@ -272,6 +278,16 @@ struct GlobalPacketPool {
     volatile uint32_t lock;
 };
 static GlobalPacketPool global_packet_pool;
+
+static inline void lock_global_packet_pool() {
+    while (atomic_uint32_t::swap(global_packet_pool.lock, 1) == 1)
+	/* do nothing */;
+}
+
+static inline void unlock_global_packet_pool() {
+    click_compiler_fence();
+    global_packet_pool.lock = 0;
+}
 #else
 static PacketPool global_packet_pool;
 #  endif
@@ -293,13 +309,11 @@ static inline PacketPool* make_local_packet_pool() {
     PacketPool *pp = thread_packet_pool;
     if (!pp && (pp = new PacketPool)) {
 	memset(pp, 0, sizeof(PacketPool));
-	while (atomic_uint32_t::swap(global_packet_pool.lock, 1) == 1)
-	    /* do nothing */;
+	lock_global_packet_pool();
 	pp->thread_pool_next = global_packet_pool.thread_pools;
 	global_packet_pool.thread_pools = pp;
 	thread_packet_pool = pp;
-	click_compiler_fence();
-	global_packet_pool.lock = 0;
+	unlock_global_packet_pool();
     }
     return pp;
 #  else
@@ -318,8 +332,7 @@ WritablePacket::pool_allocate(bool with_data)
     // the local pool.
     if ((!packet_pool.p && global_packet_pool.pbatch)
 	|| (with_data && !packet_pool.pd && global_packet_pool.pdbatch)) {
-	while (atomic_uint32_t::swap(global_packet_pool.lock, 1) == 1)
-	    /* do nothing */;
+	lock_global_packet_pool();
 
 	WritablePacket *pp;
 	if (!packet_pool.p && (pp = global_packet_pool.pbatch)) {
@@ -327,6 +340,7 @@ WritablePacket::pool_allocate(bool with_data)
 	    --global_packet_pool.pbatchcount;
 	    packet_pool.p = pp;
 	    packet_pool.pcount = pp->anno_u32(0);
+	    ++packet_pool.stats.steals;
 	}
 
 	PacketData *pd;
@@ -335,10 +349,10 @@ WritablePacket::pool_allocate(bool with_data)
 	    --global_packet_pool.pdbatchcount;
 	    packet_pool.pd = pd;
 	    packet_pool.pdcount = pd->batch_pdcount;
+	    ++packet_pool.stats.steals;
 	}
 
-	click_compiler_fence();
-	global_packet_pool.lock = 0;
+	unlock_global_packet_pool();
     }
 #  endif /* HAVE_MULTITHREAD */
 
@@ -346,8 +360,11 @@ WritablePacket::pool_allocate(bool with_data)
     if (p) {
 	packet_pool.p = static_cast<WritablePacket*>(p->next());
 	--packet_pool.pcount;
-    } else
+	++packet_pool.stats.hits;
+    } else {
 	p = new WritablePacket;
+	++packet_pool.stats.mallocs;
+    }
     return p;
 }
 
@@ -366,9 +383,10 @@ WritablePacket::pool_allocate(uint32_t headroom, uint32_t length,
 	if (n == CLICK_PACKET_POOL_BUFSIZ && (pd = packet_pool.pd)) {
 	    packet_pool.pd = pd->next;
 	    --packet_pool.pdcount;
+	    ++packet_pool.stats.data_hits;
 	    p->_head = reinterpret_cast<unsigned char *>(pd);
 	} else if ((p->_head = new unsigned char[n]))
-	    /* OK */;
+	    ++packet_pool.stats.data_mallocs;
 	else {
 	    delete p;
 	    return 0;
@@ -380,67 +398,73 @@ WritablePacket::pool_allocate(uint32_t headroom, uint32_t length,
     return p;
 }
 
-void
-WritablePacket::recycle(WritablePacket *p)
-{
-    unsigned char *data = 0;
-    if (!p->_data_packet && p->_head && !p->_destructor
-	&& p->_end - p->_head == CLICK_PACKET_POOL_BUFSIZ) {
-	data = p->_head;
-	p->_head = 0;
-    }
-    p->~WritablePacket();
+/** @brief Return packet @a p and its data buffer @a data (if any) to
+    @a packet_pool.
 
-    PacketPool& packet_pool = *make_local_packet_pool();
+    Overflowing thread pools are handed to the global pool, which requires
+    the global lock.  @a locked tracks whether this thread holds that lock,
+    so a caller freeing many packets acquires it at most once; the caller
+    must release it if @a locked is true on return. */
+static inline void
+pool_release(PacketPool& packet_pool, WritablePacket *p, unsigned char *data,
+	     bool &locked)
+{
+    unsigned capacity = packet_pool_capacity;
 #  if HAVE_MULTITHREAD
-    if ((packet_pool.p && packet_pool.pcount == CLICK_PACKET_POOL_SIZE)
-	|| (data && packet_pool.pd && packet_pool.pdcount == CLICK_PACKET_POOL_SIZE)) {
-	while (atomic_uint32_t::swap(global_packet_pool.lock, 1) == 1)
-	    /* do nothing */;
+    if ((packet_pool.p && packet_pool.pcount >= capacity)
+	|| (data && packet_pool.pd && packet_pool.pdcount >= capacity)) {
+	if (!locked) {
+	    lock_global_packet_pool();
+	    locked = true;
+	}
 
-	if (packet_pool.p && packet_pool.pcount == CLICK_PACKET_POOL_SIZE) {
+	if (packet_pool.p && packet_pool.pcount >= capacity) {
 	    if (global_packet_pool.pbatchcount == CLICK_GLOBAL_PACKET_POOL_COUNT) {
 		while (WritablePacket *p = packet_pool.p) {
 		    packet_pool.p = static_cast<WritablePacket *>(p->next());
 		    ::operator delete((void *) p);
 		}
+		packet_pool.stats.frees += packet_pool.pcount;
 	    } else {
 		packet_pool.p->set_prev(global_packet_pool.pbatch);
                 packet_pool.p->set_anno_u32(0, packet_pool.pcount);
 		global_packet_pool.pbatch = packet_pool.p;
 		++global_packet_pool.pbatchcount;
 		packet_pool.p = 0;
+		++packet_pool.stats.releases;
 	    }
 	    packet_pool.pcount = 0;
 	}
 
-	if (data && packet_pool.pd && packet_pool.pdcount == CLICK_PACKET_POOL_SIZE) {
+	if (data && packet_pool.pd && packet_pool.pdcount >= capacity) {
 	    if (global_packet_pool.pdbatchcount == CLICK_GLOBAL_PACKET_POOL_COUNT) {
 		while (PacketData *pd = packet_pool.pd) {
 		    packet_pool.pd = pd->next;
 		    delete[] reinterpret_cast<unsigned char *>(pd);
 		}
+		packet_pool.stats.frees += packet_pool.pdcount;
 	    } else {
 		packet_pool.pd->batch_next = global_packet_pool.pdbatch;
                 packet_pool.pd->batch_pdcount = packet_pool.pdcount;
 		global_packet_pool.pdbatch = packet_pool.pd;
 		++global_packet_pool.pdbatchcount;
 		packet_pool.pd = 0;
+		++packet_pool.stats.releases;
 	    }
 	    packet_pool.pdcount = 0;
 	}
-
-	click_compiler_fence();
-	global_packet_pool.lock = 0;
     }
 #  else /* !HAVE_MULTITHREAD */
-    if (packet_pool.pcount == CLICK_PACKET_POOL_SIZE) {
+    (void) locked;
+    if (packet_pool.pcount >= capacity) {
 	::operator delete((void *) p);
 	p = 0;
+	++packet_pool.stats.frees;
     }
-    if (data && packet_pool.pdcount == CLICK_PACKET_POOL_SIZE) {
+    if (data && packet_pool.pdcount >= capacity) {
 	delete[] data;
 	data = 0;
+	++packet_pool.stats.frees;
     }
 #  endif /* HAVE_MULTITHREAD */
 
@@ -448,15 +472,142 @@ WritablePacket::recycle(WritablePacket *p)
 	++packet_pool.pcount;
 	p->set_next(packet_pool.p);
 	packet_pool.p = p;
-	assert(packet_pool.pcount <= CLICK_PACKET_POOL_SIZE);
+	assert(packet_pool.pcount <= capacity);
     }
     if (data) {
 	++packet_pool.pdcount;
 	PacketData *pd = reinterpret_cast<PacketData *>(data);
 	pd->next = packet_pool.pd;
 	packet_pool.pd = pd;
-	assert(packet_pool.pdcount <= CLICK_PACKET_POOL_SIZE);
+	assert(packet_pool.pdcount <= capacity);
+    }
+}
+
+void
+WritablePacket::recycle(WritablePacket *p)
+{
+    unsigned char *data = 0;
+    if (!p->_data_packet && p->_head && !p->_destructor
+	&& p->_end - p->_head == CLICK_PACKET_POOL_BUFSIZ) {
+	data = p->_head;
+	p->_head = 0;
+    }
+    p->~WritablePacket();
+
+    bool locked = false;
+    pool_release(*make_local_packet_pool(), p, data, locked);
+#  if HAVE_MULTITHREAD
+    if (locked)
+	unlock_global_packet_pool();
+#  endif
+}
+
+/** @brief Kill every packet in the next()-linked list starting at @a head.
+
+    Equivalent to calling kill() on each packet, but looks up the thread
+    pool once and usually takes the global pool lock at most once for the
+    list.  The lock is dropped before destroying clones and packets with
+    destructors, since those may free other packets. */
+void
+WritablePacket::recycle_list(Packet *head)
+{
+    PacketPool& packet_pool = *make_local_packet_pool();
+    bool locked = false;
+    while (Packet *x = head) {
+	head = x->next();
+	if (!x->_use_count.dec_and_test())
+	    continue;
+	WritablePacket *p = static_cast<WritablePacket *>(x);
+	unsigned char *data = 0;
+	if (!p->_data_packet && p->_head && !p->_destructor
+	    && p->_end - p->_head == CLICK_PACKET_POOL_BUFSIZ) {
+	    data = p->_head;
+	    p->_head = 0;
+	}
+#  if HAVE_MULTITHREAD
+	// Killing a clone's data packet, or calling a destructor, may free
+	// packets through recycle(), which takes the global lock itself.
+	if (locked && (p->_data_packet || p->_destructor)) {
+	    unlock_global_packet_pool();
+	    locked = false;
+	}
+#  endif
+	p->~WritablePacket();
+	pool_release(packet_pool, p, data, locked);
     }
+#  if HAVE_MULTITHREAD
+    if (locked)
+	unlock_global_packet_pool();
+#  endif
+}
+
+/** @brief Return statistics for the packet pools in @a stats.
+
+    Counters are summed over all threads' pools.  Each thread updates its
+    own counters without synchronization, so with several threads the sums
+    are approximate, and may even miss recent updates entirely. */
+void
+Packet::pool_stats(PoolStats &stats)
+{
+    memset(&stats, 0, sizeof(stats));
+#  if HAVE_MULTITHREAD
+    lock_global_packet_pool();
+    for (PacketPool *pp = global_packet_pool.thread_pools; pp;
+	 pp = pp->thread_pool_next) {
+#  else
+    {
+	PacketPool *pp = &global_packet_pool;
+#  endif
+	stats.hits += pp->stats.hits;
+	stats.data_hits += pp->stats.data_hits;
+	stats.mallocs += pp->stats.mallocs;
+	stats.data_mallocs += pp->stats.data_mallocs;
+	stats.steals += pp->stats.steals;
+	stats.releases += pp->stats.releases;
+	stats.frees += pp->stats.frees;
+	stats.pcount += pp->pcount;
+	stats.pdcount += pp->pdcount;
+    }
+#  if HAVE_MULTITHREAD
+    unlock_global_packet_pool();
+#  endif
+}
+
+/** @brief Reset the packet pool statistics counters.
+
+    Increments made concurrently by other threads may be lost or may
+    survive the reset; the counters are approximate. */
+void
+Packet::pool_reset_stats()
+{
+#  if HAVE_MULTITHREAD
+    lock_global_packet_pool();
+    for (PacketPool *pp = global_packet_pool.thread_pools; pp;
+	 pp = pp->thread_pool_next)
+	memset(&pp->stats, 0, sizeof(pp->stats));
+    unlock_global_packet_pool();
+#  else
+    memset(&global_packet_pool.stats, 0, sizeof(global_packet_pool.stats));
+#  endif
+}
+
+/** @brief Return the maximum number of packets kept in each thread's pool.
+
+    The same limit applies separately to pooled data buffers. */
+unsigned
+Packet::pool_capacity()
+{
+    return packet_pool_capacity;
+}
+
+/** @brief Set the maximum number of packets kept in each thread's pool.
+    @param capacity new capacity, at least 1
+
+    Pools already larger than @a capacity shrink as packets are freed. */
+void
+Packet::set_pool_capacity(unsigned capacity)
+{
+    packet_pool_capacity = capacity ? capacity : 1;
 }
 
 # endif /* HAVE_PACKET_POOL */
@@ -967,8 +1118,6 @@ cleanup_pool(PacketPool *pp, int global)
 	pp->pd = pd->next;
 	delete[] reinterpret_cast<unsigned char *>(pd);
     }
-    assert(pcount <= CLICK_PACKET_POOL_SIZE);
-    assert(pdcount <= CLICK_PACKET_POOL_SIZE);
     assert(global || (pcount == pp->pcount && pdcount == pp->pdcount));
 }
 #endif
@@ -1003,4 +1152,44 @@ Packet::static_cleanup()
 #endif
 }
 
+
+/** @brief Create and return a batch of @a n new packets.
+ * @param n number of packets
+ * @param headroom headroom in each new packet
+ * @param data data to be copied into each new packet
+ * @param length length of each packet
+ * @param tailroom tailroom in each new packet
+ *
+ * Each packet is created as by Packet::make(@a headroom, @a data, @a length,
+ * @a tailroom).  If memory runs out, the returned batch holds fewer than @a n
+ * packets. */
+PacketBatch
+PacketBatch::make(int n, uint32_t headroom, const void *data,
+		  uint32_t length, uint32_t tailroom)
+{
+    PacketBatch batch;
+    for (; n > 0; --n) {
+	WritablePacket *p = Packet::make(headroom, data, length, tailroom);
+	if (!p)
+	    break;
+	batch.push_back(p);
+    }
+    return batch;
+}
+
+/** @brief Free all packets in the batch and make it empty.
+ *
+ * Equivalent to calling Packet::kill() on each packet. */
+void
+PacketBatch::kill()
+{
+#if HAVE_CLICK_PACKET_POOL
+    WritablePacket::recycle_list(_head);
+    clear();
+#else
+    while (Packet *p = pop_front())
+	p->kill();
+#endif
+}
+
 CLICK_ENDDECLS
@@ -2186,7 +2186,9 @@ Router::configuration_string() const
 enum { GH_VERSION, GH_CONFIG, GH_FLATCONFIG, GH_LIST, GH_REQUIREMENTS,
        GH_DRIVER, GH_ACTIVE_PORTS, GH_ACTIVE_PORT_STATS, GH_STRING_PROFILE,
        GH_STRING_PROFILE_LONG, GH_SCHEDULING_PROFILE, GH_STOP,
-       GH_ELEMENT_CYCLES, GH_CLASS_CYCLES, GH_RESET_CYCLES };
+       GH_ELEMENT_CYCLES, GH_CLASS_CYCLES, GH_RESET_CYCLES,
+       GH_PACKET_POOL_STATS, GH_PACKET_POOL_CAPACITY,
+       GH_PACKET_POOL_RESET_STATS };
 
 #if CLICK_STATS >= 2
 struct stats_info {
@@ -2280,6 +2282,26 @@ Router::router_read_handler(Element *e, void *thunk)
 	break;
 #endif
 
+#if HAVE_CLICK_PACKET_POOL
+    case GH_PACKET_POOL_STATS: {
+	Packet::PoolStats ps;
+	Packet::pool_stats(ps);
+	sa << "hits " << ps.hits << '\n'
+	   << "data_hits " << ps.data_hits << '\n'
+	   << "mallocs " << ps.mallocs << '\n'
+	   << "data_mallocs " << ps.data_mallocs << '\n'
+	   << "steals " << ps.steals << '\n'
+	   << "releases " << ps.releases << '\n'
+	   << "frees " << ps.frees << '\n'
+	   << "pooled " << ps.pcount << '\n'
+	   << "data_pooled " << ps.pdcount << '\n';
+	break;
+    }
+
+    case GH_PACKET_POOL_CAPACITY:
+	return String(Packet::pool_capacity());
+#endif
+
 #if CLICK_DEBUG_MASTER || CLICK_DEBUG_SCHEDULING
     case GH_SCHEDULING_PROFILE:
 	if (r)
@@ -2396,6 +2418,18 @@ Router::router_write_handler(const String &s, Element *e, void *thunk, ErrorHand
 	for (int i = 0; i < (r ? r->nelements() : 0); i++)
 	    r->_elements[i]->reset_cycles();
 	break;
+#endif
+#if HAVE_CLICK_PACKET_POOL
+    case GH_PACKET_POOL_CAPACITY: {
+	unsigned capacity;
+	if (!IntArg().parse(s, capacity) || capacity == 0)
+	    return errh->error("expected positive integer");
+	Packet::set_pool_capacity(capacity);
+	break;
+    }
+    case GH_PACKET_POOL_RESET_STATS:
+	Packet::pool_reset_stats();
+	break;
 #endif
     default:
 	break;
@@ -2433,6 +2467,12 @@ Router::static_initialize()
         add_read_handler(0, "element_cycles.csv", router_read_handler, (void *)GH_ELEMENT_CYCLES);
         add_read_handler(0, "class_cycles.csv", router_read_handler, (void *)GH_CLASS_CYCLES);
         add_write_handler(0, "reset_cycles", router_write_handler, (void *)GH_RESET_CYCLES);
+#endif
+#if HAVE_CLICK_PACKET_POOL
+	add_read_handler(0, "packet_pool_stats", router_read_handler, (void *)GH_PACKET_POOL_STATS);
+	add_read_handler(0, "packet_pool_capacity", router_read_handler, (void *)GH_PACKET_POOL_CAPACITY);
+	add_write_handler(0, "packet_pool_capacity", router_write_handler, (void *)GH_PACKET_POOL_CAPACITY);
+	add_write_handler(0, "packet_pool_reset_stats", router_write_handler, (void *)GH_PACKET_POOL_RESET_STATS);
 #endif
     }
 }
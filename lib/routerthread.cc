@@ -115,6 +115,8 @@ RouterThread::RouterThread(Master *master, int id)
     _ns_active_iter = 0;
 #endif
 
+    _quiescent_epoch = 1;
+
 #if CLICK_DEBUG_SCHEDULING
     _thread_state = S_BLOCKED;
     _driver_epoch = 0;
@@ -141,6 +143,10 @@ RouterThread::driver_lock_tasks()
 {
     set_thread_state(S_LOCKTASKS);
 
+    // We are between tasks, so in a quiescent state; mark it before waiting
+    // in case somebody else holds the task lock for a while.
+    _quiescent_epoch += 2;
+
     // If other people are waiting for the task lock, give them a chance to
     // catch it before we claim it.
 #if CLICK_LINUXMODULE
@@ -600,6 +606,7 @@ RouterThread::driver()
     }
 #endif
 
+    ++_quiescent_epoch;		// now running
     driver_lock_tasks();
 
 #if HAVE_ADAPTIVE_SCHEDULER
@@ -615,6 +622,10 @@ RouterThread::driver()
 	_driver_epoch++;
 #endif
 
+	// quiescent state: no element code is running on this thread
+	_quiescent_epoch += 2;
+	click_fence();
+
 #if !BSD_NETISRSCHED
 	// check to see if driver is stopped
 	if (_stop_flag > 0) {
@@ -683,6 +694,7 @@ RouterThread::driver()
     }
 
     driver_unlock_tasks();
+    ++_quiescent_epoch;		// no longer running
 
 #if HAVE_ADAPTIVE_SCHEDULER
     _cur_click_share = 0;
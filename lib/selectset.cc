@@ -33,6 +33,9 @@
 #  define EV_SET_UDATA_CAST	/* nothing */
 # endif
 #endif
+#if HAVE_ALLOW_EPOLL
+# include <sys/epoll.h>
+#endif
 CLICK_DECLS
 
 namespace {
@@ -58,6 +61,10 @@ SelectSet::SelectSet()
 # endif
 #endif
 
+#if HAVE_ALLOW_EPOLL
+    _epoll = epoll_create1(EPOLL_CLOEXEC);
+#endif
+
 #if !HAVE_ALLOW_POLL
     FD_ZERO(&_read_select_fd_set);
     FD_ZERO(&_write_select_fd_set);
@@ -85,6 +92,10 @@ SelectSet::~SelectSet()
 #if HAVE_ALLOW_KQUEUE
     if (_kqueue >= 0)
 	close(_kqueue);
+#endif
+#if HAVE_ALLOW_EPOLL
+    if (_epoll >= 0)
+	close(_epoll);
 #endif
     if (_wake_pipe[0] >= 0) {
 	close(_wake_pipe[0]);
@@ -105,6 +116,64 @@ SelectSet::initialize()
     assert(_wake_pipe[0] >= 0);
 }
 
+/** @brief Return the name of the mechanism used to wait for events.
+ *
+ * The result is "kqueue", "epoll", "poll", or "select". */
+const char *
+SelectSet::mechanism() const
+{
+#if HAVE_ALLOW_KQUEUE
+    if (_kqueue >= 0)
+	return "kqueue";
+#endif
+#if HAVE_ALLOW_EPOLL
+    if (_epoll >= 0)
+	return "epoll";
+#endif
+#if HAVE_ALLOW_POLL
+    return "poll";
+#else
+    return "select";
+#endif
+}
+
+#if HAVE_ALLOW_EPOLL
+/** @brief Stop using epoll and fall back to poll() or select().
+ *
+ * Registered file descriptors remain registered. */
+void
+SelectSet::disable_epoll()
+{
+    lock();
+    if (_epoll >= 0) {
+	close(_epoll);
+	_epoll = -1;
+    }
+    unlock();
+}
+
+void
+SelectSet::update_epoll(int fd, int old_events, int new_events)
+{
+    if (old_events == new_events)
+	return;
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = (new_events & POLLIN ? (uint32_t) EPOLLIN : 0)
+	| (new_events & POLLOUT ? (uint32_t) EPOLLOUT : 0);
+    ev.data.fd = fd;
+    int op = (!old_events ? EPOLL_CTL_ADD
+	      : new_events ? EPOLL_CTL_MOD : EPOLL_CTL_DEL);
+    if (epoll_ctl(_epoll, op, fd, &ev) < 0 && op != EPOLL_CTL_DEL) {
+	// Not all file descriptors are epollable (regular files, for
+	// example).  So if we encounter a problem, fall back to select() or
+	// poll(), which see every registered descriptor.
+	close(_epoll);
+	_epoll = -1;
+    }
+}
+#endif
+
 void
 SelectSet::kill_router(Router *router)
 {
@@ -138,6 +207,9 @@ SelectSet::register_select(int fd, bool add_read, bool add_write)
 	_pollfds.back().events = 0;
     }
     int pi = _selinfo[fd].pollfd;
+#if HAVE_ALLOW_EPOLL
+    int old_events = _pollfds[pi].events;
+#endif
 
     // add the elements
     if (add_read)
@@ -145,6 +217,11 @@ SelectSet::register_select(int fd, bool add_read, bool add_write)
     if (add_write)
 	_pollfds[pi].events |= POLLOUT;
 
+#if HAVE_ALLOW_EPOLL
+    if (_epoll >= 0)
+	update_epoll(fd, old_events, _pollfds[pi].events);
+#endif
+
 #if HAVE_ALLOW_KQUEUE
     if (_kqueue >= 0) {
 	// Add events to the kqueue
@@ -179,13 +256,10 @@ SelectSet::register_select(int fd, bool add_read, bool add_write)
 	    _max_select_fd = fd;
     } else {
 	static int warned = 0;
-# if HAVE_ALLOW_KQUEUE
-	if (_kqueue < 0)
-# endif
-	    if (!warned) {
-		click_chatter("SelectSet::add_select(%d): fd >= FD_SETSIZE", fd);
-		warned = 1;
-	    }
+	if (!warned && strcmp(mechanism(), "select") == 0) {
+	    click_chatter("SelectSet::add_select(%d): fd >= FD_SETSIZE", fd);
+	    warned = 1;
+	}
     }
 #endif
 
@@ -252,12 +326,20 @@ SelectSet::remove_pollfd(int pi, int event)
 
     // remove event
     int fd = _pollfds[pi].fd;
+#if HAVE_ALLOW_EPOLL
+    int old_events = _pollfds[pi].events;
+#endif
     _pollfds[pi].events &= ~event;
     if (event == POLLIN)
 	_selinfo[fd].read = 0;
     else
 	_selinfo[fd].write = 0;
 
+#if HAVE_ALLOW_EPOLL
+    if (_epoll >= 0)
+	update_epoll(fd, old_events, _pollfds[pi].events);
+#endif
+
 #if HAVE_ALLOW_KQUEUE
     // remove event from kqueue
     if (_kqueue >= 0) {
@@ -424,6 +506,50 @@ SelectSet::run_selects_kqueue(RouterThread *thread)
 }
 #endif /* HAVE_ALLOW_KQUEUE */
 
+#if HAVE_ALLOW_EPOLL
+void
+SelectSet::run_selects_epoll(RouterThread *thread)
+{
+# if HAVE_MULTITHREAD
+    click_fence();
+    _select_lock.release();
+# endif
+
+    // Decide how long to wait.
+    int timeout;
+    Timestamp t;
+    int delay_type = thread->timer_set().next_timer_delay(thread->active(), t);
+    if (delay_type == 0)
+	timeout = 0;
+    else if (delay_type > 0)
+	timeout = (t.sec() >= INT_MAX / 1000 ? INT_MAX - 1000 : t.msecval());
+    else
+	timeout = -1;
+    thread->set_thread_state_for_blocking(delay_type);
+
+    // Unlike poll(), epoll_wait() reports only ready descriptors, so the
+    // cost of this call does not grow with the number of selectors.
+    struct epoll_event ev[256];
+    int n = epoll_wait(_epoll, &ev[0], 256, timeout);
+    int was_errno = errno;
+
+    if (post_select(thread, true))
+	return;
+
+    thread->set_thread_state(RouterThread::S_RUNSELECT);
+    if (n < 0 && was_errno != EINTR)
+	perror("epoll_wait");
+    else if (n > 0)
+	for (struct epoll_event *p = &ev[0]; p < &ev[n]; ++p) {
+	    // call_selected() checks _selinfo, so it is safe if an earlier
+	    // selected() call removed this fd.
+	    int mask = (p->events & ~EPOLLOUT ? Element::SELECT_READ : 0)
+		+ (p->events & ~EPOLLIN ? Element::SELECT_WRITE : 0);
+	    call_selected(p->data.fd, mask);
+	}
+}
+#endif /* HAVE_ALLOW_EPOLL */
+
 #if HAVE_ALLOW_POLL
 void
 SelectSet::run_selects_poll(RouterThread *thread)
@@ -577,6 +703,12 @@ SelectSet::run_selects(RouterThread *thread)
 	    break;
 	}
 #endif
+#if HAVE_ALLOW_EPOLL
+	if (_epoll >= 0) {
+	    run_selects_epoll(thread);
+	    break;
+	}
+#endif
 #if HAVE_ALLOW_POLL
 	run_selects_poll(thread);
 #else
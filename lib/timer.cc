@@ -163,7 +163,9 @@ CLICK_DECLS
 
  The Click core stores timers in a heap, so most timer operations (including
  scheduling and unscheduling) take @e O(log @e n) time and Click can handle
- very large numbers of timers.
+ very large numbers of timers.  A thread's TimerSet can instead use a
+ hierarchical timing wheel, where these operations take @e O(1) time; see
+ TimerSet::set_mode().
 
  Timers generally run in increasing order by expiration time.  That is, if
  timer @a a's expiry() is less than timer @a b's expiry(), then @a a will
@@ -271,7 +273,29 @@ Timer::schedule_at_steady(const Timestamp &when)
     // any reschedule removes a timer from the runchunk (XXX -- even backwards
     // reschedulings)
     int old_schedpos1 = _schedpos1;
-    if (_schedpos1 <= 0) {
+    if (ts._mode == TimerSet::mode_wheel) {
+	if (_schedpos1 > 0) {
+	    // a later expiry can stay filed in the earlier slot until the
+	    // wheel reaches it
+	    TimerSet::wheel_element &w = ts._wheel.unchecked_at(_schedpos1 - 1);
+	    bool earlier = _expiry_s < w.expiry_s;
+	    if (earlier)
+		ts.wheel_unlink(_schedpos1 - 1);
+	    w.expiry_s = _expiry_s;
+	    if (earlier)
+		ts.wheel_link(_schedpos1 - 1);
+	} else {
+	    if (_schedpos1 < 0)
+		ts._timer_runchunk[-_schedpos1 - 1] = 0;
+	    ts.wheel_insert(this);
+	}
+	if (!ts._timer_expiry || _expiry_s < ts._timer_expiry) {
+	    ts._timer_expiry = _expiry_s;
+	    _thread->wake();
+	}
+	ts.unlock_timers();
+	return;
+    } else if (_schedpos1 <= 0) {
 	if (_schedpos1 < 0)
 	    ts._timer_runchunk[-_schedpos1 - 1] = 0;
 	_schedpos1 = ts._timer_heap.size() + 1;
@@ -306,7 +330,10 @@ Timer::unschedule()
     TimerSet &ts = _thread->timer_set();
     ts.lock_timers();
     int old_schedpos1 = _schedpos1;
-    if (_schedpos1 > 0) {
+    if (_schedpos1 > 0 && ts._mode == TimerSet::mode_wheel)
+	// leave _timer_expiry early; run_timers will correct it
+	ts.wheel_remove(_schedpos1 - 1);
+    else if (_schedpos1 > 0) {
 	remove_heap<4>(ts._timer_heap.begin(), ts._timer_heap.end(),
 		       ts._timer_heap.begin() + _schedpos1 - 1,
 		       TimerSet::heap_less(), TimerSet::heap_place());
@@ -48,6 +48,9 @@ TimerSet::TimerSet()
 #endif
     _timer_check = Timestamp::now_steady();
     _timer_check_reports = 0;
+
+    _mode = mode_heap;
+    wheel_clear();
 }
 
 void
@@ -55,6 +58,13 @@ TimerSet::kill_router(Router *router)
 {
     lock_timers();
     assert(!_timer_runchunk.size());
+    for (int i = 0; i < _wheel.size(); ++i)
+	if (Timer *t = _wheel.unchecked_at(i).t)
+	    if (t->router() == router) {
+		wheel_remove(i);
+		t->_owner = 0;
+		t->_schedpos1 = 0;
+	    }
     for (heap_element *thp = _timer_heap.end();
 	 thp > _timer_heap.begin(); ) {
 	--thp;
@@ -78,6 +88,259 @@ TimerSet::set_max_timer_stride(unsigned timer_stride)
 	_timer_stride = _max_timer_stride;
 }
 
+/** @brief Set how this TimerSet stores timers.
+ * @param mode mode_heap or mode_wheel
+ *
+ * mode_heap, the default, keeps timers in a 4-ary heap: scheduling and
+ * unscheduling take O(log n) time, and timers fire in strict expiration
+ * order.  mode_wheel keeps timers in a hierarchical timing wheel with
+ * millisecond slots: scheduling and unscheduling take O(1) time, which
+ * suits configurations with hundreds of thousands of timers, such as
+ * per-flow state.  Timers due within the same millisecond still fire in
+ * expiration order, and no timer fires before its expiration time.
+ *
+ * Scheduled timers move to the new structure. */
+void
+TimerSet::set_mode(int mode)
+{
+    lock_timers();
+    if (mode != _mode) {
+	Vector<Timer *> timers;
+	for (heap_element *thp = _timer_heap.begin(); thp != _timer_heap.end(); ++thp)
+	    timers.push_back(thp->t);
+	for (wheel_element *w = _wheel.begin(); w != _wheel.end(); ++w)
+	    if (w->t)
+		timers.push_back(w->t);
+	_timer_heap.clear();
+	wheel_clear();
+
+	_mode = mode;
+	for (Timer **tp = timers.begin(); tp != timers.end(); ++tp)
+	    if (_mode == mode_wheel)
+		wheel_insert(*tp);
+	    else {
+		(*tp)->_schedpos1 = _timer_heap.size() + 1;
+		_timer_heap.push_back(heap_element(*tp));
+		push_heap<4>(_timer_heap.begin(), _timer_heap.end(),
+			     heap_less(), heap_place());
+	    }
+	set_timer_expiry();
+    }
+    unlock_timers();
+}
+
+void
+TimerSet::wheel_clear()
+{
+    _wheel.clear();
+    _wheel_free = -1;
+    _wheel_count = 0;
+    _wheel_now = wheel_tick(Timestamp::now_steady());
+    for (int l = 0; l < wheel_levels; ++l)
+	_wheel_bitmap[l] = 0;
+    for (int h = 0; h < wheel_levels * wheel_size; ++h)
+	_wheel_head[h] = -1;
+}
+
+void
+TimerSet::wheel_insert(Timer *t)
+{
+    // an empty wheel may have fallen far behind
+    if (!_wheel_count)
+	_wheel_now = wheel_tick(Timestamp::now_steady());
+    int i = _wheel_free;
+    if (i >= 0)
+	_wheel_free = _wheel.unchecked_at(i).next;
+    else {
+	i = _wheel.size();
+	_wheel.push_back(wheel_element());
+    }
+    wheel_element &w = _wheel.unchecked_at(i);
+    w.expiry_s = t->_expiry_s;
+    w.t = t;
+    wheel_link(i);
+    t->_schedpos1 = i + 1;
+    ++_wheel_count;
+}
+
+void
+TimerSet::wheel_link(int i)
+{
+    wheel_element &w = _wheel.unchecked_at(i);
+    uint64_t tick = wheel_tick(w.expiry_s);
+    if (tick < _wheel_now)
+	tick = _wheel_now;
+    // the level is chosen by distance from _wheel_now, so a slot is
+    // cascaded exactly when its time window begins
+    uint64_t delta = tick - _wheel_now;
+    int level = 0;
+    while (level < wheel_levels - 1
+	   && delta >= ((uint64_t) 1 << (wheel_bits * (level + 1))))
+	++level;
+    int slot = (tick >> (wheel_bits * level)) & (wheel_size - 1);
+    int h = level * wheel_size + slot;
+    w.prev = -1 - h;
+    w.next = _wheel_head[h];
+    if (w.next >= 0)
+	_wheel.unchecked_at(w.next).prev = i;
+    _wheel_head[h] = i;
+    _wheel_bitmap[level] |= (uint64_t) 1 << slot;
+}
+
+void
+TimerSet::wheel_unlink(int i)
+{
+    wheel_element &w = _wheel.unchecked_at(i);
+    if (w.next >= 0)
+	_wheel.unchecked_at(w.next).prev = w.prev;
+    if (w.prev >= 0)
+	_wheel.unchecked_at(w.prev).next = w.next;
+    else {
+	int h = -1 - w.prev;
+	_wheel_head[h] = w.next;
+	if (w.next < 0)
+	    _wheel_bitmap[h / wheel_size] &= ~((uint64_t) 1 << (h % wheel_size));
+    }
+}
+
+void
+TimerSet::wheel_remove(int i)
+{
+    wheel_unlink(i);
+    wheel_element &w = _wheel.unchecked_at(i);
+    w.t = 0;
+    w.next = _wheel_free;
+    _wheel_free = i;
+    if (!--_wheel_count)
+	_timer_expiry = Timestamp();
+}
+
+/* Redistribute the higher-level slots whose windows begin at _wheel_now. */
+void
+TimerSet::wheel_cascade()
+{
+    for (int l = 1; l < wheel_levels; ++l) {
+	int shift = wheel_bits * l;
+	if (_wheel_now & (((uint64_t) 1 << shift) - 1))
+	    break;
+	int slot = (_wheel_now >> shift) & (wheel_size - 1);
+	int h = l * wheel_size + slot;
+	int i = _wheel_head[h];
+	_wheel_head[h] = -1;
+	_wheel_bitmap[l] &= ~((uint64_t) 1 << slot);
+	while (i >= 0) {
+	    int next = _wheel.unchecked_at(i).next;
+	    wheel_link(i);
+	    i = next;
+	}
+    }
+}
+
+/* Find the first tick at or after _wheel_now at which the wheel has work:
+   a level-0 slot to run, or a higher-level slot to cascade.  Bit L of
+   levels is set if level L has work at that tick. */
+bool
+TimerSet::wheel_next_event(uint64_t &tick, unsigned &levels) const
+{
+    levels = 0;
+    for (int l = 0; l < wheel_levels; ++l) {
+	uint64_t bm = _wheel_bitmap[l];
+	if (!bm)
+	    continue;
+	int shift = wheel_bits * l;
+	uint64_t window = _wheel_now >> shift;
+	int cur = window & (wheel_size - 1);
+	// level 0's current slot is due now; a higher level's current slot
+	// was already cascaded and next comes due a full turn later
+	int first = (l == 0 ? cur : cur + 1);
+	uint64_t later = first < wheel_size ? bm & (~(uint64_t) 0 << first) : 0;
+	uint64_t w = window & ~(uint64_t) (wheel_size - 1);
+	if (later)
+	    w += ffs_lsb(later) - 1;
+	else
+	    w += wheel_size + ffs_lsb(bm) - 1;
+	if (!levels || (w << shift) < tick) {
+	    tick = w << shift;
+	    levels = 1 << l;
+	} else if ((w << shift) == tick)
+	    levels |= 1 << l;
+    }
+    return levels != 0;
+}
+
+/* A reschedule to a later time leaves the timer filed in its old, earlier
+   slot.  Refile the timers in slot h that are due after the slot's window,
+   which ends at tick end.  Return true if any moved. */
+bool
+TimerSet::wheel_refile(int h, uint64_t end)
+{
+    bool moved = false;
+    for (int i = _wheel_head[h]; i >= 0; ) {
+	int next = _wheel.unchecked_at(i).next;
+	if (wheel_tick(_wheel.unchecked_at(i).expiry_s) >= end) {
+	    wheel_unlink(i);
+	    wheel_link(i);
+	    moved = true;
+	}
+	i = next;
+    }
+    return moved;
+}
+
+/* Return the scheduled timer with the earliest expiration, or null. */
+Timer *
+TimerSet::wheel_first(Timestamp &expiry)
+{
+    uint64_t tick;
+    unsigned levels;
+    while (1) {
+	if (!wheel_next_event(tick, levels))
+	    return 0;
+	if (levels & ~1U) {
+	    // Nothing is due before this cascade, so cascade now, even if
+	    // its time has not come.  Timers scheduled for earlier ticks
+	    // meanwhile join the current slot, which is checked exactly.
+	    _wheel_now = tick;
+	    wheel_cascade();
+	} else if (!wheel_refile(tick & (wheel_size - 1), tick + 1))
+	    break;
+    }
+
+    // no timer in a later slot can expire before those in this one
+    int h = tick & (wheel_size - 1);
+    Timer *first = _wheel.unchecked_at(_wheel_head[h]).t;
+    expiry = _wheel.unchecked_at(_wheel_head[h]).expiry_s;
+    for (int i = _wheel_head[h]; i >= 0; i = _wheel.unchecked_at(i).next)
+	if (_wheel.unchecked_at(i).expiry_s < expiry) {
+	    first = _wheel.unchecked_at(i).t;
+	    expiry = _wheel.unchecked_at(i).expiry_s;
+	}
+    return first;
+}
+
+void
+TimerSet::wheel_set_timer_expiry()
+{
+    uint64_t tick;
+    unsigned levels;
+    while (1) {
+	if (!wheel_next_event(tick, levels))
+	    _timer_expiry = Timestamp();
+	else if (levels == 1) {
+	    // level-0 slots are small, so find the exact expiry
+	    if (wheel_refile(tick & (wheel_size - 1), tick + 1))
+		continue;
+	    wheel_first(_timer_expiry);
+	} else {
+	    // wake up for the cascade; this may be early, never late
+	    _timer_expiry = Timestamp::make_msec(tick);
+	    if (!_timer_expiry)
+		_timer_expiry = Timestamp::epsilon();
+	}
+	break;
+    }
+}
+
 void
 TimerSet::check_timer_expiry(Timer *t)
 {
@@ -110,12 +373,164 @@ TimerSet::run_one_timer(Timer *t)
 #endif
 }
 
+void
+TimerSet::adjust_timer_stride(const Timestamp &first_expiry)
+{
+    Timestamp adj_expiry = first_expiry + Timer::adjustment();
+    if (adj_expiry <= _timer_check) {
+	_timer_count = 0;
+	if (_timer_stride > 1)
+	    _timer_stride = (_timer_stride * 4) / 5;
+    } else if (++_timer_count >= 12) {
+	_timer_count = 0;
+	if (++_timer_stride >= _max_timer_stride)
+	    _timer_stride = _max_timer_stride;
+    }
+}
+
+/* Run the timers collected in _timer_runchunk.  A timer rescheduled or
+   unscheduled meanwhile has its entry cleared. */
+void
+TimerSet::run_timer_runchunk(RouterThread *thread)
+{
+    Vector<Timer*>::iterator i = _timer_runchunk.begin();
+    for (; !thread->stop_flag() && i != _timer_runchunk.end(); ++i)
+	if (*i) {
+	    (*i)->_schedpos1 = 0;
+	    run_one_timer(*i);
+	}
+
+    // reschedule unrun timers if stopped early
+    for (; i != _timer_runchunk.end(); ++i)
+	if (*i) {
+	    (*i)->_schedpos1 = 0;
+	    (*i)->schedule_at_steady((*i)->_expiry_s);
+	}
+    _timer_runchunk.clear();
+}
+
+void
+TimerSet::run_timers_heap(RouterThread *thread)
+{
+    heap_element *th = _timer_heap.begin();
+
+    if (th->expiry_s <= _timer_check) {
+	// potentially adjust timer stride
+	adjust_timer_stride(th->expiry_s);
+
+	// actually run timers
+	int max_timers = 64;
+	do {
+	    Timer *t = th->t;
+	    assert(t->expiry_steady() == th->expiry_s);
+	    pop_heap<4>(_timer_heap.begin(), _timer_heap.end(), heap_less(), heap_place());
+	    _timer_heap.pop_back();
+	    set_timer_expiry();
+	    t->_schedpos1 = 0;
+
+	    run_one_timer(t);
+	} while (_timer_heap.size() > 0 && !thread->stop_flag()
+		 && (th = _timer_heap.begin(), th->expiry_s <= _timer_check)
+		 && --max_timers >= 0);
+
+	// If we ran out of timers to run, then perhaps there's an
+	// infinite timer loop or one timer is very far behind system
+	// time.  Eventually the system would catch up and run all timers,
+	// but in the meantime other timers could starve.  We detect this
+	// case and run ALL expired timers, reducing possible damage.
+	if (max_timers < 0 && !thread->stop_flag()) {
+	    _timer_runchunk.reserve(32);
+	    do {
+		Timer *t = th->t;
+		pop_heap<4>(_timer_heap.begin(), _timer_heap.end(), heap_less(), heap_place());
+		_timer_heap.pop_back();
+		t->_schedpos1 = -_timer_runchunk.size() - 1;
+
+		_timer_runchunk.push_back(t);
+	    } while (_timer_heap.size() > 0
+		     && (th = _timer_heap.begin(), th->expiry_s <= _timer_check));
+	    set_timer_expiry();
+
+	    run_timer_runchunk(thread);
+	}
+    }
+}
+
+static int
+timer_expiry_compar(const void *a, const void *b, void *)
+{
+    const Timer *ta = *reinterpret_cast<Timer * const *>(a);
+    const Timer *tb = *reinterpret_cast<Timer * const *>(b);
+    if (ta->expiry_steady() != tb->expiry_steady())
+	return ta->expiry_steady() < tb->expiry_steady() ? -1 : 1;
+    return ta < tb ? -1 : (ta != tb);
+}
+
+void
+TimerSet::run_timers_wheel(RouterThread *thread)
+{
+    // _timer_expiry is never later than the first event
+    if (_timer_expiry > _timer_check)
+	return;
+    adjust_timer_stride(_timer_expiry);
+
+    // Walk the wheel up to the current tick, one event at a time.  Each
+    // level-0 slot holds the timers of a single tick; those that have
+    // expired run as one chunk, sorted by expiration.
+    uint64_t now_tick = wheel_tick(_timer_check);
+    while (_mode == mode_wheel && !thread->stop_flag()) {
+	int h = _wheel_now & (wheel_size - 1);
+	for (int i = _wheel_head[h]; i >= 0; ) {
+	    wheel_element &w = _wheel.unchecked_at(i);
+	    int next = w.next;
+	    if (w.expiry_s <= _timer_check) {
+		_timer_runchunk.push_back(w.t);
+		wheel_remove(i);
+	    } else if (wheel_tick(w.expiry_s) > _wheel_now) {
+		wheel_unlink(i);
+		wheel_link(i);
+	    }
+	    i = next;
+	}
+	if (_timer_runchunk.size()) {
+	    if (_timer_runchunk.size() > 1)
+		click_qsort(_timer_runchunk.begin(), _timer_runchunk.size(),
+			    sizeof(Timer *), timer_expiry_compar);
+	    for (int j = 0; j < _timer_runchunk.size(); ++j)
+		_timer_runchunk[j]->_schedpos1 = -j - 1;
+	    set_timer_expiry();
+	    run_timer_runchunk(thread);
+	}
+	if (_wheel_now >= now_tick || _mode != mode_wheel || thread->stop_flag())
+	    break;
+
+	// Timers the callbacks scheduled at or before this tick wait in its
+	// slot; carry them along to the next tick visited.
+	int carry = _wheel_head[h];
+	_wheel_head[h] = -1;
+	_wheel_bitmap[0] &= ~((uint64_t) 1 << h);
+
+	uint64_t tick;
+	unsigned levels;
+	if (!wheel_next_event(tick, levels) || tick > now_tick)
+	    tick = now_tick;	// nothing happens in between, so skip ahead
+	_wheel_now = tick;
+	wheel_cascade();
+	while (carry >= 0) {
+	    int next = _wheel.unchecked_at(carry).next;
+	    wheel_link(carry);
+	    carry = next;
+	}
+    }
+    set_timer_expiry();
+}
+
 void
 TimerSet::run_timers(RouterThread *thread, Master *master)
 {
     if (!_timer_lock.attempt())
 	return;
-    if (!master->paused() && _timer_heap.size() > 0 && !thread->stop_flag()) {
+    if (!master->paused() && size() > 0 && !thread->stop_flag()) {
 	thread->set_thread_state(RouterThread::S_RUNTIMER);
 #if CLICK_LINUXMODULE
 	_timer_task = current;
@@ -123,70 +538,11 @@ TimerSet::run_timers(RouterThread *thread, Master *master)
 	_timer_processor = click_current_processor();
 #endif
 	_timer_check = Timestamp::now_steady();
-	heap_element *th = _timer_heap.begin();
-
-	if (th->expiry_s <= _timer_check) {
-	    // potentially adjust timer stride
-	    Timestamp adj_expiry = th->expiry_s + Timer::adjustment();
-	    if (adj_expiry <= _timer_check) {
-		_timer_count = 0;
-		if (_timer_stride > 1)
-		    _timer_stride = (_timer_stride * 4) / 5;
-	    } else if (++_timer_count >= 12) {
-		_timer_count = 0;
-		if (++_timer_stride >= _max_timer_stride)
-		    _timer_stride = _max_timer_stride;
-	    }
-
-	    // actually run timers
-	    int max_timers = 64;
-	    do {
-		Timer *t = th->t;
-		assert(t->expiry_steady() == th->expiry_s);
-		pop_heap<4>(_timer_heap.begin(), _timer_heap.end(), heap_less(), heap_place());
-		_timer_heap.pop_back();
-		set_timer_expiry();
-		t->_schedpos1 = 0;
 
-		run_one_timer(t);
-	    } while (_timer_heap.size() > 0 && !thread->stop_flag()
-		     && (th = _timer_heap.begin(), th->expiry_s <= _timer_check)
-		     && --max_timers >= 0);
-
-	    // If we ran out of timers to run, then perhaps there's an
-	    // infinite timer loop or one timer is very far behind system
-	    // time.  Eventually the system would catch up and run all timers,
-	    // but in the meantime other timers could starve.  We detect this
-	    // case and run ALL expired timers, reducing possible damage.
-	    if (max_timers < 0 && !thread->stop_flag()) {
-		_timer_runchunk.reserve(32);
-		do {
-		    Timer *t = th->t;
-		    pop_heap<4>(_timer_heap.begin(), _timer_heap.end(), heap_less(), heap_place());
-		    _timer_heap.pop_back();
-		    t->_schedpos1 = -_timer_runchunk.size() - 1;
-
-		    _timer_runchunk.push_back(t);
-		} while (_timer_heap.size() > 0
-			 && (th = _timer_heap.begin(), th->expiry_s <= _timer_check));
-		set_timer_expiry();
-
-		Vector<Timer*>::iterator i = _timer_runchunk.begin();
-		for (; !thread->stop_flag() && i != _timer_runchunk.end(); ++i)
-		    if (*i) {
-			(*i)->_schedpos1 = 0;
-			run_one_timer(*i);
-		    }
-
-		// reschedule unrun timers if stopped early
-		for (; i != _timer_runchunk.end(); ++i)
-		    if (*i) {
-			(*i)->_schedpos1 = 0;
-			(*i)->schedule_at_steady((*i)->_expiry_s);
-		    }
-		_timer_runchunk.clear();
-	    }
-	}
+	if (_mode == mode_wheel)
+	    run_timers_wheel(thread);
+	else
+	    run_timers_heap(thread);
 
 #if CLICK_LINUXMODULE
 	_timer_task = 0;
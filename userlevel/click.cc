@@ -74,6 +74,7 @@ CLICK_USING_DECLS
 #define THREADS_OPT		316
 #define SIMTIME_OPT		317
 #define SOCKET_OPT		318
+#define TIMER_WHEEL_OPT		319
 
 static const Clp_Option options[] = {
     { "allow-reconfigure", 'R', ALLOW_RECONFIG_OPT, 0, Clp_Negate },
@@ -90,6 +91,7 @@ static const Clp_Option options[] = {
     { "simulation-time", 0, SIMTIME_OPT, Clp_ValDouble, Clp_Optional },
     { "threads", 'j', THREADS_OPT, Clp_ValInt, 0 },
     { "time", 't', TIME_OPT, 0, 0 },
+    { "timer-wheel", 0, TIMER_WHEEL_OPT, 0, Clp_Negate },
     { "unix-socket", 'u', UNIX_SOCKET_OPT, Clp_ValString, 0 },
     { "version", 'v', VERSION_OPT, 0, 0 },
     { "warnings", 0, WARNINGS_OPT, 0, Clp_Negate },
@@ -121,6 +123,7 @@ Options:\n\
   -f, --file FILE               Read router configuration from FILE.\n\
   -e, --expression EXPR         Use EXPR as router configuration.\n\
   -j, --threads N               Start N threads (default 1).\n\
+      --timer-wheel             Keep timers in timing wheels, not heaps.\n\
   -p, --port PORT               Listen for control connections on TCP port.\n\
   -u, --unix-socket FILE        Listen for control connections on Unix socket.\n\
       --socket FD               Add a file descriptor control connection.\n\
@@ -296,6 +299,7 @@ static Vector<String> cs_ports;
 static Vector<String> cs_sockets;
 static bool warnings = true;
 static int nthreads = 1;
+static bool timer_wheel = false;
 
 static String
 click_driver_control_socket_name(int number)
@@ -315,6 +319,9 @@ parse_configuration(const String &text, bool text_is_expr, bool hotswap,
 	master = router->master();
     else
 	master = new_master = new Master(nthreads);
+    if (new_master && timer_wheel)
+	for (int t = -1; t < master->nthreads(); ++t)
+	    master->thread(t)->timer_set().set_mode(TimerSet::mode_wheel);
 
     Router *r = click_read_router(text, text_is_expr, errh, false, master);
     if (!r) {
@@ -564,6 +571,10 @@ main(int argc, char **argv)
 #endif
       break;
 
+    case TIMER_WHEEL_OPT:
+      timer_wheel = !clp->negated;
+      break;
+
     case SIMTIME_OPT: {
 	Timestamp::warp_set_class(Timestamp::warp_simulation);
 	Timestamp simbegin(clp->have_val ? clp->val.d : 1000000000);